@@ -38,6 +38,19 @@ typedef void b2FreeFcn(void* mem);
 ///	set during application startup.
 B2_API void b2SetAllocator(b2AllocFcn* allocFcn, b2FreeFcn* freeFcn);
 
+/// Prototype for a world allocation function. This receives every allocation made by a world,
+/// possibly from worker threads, so it must be thread-safe.
+///	@param size the allocation size in bytes
+///	@param alignment the required alignment, guaranteed to be a power of 2
+///	@param context the allocator context provided in the world definition
+typedef void* b2WorldAllocFcn(uint32_t size, int32_t alignment, void* context);
+
+/// Prototype for a world free function.
+///	@param mem the memory previously allocated through `b2WorldAllocFcn`
+///	@param size the size that was passed to `b2WorldAllocFcn`
+///	@param context the allocator context provided in the world definition
+typedef void b2WorldFreeFcn(void* mem, uint32_t size, void* context);
+
 /// Total bytes allocated by Box2D
 B2_API uint32_t b2GetByteCount(void);
 
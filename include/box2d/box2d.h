@@ -39,6 +39,30 @@ B2_API void b2DestroyWorld(b2WorldId worldId);
 /// @param relaxIterations for reducing constraint bounce solver.
 B2_API void b2World_Step(b2WorldId worldId, float timeStep, int32_t velocityIterations, int32_t relaxIterations);
 
+/// Start a time step and return without waiting for it. The world is locked until b2World_WaitStep,
+/// so only call b2World_WaitStep on this world in the meantime. With the built-in task system the step
+/// runs on its own thread and still uses all workers. With a user task system the step is enqueued as
+/// a single task and is single-threaded, so it gives up the parallelism of b2World_Step in exchange for
+/// the overlap. Without a task system the step runs synchronously before this returns.
+B2_API void b2World_StepAsync(b2WorldId worldId, float timeStep, int32_t velocityIterations, int32_t relaxIterations);
+
+/// Wait for the step started by b2World_StepAsync to finish and unlock the world. Does nothing if
+/// no step is in flight.
+B2_API void b2World_WaitStep(b2WorldId worldId);
+
+/// Step many independent worlds at once. Each world is a task item of a single parallel-for on the
+/// given task system, so the serial parts of one world overlap with the work of other worlds. This
+/// suits many small worlds. The step of a world inside the parallel-for is single-threaded: it uses
+/// one worker, whatever its own task system. The exception is a world holding more than half of the
+/// bodies, or a lone world. It takes the normal step on its own task system from the calling thread
+/// while the other worlds run. If enqueueTask or finishTask is NULL the worlds are stepped in turn on
+/// the calling thread and use their own task systems.
+/// Locked worlds, such as a world with an async step in flight or a world listed twice, are skipped.
+/// @return the number of worlds that were stepped
+B2_API int32_t b2StepWorlds(const b2WorldId* worldIds, int32_t worldCount, float timeStep, int32_t velocityIterations,
+							int32_t relaxIterations, b2EnqueueTaskCallback* enqueueTask, b2FinishTaskCallback* finishTask,
+							void* userTaskContext);
+
 /// Call this to draw shapes and other debug draw data. This is intentionally non-const.
 B2_API void b2World_Draw(b2WorldId worldId, b2DebugDraw* debugDraw);
 
@@ -96,6 +120,14 @@ B2_API void b2World_EnableWarmStarting(b2WorldId worldId, bool flag);
 /// Enable/disable continuous collision. Advanced feature for testing.
 B2_API void b2World_EnableContinuous(b2WorldId worldId, bool flag);
 
+/// Set how often the awake bodies are sorted spatially for the solver, see b2WorldDef::spatialSortInterval.
+/// Zero disables sorting.
+B2_API void b2World_SetSpatialSortInterval(b2WorldId worldId, int32_t interval);
+
+/// Set how many bodies may be in the islands split per time step, see b2WorldDef::islandSplitBudget.
+/// Zero splits one island per step.
+B2_API void b2World_SetIslandSplitBudget(b2WorldId worldId, int32_t bodyCount);
+
 /// Adjust the restitution threshold. Advanced feature for testing.
 B2_API void b2World_SetRestitutionThreshold(b2WorldId worldId, float value);
 
@@ -112,6 +144,18 @@ B2_API b2Profile b2World_GetProfile(b2WorldId worldId);
 /// Get counters and sizes
 B2_API b2Counters b2World_GetCounters(b2WorldId worldId);
 
+/// Get the memory used by a world, broken down by subsystem
+B2_API b2MemoryStats b2World_GetMemoryStats(b2WorldId worldId);
+
+/// Release memory that is no longer needed, for example after a level unload or an explosion.
+/// Containers only shrink if less than half is used, keeping some headroom. Live objects
+/// keep their ids. Ids of destroyed objects must not be used after this call.
+/// @param defragment also move bodies together in memory, grouped by island, and re-link free
+/// slots so new objects fill the lowest indices first. Best done when the world is quiet,
+/// for example after a level load.
+///	Advanced feature
+B2_API void b2World_Compact(b2WorldId worldId, bool defragment);
+
 /** @} */
 
 /**
@@ -305,6 +349,11 @@ B2_API b2ShapeId b2CreateCapsuleShape(b2BodyId bodyId, const b2ShapeDef* def, co
 ///	@return the shape id for accessing the shape
 B2_API b2ShapeId b2CreatePolygonShape(b2BodyId bodyId, const b2ShapeDef* def, const b2Polygon* polygon);
 
+/// Create a height field shape and attach it to a static body. The shape definition and geometry are fully cloned,
+/// including the height samples. Contacts are not created until the next time step.
+///	@return the shape id for accessing the shape
+B2_API b2ShapeId b2CreateHeightfieldShape(b2BodyId bodyId, const b2ShapeDef* def, const b2Heightfield* heightfield);
+
 /// Destroy any shape type
 B2_API void b2DestroyShape(b2ShapeId shapeId);
 
@@ -365,6 +414,9 @@ B2_API const b2Segment* b2Shape_GetSegment(b2ShapeId shapeId);
 /// Access the smooth line segment geometry of a shape. These come from chain shapes.
 B2_API const b2SmoothSegment* b2Shape_GetSmoothSegment(b2ShapeId shapeId);
 
+/// Access the height field geometry of a shape.
+B2_API const b2Heightfield* b2Shape_GetHeightfield(b2ShapeId shapeId);
+
 /// Access the capsule geometry of a shape.
 B2_API const b2Capsule* b2Shape_GetCapsule(b2ShapeId shapeId);
 
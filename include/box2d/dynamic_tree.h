@@ -48,6 +48,9 @@ typedef struct b2TreeNode
 ///	spatial game data besides rigid bodies.
 typedef struct b2DynamicTree
 {
+	/// Trees owned by a world allocate through the world allocator
+	struct b2Allocator* allocator;
+
 	b2TreeNode* nodes;
 
 	int32_t root;
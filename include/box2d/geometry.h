@@ -77,6 +77,28 @@ typedef struct b2SmoothSegment
 	int32_t chainIndex;
 } b2SmoothSegment;
 
+/// A height field for static terrain. The heights are sampled along the local x-axis starting
+/// at the origin, one sample every cellWidth. The region between the surface and minHeight is solid and
+/// collision is one-sided from above. Height fields do not have mass and must be used on static bodies.
+/// @warning use b2MakeHeightfield to fill this out
+typedef struct b2Heightfield
+{
+	/// The height samples. This is copied when the shape is created.
+	const float* heights;
+
+	/// The number of height samples, must be 2 or more
+	int32_t count;
+
+	/// The horizontal spacing between samples
+	float cellWidth;
+
+	/// The bottom of the solid region, below the lowest sample
+	float minHeight;
+
+	/// The highest sample, used for bounding
+	float maxHeight;
+} b2Heightfield;
+
 /// Validate ray cast input data (NaN, etc)
 B2_API bool b2IsValidRay(const b2RayCastInput* input);
 
@@ -98,6 +120,10 @@ B2_API b2Polygon b2MakeRoundedBox(float hx, float hy, float radius);
 /// Make an offset box, bypassing the need for a convex hull.
 B2_API b2Polygon b2MakeOffsetBox(float hx, float hy, b2Vec2 center, float angle);
 
+/// Make a height field from an array of height samples. The samples are referenced, not copied.
+/// The solid region reaches below the lowest sample by the width of the height field.
+B2_API b2Heightfield b2MakeHeightfield(const float* heights, int32_t count, float cellWidth);
+
 /// Transform a polygon. This is useful for transfering a shape from one body to another.
 B2_API b2Polygon b2TransformPolygon(b2Transform transform, const b2Polygon* polygon);
 
@@ -122,6 +148,9 @@ B2_API b2AABB b2ComputePolygonAABB(const b2Polygon* shape, b2Transform transform
 /// Compute the bounding box of a transformed line segment
 B2_API b2AABB b2ComputeSegmentAABB(const b2Segment* shape, b2Transform transform);
 
+/// Compute the bounding box of a transformed height field
+B2_API b2AABB b2ComputeHeightfieldAABB(const b2Heightfield* shape, b2Transform transform);
+
 /// Test a point for overlap with a circle in local space
 B2_API bool b2PointInCircle(b2Vec2 point, const b2Circle* shape);
 
@@ -144,6 +173,9 @@ B2_API b2RayCastOutput b2RayCastSegment(const b2RayCastInput* input, const b2Seg
 /// Ray cast versus polygon in shape local space. Initial overlap is treated as a miss.
 B2_API b2RayCastOutput b2RayCastPolygon(const b2RayCastInput* input, const b2Polygon* shape);
 
+/// Ray cast versus a height field in shape local space. Hits from below the surface are treated as a miss.
+B2_API b2RayCastOutput b2RayCastHeightfield(const b2RayCastInput* input, const b2Heightfield* shape);
+
 /// Shape cast versus a circle. Initial overlap is treated as a miss.
 B2_API b2RayCastOutput b2ShapeCastCircle(const b2ShapeCastInput* input, const b2Circle* shape);
 
@@ -155,3 +187,6 @@ B2_API b2RayCastOutput b2ShapeCastSegment(const b2ShapeCastInput* input, const b
 
 /// Shape cast versus a convex polygon. Initial overlap is treated as a miss.
 B2_API b2RayCastOutput b2ShapeCastPolygon(const b2ShapeCastInput* input, const b2Polygon* shape);
+
+/// Shape cast versus a height field. Initial overlap is treated as a miss.
+B2_API b2RayCastOutput b2ShapeCastHeightfield(const b2ShapeCastInput* input, const b2Heightfield* shape);
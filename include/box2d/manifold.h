@@ -8,6 +8,7 @@
 typedef struct b2Circle b2Circle;
 typedef struct b2Capsule b2Capsule;
 typedef struct b2DistanceCache b2DistanceCache;
+typedef struct b2Heightfield b2Heightfield;
 typedef struct b2Polygon b2Polygon;
 typedef struct b2Segment b2Segment;
 typedef struct b2SmoothSegment b2SmoothSegment;
@@ -33,7 +34,7 @@ typedef struct b2ManifoldPoint
 	float tangentImpulse;
 
 	/// uniquely identifies a contact point between two shapes
-	uint16_t id;
+	uint32_t id;
 
 	/// did this contact point exist the previous step?
 	bool persisted;
@@ -96,3 +97,15 @@ B2_API b2Manifold b2CollideSmoothSegmentAndCapsule(const b2SmoothSegment* segmen
 /// Compute the collision manifold between a smooth segment and a rounded polygon.
 B2_API b2Manifold b2CollideSmoothSegmentAndPolygon(const b2SmoothSegment* segmentA, b2Transform xfA, const b2Polygon* polygonB,
 													  b2Transform xfB, b2DistanceCache* cache);
+
+/// Compute the collision manifold between a height field and a circle.
+B2_API b2Manifold b2CollideHeightfieldAndCircle(const b2Heightfield* heightfieldA, b2Transform xfA, const b2Circle* circleB,
+												   b2Transform xfB);
+
+/// Compute the collision manifold between a height field and a capsule.
+B2_API b2Manifold b2CollideHeightfieldAndCapsule(const b2Heightfield* heightfieldA, b2Transform xfA, const b2Capsule* capsuleB,
+													b2Transform xfB, b2DistanceCache* cache);
+
+/// Compute the collision manifold between a height field and a rounded polygon.
+B2_API b2Manifold b2CollideHeightfieldAndPolygon(const b2Heightfield* heightfieldA, b2Transform xfA, const b2Polygon* polygonB,
+													b2Transform xfB, b2DistanceCache* cache);
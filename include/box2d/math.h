@@ -173,17 +173,32 @@ static inline float b2DistanceSquared(b2Vec2 a, b2Vec2 b)
 	return c.x * c.x + c.y * c.y;
 }
 
+/// Compute a rotation from an angle in radians using only basic arithmetic, so the result is
+/// the same on all platforms. The error is close to that of sinf and cosf.
+B2_API b2Rot b2ComputeRot(float angle);
+
+/// Compute the arctangent of y / x using only basic arithmetic, see b2ComputeRot
+B2_API float b2Atan2(float y, float x);
+
 /// Set using an angle in radians.
 static inline b2Rot b2MakeRot(float angle)
 {
+#if defined(BOX2D_STRICT_DETERMINISM)
+	return b2ComputeRot(angle);
+#else
 	b2Rot q = {sinf(angle), cosf(angle)};
 	return q;
+#endif
 }
 
 /// Get the angle in radians
 static inline float b2Rot_GetAngle(b2Rot q)
 {
+#if defined(BOX2D_STRICT_DETERMINISM)
+	return b2Atan2(q.s, q.c);
+#else
 	return atan2f(q.s, q.c);
+#endif
 }
 
 /// Get the x-axis
@@ -11,6 +11,7 @@
 
 #pragma once
 
+#include "box2d/api.h"
 #include "box2d/color.h"
 #include "box2d/constants.h"
 #include "box2d/id.h"
@@ -113,6 +114,13 @@ typedef void b2TaskCallback(int32_t startIndex, int32_t endIndex, uint32_t threa
 typedef void* b2EnqueueTaskCallback(b2TaskCallback* task, int32_t itemCount, int32_t minRange, void* taskContext,
 									void* userContext);
 
+/// Optional. Like b2EnqueueTaskCallback, but the task must not start before the dependencies are complete.
+/// The dependencies are user tasks returned by earlier enqueue calls that Box2D has not finished yet. Box2D
+/// still finishes every user task, including the dependencies, with b2FinishTaskCallback.
+typedef void* b2EnqueueTaskWithDependenciesCallback(b2TaskCallback* task, int32_t itemCount, int32_t minRange,
+													void* taskContext, void** dependencies, int32_t dependencyCount,
+													void* userContext);
+
 /// Finishes a user task object that wraps a Box2D task.
 typedef void b2FinishTaskCallback(void* userTask, void* userContext);
 
@@ -155,17 +163,48 @@ typedef struct b2WorldDef
 	/// application.
 	int32_t arenaAllocatorCapacity;
 
-	/// task system hookup
+	/// Number of workers for the task system. If enqueueTask or finishTask is NULL and this is
+	/// more than one, Box2D runs a built-in thread pool with workerCount - 1 threads. The thread
+	/// that steps the world is the first worker.
 	uint32_t workerCount;
 
+	/// Pin the threads of the built-in thread pool to separate cores and have each thread start on the same
+	/// solver blocks every iteration and every step. On NUMA machines this keeps the pages a worker writes
+	/// on that worker's node, since memory is placed on the node of the thread that first touches it.
+	/// Ignored when the task callbacks are provided.
+	bool enableWorkerAffinity;
+
 	/// function to spawn task
 	b2EnqueueTaskCallback* enqueueTask;
 
 	/// function to finish a task
 	b2FinishTaskCallback* finishTask;
 
+	/// Optional function to spawn a task that waits on other tasks. With this Box2D hands dependent work
+	/// to the task system early instead of waiting for the dependencies first. Used with enqueueTask and finishTask.
+	b2EnqueueTaskWithDependenciesCallback* enqueueTaskWithDependencies;
+
 	/// User context that is provided to enqueueTask and finishTask
 	void* userTaskContext;
+
+	/// Optional allocation function for all memory owned by this world. When this or freeFcn
+	/// is NULL the world uses the global allocator, see b2SetAllocator.
+	b2WorldAllocFcn* allocFcn;
+
+	/// Optional free function matching allocFcn
+	b2WorldFreeFcn* freeFcn;
+
+	/// User context that is provided to allocFcn and freeFcn
+	void* allocContext;
+
+	/// Reorder the awake bodies in memory along a Morton curve every this many steps so the solver
+	/// accesses nearby bodies in nearby memory. Intended for large piles. Zero keeps the island order.
+	int32_t spatialSortInterval;
+
+	/// Islands that lose contacts or joints are split so the pieces can sleep on their own. By default
+	/// one island is split per step, the one that lost the most. With a budget, islands are split
+	/// in parallel in that order as long as their total body count fits in the budget.
+	int32_t islandSplitBudget;
 } b2WorldDef;
 
 /// Use this to initialize your world definition
@@ -182,9 +221,16 @@ static const b2WorldDef b2_defaultWorldDef = {
 	0,							   // jointCapacity
 	1024 * 1024,				   // arenaAllocatorCapacity
 	0,							   // workerCount
+	false,						   // enableWorkerAffinity
 	NULL,						   // enqueueTask
 	NULL,						   // finishTask
+	NULL,						   // enqueueTaskWithDependencies
 	NULL,						   // userTaskContext
+	NULL,						   // allocFcn
+	NULL,						   // freeFcn
+	NULL,						   // allocContext
+	0,							   // spatialSortInterval
+	0,							   // islandSplitBudget
 };
 
 /// The body type.
@@ -248,6 +294,10 @@ typedef struct b2BodyDef
 
 	/// Does this body start out enabled?
 	bool isEnabled;
+
+	/// Compound bodies keep their shapes in a private tree and use a single broad-phase proxy.
+	/// This reduces broad-phase load for bodies that have many shapes.
+	bool isCompound;
 } b2BodyDef;
 
 /// Use this to initialize your body definition
@@ -265,6 +315,7 @@ static const b2BodyDef b2_defaultBodyDef = {
 	true,		   // isAwake
 	false,		   // fixedRotation
 	true,		   // isEnabled
+	false,		   // isCompound
 };
 
 /// This holds contact filtering data.
@@ -308,6 +359,8 @@ typedef enum b2ShapeType
 	b2_polygonShape,
 	b2_segmentShape,
 	b2_smoothSegmentShape,
+	b2_heightfieldShape,
+	b2_smoothChainShape,
 	b2_shapeTypeCount
 } b2ShapeType;
 
@@ -330,6 +383,7 @@ typedef struct b2ShapeDef
 	b2Filter filter;
 
 	/// A sensor shape collects contact information but never generates a collision response.
+	/// Sensors don't detect other sensors.
 	bool isSensor;
 
 	/// Enable sensor events for this shape. Only applies to kinematic and dynamic bodies. Ignored for sensors.
@@ -391,6 +445,11 @@ typedef struct b2ChainDef
 
 	/// Contact filtering data.
 	b2Filter filter;
+
+	/// Store the whole chain in a single shape with an internal segment tree instead of
+	/// one shape per segment. This uses a single broad-phase proxy and much less memory for
+	/// long chains. Collision with individual segments is resolved inside the contact.
+	bool useSegmentTree;
 } b2ChainDef;
 
 /// Use this to initialize your chain definition
@@ -401,7 +460,8 @@ static const b2ChainDef b2_defaultChainDef = {
 	NULL,						// userData
 	0.6f,						// friction
 	0.0f,						// restitution
-	{0x00000001, 0xFFFFFFFF, 0} // filter
+	{0x00000001, 0xFFFFFFFF, 0}, // filter
+	false,						 // useSegmentTree
 };
 
 /// Profiling data. Times are in milliseconds.
@@ -439,3 +499,60 @@ typedef struct b2Counters
 
 /// Use this to initialize your counters
 static const b2Counters b2_emptyCounters = B2_ZERO_INIT;
+
+/// Memory of one part of a world in bytes
+typedef struct b2MemoryUsage
+{
+	/// Bytes holding live data
+	int64_t used;
+
+	/// Bytes allocated, including spare capacity
+	int64_t reserved;
+} b2MemoryUsage;
+
+/// Memory of a world broken down by subsystem. This is computed from container capacities.
+typedef struct b2MemoryStats
+{
+	/// Body pool and body simulation data
+	b2MemoryUsage bodies;
+
+	/// Shape pool. Shape geometry lives in the block allocator.
+	b2MemoryUsage shapes;
+
+	/// Chain pool
+	b2MemoryUsage chains;
+
+	/// Contact pool, manifold pool and awake contact arrays
+	b2MemoryUsage contacts;
+
+	/// Joint pool
+	b2MemoryUsage joints;
+
+	/// Island pool and awake island array
+	b2MemoryUsage islands;
+
+	/// Constraint graph colors and overflow
+	b2MemoryUsage graph;
+
+	/// Broad-phase trees and move buffer
+	b2MemoryUsage broadPhase;
+
+	/// Broad-phase move set and pair set
+	b2MemoryUsage hashSets;
+
+	/// Per-step stack allocators of the world and of each worker thread. Used is the high water mark.
+	b2MemoryUsage stackAllocator;
+
+	/// Small object allocator
+	b2MemoryUsage blockAllocator;
+
+	/// Per worker thread storage
+	b2MemoryUsage taskContexts;
+
+	/// Everything else: sensors, events, compound and chain trees, chain and height field data.
+	/// This is the remainder of the world total and has no spare capacity information.
+	b2MemoryUsage other;
+
+	/// All memory allocated by the world. Reserved is exact.
+	b2MemoryUsage total;
+} b2MemoryStats;
@@ -417,6 +417,7 @@ static void UpdateUI()
 				ImGui::Checkbox("Sleep", &s_settings.enableSleep);
 				ImGui::Checkbox("Warm Starting", &s_settings.enableWarmStarting);
 				ImGui::Checkbox("Continuous", &s_settings.enableContinuous);
+				ImGui::Checkbox("Spatial Sort", &s_settings.enableSpatialSort);
 
 				ImGui::Separator();
 
@@ -224,6 +224,7 @@ void Sample::Step(Settings& settings)
 	b2World_EnableSleeping(m_worldId, settings.enableSleep);
 	b2World_EnableWarmStarting(m_worldId, settings.enableWarmStarting);
 	b2World_EnableContinuous(m_worldId, settings.enableContinuous);
+	b2World_SetSpatialSortInterval(m_worldId, settings.enableSpatialSort ? 16 : 0);
 
 	for (int32_t i = 0; i < 1; ++i)
 	{
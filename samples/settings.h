@@ -30,6 +30,7 @@ struct Settings
 	bool enableWarmStarting = true;
 	bool enableContinuous = true;
 	bool enableSleep = false;
+	bool enableSpatialSort = false;
 	bool pause = false;
 	bool singleStep = false;
 	bool restart = false;
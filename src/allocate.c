@@ -45,15 +45,31 @@ void b2SetAllocator(b2AllocFcn* allocFcn, b2FreeFcn* freeFcn)
 // Use 32 byte alignment for everything. Works with 256bit SIMD.
 #define B2_ALIGNMENT 32
 
-void* b2Alloc(uint32_t size)
+void* b2Alloc(b2Allocator* allocator, uint32_t size)
 {
 	// This could cause some sharing issues, however Box2D rarely calls b2Alloc.
 	atomic_fetch_add_explicit(&b2_byteCount, size, memory_order_relaxed);
 
+	if (allocator != NULL)
+	{
+		atomic_fetch_add_explicit(&allocator->byteCount, size, memory_order_relaxed);
+	}
+
 	// Allocation must be a multiple of 32 or risk a seg fault
 	// https://en.cppreference.com/w/c/memory/aligned_alloc
 	uint32_t size32 = ((size - 1) | 0x1F) + 1;
 
+	if (allocator != NULL && allocator->allocFcn != NULL)
+	{
+		void* ptr = allocator->allocFcn(size32, B2_ALIGNMENT, allocator->context);
+		b2TracyCAlloc(ptr, size);
+
+		B2_ASSERT(ptr != NULL);
+		B2_ASSERT(((uintptr_t)ptr & 0x1F) == 0);
+
+		return ptr;
+	}
+
 	if (b2_allocFcn != NULL)
 	{
 		void* ptr = b2_allocFcn(size32, B2_ALIGNMENT);
@@ -75,11 +91,11 @@ void* b2Alloc(uint32_t size)
 
 	B2_ASSERT(ptr != NULL);
 	B2_ASSERT(((uintptr_t)ptr & 0x1F) == 0);
-	
+
 	return ptr;
 }
 
-void b2Free(void* mem, uint32_t size)
+void b2Free(b2Allocator* allocator, void* mem, uint32_t size)
 {
 	if (mem == NULL)
 	{
@@ -88,7 +104,12 @@ void b2Free(void* mem, uint32_t size)
 
 	b2TracyCFree(mem);
 
-	if (b2_freeFcn != NULL)
+	if (allocator != NULL && allocator->freeFcn != NULL)
+	{
+		uint32_t size32 = ((size - 1) | 0x1F) + 1;
+		allocator->freeFcn(mem, size32, allocator->context);
+	}
+	else if (b2_freeFcn != NULL)
 	{
 		b2_freeFcn(mem);
 	}
@@ -102,6 +123,11 @@ void b2Free(void* mem, uint32_t size)
 	}
 
 	atomic_fetch_sub_explicit(&b2_byteCount, size, memory_order_relaxed);
+
+	if (allocator != NULL)
+	{
+		atomic_fetch_sub_explicit(&allocator->byteCount, size, memory_order_relaxed);
+	}
 }
 
 uint32_t b2GetByteCount(void)
@@ -2,7 +2,24 @@
 // SPDX-License-Identifier: MIT
 
 #pragma once
+
+#include "box2d/api.h"
+
+#include <stdatomic.h>
 #include <stdint.h>
 
-void* b2Alloc(uint32_t size);
-void b2Free(void* mem, uint32_t size);
+// Allocation hooks of a world. Containers keep a pointer to the allocator they were created
+// with so they can grow and be freed from any thread. A NULL allocator, or one without hooks,
+// uses the global allocator.
+typedef struct b2Allocator
+{
+	b2WorldAllocFcn* allocFcn;
+	b2WorldFreeFcn* freeFcn;
+	void* context;
+
+	// Bytes currently allocated through this allocator
+	_Atomic int64_t byteCount;
+} b2Allocator;
+
+void* b2Alloc(b2Allocator* allocator, uint32_t size);
+void b2Free(b2Allocator* allocator, void* mem, uint32_t size);
@@ -7,51 +7,90 @@
 #include "array.h"
 #include "core.h"
 
-#include <stdbool.h>
+#include "box2d/math.h"
+#include "box2d/types.h"
 
 typedef struct b2StackEntry
 {
 	char* data;
 	const char* name;
 	int32_t size;
-	bool usedMalloc;
+
+	// Stack position before this entry, restored when the entry is freed
+	int32_t chunkIndex;
+	int32_t index;
 } b2StackEntry;
 
+typedef struct b2StackChunk
+{
+	char* data;
+	int32_t capacity;
+} b2StackChunk;
+
 // This is a stack-like arena allocator used for fast per step allocations.
 // You must nest allocate/free pairs. The code will B2_ASSERT
 // if you try to interleave multiple allocate/free pairs.
-// This allocator uses the heap if space is insufficient.
-// I could remove the need to free entries individually.
+// When the current chunk is full another chunk is added. Chunks are kept, so after a
+// few steps the stack stops allocating. b2GrowStack merges the chunks outside the step.
+// The allocator is not thread safe. Worker threads each get their own stack.
 typedef struct b2StackAllocator
 {
-	char* data;
-	int32_t capacity;
+	b2Allocator* baseAllocator;
+	b2StackChunk* chunks;
+	int32_t chunkIndex;
 	int32_t index;
 
+	// Sum of the chunk capacities
+	int32_t capacity;
+	int32_t minCapacity;
+
 	int32_t allocation;
 	int32_t maxAllocation;
 
 	b2StackEntry* entries;
 } b2StackAllocator;
 
-b2StackAllocator* b2CreateStackAllocator(int32_t capacity)
+// Replace all chunks with a single chunk
+static void b2ResetStackChunks(b2StackAllocator* alloc, int32_t capacity)
+{
+	int32_t chunkCount = b2Array(alloc->chunks).count;
+	for (int32_t i = 0; i < chunkCount; ++i)
+	{
+		b2Free(alloc->baseAllocator, alloc->chunks[i].data, alloc->chunks[i].capacity);
+	}
+	b2Array_Clear(alloc->chunks);
+
+	if (capacity > 0)
+	{
+		b2StackChunk chunk = {b2Alloc(alloc->baseAllocator, capacity), capacity};
+		b2Array_Push(alloc->chunks, chunk);
+	}
+
+	alloc->chunkIndex = 0;
+	alloc->index = 0;
+	alloc->capacity = capacity;
+}
+
+b2StackAllocator* b2CreateStackAllocator(b2Allocator* baseAllocator, int32_t capacity)
 {
 	B2_ASSERT(capacity >= 0);
-	b2StackAllocator* allocator = b2Alloc(sizeof(b2StackAllocator));
-	allocator->capacity = capacity;
-	allocator->data = b2Alloc(capacity);
+	b2StackAllocator* allocator = b2Alloc(baseAllocator, sizeof(b2StackAllocator));
+	allocator->baseAllocator = baseAllocator;
+	allocator->chunks = b2CreateArray(baseAllocator, sizeof(b2StackChunk), 4);
+	allocator->minCapacity = capacity;
 	allocator->allocation = 0;
 	allocator->maxAllocation = 0;
-	allocator->index = 0;
-	allocator->entries = b2CreateArray(sizeof(b2StackEntry), 32);
+	allocator->entries = b2CreateArray(baseAllocator, sizeof(b2StackEntry), 32);
+	b2ResetStackChunks(allocator, capacity);
 	return allocator;
 }
 
 void b2DestroyStackAllocator(b2StackAllocator* allocator)
 {
+	b2ResetStackChunks(allocator, 0);
+	b2DestroyArray(allocator->chunks, sizeof(b2StackChunk));
 	b2DestroyArray(allocator->entries, sizeof(b2StackEntry));
-	b2Free(allocator->data, allocator->capacity);
-	b2Free(allocator, sizeof(b2StackAllocator));
+	b2Free(allocator->baseAllocator, allocator, sizeof(b2StackAllocator));
 }
 
 void* b2AllocateStackItem(b2StackAllocator* alloc, int32_t size, const char* name)
@@ -62,23 +101,38 @@ void* b2AllocateStackItem(b2StackAllocator* alloc, int32_t size, const char* nam
 	b2StackEntry entry;
 	entry.size = size32;
 	entry.name = name;
-	if (alloc->index + size32 > alloc->capacity)
-	{
-		// fall back to the heap (undesirable)
-		entry.data = (char*)b2Alloc(size32);
-		entry.usedMalloc = true;
+	entry.chunkIndex = alloc->chunkIndex;
+	entry.index = alloc->index;
 
-		B2_ASSERT(((uintptr_t)entry.data & 0x1F) == 0);
-	}
-	else
+	int32_t chunkCount = b2Array(alloc->chunks).count;
+	if (chunkCount == 0 || alloc->index + size32 > alloc->chunks[alloc->chunkIndex].capacity)
 	{
-		entry.data = alloc->data + alloc->index;
-		entry.usedMalloc = false;
-		alloc->index += size32;
-
-		B2_ASSERT(((uintptr_t)entry.data & 0x1F) == 0);
+		// Chunks beyond the current chunk are empty. Use the first one that fits.
+		int32_t chunkIndex = chunkCount == 0 ? 0 : alloc->chunkIndex + 1;
+		while (chunkIndex < chunkCount && alloc->chunks[chunkIndex].capacity < size32)
+		{
+			chunkIndex += 1;
+		}
+
+		if (chunkIndex == chunkCount)
+		{
+			// Double the total capacity so the number of chunks stays small
+			int32_t capacity = B2_MAX(size32, alloc->capacity);
+			capacity = B2_MAX(capacity, 1024);
+			b2StackChunk chunk = {b2Alloc(alloc->baseAllocator, capacity), capacity};
+			b2Array_Push(alloc->chunks, chunk);
+			alloc->capacity += capacity;
+		}
+
+		alloc->chunkIndex = chunkIndex;
+		alloc->index = 0;
 	}
 
+	entry.data = alloc->chunks[alloc->chunkIndex].data + alloc->index;
+	alloc->index += size32;
+
+	B2_ASSERT(((uintptr_t)entry.data & 0x1F) == 0);
+
 	alloc->allocation += size32;
 	if (alloc->allocation > alloc->maxAllocation)
 	{
@@ -95,14 +149,9 @@ void b2FreeStackItem(b2StackAllocator* alloc, void* mem)
 	B2_ASSERT(entryCount > 0);
 	b2StackEntry* entry = alloc->entries + (entryCount - 1);
 	B2_ASSERT(mem == entry->data);
-	if (entry->usedMalloc)
-	{
-		b2Free(mem, entry->size);
-	}
-	else
-	{
-		alloc->index -= entry->size;
-	}
+	B2_MAYBE_UNUSED(mem);
+	alloc->chunkIndex = entry->chunkIndex;
+	alloc->index = entry->index;
 	alloc->allocation -= entry->size;
 	b2Array_Pop(alloc->entries);
 }
@@ -112,14 +161,34 @@ void b2GrowStack(b2StackAllocator* alloc)
 	// Stack must not be in use
 	B2_ASSERT(alloc->allocation == 0);
 
-	if (alloc->maxAllocation > alloc->capacity)
+	// Merge the chunks added during the step so the next step uses one contiguous block
+	int32_t chunkCount = b2Array(alloc->chunks).count;
+	if (chunkCount > 1 || alloc->maxAllocation > alloc->capacity)
 	{
-		b2Free(alloc->data, alloc->capacity);
-		alloc->capacity = alloc->maxAllocation + alloc->maxAllocation / 2;
-		alloc->data = b2Alloc(alloc->capacity);
+		int32_t capacity = alloc->maxAllocation + alloc->maxAllocation / 2;
+		if (chunkCount > 0)
+		{
+			capacity = B2_MAX(capacity, alloc->chunks[0].capacity);
+		}
+		b2ResetStackChunks(alloc, capacity);
 	}
 }
 
+void b2ShrinkStack(b2StackAllocator* alloc)
+{
+	// Stack must not be in use
+	B2_ASSERT(alloc->allocation == 0);
+
+	int32_t newCapacity = b2GetShrinkCapacity(alloc->capacity, alloc->maxAllocation, alloc->minCapacity);
+	if (newCapacity < alloc->capacity || b2Array(alloc->chunks).count > 1)
+	{
+		b2ResetStackChunks(alloc, newCapacity);
+	}
+
+	// Start tracking the peak again so a past spike doesn't hold memory
+	alloc->maxAllocation = 0;
+}
+
 int32_t b2GetStackCapacity(b2StackAllocator* alloc)
 {
 	return alloc->capacity;
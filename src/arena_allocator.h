@@ -5,17 +5,21 @@
 
 #include <stdint.h>
 
+typedef struct b2Allocator b2Allocator;
 typedef struct b2StackAllocator b2StackAllocator;
 
-b2StackAllocator* b2CreateStackAllocator(int32_t capacity);
+b2StackAllocator* b2CreateStackAllocator(b2Allocator* baseAllocator, int32_t capacity);
 void b2DestroyStackAllocator(b2StackAllocator* allocator);
 
 void* b2AllocateStackItem(b2StackAllocator* alloc, int32_t size, const char* name);
 void b2FreeStackItem(b2StackAllocator* alloc, void* mem);
 
-// Grow the stack based on usage
+// Grow the stack based on usage and merge chunks added during the step
 void b2GrowStack(b2StackAllocator* alloc);
 
+// Shrink the stack based on usage since the last shrink, but not below the initial capacity
+void b2ShrinkStack(b2StackAllocator* alloc);
+
 int32_t b2GetStackCapacity(b2StackAllocator* alloc);
 int32_t b2GetStackAllocation(b2StackAllocator* alloc);
 int32_t b2GetMaxStackAllocation(b2StackAllocator* alloc);
@@ -8,9 +8,10 @@
 
 #include <string.h>
 
-void* b2CreateArray(int32_t elementSize, int32_t capacity)
+void* b2CreateArray(b2Allocator* allocator, int32_t elementSize, int32_t capacity)
 {
-	void* result = (b2ArrayHeader*)b2Alloc(sizeof(b2ArrayHeader) + elementSize * capacity) + 1;
+	void* result = (b2ArrayHeader*)b2Alloc(allocator, sizeof(b2ArrayHeader) + elementSize * capacity) + 1;
+	b2Array(result).allocator = allocator;
 	b2Array(result).count = 0;
 	b2Array(result).capacity = capacity;
 	return result;
@@ -20,7 +21,27 @@ void b2DestroyArray(void* a, int32_t elementSize)
 {
 	int32_t capacity = b2Array(a).capacity;
 	int32_t size = sizeof(b2ArrayHeader) + elementSize * capacity;
-	b2Free(((b2ArrayHeader*)a) - 1, size);
+	b2Free(b2Array(a).allocator, ((b2ArrayHeader*)a) - 1, size);
+}
+
+void b2Array_Shrink(void** a, int32_t elementSize)
+{
+	int32_t count = b2Array(*a).count;
+	int32_t capacity = b2Array(*a).capacity;
+	int32_t newCapacity = b2GetShrinkCapacity(capacity, count, 2);
+	if (newCapacity == capacity)
+	{
+		return;
+	}
+
+	void* tmp = *a;
+	b2Allocator* allocator = b2Array(tmp).allocator;
+	*a = (b2ArrayHeader*)b2Alloc(allocator, sizeof(b2ArrayHeader) + elementSize * newCapacity) + 1;
+	b2Array(*a).allocator = allocator;
+	b2Array(*a).capacity = newCapacity;
+	b2Array(*a).count = count;
+	memcpy(*a, tmp, count * elementSize);
+	b2DestroyArray(tmp, elementSize);
 }
 
 void b2Array_Grow(void** a, int32_t elementSize)
@@ -32,9 +53,32 @@ void b2Array_Grow(void** a, int32_t elementSize)
 	int32_t newCapacity = capacity + (capacity >> 1);
 	newCapacity = newCapacity >= 2 ? newCapacity : 2;
 	void* tmp = *a;
-	*a = (b2ArrayHeader*)b2Alloc(sizeof(b2ArrayHeader) + elementSize * newCapacity) + 1;
+	b2Allocator* allocator = b2Array(tmp).allocator;
+	*a = (b2ArrayHeader*)b2Alloc(allocator, sizeof(b2ArrayHeader) + elementSize * newCapacity) + 1;
+	b2Array(*a).allocator = allocator;
 	b2Array(*a).capacity = newCapacity;
 	b2Array(*a).count = capacity;
 	memcpy(*a, tmp, capacity * elementSize);
 	b2DestroyArray(tmp, elementSize);
 }
+
+void b2Array_Resize(void** a, int32_t elementSize, int32_t count)
+{
+	int32_t capacity = b2Array(*a).capacity;
+	if (count > capacity)
+	{
+		// grow by at least 50%
+		int32_t newCapacity = capacity + (capacity >> 1);
+		newCapacity = newCapacity >= count ? newCapacity : count;
+		void* tmp = *a;
+		int32_t oldCount = b2Array(tmp).count;
+		b2Allocator* allocator = b2Array(tmp).allocator;
+		*a = (b2ArrayHeader*)b2Alloc(allocator, sizeof(b2ArrayHeader) + elementSize * newCapacity) + 1;
+		b2Array(*a).allocator = allocator;
+		b2Array(*a).capacity = newCapacity;
+		memcpy(*a, tmp, oldCount * elementSize);
+		b2DestroyArray(tmp, elementSize);
+	}
+
+	b2Array(*a).count = count;
+}
@@ -7,18 +7,42 @@
 
 #include <stdint.h>
 
+typedef struct b2Allocator b2Allocator;
+
 typedef struct b2ArrayHeader
 {
+	b2Allocator* allocator;
 	int32_t count;
 	int32_t capacity;
 } b2ArrayHeader;
 
 #define b2Array(a) ((b2ArrayHeader*)(a))[-1]
 
-void* b2CreateArray(int32_t elementSize, int32_t capacity);
+void* b2CreateArray(b2Allocator* allocator, int32_t elementSize, int32_t capacity);
 void b2DestroyArray(void* a, int32_t elementSize);
 void b2Array_Grow(void** a, int32_t elementSize);
 
+// Set the count, growing the capacity if needed. New elements are not initialized.
+void b2Array_Resize(void** a, int32_t elementSize, int32_t count);
+
+// Release spare capacity, see b2GetShrinkCapacity
+void b2Array_Shrink(void** a, int32_t elementSize);
+
+// Shrink policy shared by the containers. Returns the capacity a container should shrink to.
+// Containers only shrink when less than half of their capacity is needed and they keep 50%
+// headroom, so a world that oscillates around some size doesn't keep reallocating.
+static inline int32_t b2GetShrinkCapacity(int32_t capacity, int32_t needed, int32_t minCapacity)
+{
+	if (2 * needed >= capacity)
+	{
+		return capacity;
+	}
+
+	int32_t newCapacity = needed + needed / 2;
+	newCapacity = newCapacity > minCapacity ? newCapacity : minCapacity;
+	return newCapacity < capacity ? newCapacity : capacity;
+}
+
 #define b2Array_Check(a, index) B2_ASSERT(0 <= index && index < b2Array(a).count)
 
 #define b2Array_Clear(a) b2Array(a).count = 0
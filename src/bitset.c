@@ -4,23 +4,25 @@
 #include "bitset.h"
 
 #include "allocate.h"
+#include "array.h"
 
 #include <string.h>
 
-b2BitSet b2CreateBitSet(uint32_t bitCapacity)
+b2BitSet b2CreateBitSet(b2Allocator* allocator, uint32_t bitCapacity)
 {
 	b2BitSet bitSet = {0};
 
+	bitSet.allocator = allocator;
 	bitSet.blockCapacity = (bitCapacity + sizeof(uint64_t) * 8 - 1) / (sizeof(uint64_t) * 8);
 	bitSet.blockCount = 0;
-	bitSet.bits = b2Alloc(bitSet.blockCapacity * sizeof(uint64_t));
+	bitSet.bits = b2Alloc(allocator, bitSet.blockCapacity * sizeof(uint64_t));
 	memset(bitSet.bits, 0, bitSet.blockCapacity * sizeof(uint64_t));
 	return bitSet;
 }
 
 void b2DestroyBitSet(b2BitSet* bitSet)
 {
-	b2Free(bitSet->bits, bitSet->blockCapacity * sizeof(uint64_t));
+	b2Free(bitSet->allocator, bitSet->bits, bitSet->blockCapacity * sizeof(uint64_t));
 	bitSet->blockCapacity = 0;
 	bitSet->blockCount = 0;
 	bitSet->bits = NULL;
@@ -31,9 +33,10 @@ void b2SetBitCountAndClear(b2BitSet* bitSet, uint32_t bitCount)
 	uint32_t blockCount = (bitCount + sizeof(uint64_t) * 8 - 1) / (sizeof(uint64_t) * 8);
 	if (bitSet->blockCapacity < blockCount)
 	{
+		b2Allocator* allocator = bitSet->allocator;
 		b2DestroyBitSet(bitSet);
 		uint32_t newBitCapacity = bitCount + (bitCount >> 1);
-		*bitSet = b2CreateBitSet(newBitCapacity);
+		*bitSet = b2CreateBitSet(allocator, newBitCapacity);
 	}
 
 	bitSet->blockCount = blockCount;
@@ -47,16 +50,36 @@ void b2GrowBitSet(b2BitSet* bitSet, uint32_t blockCount)
 	{
 		uint32_t oldCapacity = bitSet->blockCapacity;
 		bitSet->blockCapacity = blockCount + blockCount / 2;
-		uint64_t* newBits = b2Alloc(bitSet->blockCapacity * sizeof(uint64_t));
+		uint64_t* newBits = b2Alloc(bitSet->allocator, bitSet->blockCapacity * sizeof(uint64_t));
 		memset(newBits, 0, bitSet->blockCapacity * sizeof(uint64_t));
 		memcpy(newBits, bitSet->bits, bitSet->blockCount * sizeof(uint64_t));
-		b2Free(bitSet->bits, oldCapacity * sizeof(uint64_t));
+		b2Free(bitSet->allocator, bitSet->bits, oldCapacity * sizeof(uint64_t));
 		bitSet->bits = newBits;
 	}
 
 	bitSet->blockCount = blockCount;
 }
 
+void b2ShrinkBitSet(b2BitSet* bitSet, uint32_t bitCount)
+{
+	uint32_t neededBlocks = (bitCount + sizeof(uint64_t) * 8 - 1) / (sizeof(uint64_t) * 8);
+	uint32_t oldCapacity = bitSet->blockCapacity;
+	uint32_t newCapacity = (uint32_t)b2GetShrinkCapacity((int32_t)oldCapacity, (int32_t)neededBlocks, 1);
+	if (newCapacity == oldCapacity)
+	{
+		return;
+	}
+
+	uint32_t blockCount = bitSet->blockCount < newCapacity ? bitSet->blockCount : newCapacity;
+	uint64_t* newBits = b2Alloc(bitSet->allocator, newCapacity * sizeof(uint64_t));
+	memset(newBits, 0, newCapacity * sizeof(uint64_t));
+	memcpy(newBits, bitSet->bits, blockCount * sizeof(uint64_t));
+	b2Free(bitSet->allocator, bitSet->bits, oldCapacity * sizeof(uint64_t));
+	bitSet->bits = newBits;
+	bitSet->blockCapacity = newCapacity;
+	bitSet->blockCount = blockCount;
+}
+
 void b2InPlaceUnion(b2BitSet* restrict setA, const b2BitSet* restrict setB)
 {
 	B2_ASSERT(setA->blockCount == setB->blockCount);
@@ -8,20 +8,26 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+typedef struct b2Allocator b2Allocator;
+
 // Bit set provides fast operations on large arrays of bits
 typedef struct b2BitSet
 {
+	b2Allocator* allocator;
 	uint64_t* bits;
 	uint32_t blockCapacity;
 	uint32_t blockCount;
 } b2BitSet;
 
-b2BitSet b2CreateBitSet(uint32_t bitCapacity);
+b2BitSet b2CreateBitSet(b2Allocator* allocator, uint32_t bitCapacity);
 void b2DestroyBitSet(b2BitSet* bitSet);
 void b2SetBitCountAndClear(b2BitSet* bitset, uint32_t bitCount);
 void b2InPlaceUnion(b2BitSet* setA, const b2BitSet* setB);
 void b2GrowBitSet(b2BitSet* set, uint32_t blockCount);
 
+// Release capacity beyond what is needed for bitCount bits. Bits past bitCount are dropped.
+void b2ShrinkBitSet(b2BitSet* bitSet, uint32_t bitCount);
+
 static inline void b2SetBit(b2BitSet* bitSet, uint32_t bitIndex)
 {
 	uint32_t blockIndex = bitIndex / 64;
@@ -31,6 +31,15 @@ static inline uint32_t b2CTZ(uint64_t block)
 	return index;
 }
 
+static inline uint32_t b2PopCount(uint64_t block)
+{
+#ifdef _WIN64
+	return (uint32_t)__popcnt64(block);
+#else
+	return __popcnt((uint32_t)block) + __popcnt((uint32_t)(block >> 32));
+#endif
+}
+
 #else
 
 static inline uint32_t b2CTZ(uint64_t block)
@@ -38,4 +47,19 @@ static inline uint32_t b2CTZ(uint64_t block)
 	return __builtin_ctzll(block);
 }
 
+static inline uint32_t b2PopCount(uint64_t block)
+{
+	return (uint32_t)__builtin_popcountll(block);
+}
+
 #endif
+
+static inline uint32_t b2CountSetBits(const b2BitSet* bitSet)
+{
+	uint32_t count = 0;
+	for (uint32_t k = 0; k < bitSet->blockCount; ++k)
+	{
+		count += b2PopCount(bitSet->bits[k]);
+	}
+	return count;
+}
@@ -76,14 +76,16 @@ typedef struct b2Block
 // See: http://www.codeproject.com/useritems/Small_Block_Allocator.asp
 typedef struct b2BlockAllocator
 {
+	b2Allocator* baseAllocator;
 	b2Chunk* chunks;
 	int32_t chunkCount;
 	int32_t chunkSpace;
+	int32_t allocation;
 
 	b2Block* freeLists[b2_blockSizeCount];
 } b2BlockAllocator;
 
-b2BlockAllocator* b2CreateBlockAllocator(void)
+b2BlockAllocator* b2CreateBlockAllocator(b2Allocator* baseAllocator)
 {
 	if (b2_sizeMapInitialized == false)
 	{
@@ -93,10 +95,12 @@ b2BlockAllocator* b2CreateBlockAllocator(void)
 
 	_Static_assert(b2_blockSizeCount < UCHAR_MAX, "block size too large");
 
-	b2BlockAllocator* allocator = (b2BlockAllocator*)b2Alloc(sizeof(b2BlockAllocator));
+	b2BlockAllocator* allocator = (b2BlockAllocator*)b2Alloc(baseAllocator, sizeof(b2BlockAllocator));
+	allocator->baseAllocator = baseAllocator;
 	allocator->chunkSpace = b2_chunkArrayIncrement;
 	allocator->chunkCount = 0;
-	allocator->chunks = (b2Chunk*)b2Alloc(allocator->chunkSpace * sizeof(b2Chunk));
+	allocator->allocation = 0;
+	allocator->chunks = (b2Chunk*)b2Alloc(baseAllocator, allocator->chunkSpace * sizeof(b2Chunk));
 
 	memset(allocator->chunks, 0, allocator->chunkSpace * sizeof(b2Chunk));
 	memset(allocator->freeLists, 0, sizeof(allocator->freeLists));
@@ -108,11 +112,11 @@ void b2DestroyBlockAllocator(b2BlockAllocator* allocator)
 {
 	for (int32_t i = 0; i < allocator->chunkCount; ++i)
 	{
-		b2Free(allocator->chunks[i].blocks, b2_chunkSize);
+		b2Free(allocator->baseAllocator, allocator->chunks[i].blocks, b2_chunkSize);
 	}
 
-	b2Free(allocator->chunks, allocator->chunkSpace * sizeof(b2Chunk));
-	b2Free(allocator, sizeof(b2BlockAllocator));
+	b2Free(allocator->baseAllocator, allocator->chunks, allocator->chunkSpace * sizeof(b2Chunk));
+	b2Free(allocator->baseAllocator, allocator, sizeof(b2BlockAllocator));
 }
 
 void* b2AllocBlock(b2BlockAllocator* allocator, int32_t size)
@@ -126,12 +130,14 @@ void* b2AllocBlock(b2BlockAllocator* allocator, int32_t size)
 
 	if (size > b2_maxBlockSize)
 	{
-		return b2Alloc(size);
+		return b2Alloc(allocator->baseAllocator, size);
 	}
 
 	int32_t index = b2_sizeMap.values[size];
 	B2_ASSERT(0 <= index && index < b2_blockSizeCount);
 
+	allocator->allocation += b2_blockSizes[index];
+
 	if (allocator->freeLists[index])
 	{
 		b2Block* block = allocator->freeLists[index];
@@ -145,14 +151,14 @@ void* b2AllocBlock(b2BlockAllocator* allocator, int32_t size)
 			b2Chunk* oldChunks = allocator->chunks;
 			int32_t oldSize = allocator->chunkSpace * sizeof(b2Chunk);
 			allocator->chunkSpace += b2_chunkArrayIncrement;
-			allocator->chunks = (b2Chunk*)b2Alloc(allocator->chunkSpace * sizeof(b2Chunk));
+			allocator->chunks = (b2Chunk*)b2Alloc(allocator->baseAllocator, allocator->chunkSpace * sizeof(b2Chunk));
 			memcpy(allocator->chunks, oldChunks, allocator->chunkCount * sizeof(b2Chunk));
 			memset(allocator->chunks + allocator->chunkCount, 0, b2_chunkArrayIncrement * sizeof(b2Chunk));
-			b2Free(oldChunks, oldSize);
+			b2Free(allocator->baseAllocator, oldChunks, oldSize);
 		}
 
 		b2Chunk* chunk = allocator->chunks + allocator->chunkCount;
-		chunk->blocks = (b2Block*)b2Alloc(b2_chunkSize);
+		chunk->blocks = (b2Block*)b2Alloc(allocator->baseAllocator, b2_chunkSize);
 #if B2_DEBUG
 		memset(chunk->blocks, 0xcd, b2_chunkSize);
 #endif
@@ -187,7 +193,7 @@ void b2FreeBlock(b2BlockAllocator* allocator, void* p, int32_t size)
 
 	if (size > b2_maxBlockSize)
 	{
-		b2Free(p, size);
+		b2Free(allocator->baseAllocator, p, size);
 		return;
 	}
 
@@ -219,7 +225,21 @@ void b2FreeBlock(b2BlockAllocator* allocator, void* p, int32_t size)
 	memset(p, 0xfd, blockSize);
 #endif
 
+	allocator->allocation -= b2_blockSizes[index];
+	B2_ASSERT(allocator->allocation >= 0);
+
 	b2Block* block = (b2Block*)p;
 	block->next = allocator->freeLists[index];
 	allocator->freeLists[index] = block;
 }
+
+int32_t b2GetBlockCapacity(b2BlockAllocator* allocator)
+{
+	return allocator->chunkCount * b2_chunkSize + allocator->chunkSpace * (int32_t)sizeof(b2Chunk) +
+		   (int32_t)sizeof(b2BlockAllocator);
+}
+
+int32_t b2GetBlockAllocation(b2BlockAllocator* allocator)
+{
+	return allocator->allocation;
+}
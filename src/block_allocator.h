@@ -5,11 +5,12 @@
 
 #include "box2d/types.h"
 
+typedef struct b2Allocator b2Allocator;
 typedef struct b2BlockAllocator b2BlockAllocator;
 
 /// Create an allocator suitable for allocating and freeing small objects quickly.
-/// Does not return memory to the heap.
-b2BlockAllocator* b2CreateBlockAllocator(void);
+/// Does not return memory to the heap. Chunks come from the base allocator.
+b2BlockAllocator* b2CreateBlockAllocator(b2Allocator* baseAllocator);
 
 /// Destroy a block alloctor instance
 void b2DestroyBlockAllocator(b2BlockAllocator* allocator);
@@ -19,3 +20,9 @@ void* b2AllocBlock(b2BlockAllocator* allocator, int32_t size);
 
 /// Free memory. This will use b2Free if the size is larger than b2_maxBlockSize.
 void b2FreeBlock(b2BlockAllocator* allocator,void* p, int32_t size);
+
+/// Bytes reserved in chunks and bookkeeping
+int32_t b2GetBlockCapacity(b2BlockAllocator* allocator);
+
+/// Bytes of the blocks currently handed out. Does not include sizes above b2_maxBlockSize.
+int32_t b2GetBlockAllocation(b2BlockAllocator* allocator);
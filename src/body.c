@@ -5,13 +5,16 @@
 
 #include "aabb.h"
 #include "allocate.h"
+#include "arena_allocator.h"
 #include "array.h"
 #include "block_allocator.h"
+#include "broad_phase.h"
 #include "contact.h"
 #include "core.h"
 #include "graph.h"
 #include "island.h"
 #include "joint.h"
+#include "sensor.h"
 #include "shape.h"
 #include "world.h"
 
@@ -20,6 +23,10 @@
 #include "box2d/event_types.h"
 #include "box2d/id.h"
 
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
 static void b2CreateIslandForBody(b2World* world, b2Body* body, bool isAwake)
 {
 	B2_ASSERT(body->islandIndex == B2_NULL_INDEX);
@@ -123,8 +130,44 @@ static void b2DestroyBodyContacts(b2World* world, b2Body* body)
 	}
 }
 
+// Create the single broad-phase proxy of a compound body. This covers all the shapes in the body shape tree.
+void b2CreateCompoundProxy(b2World* world, b2Body* body)
+{
+	B2_ASSERT(body->isCompound && body->proxyKey == B2_NULL_INDEX);
+
+	b2DynamicTree* tree = &body->shapeTree;
+	if (tree->root == B2_NULL_INDEX)
+	{
+		return;
+	}
+
+	uint32_t categoryBits = 0;
+	int32_t shapeIndex = body->shapeList;
+	while (shapeIndex != B2_NULL_INDEX)
+	{
+		b2Shape* shape = world->shapes + shapeIndex;
+		categoryBits |= shape->filter.categoryBits;
+		shapeIndex = shape->nextShapeIndex;
+	}
+
+	b2AABB aabb = tree->nodes[tree->root].aabb;
+	int32_t userData = B2_COMPOUND_PROXY_DATA(body->object.index);
+	body->proxyKey = b2BroadPhase_CreateProxy(&world->broadPhase, body->type, aabb, categoryBits, userData);
+}
+
+void b2DestroyCompoundProxy(b2World* world, b2Body* body)
+{
+	if (body->proxyKey != B2_NULL_INDEX)
+	{
+		b2BroadPhase_DestroyProxy(&world->broadPhase, body->proxyKey);
+		body->proxyKey = B2_NULL_INDEX;
+	}
+}
+
 static void b2EnableBody(b2World* world, b2Body* body)
 {
+	b2BodySim* bodySim = b2GetBodySim(world, body);
+
 	// Add shapes to broad-phase
 	int32_t shapeIndex = body->shapeList;
 	while (shapeIndex != B2_NULL_INDEX)
@@ -132,7 +175,19 @@ static void b2EnableBody(b2World* world, b2Body* body)
 		b2Shape* shape = world->shapes + shapeIndex;
 		shapeIndex = shape->nextShapeIndex;
 
-		b2CreateShapeProxy(shape, &world->broadPhase, body->type, body->transform);
+		if (body->isCompound)
+		{
+			b2CreateCompoundShapeProxy(shape, &body->shapeTree, body->type, bodySim->transform);
+		}
+		else
+		{
+			b2CreateShapeProxy(shape, &world->broadPhase, body->type, bodySim->transform);
+		}
+	}
+
+	if (body->isCompound)
+	{
+		b2CreateCompoundProxy(world, body);
 	}
 
 	b2CreateIslandForBody(world, body, true);
@@ -167,7 +222,22 @@ static void b2DisableBody(b2World* world, b2Body* body)
 		b2Shape* shape = world->shapes + shapeIndex;
 		shapeIndex = shape->nextShapeIndex;
 
-		b2DestroyShapeProxy(shape, &world->broadPhase);
+		// Overlaps are recomputed from scratch when the body is enabled again
+		b2ClearSensor(world, shape);
+
+		if (body->isCompound)
+		{
+			b2DestroyCompoundShapeProxy(shape, &body->shapeTree);
+		}
+		else
+		{
+			b2DestroyShapeProxy(shape, &world->broadPhase);
+		}
+	}
+
+	if (body->isCompound)
+	{
+		b2DestroyCompoundProxy(world, body);
 	}
 
 	int32_t jointKey = body->jointList;
@@ -211,34 +281,46 @@ B2_API b2BodyId b2CreateBody(b2WorldId worldId, const b2BodyDef* def)
 	B2_ASSERT(b2IsValid(def->angularDamping) && def->angularDamping >= 0.0f);
 	B2_ASSERT(b2IsValid(def->gravityScale) && def->gravityScale >= 0.0f);
 
+	b2BodySim bodySim;
+	bodySim.transform.p = def->position;
+	bodySim.transform.q = b2MakeRot(def->angle);
+	bodySim.position0 = def->position;
+	bodySim.position = def->position;
+	bodySim.angle0 = def->angle;
+	bodySim.angle = def->angle;
+	bodySim.localCenter = b2Vec2_zero;
+	bodySim.linearVelocity = def->linearVelocity;
+	bodySim.angularVelocity = def->angularVelocity;
+	bodySim.force = b2Vec2_zero;
+	bodySim.torque = 0.0f;
+	bodySim.mass = 0.0f;
+	bodySim.invMass = 0.0f;
+	bodySim.I = 0.0f;
+	bodySim.invI = 0.0f;
+	bodySim.minExtent = b2_huge;
+	bodySim.maxExtent = 0.0f;
+	bodySim.linearDamping = def->linearDamping;
+	bodySim.angularDamping = def->angularDamping;
+	bodySim.gravityScale = def->gravityScale;
+
+	int32_t bodyIndex = body->object.index;
+	if (bodyIndex == b2Array(world->bodySimArray).count)
+	{
+		b2Array_Push(world->bodySimArray, bodySim);
+	}
+	else
+	{
+		B2_ASSERT(bodyIndex < b2Array(world->bodySimArray).count);
+		world->bodySimArray[bodyIndex] = bodySim;
+	}
+
 	body->type = def->type;
-	body->transform.p = def->position;
-	body->transform.q = b2MakeRot(def->angle);
-	body->position0 = def->position;
-	body->position = def->position;
-	body->angle0 = def->angle;
-	body->angle = def->angle;
-	body->localCenter = b2Vec2_zero;
-	body->linearVelocity = def->linearVelocity;
-	body->angularVelocity = def->angularVelocity;
-	body->deltaPosition = b2Vec2_zero;
-	body->deltaAngle = 0.0f;
-	body->force = b2Vec2_zero;
-	body->torque = 0.0f;
 	body->shapeList = B2_NULL_INDEX;
 	body->chainList = B2_NULL_INDEX;
 	body->jointList = B2_NULL_INDEX;
 	body->jointCount = 0;
 	body->contactList = B2_NULL_INDEX;
 	body->contactCount = 0;
-	body->mass = 0.0f;
-	body->invMass = 0.0f;
-	body->I = 0.0f;
-	body->invI = 0.0f;
-	body->minExtent = b2_huge;
-	body->linearDamping = def->linearDamping;
-	body->angularDamping = def->angularDamping;
-	body->gravityScale = def->gravityScale;
 	body->sleepTime = 0.0f;
 	body->userData = def->userData;
 	body->world = worldId.index;
@@ -252,26 +334,60 @@ B2_API b2BodyId b2CreateBody(b2WorldId worldId, const b2BodyDef* def)
 	body->islandIndex = B2_NULL_INDEX;
 	body->islandPrev = B2_NULL_INDEX;
 	body->islandNext = B2_NULL_INDEX;
+	body->proxyKey = B2_NULL_INDEX;
+	body->isCompound = def->isCompound;
+
+	b2BodyHandle* handle = (b2BodyHandle*)b2AllocObject(&world->bodyHandlePool);
+	world->bodyHandles = (b2BodyHandle*)world->bodyHandlePool.memory;
+	handle->bodyIndex = bodyIndex;
+	body->handleIndex = handle->object.index;
+
+	if (body->isCompound)
+	{
+		body->shapeTree = b2CreateDynamicTree(&world->allocator);
+	}
+	else
+	{
+		body->shapeTree = (b2DynamicTree){0};
+	}
 
 	if (body->isEnabled)
 	{
 		b2CreateIslandForBody(world, body, def->isAwake);
 	}
 
-	b2BodyId id = {body->object.index, worldId.index, body->object.revision};
-	return id;
+	return b2MakeBodyId(world, body);
 }
 
 // Get a validated body from a world using an id.
 b2Body* b2GetBody(b2World* world, b2BodyId id)
 {
-	B2_ASSERT(0 <= id.index && id.index < world->bodyPool.capacity);
-	b2Body* body = world->bodies + id.index;
-	B2_ASSERT(b2ObjectValid(&body->object));
-	B2_ASSERT(id.revision == body->object.revision);
+	B2_ASSERT(0 <= id.index && id.index < world->bodyHandlePool.capacity);
+	b2BodyHandle* handle = world->bodyHandles + id.index;
+	B2_ASSERT(b2ObjectValid(&handle->object));
+	B2_ASSERT(id.revision == handle->object.revision);
+
+	B2_ASSERT(0 <= handle->bodyIndex && handle->bodyIndex < world->bodyPool.capacity);
+	b2Body* body = world->bodies + handle->bodyIndex;
+	B2_ASSERT(b2ObjectValid(&body->object) && body->handleIndex == id.index);
 	return body;
 }
 
+b2BodyId b2MakeBodyId(b2World* world, const b2Body* body)
+{
+	B2_ASSERT(0 <= body->handleIndex && body->handleIndex < world->bodyHandlePool.capacity);
+	b2BodyHandle* handle = world->bodyHandles + body->handleIndex;
+	B2_ASSERT(handle->bodyIndex == body->object.index);
+	b2BodyId id = {body->handleIndex, world->index, handle->object.revision};
+	return id;
+}
+
+b2BodySim* b2GetBodySim(b2World* world, b2Body* body)
+{
+	B2_ASSERT(0 <= body->object.index && body->object.index < b2Array(world->bodySimArray).count);
+	return world->bodySimArray + body->object.index;
+}
+
 bool b2IsBodyAwake(b2World* world, b2Body* body)
 {
 	if (body->islandIndex != B2_NULL_INDEX)
@@ -310,10 +426,23 @@ void b2DestroyBodyInternal(b2World* world, b2Body* body)
 		b2Shape* shape = world->shapes + shapeIndex;
 		shapeIndex = shape->nextShapeIndex;
 
-		b2DestroyShapeProxy(shape, &world->broadPhase);
+		if (body->isCompound == false)
+		{
+			b2DestroyShapeProxy(shape, &world->broadPhase);
+		}
+
+		b2DestroySensor(world, shape);
+		b2DestroyShapeAllocations(world, shape);
 		b2FreeObject(&world->shapePool, &shape->object);
 	}
 
+	if (body->isCompound)
+	{
+		// Compound shape proxies go away with the shape tree
+		b2DestroyCompoundProxy(world, body);
+		b2DynamicTree_Destroy(&body->shapeTree);
+	}
+
 	// Delete the attached chains. The associated shapes have already been deleted above.
 	int32_t chainIndex = body->chainList;
 	while (chainIndex != B2_NULL_INDEX)
@@ -321,13 +450,14 @@ void b2DestroyBodyInternal(b2World* world, b2Body* body)
 		b2ChainShape* chain = world->chains + chainIndex;
 		chainIndex = chain->nextIndex;
 
-		b2Free(chain->shapeIndices, chain->count * sizeof(int32_t));
+		b2Free(&world->allocator, chain->shapeIndices, chain->count * sizeof(int32_t));
 		chain->shapeIndices = NULL;
 		b2FreeObject(&world->chainPool, &chain->object);
 	}
 
 	b2RemoveBodyFromIsland(world, body);
 
+	b2FreeObject(&world->bodyHandlePool, &world->bodyHandles[body->handleIndex].object);
 	b2FreeObject(&world->bodyPool, &body->object);
 }
 
@@ -384,7 +514,7 @@ int32_t b2Body_GetContactData(b2BodyId bodyId, b2ContactData* contactData, int32
 
 			contactData[index].shapeIdA = (b2ShapeId){shapeA->object.index, bodyId.world, shapeA->object.revision};
 			contactData[index].shapeIdB = (b2ShapeId){shapeB->object.index, bodyId.world, shapeB->object.revision};
-			contactData[index].manifold = contact->manifold;
+			contactData[index].manifold = *b2GetContactManifold(world, contact);
 			index += 1;
 		}
 
@@ -405,9 +535,10 @@ b2AABB b2Body_ComputeAABB(b2BodyId bodyId)
 	}
 
 	b2Body* body = b2GetBody(world, bodyId);
+	b2BodySim* bodySim = b2GetBodySim(world, body);
 	if (body->shapeList == B2_NULL_INDEX)
 	{
-		return (b2AABB){body->transform.p, body->transform.p};
+		return (b2AABB){bodySim->transform.p, bodySim->transform.p};
 	}
 
 	b2Shape* shape = world->shapes + body->shapeList;
@@ -423,19 +554,21 @@ b2AABB b2Body_ComputeAABB(b2BodyId bodyId)
 
 void b2UpdateBodyMassData(b2World* world, b2Body* body)
 {
+	b2BodySim* bodySim = b2GetBodySim(world, body);
+
 	// Compute mass data from shapes. Each shape has its own density.
-	body->mass = 0.0f;
-	body->invMass = 0.0f;
-	body->I = 0.0f;
-	body->invI = 0.0f;
-	body->localCenter = b2Vec2_zero;
-	body->minExtent = b2_huge;
-	body->maxExtent = 0.0f;
+	bodySim->mass = 0.0f;
+	bodySim->invMass = 0.0f;
+	bodySim->I = 0.0f;
+	bodySim->invI = 0.0f;
+	bodySim->localCenter = b2Vec2_zero;
+	bodySim->minExtent = b2_huge;
+	bodySim->maxExtent = 0.0f;
 
 	// Static and kinematic bodies have zero mass.
 	if (body->type == b2_staticBody || body->type == b2_kinematicBody)
 	{
-		body->position = body->transform.p;
+		bodySim->position = bodySim->transform.p;
 		return;
 	}
 
@@ -455,43 +588,43 @@ void b2UpdateBodyMassData(b2World* world, b2Body* body)
 		}
 
 		b2MassData massData = b2ComputeShapeMass(s);
-		body->mass += massData.mass;
+		bodySim->mass += massData.mass;
 		localCenter = b2MulAdd(localCenter, massData.mass, massData.center);
-		body->I += massData.I;
+		bodySim->I += massData.I;
 
 		b2ShapeExtent extent = b2ComputeShapeExtent(s);
-		body->minExtent = B2_MIN(body->minExtent, extent.minExtent);
-		body->maxExtent = B2_MAX(body->maxExtent, extent.maxExtent);
+		bodySim->minExtent = B2_MIN(bodySim->minExtent, extent.minExtent);
+		bodySim->maxExtent = B2_MAX(bodySim->maxExtent, extent.maxExtent);
 	}
 
 	// Compute center of mass.
-	if (body->mass > 0.0f)
+	if (bodySim->mass > 0.0f)
 	{
-		body->invMass = 1.0f / body->mass;
-		localCenter = b2MulSV(body->invMass, localCenter);
+		bodySim->invMass = 1.0f / bodySim->mass;
+		localCenter = b2MulSV(bodySim->invMass, localCenter);
 	}
 
-	if (body->I > 0.0f && body->fixedRotation == false)
+	if (bodySim->I > 0.0f && body->fixedRotation == false)
 	{
 		// Center the inertia about the center of mass.
-		body->I -= body->mass * b2Dot(localCenter, localCenter);
-		B2_ASSERT(body->I > 0.0f);
-		body->invI = 1.0f / body->I;
+		bodySim->I -= bodySim->mass * b2Dot(localCenter, localCenter);
+		B2_ASSERT(bodySim->I > 0.0f);
+		bodySim->invI = 1.0f / bodySim->I;
 	}
 	else
 	{
-		body->I = 0.0f;
-		body->invI = 0.0f;
+		bodySim->I = 0.0f;
+		bodySim->invI = 0.0f;
 	}
 
 	// Move center of mass.
-	b2Vec2 oldCenter = body->position;
-	body->localCenter = localCenter;
-	body->position = b2TransformPoint(body->transform, body->localCenter);
+	b2Vec2 oldCenter = bodySim->position;
+	bodySim->localCenter = localCenter;
+	bodySim->position = b2TransformPoint(bodySim->transform, bodySim->localCenter);
 
 	// Update center of mass velocity.
-	b2Vec2 deltaLinear = b2CrossSV(body->angularVelocity, b2Sub(body->position, oldCenter));
-	body->linearVelocity = b2Add(body->linearVelocity, deltaLinear);
+	b2Vec2 deltaLinear = b2CrossSV(bodySim->angularVelocity, b2Sub(bodySim->position, oldCenter));
+	bodySim->linearVelocity = b2Add(bodySim->linearVelocity, deltaLinear);
 }
 
 static b2ShapeId b2CreateShape(b2BodyId bodyId, const b2ShapeDef* def, const void* geometry, b2ShapeType shapeType)
@@ -504,6 +637,7 @@ static b2ShapeId b2CreateShape(b2BodyId bodyId, const b2ShapeDef* def, const voi
 	}
 
 	b2Body* body = b2GetBody(world, bodyId);
+	b2BodySim* bodySim = b2GetBodySim(world, body);
 
 	b2Shape* shape = (b2Shape*)b2AllocObject(&world->shapePool);
 	world->shapes = (b2Shape*)world->shapePool.memory;
@@ -512,28 +646,52 @@ static b2ShapeId b2CreateShape(b2BodyId bodyId, const b2ShapeDef* def, const voi
 	B2_ASSERT(b2IsValid(def->friction) && def->friction >= 0.0f);
 	B2_ASSERT(b2IsValid(def->restitution) && def->restitution >= 0.0f);
 
+	shape->geometry = b2AllocBlock(world->blockAllocator, b2GetShapeGeometrySize(shapeType));
+
 	switch (shapeType)
 	{
 		case b2_capsuleShape:
-			shape->capsule = *(const b2Capsule*)geometry;
+			*shape->capsule = *(const b2Capsule*)geometry;
 			break;
 
 		case b2_circleShape:
-			shape->circle = *(const b2Circle*)geometry;
+			*shape->circle = *(const b2Circle*)geometry;
 			break;
 
 		case b2_polygonShape:
-			shape->polygon = *(const b2Polygon*)geometry;
+			*shape->polygon = *(const b2Polygon*)geometry;
 			break;
 
 		case b2_segmentShape:
-			shape->segment = *(const b2Segment*)geometry;
+			*shape->segment = *(const b2Segment*)geometry;
 			break;
 
 		case b2_smoothSegmentShape:
-			shape->smoothSegment = *(const b2SmoothSegment*)geometry;
+			*shape->smoothSegment = *(const b2SmoothSegment*)geometry;
 			break;
 
+		case b2_heightfieldShape:
+		{
+			// The shape owns a copy of the height samples
+			const b2Heightfield* heightfield = (const b2Heightfield*)geometry;
+			float* heights = b2Alloc(&world->allocator, heightfield->count * sizeof(float));
+			memcpy(heights, heightfield->heights, heightfield->count * sizeof(float));
+			*shape->heightfield = *heightfield;
+			shape->heightfield->heights = heights;
+		}
+		break;
+
+		case b2_smoothChainShape:
+		{
+			// The shape owns a copy of the points and the segment tree
+			const b2SmoothChain* chain = (const b2SmoothChain*)geometry;
+			*shape->smoothChain = *chain;
+			shape->smoothChain->points = b2Alloc(&world->allocator, chain->pointCount * sizeof(b2Vec2));
+			memcpy(shape->smoothChain->points, chain->points, chain->pointCount * sizeof(b2Vec2));
+			b2BuildSmoothChain(world, shape->smoothChain);
+		}
+		break;
+
 		default:
 			B2_ASSERT(false);
 			break;
@@ -553,19 +711,32 @@ static b2ShapeId b2CreateShape(b2BodyId bodyId, const b2ShapeDef* def, const voi
 	shape->enablePreSolveEvents = def->enablePreSolveEvents;
 	shape->isFast = false;
 	shape->proxyKey = B2_NULL_INDEX;
+	shape->sensorIndex = B2_NULL_INDEX;
 	shape->localCentroid = b2GetShapeCentroid(shape);
 	shape->aabb = (b2AABB){b2Vec2_zero, b2Vec2_zero};
 	shape->fatAABB = (b2AABB){b2Vec2_zero, b2Vec2_zero};
 
-	if (body->isEnabled)
+	if (shape->isSensor)
 	{
-		b2CreateShapeProxy(shape, &world->broadPhase, body->type, body->transform);
+		b2CreateSensor(world, shape);
 	}
 
 	// Add to shape linked list
 	shape->nextShapeIndex = body->shapeList;
 	body->shapeList = shape->object.index;
 
+	if (body->isEnabled && body->isCompound)
+	{
+		// Rebuild the compound proxy to cover the new shape
+		b2CreateCompoundShapeProxy(shape, &body->shapeTree, body->type, bodySim->transform);
+		b2DestroyCompoundProxy(world, body);
+		b2CreateCompoundProxy(world, body);
+	}
+	else if (body->isEnabled)
+	{
+		b2CreateShapeProxy(shape, &world->broadPhase, body->type, bodySim->transform);
+	}
+
 	if (shape->density > 0.0f)
 	{
 		b2UpdateBodyMassData(world, body);
@@ -609,6 +780,27 @@ b2ShapeId b2CreateSegmentShape(b2BodyId bodyId, const b2ShapeDef* def, const b2S
 	return b2CreateShape(bodyId, def, segment, b2_segmentShape);
 }
 
+b2ShapeId b2CreateHeightfieldShape(b2BodyId bodyId, const b2ShapeDef* def, const b2Heightfield* heightfield)
+{
+	B2_ASSERT(heightfield->heights != NULL && heightfield->count >= 2);
+	B2_ASSERT(b2IsValid(heightfield->cellWidth) && heightfield->cellWidth > 0.0f);
+	if (heightfield->heights == NULL || heightfield->count < 2 || heightfield->cellWidth <= 0.0f)
+	{
+		return b2_nullShapeId;
+	}
+
+	// Height fields have no mass and their contacts assume the terrain does not move
+	b2World* world = b2GetWorldFromIndex(bodyId.world);
+	b2Body* body = b2GetBody(world, bodyId);
+	B2_ASSERT(body->type == b2_staticBody);
+	if (body->type != b2_staticBody)
+	{
+		return b2_nullShapeId;
+	}
+
+	return b2CreateShape(bodyId, def, heightfield, b2_heightfieldShape);
+}
+
 // Destroy a shape on a body. This doesn't need to be called when destroying a body.
 static void b2DestroyShapeInternal(b2World* world, b2Shape* shape)
 {
@@ -657,11 +849,19 @@ static void b2DestroyShapeInternal(b2World* world, b2Shape* shape)
 		}
 	}
 
-	if (body->isEnabled)
+	if (body->isEnabled && body->isCompound)
+	{
+		b2DestroyCompoundShapeProxy(shape, &body->shapeTree);
+		b2DestroyCompoundProxy(world, body);
+		b2CreateCompoundProxy(world, body);
+	}
+	else if (body->isEnabled)
 	{
 		b2DestroyShapeProxy(shape, &world->broadPhase);
 	}
 
+	b2DestroySensor(world, shape);
+	b2DestroyShapeAllocations(world, shape);
 	b2FreeObject(&world->shapePool, &shape->object);
 
 	// Reset the mass data
@@ -705,7 +905,7 @@ b2ChainId b2CreateChain(b2BodyId bodyId, const b2ChainDef* def)
 	world->chains = (b2ChainShape*)world->chainPool.memory;
 
 	int32_t chainIndex = chainShape->object.index;
-	chainShape->bodyIndex = bodyId.index;
+	chainShape->bodyIndex = body->object.index;
 	chainShape->nextIndex = body->chainList;
 	body->chainList = chainShape->object.index;
 
@@ -720,10 +920,26 @@ b2ChainId b2CreateChain(b2BodyId bodyId, const b2ChainDef* def)
 	int32_t n = def->count;
 	const b2Vec2* points = def->points;
 
-	if (def->loop)
+	if (def->useSegmentTree)
+	{
+		// One shape for the whole chain
+		b2SmoothChain smoothChain = {0};
+		smoothChain.points = (b2Vec2*)points;
+		smoothChain.pointCount = n;
+		smoothChain.segmentCount = def->loop ? n : n - 3;
+		smoothChain.chainIndex = chainIndex;
+		smoothChain.loop = def->loop;
+
+		chainShape->count = 1;
+		chainShape->shapeIndices = b2Alloc(&world->allocator, sizeof(int32_t));
+
+		b2ShapeId shapeId = b2CreateShape(bodyId, &shapeDef, &smoothChain, b2_smoothChainShape);
+		chainShape->shapeIndices[0] = shapeId.index;
+	}
+	else if (def->loop)
 	{
 		chainShape->count = n;
-		chainShape->shapeIndices = b2Alloc(n * sizeof(int32_t));
+		chainShape->shapeIndices = b2Alloc(&world->allocator, n * sizeof(int32_t));
 
 		b2SmoothSegment smoothSegment;
 
@@ -764,7 +980,7 @@ b2ChainId b2CreateChain(b2BodyId bodyId, const b2ChainDef* def)
 	else
 	{
 		chainShape->count = n - 3;
-		chainShape->shapeIndices = b2Alloc(n * sizeof(int32_t));
+		chainShape->shapeIndices = b2Alloc(&world->allocator, n * sizeof(int32_t));
 
 		b2SmoothSegment smoothSegment;
 
@@ -794,7 +1010,7 @@ void b2DestroyChain(b2ChainId chainId)
 		return;
 	}
 
-	B2_ASSERT(0 <= chainId.index && chainId.index < world->chainPool.count);
+	B2_ASSERT(0 <= chainId.index && chainId.index < world->chainPool.capacity);
 
 	b2ChainShape* chain = world->chains + chainId.index;
 	B2_ASSERT(chain->object.revision == chainId.revision);
@@ -825,12 +1041,12 @@ void b2DestroyChain(b2ChainId chainId)
 	for (int32_t i = 0; i < count; ++i)
 	{
 		int32_t shapeIndex = chain->shapeIndices[i];
-		B2_ASSERT(0 <= shapeIndex && shapeIndex < world->shapePool.count);
+		B2_ASSERT(0 <= shapeIndex && shapeIndex < world->shapePool.capacity);
 		b2Shape* shape = world->shapes + shapeIndex;
 		b2DestroyShapeInternal(world, shape);
 	}
 
-	b2Free(chain->shapeIndices, count * sizeof(int32_t));
+	b2Free(&world->allocator, chain->shapeIndices, count * sizeof(int32_t));
 	b2FreeObject(&world->chainPool, &chain->object);
 }
 
@@ -838,49 +1054,56 @@ b2Vec2 b2Body_GetPosition(b2BodyId bodyId)
 {
 	b2World* world = b2GetWorldFromIndex(bodyId.world);
 	b2Body* body = b2GetBody(world, bodyId);
-	return body->transform.p;
+	b2BodySim* bodySim = b2GetBodySim(world, body);
+	return bodySim->transform.p;
 }
 
 float b2Body_GetAngle(b2BodyId bodyId)
 {
 	b2World* world = b2GetWorldFromIndex(bodyId.world);
 	b2Body* body = b2GetBody(world, bodyId);
-	return body->angle;
+	b2BodySim* bodySim = b2GetBodySim(world, body);
+	return bodySim->angle;
 }
 
 b2Transform b2Body_GetTransform(b2BodyId bodyId)
 {
 	b2World* world = b2GetWorldFromIndex(bodyId.world);
 	b2Body* body = b2GetBody(world, bodyId);
-	return body->transform;
+	b2BodySim* bodySim = b2GetBodySim(world, body);
+	return bodySim->transform;
 }
 
 b2Vec2 b2Body_GetLocalPoint(b2BodyId bodyId, b2Vec2 globalPoint)
 {
 	b2World* world = b2GetWorldFromIndex(bodyId.world);
 	b2Body* body = b2GetBody(world, bodyId);
-	return b2InvTransformPoint(body->transform, globalPoint);
+	b2BodySim* bodySim = b2GetBodySim(world, body);
+	return b2InvTransformPoint(bodySim->transform, globalPoint);
 }
 
 b2Vec2 b2Body_GetWorldPoint(b2BodyId bodyId, b2Vec2 localPoint)
 {
 	b2World* world = b2GetWorldFromIndex(bodyId.world);
 	b2Body* body = b2GetBody(world, bodyId);
-	return b2TransformPoint(body->transform, localPoint);
+	b2BodySim* bodySim = b2GetBodySim(world, body);
+	return b2TransformPoint(bodySim->transform, localPoint);
 }
 
 b2Vec2 b2Body_GetLocalVector(b2BodyId bodyId, b2Vec2 globalVector)
 {
 	b2World* world = b2GetWorldFromIndex(bodyId.world);
 	b2Body* body = b2GetBody(world, bodyId);
-	return b2InvRotateVector(body->transform.q, globalVector);
+	b2BodySim* bodySim = b2GetBodySim(world, body);
+	return b2InvRotateVector(bodySim->transform.q, globalVector);
 }
 
 b2Vec2 b2Body_GetWorldVector(b2BodyId bodyId, b2Vec2 localVector)
 {
 	b2World* world = b2GetWorldFromIndex(bodyId.world);
 	b2Body* body = b2GetBody(world, bodyId);
-	return b2RotateVector(body->transform.q, localVector);
+	b2BodySim* bodySim = b2GetBodySim(world, body);
+	return b2RotateVector(bodySim->transform.q, localVector);
 }
 
 void b2Body_SetTransform(b2BodyId bodyId, b2Vec2 position, float angle)
@@ -889,72 +1112,93 @@ void b2Body_SetTransform(b2BodyId bodyId, b2Vec2 position, float angle)
 	B2_ASSERT(world->locked == false);
 
 	b2Body* body = b2GetBody(world, bodyId);
+	b2BodySim* bodySim = b2GetBodySim(world, body);
 
-	body->transform.p = position;
-	body->transform.q = b2MakeRot(angle);
+	bodySim->transform.p = position;
+	bodySim->transform.q = b2MakeRot(angle);
 
-	body->position = b2TransformPoint(body->transform, body->localCenter);
-	body->angle = angle;
+	bodySim->position = b2TransformPoint(bodySim->transform, bodySim->localCenter);
+	bodySim->angle = angle;
 
-	body->position0 = body->position;
-	body->angle0 = body->angle;
+	bodySim->position0 = bodySim->position;
+	bodySim->angle0 = bodySim->angle;
 
 	b2BroadPhase* broadPhase = &world->broadPhase;
 
 	const b2Vec2 aabbMargin = {b2_aabbMargin, b2_aabbMargin};
+	bool compoundMoved = false;
 	int32_t shapeIndex = body->shapeList;
 	while (shapeIndex != B2_NULL_INDEX)
 	{
 		b2Shape* shape = world->shapes + shapeIndex;
-		shape->aabb = b2ComputeShapeAABB(shape, body->transform);
+		shape->aabb = b2ComputeShapeAABB(shape, bodySim->transform);
 
 		if (b2AABB_Contains(shape->fatAABB, shape->aabb) == false)
 		{
 			shape->fatAABB.lowerBound = b2Sub(shape->aabb.lowerBound, aabbMargin);
 			shape->fatAABB.upperBound = b2Add(shape->aabb.upperBound, aabbMargin);
-			b2BroadPhase_MoveProxy(broadPhase, shape->proxyKey, shape->fatAABB);
+
+			if (body->isCompound)
+			{
+				b2DynamicTree_MoveProxy(&body->shapeTree, shape->proxyKey, shape->fatAABB);
+				compoundMoved = true;
+			}
+			else
+			{
+				b2BroadPhase_MoveProxy(broadPhase, shape->proxyKey, shape->fatAABB);
+			}
 		}
 
 		shapeIndex = shape->nextShapeIndex;
 	}
+
+	if (compoundMoved && body->proxyKey != B2_NULL_INDEX)
+	{
+		b2DynamicTree* tree = &body->shapeTree;
+		b2BroadPhase_MoveProxy(broadPhase, body->proxyKey, tree->nodes[tree->root].aabb);
+	}
 }
 
 b2Vec2 b2Body_GetLinearVelocity(b2BodyId bodyId)
 {
 	b2World* world = b2GetWorldFromIndex(bodyId.world);
 	b2Body* body = b2GetBody(world, bodyId);
-	return body->linearVelocity;
+	b2BodySim* bodySim = b2GetBodySim(world, body);
+	return bodySim->linearVelocity;
 }
 
 float b2Body_GetAngularVelocity(b2BodyId bodyId)
 {
 	b2World* world = b2GetWorldFromIndex(bodyId.world);
 	b2Body* body = b2GetBody(world, bodyId);
-	return body->angularVelocity;
+	b2BodySim* bodySim = b2GetBodySim(world, body);
+	return bodySim->angularVelocity;
 }
 
 void b2Body_SetLinearVelocity(b2BodyId bodyId, b2Vec2 linearVelocity)
 {
 	b2World* world = b2GetWorldFromIndex(bodyId.world);
 	b2Body* body = b2GetBody(world, bodyId);
+	b2BodySim* bodySim = b2GetBodySim(world, body);
 	if (body->type == b2_staticBody || body->isEnabled == false)
 	{
 		return;
 	}
 
-	body->linearVelocity = linearVelocity;
+	bodySim->linearVelocity = linearVelocity;
 }
 
 void b2Body_SetAngularVelocity(b2BodyId bodyId, float angularVelocity)
 {
 	b2World* world = b2GetWorldFromIndex(bodyId.world);
 	b2Body* body = b2GetBody(world, bodyId);
+	b2BodySim* bodySim = b2GetBodySim(world, body);
 	if (body->type == b2_staticBody || body->isEnabled == false)
 	{
 		return;
 	}
 
-	body->angularVelocity = angularVelocity;
+	bodySim->angularVelocity = angularVelocity;
 
 	if (angularVelocity != 0.0f)
 	{
@@ -966,6 +1210,7 @@ void b2Body_ApplyForce(b2BodyId bodyId, b2Vec2 force, b2Vec2 point, bool wake)
 {
 	b2World* world = b2GetWorldFromIndex(bodyId.world);
 	b2Body* body = b2GetBody(world, bodyId);
+	b2BodySim* bodySim = b2GetBodySim(world, body);
 	if (body->type == b2_staticBody || body->isEnabled == false)
 	{
 		return;
@@ -978,8 +1223,8 @@ void b2Body_ApplyForce(b2BodyId bodyId, b2Vec2 force, b2Vec2 point, bool wake)
 
 	if (b2IsBodyAwake(world, body))
 	{
-		body->force = b2Add(body->force, force);
-		body->torque += b2Cross(b2Sub(point, body->position), force);
+		bodySim->force = b2Add(bodySim->force, force);
+		bodySim->torque += b2Cross(b2Sub(point, bodySim->position), force);
 	}
 }
 
@@ -987,6 +1232,7 @@ void b2Body_ApplyForceToCenter(b2BodyId bodyId, b2Vec2 force, bool wake)
 {
 	b2World* world = b2GetWorldFromIndex(bodyId.world);
 	b2Body* body = b2GetBody(world, bodyId);
+	b2BodySim* bodySim = b2GetBodySim(world, body);
 	if (body->type == b2_staticBody || body->isEnabled == false)
 	{
 		return;
@@ -999,7 +1245,7 @@ void b2Body_ApplyForceToCenter(b2BodyId bodyId, b2Vec2 force, bool wake)
 
 	if (b2IsBodyAwake(world, body))
 	{
-		body->force = b2Add(body->force, force);
+		bodySim->force = b2Add(bodySim->force, force);
 	}
 }
 
@@ -1007,6 +1253,7 @@ void b2Body_ApplyTorque(b2BodyId bodyId, float torque, bool wake)
 {
 	b2World* world = b2GetWorldFromIndex(bodyId.world);
 	b2Body* body = b2GetBody(world, bodyId);
+	b2BodySim* bodySim = b2GetBodySim(world, body);
 	if (body->type == b2_staticBody || body->isEnabled == false)
 	{
 		return;
@@ -1019,7 +1266,7 @@ void b2Body_ApplyTorque(b2BodyId bodyId, float torque, bool wake)
 
 	if (b2IsBodyAwake(world, body))
 	{
-		body->torque += torque;
+		bodySim->torque += torque;
 	}
 }
 
@@ -1027,6 +1274,7 @@ void b2Body_ApplyLinearImpulse(b2BodyId bodyId, b2Vec2 impulse, b2Vec2 point, bo
 {
 	b2World* world = b2GetWorldFromIndex(bodyId.world);
 	b2Body* body = b2GetBody(world, bodyId);
+	b2BodySim* bodySim = b2GetBodySim(world, body);
 	if (body->type == b2_staticBody || body->isEnabled == false)
 	{
 		return;
@@ -1039,8 +1287,8 @@ void b2Body_ApplyLinearImpulse(b2BodyId bodyId, b2Vec2 impulse, b2Vec2 point, bo
 
 	if (b2IsBodyAwake(world, body))
 	{
-		body->linearVelocity = b2MulAdd(body->linearVelocity, body->invMass, impulse);
-		body->angularVelocity += body->invI * b2Cross(b2Sub(point, body->position), impulse);
+		bodySim->linearVelocity = b2MulAdd(bodySim->linearVelocity, bodySim->invMass, impulse);
+		bodySim->angularVelocity += bodySim->invI * b2Cross(b2Sub(point, bodySim->position), impulse);
 	}
 }
 
@@ -1048,6 +1296,7 @@ void b2Body_ApplyLinearImpulseToCenter(b2BodyId bodyId, b2Vec2 impulse, bool wak
 {
 	b2World* world = b2GetWorldFromIndex(bodyId.world);
 	b2Body* body = b2GetBody(world, bodyId);
+	b2BodySim* bodySim = b2GetBodySim(world, body);
 	if (body->type == b2_staticBody || body->isEnabled == false)
 	{
 		return;
@@ -1060,7 +1309,7 @@ void b2Body_ApplyLinearImpulseToCenter(b2BodyId bodyId, b2Vec2 impulse, bool wak
 
 	if (b2IsBodyAwake(world, body))
 	{
-		body->linearVelocity = b2MulAdd(body->linearVelocity, body->invMass, impulse);
+		bodySim->linearVelocity = b2MulAdd(bodySim->linearVelocity, bodySim->invMass, impulse);
 	}
 }
 
@@ -1068,6 +1317,7 @@ void b2Body_ApplyAngularImpulse(b2BodyId bodyId, float impulse, bool wake)
 {
 	b2World* world = b2GetWorldFromIndex(bodyId.world);
 	b2Body* body = b2GetBody(world, bodyId);
+	b2BodySim* bodySim = b2GetBodySim(world, body);
 	if (body->type == b2_staticBody || body->isEnabled == false)
 	{
 		return;
@@ -1080,7 +1330,7 @@ void b2Body_ApplyAngularImpulse(b2BodyId bodyId, float impulse, bool wake)
 
 	if (b2IsBodyAwake(world, body))
 	{
-		body->angularVelocity += impulse;
+		bodySim->angularVelocity += impulse;
 	}
 }
 
@@ -1128,28 +1378,32 @@ float b2Body_GetMass(b2BodyId bodyId)
 {
 	b2World* world = b2GetWorldFromIndex(bodyId.world);
 	b2Body* body = b2GetBody(world, bodyId);
-	return body->mass;
+	b2BodySim* bodySim = b2GetBodySim(world, body);
+	return bodySim->mass;
 }
 
 float b2Body_GetInertiaTensor(b2BodyId bodyId)
 {
 	b2World* world = b2GetWorldFromIndex(bodyId.world);
 	b2Body* body = b2GetBody(world, bodyId);
-	return body->I;
+	b2BodySim* bodySim = b2GetBodySim(world, body);
+	return bodySim->I;
 }
 
 b2Vec2 b2Body_GetLocalCenterOfMass(b2BodyId bodyId)
 {
 	b2World* world = b2GetWorldFromIndex(bodyId.world);
 	b2Body* body = b2GetBody(world, bodyId);
-	return body->localCenter;
+	b2BodySim* bodySim = b2GetBodySim(world, body);
+	return bodySim->localCenter;
 }
 
 b2Vec2 b2Body_GetWorldCenterOfMass(b2BodyId bodyId)
 {
 	b2World* world = b2GetWorldFromIndex(bodyId.world);
 	b2Body* body = b2GetBody(world, bodyId);
-	return body->position;
+	b2BodySim* bodySim = b2GetBodySim(world, body);
+	return bodySim->position;
 }
 
 void b2Body_SetMassData(b2BodyId bodyId, b2MassData massData)
@@ -1165,23 +1419,25 @@ void b2Body_SetMassData(b2BodyId bodyId, b2MassData massData)
 	}
 
 	b2Body* body = b2GetBody(world, bodyId);
-	body->mass = massData.mass;
-	body->I = massData.I;
-	body->localCenter = massData.center;
+	b2BodySim* bodySim = b2GetBodySim(world, body);
+	bodySim->mass = massData.mass;
+	bodySim->I = massData.I;
+	bodySim->localCenter = massData.center;
 
-	b2Vec2 p = b2TransformPoint(body->transform, massData.center);
-	body->position = p;
-	body->position0 = p;
+	b2Vec2 p = b2TransformPoint(bodySim->transform, massData.center);
+	bodySim->position = p;
+	bodySim->position0 = p;
 
-	body->invMass = body->mass > 0.0f ? 1.0f / body->mass : 0.0f;
-	body->invI = body->I > 0.0f ? 1.0f / body->I : 0.0f;
+	bodySim->invMass = bodySim->mass > 0.0f ? 1.0f / bodySim->mass : 0.0f;
+	bodySim->invI = bodySim->I > 0.0f ? 1.0f / bodySim->I : 0.0f;
 }
 
 b2MassData b2Body_GetMassData(b2BodyId bodyId)
 {
 	b2World* world = b2GetWorldFromIndex(bodyId.world);
 	b2Body* body = b2GetBody(world, bodyId);
-	b2MassData massData = {body->mass, body->localCenter, body->I};
+	b2BodySim* bodySim = b2GetBodySim(world, body);
+	b2MassData massData = {bodySim->mass, bodySim->localCenter, bodySim->I};
 	return massData;
 }
 
@@ -1196,14 +1452,16 @@ void b2Body_SetLinearDamping(b2BodyId bodyId, float linearDamping)
 	}
 
 	b2Body* body = b2GetBody(world, bodyId);
-	body->linearDamping = linearDamping;
+	b2BodySim* bodySim = b2GetBodySim(world, body);
+	bodySim->linearDamping = linearDamping;
 }
 
 float b2Body_GetLinearDamping(b2BodyId bodyId)
 {
 	b2World* world = b2GetWorldFromIndex(bodyId.world);
 	b2Body* body = b2GetBody(world, bodyId);
-	return body->linearDamping;
+	b2BodySim* bodySim = b2GetBodySim(world, body);
+	return bodySim->linearDamping;
 }
 
 void b2Body_SetAngularDamping(b2BodyId bodyId, float angularDamping)
@@ -1217,14 +1475,16 @@ void b2Body_SetAngularDamping(b2BodyId bodyId, float angularDamping)
 	}
 
 	b2Body* body = b2GetBody(world, bodyId);
-	body->angularDamping = angularDamping;
+	b2BodySim* bodySim = b2GetBodySim(world, body);
+	bodySim->angularDamping = angularDamping;
 }
 
 float b2Body_GetAngularDamping(b2BodyId bodyId)
 {
 	b2World* world = b2GetWorldFromIndex(bodyId.world);
 	b2Body* body = b2GetBody(world, bodyId);
-	return body->angularDamping;
+	b2BodySim* bodySim = b2GetBodySim(world, body);
+	return bodySim->angularDamping;
 }
 
 void b2Body_SetGravityScale(b2BodyId bodyId, float gravityScale)
@@ -1238,14 +1498,16 @@ void b2Body_SetGravityScale(b2BodyId bodyId, float gravityScale)
 	}
 
 	b2Body* body = b2GetBody(world, bodyId);
-	body->gravityScale = gravityScale;
+	b2BodySim* bodySim = b2GetBodySim(world, body);
+	bodySim->gravityScale = gravityScale;
 }
 
 float b2Body_GetGravityScale(b2BodyId bodyId)
 {
 	b2World* world = b2GetWorldFromIndex(bodyId.world);
 	b2Body* body = b2GetBody(world, bodyId);
-	return body->gravityScale;
+	b2BodySim* bodySim = b2GetBodySim(world, body);
+	return bodySim->gravityScale;
 }
 
 bool b2Body_IsAwake(b2BodyId bodyId)
@@ -1369,6 +1631,466 @@ bool b2ShouldBodiesCollide(b2World* world, b2Body* bodyA, b2Body* bodyB)
 	return true;
 }
 
+// Spread the low 16 bits so there is a zero bit between each
+static uint32_t b2SpreadBits(uint32_t x)
+{
+	x &= 0xFFFF;
+	x = (x | (x << 8)) & 0x00FF00FF;
+	x = (x | (x << 4)) & 0x0F0F0F0F;
+	x = (x | (x << 2)) & 0x33333333;
+	x = (x | (x << 1)) & 0x55555555;
+	return x;
+}
+
+// Morton code of a point on a one meter grid. The grid covers 65 kilometers on each axis
+// around the origin. Points outside are clamped, which only reduces the locality.
+static uint32_t b2MakeSortKey(b2Vec2 p)
+{
+	float scale = 1.0f / b2_lengthUnitsPerMeter;
+	float x = B2_CLAMP(floorf(scale * p.x), -32768.0f, 32767.0f);
+	float y = B2_CLAMP(floorf(scale * p.y), -32768.0f, 32767.0f);
+	uint32_t ix = (uint32_t)((int32_t)x + 32768);
+	uint32_t iy = (uint32_t)((int32_t)y + 32768);
+	return b2SpreadBits(ix) | (b2SpreadBits(iy) << 1);
+}
+
+// Append the bodies of an island to the body order, following the island body list
+static int32_t b2OrderIslandBodies(b2World* world, b2Island* island, int32_t* order, int32_t* remap, int32_t bodyCount)
+{
+	int32_t bodyIndex = island->headBody;
+	while (bodyIndex != B2_NULL_INDEX)
+	{
+		B2_ASSERT(remap[bodyIndex] == B2_NULL_INDEX);
+		remap[bodyIndex] = bodyCount;
+		order[bodyCount] = bodyIndex;
+		bodyCount += 1;
+		bodyIndex = world->bodies[bodyIndex].islandNext;
+	}
+
+	return bodyCount;
+}
+
+// Stable radix sort of body indices by Morton code, so equal keys keep their island order
+static void b2SortBodiesSpatially(b2World* world, int32_t* order, int32_t count)
+{
+	b2StackAllocator* alloc = world->stackAllocator;
+	uint32_t* keys = b2AllocateStackItem(alloc, count * sizeof(uint32_t), "sort keys");
+	uint32_t* tempKeys = b2AllocateStackItem(alloc, count * sizeof(uint32_t), "sort keys");
+	int32_t* tempOrder = b2AllocateStackItem(alloc, count * sizeof(int32_t), "sort order");
+
+	const b2BodySim* bodySims = world->bodySimArray;
+	for (int32_t i = 0; i < count; ++i)
+	{
+		keys[i] = b2MakeSortKey(bodySims[order[i]].position);
+	}
+
+	// Four passes of 8 bits leave the result in the original arrays
+	uint32_t* srcKeys = keys;
+	uint32_t* dstKeys = tempKeys;
+	int32_t* srcOrder = order;
+	int32_t* dstOrder = tempOrder;
+	for (int32_t shift = 0; shift < 32; shift += 8)
+	{
+		int32_t offsets[256] = {0};
+		for (int32_t i = 0; i < count; ++i)
+		{
+			offsets[(srcKeys[i] >> shift) & 0xFF] += 1;
+		}
+
+		int32_t sum = 0;
+		for (int32_t i = 0; i < 256; ++i)
+		{
+			int32_t n = offsets[i];
+			offsets[i] = sum;
+			sum += n;
+		}
+
+		for (int32_t i = 0; i < count; ++i)
+		{
+			int32_t slot = offsets[(srcKeys[i] >> shift) & 0xFF]++;
+			dstKeys[slot] = srcKeys[i];
+			dstOrder[slot] = srcOrder[i];
+		}
+
+		uint32_t* swapKeys = srcKeys;
+		srcKeys = dstKeys;
+		dstKeys = swapKeys;
+
+		int32_t* swapOrder = srcOrder;
+		srcOrder = dstOrder;
+		dstOrder = swapOrder;
+	}
+
+	B2_ASSERT(srcOrder == order);
+
+	b2FreeStackItem(alloc, tempOrder);
+	b2FreeStackItem(alloc, tempKeys);
+	b2FreeStackItem(alloc, keys);
+}
+
+static int32_t b2RemapBodyIndex(const int32_t* remap, int32_t bodyIndex)
+{
+	return bodyIndex == B2_NULL_INDEX ? B2_NULL_INDEX : remap[bodyIndex];
+}
+
+void b2DefragmentBodies(b2World* world)
+{
+	b2Pool* pool = &world->bodyPool;
+	int32_t capacity = pool->capacity;
+	int32_t count = pool->count;
+	if (count == 0)
+	{
+		return;
+	}
+
+	b2StackAllocator* alloc = world->stackAllocator;
+	int32_t* remap = b2AllocateStackItem(alloc, capacity * sizeof(int32_t), "body remap");
+	int32_t* permutation = b2AllocateStackItem(alloc, capacity * sizeof(int32_t), "body permutation");
+	for (int32_t i = 0; i < capacity; ++i)
+	{
+		remap[i] = B2_NULL_INDEX;
+	}
+
+	// Awake islands go first because the solver touches them every step. The island body lists
+	// follow the constraint graph so neighboring bodies end up near each other in memory.
+	int32_t* order = permutation;
+	int32_t awakeCount = 0;
+	int32_t awakeIslandCount = b2Array(world->awakeIslandArray).count;
+	for (int32_t i = 0; i < awakeIslandCount; ++i)
+	{
+		b2Island* island = world->islands + world->awakeIslandArray[i];
+		awakeCount = b2OrderIslandBodies(world, island, order, remap, awakeCount);
+	}
+
+	int32_t newCount = awakeCount;
+	int32_t islandCapacity = world->islandPool.capacity;
+	for (int32_t i = 0; i < islandCapacity; ++i)
+	{
+		b2Island* island = world->islands + i;
+		if (b2ObjectValid(&island->object) == false || island->awakeIndex != B2_NULL_INDEX)
+		{
+			continue;
+		}
+
+		newCount = b2OrderIslandBodies(world, island, order, remap, newCount);
+	}
+
+	// Static and disabled bodies keep their relative order
+	b2Body* bodies = world->bodies;
+	for (int32_t i = 0; i < capacity; ++i)
+	{
+		if (b2ObjectValid(&bodies[i].object) && remap[i] == B2_NULL_INDEX)
+		{
+			remap[i] = newCount;
+			order[newCount] = i;
+			newCount += 1;
+		}
+	}
+
+	B2_ASSERT(newCount == count);
+
+	// Free slots go to the end in index order. Public ids live in the handles, so body revisions don't matter.
+	for (int32_t i = 0; i < capacity; ++i)
+	{
+		if (remap[i] == B2_NULL_INDEX)
+		{
+			remap[i] = newCount++;
+		}
+	}
+
+	// Body sims parallel the pool, so give every slot one while moving
+	while (b2Array(world->bodySimArray).count < capacity)
+	{
+		b2BodySim emptySim = {0};
+		b2Array_Push(world->bodySimArray, emptySim);
+	}
+
+	// Move bodies and sims in place by following the permutation cycles
+	b2BodySim* bodySims = world->bodySimArray;
+	memcpy(permutation, remap, capacity * sizeof(int32_t));
+	for (int32_t i = 0; i < capacity; ++i)
+	{
+		while (permutation[i] != i)
+		{
+			int32_t j = permutation[i];
+
+			b2Body tempBody = bodies[j];
+			bodies[j] = bodies[i];
+			bodies[i] = tempBody;
+
+			b2BodySim tempSim = bodySims[j];
+			bodySims[j] = bodySims[i];
+			bodySims[i] = tempSim;
+
+			permutation[i] = permutation[j];
+			permutation[j] = j;
+		}
+	}
+
+	for (int32_t i = 0; i < count; ++i)
+	{
+		b2Body* body = bodies + i;
+		body->object.index = i;
+		body->object.next = i;
+		body->islandPrev = b2RemapBodyIndex(remap, body->islandPrev);
+		body->islandNext = b2RemapBodyIndex(remap, body->islandNext);
+		world->bodyHandles[body->handleIndex].bodyIndex = i;
+	}
+
+	for (int32_t i = count; i < capacity; ++i)
+	{
+		b2Object* object = &bodies[i].object;
+		object->index = i;
+		object->next = i + 1 < capacity ? i + 1 : B2_NULL_INDEX;
+	}
+	pool->freeList = count < capacity ? count : B2_NULL_INDEX;
+	b2Array(world->bodySimArray).count = count;
+
+	// Fix everything that refers to bodies by index
+	for (int32_t i = 0; i < world->shapePool.capacity; ++i)
+	{
+		b2Shape* shape = world->shapes + i;
+		if (b2ObjectValid(&shape->object))
+		{
+			shape->bodyIndex = remap[shape->bodyIndex];
+		}
+	}
+
+	for (int32_t i = 0; i < world->chainPool.capacity; ++i)
+	{
+		b2ChainShape* chain = world->chains + i;
+		if (b2ObjectValid(&chain->object))
+		{
+			chain->bodyIndex = remap[chain->bodyIndex];
+		}
+	}
+
+	for (int32_t i = 0; i < world->contactPool.capacity; ++i)
+	{
+		b2Contact* contact = world->contacts + i;
+		if (b2ObjectValid(&contact->object))
+		{
+			contact->edges[0].bodyIndex = remap[contact->edges[0].bodyIndex];
+			contact->edges[1].bodyIndex = remap[contact->edges[1].bodyIndex];
+		}
+	}
+
+	for (int32_t i = 0; i < world->jointPool.capacity; ++i)
+	{
+		b2Joint* joint = world->joints + i;
+		if (b2ObjectValid(&joint->object))
+		{
+			joint->edges[0].bodyIndex = remap[joint->edges[0].bodyIndex];
+			joint->edges[1].bodyIndex = remap[joint->edges[1].bodyIndex];
+		}
+	}
+
+	for (int32_t i = 0; i < islandCapacity; ++i)
+	{
+		b2Island* island = world->islands + i;
+		if (b2ObjectValid(&island->object))
+		{
+			island->headBody = b2RemapBodyIndex(remap, island->headBody);
+			island->tailBody = b2RemapBodyIndex(remap, island->tailBody);
+		}
+	}
+
+	// Graph coloring tracks bodies by index
+	b2Graph* graph = &world->graph;
+	b2BitSet tempSet = b2CreateBitSet(&world->allocator, capacity);
+	for (int32_t i = 0; i < b2_graphColorCount; ++i)
+	{
+		b2BitSet* bodySet = &graph->colors[i].bodySet;
+		b2SetBitCountAndClear(&tempSet, capacity);
+
+		for (int32_t j = 0; j < capacity; ++j)
+		{
+			if (b2GetBit(bodySet, j))
+			{
+				b2SetBit(&tempSet, remap[j]);
+			}
+		}
+
+		b2BitSet swap = *bodySet;
+		*bodySet = tempSet;
+		tempSet = swap;
+	}
+	b2DestroyBitSet(&tempSet);
+
+	// Compound proxies store the body index as user data
+	for (int32_t i = 0; i < count; ++i)
+	{
+		b2Body* body = bodies + i;
+		if (body->isCompound && body->proxyKey != B2_NULL_INDEX)
+		{
+			b2DynamicTree* tree = world->broadPhase.trees + B2_PROXY_TYPE(body->proxyKey);
+			tree->nodes[B2_PROXY_ID(body->proxyKey)].userData = B2_COMPOUND_PROXY_DATA(i);
+		}
+	}
+
+	b2FreeStackItem(alloc, permutation);
+	b2FreeStackItem(alloc, remap);
+}
+
+static int b2CompareBodyIndices(const void* a, const void* b)
+{
+	int32_t indexA = *(const int32_t*)a;
+	int32_t indexB = *(const int32_t*)b;
+	return (indexA > indexB) - (indexA < indexB);
+}
+
+// New index of a body during b2SortAwakeBodies. The handles are updated before the bodies move.
+static int32_t b2SortedBodyIndex(const b2World* world, int32_t bodyIndex)
+{
+	if (bodyIndex == B2_NULL_INDEX)
+	{
+		return B2_NULL_INDEX;
+	}
+
+	return world->bodyHandles[world->bodies[bodyIndex].handleIndex].bodyIndex;
+}
+
+void b2SortAwakeBodies(b2World* world)
+{
+	int32_t count = 0;
+	int32_t awakeIslandCount = b2Array(world->awakeIslandArray).count;
+	for (int32_t i = 0; i < awakeIslandCount; ++i)
+	{
+		count += world->islands[world->awakeIslandArray[i]].bodyCount;
+	}
+
+	if (count < 2)
+	{
+		return;
+	}
+
+	b2StackAllocator* alloc = world->stackAllocator;
+	int32_t* order = b2AllocateStackItem(alloc, count * sizeof(int32_t), "sort order");
+	int32_t* slots = b2AllocateStackItem(alloc, count * sizeof(int32_t), "sort slots");
+	b2Body* tempBodies = b2AllocateStackItem(alloc, count * sizeof(b2Body), "sort bodies");
+	b2BodySim* tempSims = b2AllocateStackItem(alloc, count * sizeof(b2BodySim), "sort sims");
+	bool* colorBits = b2AllocateStackItem(alloc, count * sizeof(bool), "sort color bits");
+
+	b2Body* bodies = world->bodies;
+	int32_t index = 0;
+	for (int32_t i = 0; i < awakeIslandCount; ++i)
+	{
+		b2Island* island = world->islands + world->awakeIslandArray[i];
+		int32_t bodyIndex = island->headBody;
+		while (bodyIndex != B2_NULL_INDEX)
+		{
+			order[index] = bodyIndex;
+			index += 1;
+			bodyIndex = bodies[bodyIndex].islandNext;
+		}
+	}
+	B2_ASSERT(index == count);
+
+	// The awake bodies trade places among the slots they already occupy, so sleeping and static
+	// bodies stay put and nothing else is touched.
+	memcpy(slots, order, count * sizeof(int32_t));
+	qsort(slots, count, sizeof(int32_t), b2CompareBodyIndices);
+	b2SortBodiesSpatially(world, order, count);
+
+	for (int32_t i = 0; i < count; ++i)
+	{
+		world->bodyHandles[bodies[order[i]].handleIndex].bodyIndex = slots[i];
+	}
+
+	// Fix everything that refers to the moved bodies by index
+	for (int32_t i = 0; i < count; ++i)
+	{
+		b2Body* body = bodies + order[i];
+		int32_t newIndex = slots[i];
+
+		int32_t shapeIndex = body->shapeList;
+		while (shapeIndex != B2_NULL_INDEX)
+		{
+			b2Shape* shape = world->shapes + shapeIndex;
+			shape->bodyIndex = newIndex;
+			shapeIndex = shape->nextShapeIndex;
+		}
+
+		int32_t chainIndex = body->chainList;
+		while (chainIndex != B2_NULL_INDEX)
+		{
+			b2ChainShape* chain = world->chains + chainIndex;
+			chain->bodyIndex = newIndex;
+			chainIndex = chain->nextIndex;
+		}
+
+		int32_t contactKey = body->contactList;
+		while (contactKey != B2_NULL_INDEX)
+		{
+			b2Contact* contact = world->contacts + (contactKey >> 1);
+			contact->edges[contactKey & 1].bodyIndex = newIndex;
+			contactKey = contact->edges[contactKey & 1].nextKey;
+		}
+
+		int32_t jointKey = body->jointList;
+		while (jointKey != B2_NULL_INDEX)
+		{
+			b2Joint* joint = world->joints + (jointKey >> 1);
+			joint->edges[jointKey & 1].bodyIndex = newIndex;
+			jointKey = joint->edges[jointKey & 1].nextKey;
+		}
+
+		// Compound proxies store the body index as user data
+		if (body->isCompound && body->proxyKey != B2_NULL_INDEX)
+		{
+			b2DynamicTree* tree = world->broadPhase.trees + B2_PROXY_TYPE(body->proxyKey);
+			tree->nodes[B2_PROXY_ID(body->proxyKey)].userData = B2_COMPOUND_PROXY_DATA(newIndex);
+		}
+
+		tempBodies[i] = *body;
+		tempBodies[i].islandPrev = b2SortedBodyIndex(world, body->islandPrev);
+		tempBodies[i].islandNext = b2SortedBodyIndex(world, body->islandNext);
+		tempSims[i] = world->bodySimArray[order[i]];
+	}
+
+	for (int32_t i = 0; i < awakeIslandCount; ++i)
+	{
+		b2Island* island = world->islands + world->awakeIslandArray[i];
+		island->headBody = b2SortedBodyIndex(world, island->headBody);
+		island->tailBody = b2SortedBodyIndex(world, island->tailBody);
+	}
+
+	// Graph coloring tracks bodies by index
+	b2Graph* graph = &world->graph;
+	for (int32_t i = 0; i < b2_graphColorCount; ++i)
+	{
+		b2BitSet* bodySet = &graph->colors[i].bodySet;
+		for (int32_t j = 0; j < count; ++j)
+		{
+			colorBits[j] = b2GetBit(bodySet, order[j]);
+			b2ClearBit(bodySet, order[j]);
+		}
+
+		for (int32_t j = 0; j < count; ++j)
+		{
+			if (colorBits[j])
+			{
+				b2SetBitGrow(bodySet, slots[j]);
+			}
+		}
+	}
+
+	for (int32_t i = 0; i < count; ++i)
+	{
+		int32_t newIndex = slots[i];
+		bodies[newIndex] = tempBodies[i];
+		bodies[newIndex].object.index = newIndex;
+		bodies[newIndex].object.next = newIndex;
+		world->bodySimArray[newIndex] = tempSims[i];
+	}
+
+	b2FreeStackItem(alloc, colorBits);
+	b2FreeStackItem(alloc, tempSims);
+	b2FreeStackItem(alloc, tempBodies);
+	b2FreeStackItem(alloc, slots);
+	b2FreeStackItem(alloc, order);
+}
+
 #if 0
 void b2Body_Dump(b2Body* b)
 {
@@ -4,6 +4,7 @@
 #pragma once
 
 #include "box2d/distance.h"
+#include "box2d/dynamic_tree.h"
 #include "box2d/id.h"
 #include "box2d/math.h"
 
@@ -12,16 +13,14 @@
 typedef struct b2Polygon b2Polygon;
 typedef struct b2World b2World;
 
-// A rigid body
-typedef struct b2Body
+// Body simulation data. This is the hot data touched by the solver, the continuous collision and shape
+// AABB updates every time step. It is stored in a dense array parallel to the body pool (same index)
+// so these stages don't pull the cold body data through the cache.
+typedef struct b2BodySim
 {
-	b2Object object;
-
-	enum b2BodyType type;
-
 	// the body origin transform (not center of mass)
 	b2Transform transform;
-	
+
 	// center of mass position in world
 	b2Vec2 position0;
 	b2Vec2 position;
@@ -36,16 +35,39 @@ typedef struct b2Body
 	b2Vec2 linearVelocity;
 	float angularVelocity;
 
-	// These are the change in position/angle that accumulate across constraint substeps
-	b2Vec2 deltaPosition;
-	float deltaAngle;
-
 	b2Vec2 force;
 	float torque;
 
+	float mass, invMass;
+
+	// Rotational inertia about the center of mass.
+	float I, invI;
+
+	float minExtent;
+	float maxExtent;
+	float linearDamping;
+	float angularDamping;
+	float gravityScale;
+} b2BodySim;
+
+// A rigid body. This is the cold data. See b2BodySim for the simulation data.
+typedef struct b2Body
+{
+	b2Object object;
+
+	// Index of the handle that public ids refer to. The body itself may move, see b2DefragmentBodies.
+	int32_t handleIndex;
+
+	enum b2BodyType type;
+
 	int32_t shapeList;
 	int32_t chainList;
 
+	// Compound bodies keep shape proxies in this tree and own a single broad-phase proxy.
+	// The tree is in world space and is only valid for compound bodies.
+	b2DynamicTree shapeTree;
+	int32_t proxyKey;
+
 	// This is a key: [jointIndex:31, edgeIndex:1]
 	int32_t jointList;
 	int32_t jointCount;
@@ -60,17 +82,6 @@ typedef struct b2Body
 	int32_t islandPrev;
 	int32_t islandNext;
 
-	float mass, invMass;
-
-	// Rotational inertia about the center of mass.
-	float I, invI;
-
-	float minExtent;
-	float maxExtent;
-	float linearDamping;
-	float angularDamping;
-	float gravityScale;
-
 	float sleepTime;
 
 	void* userData;
@@ -83,6 +94,7 @@ typedef struct b2Body
 	bool isFast;
 	bool isSpeedCapped;
 	bool enlargeAABB;
+	bool isCompound;
 } b2Body;
 
 // TODO_ERIN every non-static body gets a solver body. No solver bodies for static bodies to avoid cross thread sharing and the cache misses they bring.
@@ -101,29 +113,49 @@ typedef struct b2SolverBody
 	float invI;    // 4
 } b2SolverBody;
 
+// Public body ids point at a handle which points at the body. This keeps ids valid when bodies
+// are moved around in the body pool to improve memory locality.
+typedef struct b2BodyHandle
+{
+	b2Object object;
+	int32_t bodyIndex;
+} b2BodyHandle;
+
 b2Body* b2GetBody(b2World* world, b2BodyId id);
+b2BodyId b2MakeBodyId(b2World* world, const b2Body* body);
+b2BodySim* b2GetBodySim(b2World* world, b2Body* body);
 bool b2ShouldBodiesCollide(b2World* world, b2Body* bodyA, b2Body* bodyB);
 bool b2IsBodyAwake(b2World* world, b2Body* body);
 void b2UpdateBodyMassData(b2World* world, b2Body* body);
 
-static inline b2Sweep b2MakeSweep(const b2Body* body)
+// Move the bodies to the front of the body pool ordered by island. Public body ids stay valid.
+void b2DefragmentBodies(b2World* world);
+
+// Reorder the awake bodies along a space filling curve within the slots they already occupy.
+// Only the awake bodies and the objects attached to them are touched. Public body ids stay valid.
+void b2SortAwakeBodies(b2World* world);
+
+void b2CreateCompoundProxy(b2World* world, b2Body* body);
+void b2DestroyCompoundProxy(b2World* world, b2Body* body);
+
+static inline b2Sweep b2MakeSweep(const b2Body* body, const b2BodySim* bodySim)
 {
 	b2Sweep s;
 	if (body->type == b2_staticBody)
 	{
-		s.c1 = body->position;
-		s.c2 = body->position;
-		s.a1 = body->angle;
-		s.a2 = body->angle;
+		s.c1 = bodySim->position;
+		s.c2 = bodySim->position;
+		s.a1 = bodySim->angle;
+		s.a2 = bodySim->angle;
 	}
 	else
 	{
-		s.c1 = body->position0;
-		s.c2 = body->position;
-		s.a1 = body->angle0;
-		s.a2 = body->angle;
+		s.c1 = bodySim->position0;
+		s.c2 = bodySim->position;
+		s.a1 = bodySim->angle0;
+		s.a2 = bodySim->angle;
 	}
 
-	s.localCenter = body->localCenter;
+	s.localCenter = bodySim->localCenter;
 	return s;
 }
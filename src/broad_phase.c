@@ -25,7 +25,7 @@
 
 // static FILE* s_file = NULL;
 
-void b2CreateBroadPhase(b2BroadPhase* bp)
+void b2CreateBroadPhase(b2BroadPhase* bp, b2Allocator* allocator)
 {
 	// if (s_file == NULL)
 	//{
@@ -33,11 +33,12 @@ void b2CreateBroadPhase(b2BroadPhase* bp)
 	//	fprintf(s_file, "============\n\n");
 	// }
 
+	bp->allocator = allocator;
 	bp->proxyCount = 0;
 
 	// TODO_ERIN initial size in b2WorldDef?
-	bp->moveSet = b2CreateSet(16);
-	bp->moveArray = b2CreateArray(sizeof(int32_t), 16);
+	bp->moveSet = b2CreateSet(allocator, 16);
+	bp->moveArray = b2CreateArray(allocator, sizeof(int32_t), 16);
 
 	bp->moveResults = NULL;
 	bp->movePairs = NULL;
@@ -45,11 +46,11 @@ void b2CreateBroadPhase(b2BroadPhase* bp)
 	bp->movePairIndex = 0;
 
 	// TODO_ERIN initial size from b2WorldDef
-	bp->pairSet = b2CreateSet(32);
+	bp->pairSet = b2CreateSet(allocator, 32);
 
 	for (int32_t i = 0; i < b2_bodyTypeCount; ++i)
 	{
-		bp->trees[i] = b2DynamicTree_Create();
+		bp->trees[i] = b2CreateDynamicTree(allocator);
 	}
 }
 
@@ -92,10 +93,10 @@ static inline void b2UnBufferMove(b2BroadPhase* bp, int32_t proxyKey)
 	}
 }
 
-int32_t b2BroadPhase_CreateProxy(b2BroadPhase* bp, b2BodyType bodyType, b2AABB aabb, uint32_t categoryBits, int32_t shapeIndex)
+int32_t b2BroadPhase_CreateProxy(b2BroadPhase* bp, b2BodyType bodyType, b2AABB aabb, uint32_t categoryBits, int32_t userData)
 {
 	B2_ASSERT(0 <= bodyType && bodyType < b2_bodyTypeCount);
-	int32_t proxyId = b2DynamicTree_CreateProxy(bp->trees + bodyType, aabb, categoryBits, shapeIndex);
+	int32_t proxyId = b2DynamicTree_CreateProxy(bp->trees + bodyType, aabb, categoryBits, userData);
 	int32_t proxyKey = B2_PROXY_KEY(proxyId, bodyType);
 	if (bodyType != b2_staticBody)
 	{
@@ -161,51 +162,22 @@ typedef struct b2QueryPairContext
 	b2MoveResult* moveResult;
 	b2BodyType queryTreeType;
 	int32_t queryProxyKey;
-	int32_t queryShapeIndex;
+	int32_t queryUserData;
 } b2QueryPairContext;
 
-// This is called from b2DynamicTree::Query when we are gathering pairs.
-static bool b2PairQueryCallback(int32_t proxyId, int32_t shapeIndex, void* context)
+// Add a potential pair of shapes. The shapes are ordered by proxy key for determinism.
+static void b2AddPair(b2QueryPairContext* queryContext, int32_t shapeIndexA, int32_t shapeIndexB)
 {
-	b2QueryPairContext* queryContext = context;
-	b2BroadPhase* bp = &queryContext->world->broadPhase;
-
-	int32_t proxyKey = B2_PROXY_KEY(proxyId, queryContext->queryTreeType);
-
-	// A proxy cannot form a pair with itself.
-	if (proxyKey == queryContext->queryProxyKey)
-	{
-		return true;
-	}
-
-	bool moved = b2ContainsKey(&bp->moveSet, proxyKey + 1);
-	if (moved && proxyKey < queryContext->queryProxyKey)
-	{
-		// Both proxies are moving. Avoid duplicate pairs.
-		return true;
-	}
+	b2World* world = queryContext->world;
+	b2BroadPhase* bp = &world->broadPhase;
 
-	uint64_t pairKey = B2_SHAPE_PAIR_KEY(shapeIndex, queryContext->queryShapeIndex);
+	uint64_t pairKey = B2_SHAPE_PAIR_KEY(shapeIndexA, shapeIndexB);
 	if (b2ContainsKey(&bp->pairSet, pairKey))
 	{
 		// contact exists
-		return true;
-	}
-
-	int32_t shapeIndexA, shapeIndexB;
-	if (proxyKey < queryContext->queryProxyKey)
-	{
-		shapeIndexA = shapeIndex;
-		shapeIndexB = queryContext->queryShapeIndex;
-	}
-	else
-	{
-		shapeIndexA = queryContext->queryShapeIndex;
-		shapeIndexB = shapeIndex;
+		return;
 	}
 
-	b2World* world = queryContext->world;
-
 	B2_ASSERT(0 <= shapeIndexA && shapeIndexA < world->shapePool.capacity);
 	B2_ASSERT(0 <= shapeIndexB && shapeIndexB < world->shapePool.capacity);
 
@@ -215,12 +187,18 @@ static bool b2PairQueryCallback(int32_t proxyId, int32_t shapeIndex, void* conte
 	// Are the shapes on the same body?
 	if (shapeA->bodyIndex == shapeB->bodyIndex)
 	{
-		return true;
+		return;
+	}
+
+	// Sensors are handled elsewhere
+	if (shapeA->isSensor || shapeB->isSensor)
+	{
+		return;
 	}
 
 	if (b2ShouldShapesCollide(shapeA->filter, shapeB->filter) == false)
 	{
-		return true;
+		return;
 	}
 
 	int32_t bodyIndexA = shapeA->bodyIndex;
@@ -232,7 +210,7 @@ static bool b2PairQueryCallback(int32_t proxyId, int32_t shapeIndex, void* conte
 	// TODO_ERIN this could be a hash set
 	if (b2ShouldBodiesCollide(world, bodyA, bodyB) == false)
 	{
-		return true;
+		return;
 	}
 
 	// TODO_ERIN per thread to eliminate atomic?
@@ -246,7 +224,7 @@ static bool b2PairQueryCallback(int32_t proxyId, int32_t shapeIndex, void* conte
 	}
 	else
 	{
-		pair = b2Alloc(sizeof(b2MovePair));
+		pair = b2Alloc(&world->allocator, sizeof(b2MovePair));
 		pair->heap = true;
 	}
 
@@ -254,6 +232,136 @@ static bool b2PairQueryCallback(int32_t proxyId, int32_t shapeIndex, void* conte
 	pair->shapeIndexB = shapeIndexB;
 	pair->next = queryContext->moveResult->pairList;
 	queryContext->moveResult->pairList = pair;
+}
+
+typedef struct b2CompoundPairContext
+{
+	b2QueryPairContext* queryContext;
+	int32_t shapeIndex;
+	bool shapeIsA;
+} b2CompoundPairContext;
+
+static bool b2CompoundPairCallback(int32_t proxyId, int32_t shapeIndex, void* context)
+{
+	B2_MAYBE_UNUSED(proxyId);
+
+	b2CompoundPairContext* compoundContext = context;
+	if (compoundContext->shapeIsA)
+	{
+		b2AddPair(compoundContext->queryContext, compoundContext->shapeIndex, shapeIndex);
+	}
+	else
+	{
+		b2AddPair(compoundContext->queryContext, shapeIndex, compoundContext->shapeIndex);
+	}
+
+	return true;
+}
+
+// Pairs between two compound bodies. Each shape of the first body queries the shape tree of the
+// second body. The tree leaves hold the fat AABBs of the shapes in world space.
+static void b2AddTreePairs(b2QueryPairContext* queryContext, const b2Body* bodyA, const b2Body* bodyB)
+{
+	b2World* world = queryContext->world;
+	const b2DynamicTree* treeB = &bodyB->shapeTree;
+	b2AABB rootAABB = treeB->nodes[treeB->root].aabb;
+
+	b2CompoundPairContext compoundContext;
+	compoundContext.queryContext = queryContext;
+	compoundContext.shapeIsA = true;
+
+	int32_t shapeIndex = bodyA->shapeList;
+	while (shapeIndex != B2_NULL_INDEX)
+	{
+		const b2Shape* shape = world->shapes + shapeIndex;
+		if (b2AABB_Overlaps(shape->fatAABB, rootAABB))
+		{
+			compoundContext.shapeIndex = shapeIndex;
+			b2DynamicTree_Query(treeB, shape->fatAABB, b2CompoundPairCallback, &compoundContext);
+		}
+
+		shapeIndex = shape->nextShapeIndex;
+	}
+}
+
+// Expand a proxy pair where at least one proxy belongs to a compound body into shape pairs.
+static void b2AddCompoundPairs(b2QueryPairContext* queryContext, int32_t userDataA, int32_t userDataB)
+{
+	b2World* world = queryContext->world;
+
+	if (B2_IS_COMPOUND_PROXY(userDataA) && B2_IS_COMPOUND_PROXY(userDataB))
+	{
+		b2Body* bodyA = world->bodies + B2_COMPOUND_BODY_INDEX(userDataA);
+		b2Body* bodyB = world->bodies + B2_COMPOUND_BODY_INDEX(userDataB);
+		B2_ASSERT(bodyA->isCompound && bodyB->isCompound);
+		b2AddTreePairs(queryContext, bodyA, bodyB);
+		return;
+	}
+
+	b2CompoundPairContext compoundContext;
+	compoundContext.queryContext = queryContext;
+
+	b2Body* compoundBody;
+	if (B2_IS_COMPOUND_PROXY(userDataA))
+	{
+		compoundBody = world->bodies + B2_COMPOUND_BODY_INDEX(userDataA);
+		compoundContext.shapeIndex = userDataB;
+		compoundContext.shapeIsA = false;
+	}
+	else
+	{
+		compoundBody = world->bodies + B2_COMPOUND_BODY_INDEX(userDataB);
+		compoundContext.shapeIndex = userDataA;
+		compoundContext.shapeIsA = true;
+	}
+
+	B2_ASSERT(compoundBody->isCompound);
+	B2_ASSERT(0 <= compoundContext.shapeIndex && compoundContext.shapeIndex < world->shapePool.capacity);
+	b2AABB fatAABB = world->shapes[compoundContext.shapeIndex].fatAABB;
+	b2DynamicTree_Query(&compoundBody->shapeTree, fatAABB, b2CompoundPairCallback, &compoundContext);
+}
+
+// This is called from b2DynamicTree::Query when we are gathering pairs.
+static bool b2PairQueryCallback(int32_t proxyId, int32_t userData, void* context)
+{
+	b2QueryPairContext* queryContext = context;
+	b2BroadPhase* bp = &queryContext->world->broadPhase;
+
+	int32_t proxyKey = B2_PROXY_KEY(proxyId, queryContext->queryTreeType);
+
+	// A proxy cannot form a pair with itself.
+	if (proxyKey == queryContext->queryProxyKey)
+	{
+		return true;
+	}
+
+	bool moved = b2ContainsKey(&bp->moveSet, proxyKey + 1);
+	if (moved && proxyKey < queryContext->queryProxyKey)
+	{
+		// Both proxies are moving. Avoid duplicate pairs.
+		return true;
+	}
+
+	int32_t userDataA, userDataB;
+	if (proxyKey < queryContext->queryProxyKey)
+	{
+		userDataA = userData;
+		userDataB = queryContext->queryUserData;
+	}
+	else
+	{
+		userDataA = queryContext->queryUserData;
+		userDataB = userData;
+	}
+
+	if (B2_IS_COMPOUND_PROXY(userDataA) || B2_IS_COMPOUND_PROXY(userDataB))
+	{
+		b2AddCompoundPairs(queryContext, userDataA, userDataB);
+	}
+	else
+	{
+		b2AddPair(queryContext, userDataA, userDataB);
+	}
 
 	// continue the query
 	return true;
@@ -293,7 +401,7 @@ void b2FindPairsTask(int32_t startIndex, int32_t endIndex, uint32_t threadIndex,
 		// We have to query the tree with the fat AABB so that
 		// we don't fail to create a contact that may touch later.
 		b2AABB fatAABB = b2DynamicTree_GetAABB(baseTree, proxyId);
-		queryContext.queryShapeIndex = b2DynamicTree_GetUserData(baseTree, proxyId);
+		queryContext.queryUserData = b2DynamicTree_GetUserData(baseTree, proxyId);
 
 		// Query trees
 		if (proxyType == b2_dynamicBody)
@@ -381,7 +489,7 @@ void b2UpdateBroadPhasePairs(b2World* world)
 			{
 				b2MovePair* temp = pair;
 				pair = pair->next;
-				b2Free(temp, sizeof(b2MovePair));
+				b2Free(&world->allocator, temp, sizeof(b2MovePair));
 			}
 			else
 			{
@@ -8,6 +8,7 @@
 
 #include "box2d/dynamic_tree.h"
 
+typedef struct b2Allocator b2Allocator;
 typedef struct b2Shape b2Shape;
 typedef struct b2MovePair b2MovePair;
 typedef struct b2MoveResult b2MoveResult;
@@ -19,11 +20,19 @@ typedef struct b2World b2World;
 #define B2_PROXY_ID(KEY) ((KEY) >> 4)
 #define B2_PROXY_KEY(ID, TYPE) (((ID) << 4) | (TYPE))
 
+// A compound body has a single proxy that stores an encoded body index as user data instead of a shape index.
+// Shape indices are non-negative and B2_NULL_INDEX is -1, so the encoding starts at -2.
+#define B2_COMPOUND_PROXY_DATA(BODY_INDEX) (-2 - (BODY_INDEX))
+#define B2_IS_COMPOUND_PROXY(DATA) ((DATA) < -1)
+#define B2_COMPOUND_BODY_INDEX(DATA) (-2 - (DATA))
+
 /// The broad-phase is used for computing pairs and performing volume queries and ray casts.
 /// This broad-phase does not persist pairs. Instead, this reports potentially new pairs.
 /// It is up to the client to consume the new pairs and to track subsequent overlap.
 typedef struct b2BroadPhase
 {
+	b2Allocator* allocator;
+
 	b2DynamicTree trees[b2_bodyTypeCount];
 	int32_t proxyCount;
 
@@ -44,9 +53,9 @@ typedef struct b2BroadPhase
 
 } b2BroadPhase;
 
-void b2CreateBroadPhase(b2BroadPhase* bp);
+void b2CreateBroadPhase(b2BroadPhase* bp, b2Allocator* allocator);
 void b2DestroyBroadPhase(b2BroadPhase* bp);
-int32_t b2BroadPhase_CreateProxy(b2BroadPhase* bp, b2BodyType bodyType, b2AABB aabb, uint32_t categoryBits, int32_t shapeIndex);
+int32_t b2BroadPhase_CreateProxy(b2BroadPhase* bp, b2BodyType bodyType, b2AABB aabb, uint32_t categoryBits, int32_t userData);
 void b2BroadPhase_DestroyProxy(b2BroadPhase* bp, int32_t proxyKey);
 
 void b2BroadPhase_MoveProxy(b2BroadPhase* bp, int32_t proxyKey, b2AABB aabb);
@@ -59,6 +68,12 @@ int32_t b2BroadPhase_GetShapeIndex(b2BroadPhase* bp, int32_t proxyKey);
 void b2UpdateBroadPhasePairs(b2World* world);
 bool b2BroadPhase_TestOverlap(const b2BroadPhase* bp, int32_t proxyKeyA, int32_t proxyKeyB);
 
+// Create a dynamic tree that allocates through a world allocator. Implemented in dynamic_tree.c.
+b2DynamicTree b2CreateDynamicTree(b2Allocator* allocator);
+
+// Release free nodes at the end of the node pool and oversized rebuild buffers. Proxy ids don't change.
+void b2ShrinkDynamicTree(b2DynamicTree* tree);
+
 void b2ValidateBroadphase(const b2BroadPhase* bp);
 void b2ValidateNoEnlarged(const b2BroadPhase* bp);
 
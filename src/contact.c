@@ -69,77 +69,115 @@ static b2Manifold b2CircleManifold(const b2Shape* shapeA, b2Transform xfA, const
 								   b2DistanceCache* cache)
 {
 	B2_MAYBE_UNUSED(cache);
-	return b2CollideCircles(&shapeA->circle, xfA, &shapeB->circle, xfB);
+	return b2CollideCircles(shapeA->circle, xfA, shapeB->circle, xfB);
 }
 
 static b2Manifold b2CapsuleAndCircleManifold(const b2Shape* shapeA, b2Transform xfA, const b2Shape* shapeB, b2Transform xfB,
 											 b2DistanceCache* cache)
 {
 	B2_MAYBE_UNUSED(cache);
-	return b2CollideCapsuleAndCircle(&shapeA->capsule, xfA, &shapeB->circle, xfB);
+	return b2CollideCapsuleAndCircle(shapeA->capsule, xfA, shapeB->circle, xfB);
 }
 
 static b2Manifold b2CapsuleManifold(const b2Shape* shapeA, b2Transform xfA, const b2Shape* shapeB, b2Transform xfB,
 									b2DistanceCache* cache)
 {
-	return b2CollideCapsules(&shapeA->capsule, xfA, &shapeB->capsule, xfB, cache);
+	return b2CollideCapsules(shapeA->capsule, xfA, shapeB->capsule, xfB, cache);
 }
 
 static b2Manifold b2PolygonAndCircleManifold(const b2Shape* shapeA, b2Transform xfA, const b2Shape* shapeB, b2Transform xfB,
 											 b2DistanceCache* cache)
 {
 	B2_MAYBE_UNUSED(cache);
-	return b2CollidePolygonAndCircle(&shapeA->polygon, xfA, &shapeB->circle, xfB);
+	return b2CollidePolygonAndCircle(shapeA->polygon, xfA, shapeB->circle, xfB);
 }
 
 static b2Manifold b2PolygonAndCapsuleManifold(const b2Shape* shapeA, b2Transform xfA, const b2Shape* shapeB, b2Transform xfB,
 											  b2DistanceCache* cache)
 {
-	return b2CollidePolygonAndCapsule(&shapeA->polygon, xfA, &shapeB->capsule, xfB, cache);
+	return b2CollidePolygonAndCapsule(shapeA->polygon, xfA, shapeB->capsule, xfB, cache);
 }
 
 static b2Manifold b2PolygonManifold(const b2Shape* shapeA, b2Transform xfA, const b2Shape* shapeB, b2Transform xfB,
 									b2DistanceCache* cache)
 {
-	return b2CollidePolygons(&shapeA->polygon, xfA, &shapeB->polygon, xfB, cache);
+	return b2CollidePolygons(shapeA->polygon, xfA, shapeB->polygon, xfB, cache);
 }
 
 static b2Manifold b2SegmentAndCircleManifold(const b2Shape* shapeA, b2Transform xfA, const b2Shape* shapeB, b2Transform xfB,
 											 b2DistanceCache* cache)
 {
 	B2_MAYBE_UNUSED(cache);
-	return b2CollideSegmentAndCircle(&shapeA->segment, xfA, &shapeB->circle, xfB);
+	return b2CollideSegmentAndCircle(shapeA->segment, xfA, shapeB->circle, xfB);
 }
 
 static b2Manifold b2SegmentAndCapsuleManifold(const b2Shape* shapeA, b2Transform xfA, const b2Shape* shapeB, b2Transform xfB,
 											  b2DistanceCache* cache)
 {
-	return b2CollideSegmentAndCapsule(&shapeA->segment, xfA, &shapeB->capsule, xfB, cache);
+	return b2CollideSegmentAndCapsule(shapeA->segment, xfA, shapeB->capsule, xfB, cache);
 }
 
 static b2Manifold b2SegmentAndPolygonManifold(const b2Shape* shapeA, b2Transform xfA, const b2Shape* shapeB, b2Transform xfB,
 											  b2DistanceCache* cache)
 {
-	return b2CollideSegmentAndPolygon(&shapeA->segment, xfA, &shapeB->polygon, xfB, cache);
+	return b2CollideSegmentAndPolygon(shapeA->segment, xfA, shapeB->polygon, xfB, cache);
 }
 
 static b2Manifold b2SmoothSegmentAndCircleManifold(const b2Shape* shapeA, b2Transform xfA, const b2Shape* shapeB, b2Transform xfB,
 												   b2DistanceCache* cache)
 {
 	B2_MAYBE_UNUSED(cache);
-	return b2CollideSmoothSegmentAndCircle(&shapeA->smoothSegment, xfA, &shapeB->circle, xfB);
+	return b2CollideSmoothSegmentAndCircle(shapeA->smoothSegment, xfA, shapeB->circle, xfB);
 }
 
 static b2Manifold b2SmoothSegmentAndCapsuleManifold(const b2Shape* shapeA, b2Transform xfA, const b2Shape* shapeB, b2Transform xfB,
 												   b2DistanceCache* cache)
 {
-	return b2CollideSmoothSegmentAndCapsule(&shapeA->smoothSegment, xfA, &shapeB->capsule, xfB, cache);
+	return b2CollideSmoothSegmentAndCapsule(shapeA->smoothSegment, xfA, shapeB->capsule, xfB, cache);
 }
 
 static b2Manifold b2SmoothSegmentAndPolygonManifold(const b2Shape* shapeA, b2Transform xfA, const b2Shape* shapeB,
 													b2Transform xfB, b2DistanceCache* cache)
 {
-	return b2CollideSmoothSegmentAndPolygon(&shapeA->smoothSegment, xfA, &shapeB->polygon, xfB, cache);
+	return b2CollideSmoothSegmentAndPolygon(shapeA->smoothSegment, xfA, shapeB->polygon, xfB, cache);
+}
+
+static b2Manifold b2HeightfieldAndCircleManifold(const b2Shape* shapeA, b2Transform xfA, const b2Shape* shapeB, b2Transform xfB,
+												 b2DistanceCache* cache)
+{
+	B2_MAYBE_UNUSED(cache);
+	return b2CollideHeightfieldAndCircle(shapeA->heightfield, xfA, shapeB->circle, xfB);
+}
+
+static b2Manifold b2HeightfieldAndCapsuleManifold(const b2Shape* shapeA, b2Transform xfA, const b2Shape* shapeB, b2Transform xfB,
+												  b2DistanceCache* cache)
+{
+	return b2CollideHeightfieldAndCapsule(shapeA->heightfield, xfA, shapeB->capsule, xfB, cache);
+}
+
+static b2Manifold b2HeightfieldAndPolygonManifold(const b2Shape* shapeA, b2Transform xfA, const b2Shape* shapeB, b2Transform xfB,
+												  b2DistanceCache* cache)
+{
+	return b2CollideHeightfieldAndPolygon(shapeA->heightfield, xfA, shapeB->polygon, xfB, cache);
+}
+
+static b2Manifold b2SmoothChainAndCircleManifold(const b2Shape* shapeA, b2Transform xfA, const b2Shape* shapeB, b2Transform xfB,
+												 b2DistanceCache* cache)
+{
+	B2_MAYBE_UNUSED(cache);
+	return b2CollideSmoothChainAndCircle(shapeA->smoothChain, xfA, shapeB->circle, xfB);
+}
+
+static b2Manifold b2SmoothChainAndCapsuleManifold(const b2Shape* shapeA, b2Transform xfA, const b2Shape* shapeB, b2Transform xfB,
+												  b2DistanceCache* cache)
+{
+	return b2CollideSmoothChainAndCapsule(shapeA->smoothChain, xfA, shapeB->capsule, xfB, cache);
+}
+
+static b2Manifold b2SmoothChainAndPolygonManifold(const b2Shape* shapeA, b2Transform xfA, const b2Shape* shapeB, b2Transform xfB,
+												  b2DistanceCache* cache)
+{
+	return b2CollideSmoothChainAndPolygon(shapeA->smoothChain, xfA, shapeB->polygon, xfB, cache);
 }
 
 static void b2AddType(b2ManifoldFcn* fcn, b2ShapeType type1, b2ShapeType type2)
@@ -173,10 +211,23 @@ void b2InitializeContactRegisters(void)
 		b2AddType(b2SmoothSegmentAndCircleManifold, b2_smoothSegmentShape, b2_circleShape);
 		b2AddType(b2SmoothSegmentAndCapsuleManifold, b2_smoothSegmentShape, b2_capsuleShape);
 		b2AddType(b2SmoothSegmentAndPolygonManifold, b2_smoothSegmentShape, b2_polygonShape);
+		b2AddType(b2HeightfieldAndCircleManifold, b2_heightfieldShape, b2_circleShape);
+		b2AddType(b2HeightfieldAndCapsuleManifold, b2_heightfieldShape, b2_capsuleShape);
+		b2AddType(b2HeightfieldAndPolygonManifold, b2_heightfieldShape, b2_polygonShape);
+		b2AddType(b2SmoothChainAndCircleManifold, b2_smoothChainShape, b2_circleShape);
+		b2AddType(b2SmoothChainAndCapsuleManifold, b2_smoothChainShape, b2_capsuleShape);
+		b2AddType(b2SmoothChainAndPolygonManifold, b2_smoothChainShape, b2_polygonShape);
 		s_initialized = true;
 	}
 }
 
+bool b2ShouldShapeTypesCollide(b2ShapeType typeA, b2ShapeType typeB)
+{
+	B2_ASSERT(0 <= typeA && typeA < b2_shapeTypeCount);
+	B2_ASSERT(0 <= typeB && typeB < b2_shapeTypeCount);
+	return s_registers[typeA][typeB].fcn != NULL;
+}
+
 void b2CreateContact(b2World* world, b2Shape* shapeA, b2Shape* shapeB)
 {
 	b2ShapeType type1 = shapeA->type;
@@ -205,16 +256,6 @@ void b2CreateContact(b2World* world, b2Shape* shapeA, b2Shape* shapeB)
 
 	contact->flags = 0;
 
-	if (shapeA->isSensor || shapeB->isSensor)
-	{
-		contact->flags |= b2_contactSensorFlag;
-	}
-
-	if (shapeA->enableSensorEvents || shapeB->enableSensorEvents)
-	{
-		contact->flags |= b2_contactEnableSensorEvents;
-	}
-
 	if (shapeA->enableContactEvents || shapeB->enableContactEvents)
 	{
 		contact->flags |= b2_contactEnableContactEvents;
@@ -227,8 +268,8 @@ void b2CreateContact(b2World* world, b2Shape* shapeA, b2Shape* shapeB)
 
 	contact->shapeIndexA = shapeA->object.index;
 	contact->shapeIndexB = shapeB->object.index;
+	contact->manifoldIndex = B2_NULL_INDEX;
 	contact->cache = b2_emptyDistanceCache;
-	contact->manifold = b2_emptyManifold;
 	contact->friction = b2MixFriction(shapeA->friction, shapeB->friction);
 	contact->restitution = b2MixRestitution(shapeA->restitution, shapeB->restitution);
 	contact->tangentSpeed = 0.0f;
@@ -372,6 +413,8 @@ void b2DestroyContact(b2World* world, b2Contact* contact)
 		b2UnlinkContact(world, contact);
 	}
 
+	b2RemoveContactManifold(world, contact);
+
 	// Remove from awake contact array
 	b2Array_Check(world->contactAwakeIndexArray, contactIndex);
 	int32_t awakeIndex = world->contactAwakeIndexArray[contactIndex];
@@ -396,26 +439,12 @@ bool b2ShouldShapesCollide(b2Filter filterA, b2Filter filterB)
 	return collide;
 }
 
-static bool b2TestShapeOverlap(const b2Shape* shapeA, b2Transform xfA, const b2Shape* shapeB, b2Transform xfB)
-{
-	b2DistanceInput input;
-	input.proxyA = b2MakeShapeDistanceProxy(shapeA);
-	input.proxyB = b2MakeShapeDistanceProxy(shapeB);
-	input.transformA = xfA;
-	input.transformB = xfB;
-	input.useRadii = true;
-
-	b2DistanceCache cache = {0};
-	b2DistanceOutput output = b2ShapeDistance(&cache, &input);
-
-	return output.distance < 10.0f * FLT_EPSILON;
-}
-
 // Update the contact manifold and touching status.
 // Note: do not assume the shape AABBs are overlapping or are valid.
-void b2UpdateContact(b2World* world, b2Contact* contact, b2Shape* shapeA, b2Body* bodyA, b2Shape* shapeB, b2Body* bodyB)
+void b2UpdateContact(b2World* world, b2Contact* contact, b2Manifold* manifold, b2Shape* shapeA, b2BodySim* bodySimA,
+					 b2Shape* shapeB, b2BodySim* bodySimB)
 {
-	b2Manifold oldManifold = contact->manifold;
+	b2Manifold oldManifold = *manifold;
 
 	B2_ASSERT(shapeA->object.index == contact->shapeIndexA);
 	B2_ASSERT(shapeB->object.index == contact->shapeIndexB);
@@ -423,64 +452,51 @@ void b2UpdateContact(b2World* world, b2Contact* contact, b2Shape* shapeA, b2Body
 	b2ShapeId shapeIdA = {shapeA->object.index, world->index, shapeA->object.revision};
 	b2ShapeId shapeIdB = {shapeB->object.index, world->index, shapeB->object.revision};
 
-	bool touching = false;
-	contact->manifold.pointCount = 0;
+	B2_ASSERT(shapeA->isSensor == false && shapeB->isSensor == false);
 
-	bool sensorA = shapeA->isSensor;
-	bool sensorB = shapeB->isSensor;
-	bool sensor = sensorA || sensorB;
-
-	// Is this contact a sensor?
-	if (sensor)
-	{
-		touching = b2TestShapeOverlap(shapeA, bodyA->transform, shapeB, bodyB->transform);
+	bool touching = false;
 
-		// Sensors don't generate manifolds.
-	}
-	else
-	{
-		// Compute TOI
-		b2ManifoldFcn* fcn = s_registers[shapeA->type][shapeB->type].fcn;
+	// Compute TOI
+	b2ManifoldFcn* fcn = s_registers[shapeA->type][shapeB->type].fcn;
 
-		contact->manifold = fcn(shapeA, bodyA->transform, shapeB, bodyB->transform, &contact->cache);
+	*manifold = fcn(shapeA, bodySimA->transform, shapeB, bodySimB->transform, &contact->cache);
 
-		touching = contact->manifold.pointCount > 0;
+	touching = manifold->pointCount > 0;
 
-		// Match old contact ids to new contact ids and copy the
-		// stored impulses to warm start the solver.
-		for (int32_t i = 0; i < contact->manifold.pointCount; ++i)
+	// Match old contact ids to new contact ids and copy the
+	// stored impulses to warm start the solver.
+	for (int32_t i = 0; i < manifold->pointCount; ++i)
+	{
+		b2ManifoldPoint* mp2 = manifold->points + i;
+		mp2->anchorA = b2Sub(mp2->point, bodySimA->position);
+		mp2->anchorB = b2Sub(mp2->point, bodySimB->position);
+		mp2->normalImpulse = 0.0f;
+		mp2->tangentImpulse = 0.0f;
+		mp2->persisted = false;
+		uint32_t id2 = mp2->id;
+
+		for (int32_t j = 0; j < oldManifold.pointCount; ++j)
 		{
-			b2ManifoldPoint* mp2 = contact->manifold.points + i;
-			mp2->anchorA = b2Sub(mp2->point, bodyA->position);
-			mp2->anchorB = b2Sub(mp2->point, bodyB->position);
-			mp2->normalImpulse = 0.0f;
-			mp2->tangentImpulse = 0.0f;
-			mp2->persisted = false;
-			uint16_t id2 = mp2->id;
-
-			for (int32_t j = 0; j < oldManifold.pointCount; ++j)
+			b2ManifoldPoint* mp1 = oldManifold.points + j;
+
+			if (mp1->id == id2)
 			{
-				b2ManifoldPoint* mp1 = oldManifold.points + j;
-
-				if (mp1->id == id2)
-				{
-					mp2->normalImpulse = mp1->normalImpulse;
-					mp2->tangentImpulse = mp1->tangentImpulse;
-					mp2->persisted = true;
-					break;
-				}
+				mp2->normalImpulse = mp1->normalImpulse;
+				mp2->tangentImpulse = mp1->tangentImpulse;
+				mp2->persisted = true;
+				break;
 			}
 		}
+	}
 
-		if (touching && world->preSolveFcn && (contact->flags & b2_contactEnablePreSolveEvents) != 0)
+	if (touching && world->preSolveFcn && (contact->flags & b2_contactEnablePreSolveEvents) != 0)
+	{
+		// this call assumes thread safety
+		bool collide = world->preSolveFcn(shapeIdA, shapeIdB, manifold, world->preSolveContext);
+		if (collide == false)
 		{
-			// this call assumes thread safety
-			bool collide = world->preSolveFcn(shapeIdA, shapeIdB, &contact->manifold, world->preSolveContext);
-			if (collide == false)
-			{
-				// disable contact
-				touching = false;
-			}
+			// disable contact
+			touching = false;
 		}
 	}
 
@@ -494,6 +510,41 @@ void b2UpdateContact(b2World* world, b2Contact* contact, b2Shape* shapeA, b2Body
 	}
 }
 
+const b2Manifold* b2GetContactManifold(const b2World* world, const b2Contact* contact)
+{
+	if (contact->manifoldIndex == B2_NULL_INDEX)
+	{
+		return &b2_emptyManifold;
+	}
+
+	B2_ASSERT(0 <= contact->manifoldIndex && contact->manifoldIndex < world->manifoldPool.capacity);
+	return &world->manifolds[contact->manifoldIndex].manifold;
+}
+
+void b2AddContactManifold(b2World* world, b2Contact* contact, const b2Manifold* manifold)
+{
+	B2_ASSERT(contact->manifoldIndex == B2_NULL_INDEX);
+
+	b2ContactManifold* contactManifold = (b2ContactManifold*)b2AllocObject(&world->manifoldPool);
+	world->manifolds = (b2ContactManifold*)world->manifoldPool.memory;
+
+	contactManifold->manifold = *manifold;
+	contact->manifoldIndex = contactManifold->object.index;
+}
+
+void b2RemoveContactManifold(b2World* world, b2Contact* contact)
+{
+	if (contact->manifoldIndex == B2_NULL_INDEX)
+	{
+		return;
+	}
+
+	b2ContactManifold* contactManifold = world->manifolds + contact->manifoldIndex;
+	B2_ASSERT(b2ObjectValid(&contactManifold->object));
+	b2FreeObject(&world->manifoldPool, &contactManifold->object);
+	contact->manifoldIndex = B2_NULL_INDEX;
+}
+
 #if 0 // todo probably delete this in favor of new API
 b2Contact* b2GetContact(b2World* world, b2ContactId contactId)
 {
@@ -558,7 +609,7 @@ b2ContactData b2Contact_GetData(b2ContactId contactId)
 	b2Shape* shapeB = world->shapes + contact->shapeIndexB;
 	b2ShapeId idA = {shapeA->object.index, contactId.world, shapeA->object.revision};
 	b2ShapeId idB = {shapeB->object.index, contactId.world, shapeB->object.revision};
-	b2ContactData data = {idA, idB, contact->manifold};
+	b2ContactData data = {idA, idB, *b2GetContactManifold(world, contact)};
 	return data;
 }
 #endif
@@ -9,7 +9,7 @@
 #include "box2d/manifold.h"
 #include "box2d/types.h"
 
-typedef struct b2Body b2Body;
+typedef struct b2BodySim b2BodySim;
 typedef struct b2Shape b2Shape;
 typedef struct b2World b2World;
 
@@ -31,9 +31,6 @@ enum b2ContactFlags
 	// Set when the shapes are touching.
 	b2_contactTouchingFlag = 0x00000002,
 
-	// One of the shapes is a sensor
-	b2_contactSensorFlag = 0x00000010,
-
 	// This contact no longer has overlapping AABBs
 	b2_contactDisjoint = 0x00000020,
 
@@ -43,9 +40,6 @@ enum b2ContactFlags
 	// This contact stopped touching
 	b2_contactStoppedTouching = 0x00000080,
 
-	// This contact wants sensor events
-	b2_contactEnableSensorEvents = 0x00000100,
-
 	// This contact wants contact events
 	b2_contactEnableContactEvents = 0x00000200,
 
@@ -73,8 +67,10 @@ typedef struct b2Contact
 	int32_t shapeIndexA;
 	int32_t shapeIndexB;
 
+	// Index into the world manifold pool. Only touching contacts have a manifold, otherwise B2_NULL_INDEX.
+	int32_t manifoldIndex;
+
 	b2DistanceCache cache;
-	b2Manifold manifold;
 
 	// A contact only belongs to an island if touching, otherwise B2_NULL_INDEX.
 	int32_t islandPrev;
@@ -91,6 +87,23 @@ typedef struct b2Contact
 	bool isMarked;
 } b2Contact;
 
+// Storage for the manifold of a touching contact. Most contacts in the broad-phase only have
+// overlapping AABBs, so the manifold is kept out of b2Contact and allocated when the shapes
+// start touching.
+typedef struct b2ContactManifold
+{
+	b2Object object;
+	b2Manifold manifold;
+} b2ContactManifold;
+
+// A manifold computed by the narrow-phase for a contact that started touching. These are
+// moved into the manifold pool serially after the narrow-phase.
+typedef struct b2PendingManifold
+{
+	int32_t contactIndex;
+	b2Manifold manifold;
+} b2PendingManifold;
+
 void b2InitializeContactRegisters(void);
 
 void b2CreateContact(b2World* world, b2Shape* shapeA, b2Shape* shapeB);
@@ -98,4 +111,18 @@ void b2DestroyContact(b2World* world, b2Contact* contact);
 
 bool b2ShouldShapesCollide(b2Filter filterA, b2Filter filterB);
 
-void b2UpdateContact(b2World* world, b2Contact* contact, b2Shape* shapeA, b2Body* bodyA, b2Shape* shapeB, b2Body* bodyB);
+// Is there collision support for these shape types? For example, there is no segment versus segment collision.
+bool b2ShouldShapeTypesCollide(b2ShapeType typeA, b2ShapeType typeB);
+
+// The manifold holds the previous manifold on input and the new manifold on output
+void b2UpdateContact(b2World* world, b2Contact* contact, b2Manifold* manifold, b2Shape* shapeA, b2BodySim* bodySimA,
+					 b2Shape* shapeB, b2BodySim* bodySimB);
+
+// Get the manifold of a contact. Returns an empty manifold if the contact is not touching.
+const b2Manifold* b2GetContactManifold(const b2World* world, const b2Contact* contact);
+
+// Move the manifold of a contact that started touching into the manifold pool
+void b2AddContactManifold(b2World* world, b2Contact* contact, const b2Manifold* manifold);
+
+// Release the manifold of a contact that stopped touching
+void b2RemoveContactManifold(b2World* world, b2Contact* contact);
@@ -24,6 +24,7 @@ void b2PrepareAndWarmStartOverflowContacts(b2SolverTaskContext* context)
 	b2World* world = context->world;
 	b2Graph* graph = context->graph;
 	b2Contact* contacts = world->contacts;
+	b2ContactManifold* manifolds = world->manifolds;
 	const int32_t* bodyMap = context->bodyToSolverMap;
 	b2SolverBody* solverBodies = context->solverBodies;
 
@@ -47,7 +48,7 @@ void b2PrepareAndWarmStartOverflowContacts(b2SolverTaskContext* context)
 	{
 		b2Contact* contact = contacts + contactIndices[i];
 
-		const b2Manifold* manifold = &contact->manifold;
+		const b2Manifold* manifold = &manifolds[contact->manifoldIndex].manifold;
 		int32_t pointCount = manifold->pointCount;
 
 		B2_ASSERT(0 < pointCount && pointCount <= 2);
@@ -365,6 +366,7 @@ void b2StoreOverflowImpulses(b2SolverTaskContext* context)
 {
 	b2TracyCZoneNC(store_impulses, "Store", b2_colorFirebrick, true);
 
+	b2ContactManifold* manifolds = context->world->manifolds;
 	b2ContactConstraint* constraints = context->graph->overflow.contactConstraints;
 	int32_t count = b2Array(context->graph->overflow.contactArray).count;
 
@@ -372,7 +374,7 @@ void b2StoreOverflowImpulses(b2SolverTaskContext* context)
 	{
 		b2ContactConstraint* constraint = constraints + i;
 		b2Contact* contact = constraint->contact;
-		b2Manifold* manifold = &contact->manifold;
+		b2Manifold* manifold = &manifolds[contact->manifoldIndex].manifold;
 		int32_t pointCount = manifold->pointCount;
 
 		for (int32_t j = 0; j < pointCount; ++j)
@@ -504,6 +506,7 @@ void b2PrepareContactsSIMD(int32_t startIndex, int32_t endIndex, b2SolverTaskCon
 
 	b2World* world = context->world;
 	b2Contact* contacts = world->contacts;
+	b2ContactManifold* manifolds = world->manifolds;
 	const int32_t* bodyMap = context->bodyToSolverMap;
 	b2SolverBody* solverBodies = context->solverBodies;
 	b2ContactConstraintSIMD* constraints = context->contactConstraints;
@@ -533,7 +536,7 @@ void b2PrepareContactsSIMD(int32_t startIndex, int32_t endIndex, b2SolverTaskCon
 			{
 				b2Contact* contact = contacts + contactIndex;
 
-				const b2Manifold* manifold = &contact->manifold;
+				const b2Manifold* manifold = &manifolds[contact->manifoldIndex].manifold;
 				int32_t indexA = bodyMap[contact->edges[0].bodyIndex];
 				int32_t indexB = bodyMap[contact->edges[1].bodyIndex];
 
@@ -1016,6 +1019,7 @@ void b2StoreImpulsesSIMD(int32_t startIndex, int32_t endIndex, b2SolverTaskConte
 	b2TracyCZoneNC(store_impulses, "Store", b2_colorFirebrick, true);
 
 	b2Contact* contacts = context->world->contacts;
+	b2ContactManifold* manifolds = context->world->manifolds;
 	const b2ContactConstraintSIMD* constraints = context->contactConstraints;
 	const int32_t* indices = context->contactIndices;
 
@@ -1039,14 +1043,14 @@ void b2StoreImpulsesSIMD(int32_t startIndex, int32_t endIndex, b2SolverTaskConte
 		int32_t index6 = base[6];
 		int32_t index7 = base[7];
 
-		b2Manifold* m0 = index0 == B2_NULL_INDEX ? &dummy : &contacts[index0].manifold;
-		b2Manifold* m1 = index1 == B2_NULL_INDEX ? &dummy : &contacts[index1].manifold;
-		b2Manifold* m2 = index2 == B2_NULL_INDEX ? &dummy : &contacts[index2].manifold;
-		b2Manifold* m3 = index3 == B2_NULL_INDEX ? &dummy : &contacts[index3].manifold;
-		b2Manifold* m4 = index4 == B2_NULL_INDEX ? &dummy : &contacts[index4].manifold;
-		b2Manifold* m5 = index5 == B2_NULL_INDEX ? &dummy : &contacts[index5].manifold;
-		b2Manifold* m6 = index6 == B2_NULL_INDEX ? &dummy : &contacts[index6].manifold;
-		b2Manifold* m7 = index7 == B2_NULL_INDEX ? &dummy : &contacts[index7].manifold;
+		b2Manifold* m0 = index0 == B2_NULL_INDEX ? &dummy : &manifolds[contacts[index0].manifoldIndex].manifold;
+		b2Manifold* m1 = index1 == B2_NULL_INDEX ? &dummy : &manifolds[contacts[index1].manifoldIndex].manifold;
+		b2Manifold* m2 = index2 == B2_NULL_INDEX ? &dummy : &manifolds[contacts[index2].manifoldIndex].manifold;
+		b2Manifold* m3 = index3 == B2_NULL_INDEX ? &dummy : &manifolds[contacts[index3].manifoldIndex].manifold;
+		b2Manifold* m4 = index4 == B2_NULL_INDEX ? &dummy : &manifolds[contacts[index4].manifoldIndex].manifold;
+		b2Manifold* m5 = index5 == B2_NULL_INDEX ? &dummy : &manifolds[contacts[index5].manifoldIndex].manifold;
+		b2Manifold* m6 = index6 == B2_NULL_INDEX ? &dummy : &manifolds[contacts[index6].manifoldIndex].manifold;
+		b2Manifold* m7 = index7 == B2_NULL_INDEX ? &dummy : &manifolds[contacts[index7].manifoldIndex].manifold;
 
 		m0->points[0].normalImpulse = normalImpulse1[0];
 		m0->points[0].tangentImpulse = tangentImpulse1[0];
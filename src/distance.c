@@ -2,14 +2,17 @@
 // SPDX-FileCopyrightText: 2023 Erin Catto
 // SPDX-License-Identifier: MIT
 
-#include "box2d/distance.h"
+#include "distance.h"
 
+#include "bitset.inl"
 #include "core.h"
 
 #include "box2d/constants.h"
 #include "box2d/math.h"
 #include "box2d/timer.h"
 
+#include "x86/sse.h"
+
 #include <float.h>
 
 #define B2_RESTRICT
@@ -128,7 +131,8 @@ static b2Vec2 b2Weight3(float a1, b2Vec2 w1, float a2, b2Vec2 w2, float a3, b2Ve
 	return (b2Vec2){a1 * w1.x + a2 * w2.x + a3 * w3.x, a1 * w1.y + a2 * w2.y + a3 * w3.y};
 }
 
-static int32_t b2FindSupport(const b2DistanceProxy* proxy, b2Vec2 direction)
+// Reference support function. Linear scan with scalar dot products.
+int32_t b2FindSupportScalar(const b2DistanceProxy* proxy, b2Vec2 direction)
 {
 	int32_t bestIndex = 0;
 	float bestValue = b2Dot(proxy->vertices[0], direction);
@@ -145,6 +149,78 @@ static int32_t b2FindSupport(const b2DistanceProxy* proxy, b2Vec2 direction)
 	return bestIndex;
 }
 
+// Support function that computes four dot products at a time. The vertices are stored as
+// interleaved x,y pairs so each block of four vertices is two loads and two shuffles.
+// Ties resolve to the lowest index, matching b2FindSupportScalar exactly.
+int32_t b2FindSupportSIMD(const b2DistanceProxy* proxy, b2Vec2 direction)
+{
+	const float* data = (const float*)proxy->vertices;
+	int32_t count = proxy->count;
+	int32_t blockCount = count >> 2;
+
+	// Proxies come from shapes, so the full blocks fit in the dot product array below
+	B2_ASSERT(count <= b2_maxPolygonVertices);
+
+	simde__m128 dx = simde_mm_set1_ps(direction.x);
+	simde__m128 dy = simde_mm_set1_ps(direction.y);
+
+	simde__m128 dots[(b2_maxPolygonVertices + 3) / 4];
+	simde__m128 m = simde_mm_set1_ps(-FLT_MAX);
+
+	for (int32_t block = 0; block < blockCount; ++block)
+	{
+		// (x0, y0, x1, y1) and (x2, y2, x3, y3)
+		simde__m128 a = simde_mm_loadu_ps(data + 8 * block);
+		simde__m128 b = simde_mm_loadu_ps(data + 8 * block + 4);
+
+		// (x0, x1, x2, x3) and (y0, y1, y2, y3)
+		simde__m128 xs = simde_mm_shuffle_ps(a, b, SIMDE_MM_SHUFFLE(2, 0, 2, 0));
+		simde__m128 ys = simde_mm_shuffle_ps(a, b, SIMDE_MM_SHUFFLE(3, 1, 3, 1));
+
+		// Same operation order as b2Dot so the values are bitwise identical
+		dots[block] = simde_mm_add_ps(simde_mm_mul_ps(xs, dx), simde_mm_mul_ps(ys, dy));
+		m = simde_mm_max_ps(m, dots[block]);
+	}
+
+	// Broadcast the maximum to all lanes
+	m = simde_mm_max_ps(m, simde_mm_shuffle_ps(m, m, SIMDE_MM_SHUFFLE(2, 3, 0, 1)));
+	m = simde_mm_max_ps(m, simde_mm_shuffle_ps(m, m, SIMDE_MM_SHUFFLE(1, 0, 3, 2)));
+
+	// Gather the lanes that hold the maximum, one bit per vertex. The lowest set bit is the first maximum.
+	_Static_assert(b2_maxPolygonVertices <= 32, "support mask too small");
+	uint32_t mask = 0;
+	for (int32_t block = 0; block < blockCount; ++block)
+	{
+		mask |= (uint32_t)simde_mm_movemask_ps(simde_mm_cmpeq_ps(dots[block], m)) << (4 * block);
+	}
+
+	int32_t bestIndex = mask != 0 ? (int32_t)b2CTZ(mask) : 0;
+	float bestValue = simde_mm_cvtss_f32(m);
+
+	for (int32_t i = 4 * blockCount; i < count; ++i)
+	{
+		float value = b2Dot(proxy->vertices[i], direction);
+		if (value > bestValue)
+		{
+			bestIndex = i;
+			bestValue = value;
+		}
+	}
+
+	return bestIndex;
+}
+
+// Small proxies are not worth the shuffles
+static inline int32_t b2FindSupport(const b2DistanceProxy* proxy, b2Vec2 direction)
+{
+	if (proxy->count < 4)
+	{
+		return b2FindSupportScalar(proxy, direction);
+	}
+
+	return b2FindSupportSIMD(proxy, direction);
+}
+
 typedef struct b2SimplexVertex
 {
 	b2Vec2 wA;		// support point in proxyA
@@ -497,7 +573,10 @@ int32_t b2_gjkIters;
 int32_t b2_gjkMaxIters;
 #endif
 
-b2DistanceOutput b2ShapeDistance(b2DistanceCache* B2_RESTRICT cache, const b2DistanceInput* B2_RESTRICT input)
+// The support search is a compile time choice after inlining. The scalar version is kept as a
+// reference for testing and benchmarking.
+static inline b2DistanceOutput b2ShapeDistanceInternal(b2DistanceCache* B2_RESTRICT cache,
+													   const b2DistanceInput* B2_RESTRICT input, bool scalarSupport)
 {
 #if B2_GJK_DEBUG
 	++b2_gjkCalls;
@@ -575,9 +654,20 @@ b2DistanceOutput b2ShapeDistance(b2DistanceCache* B2_RESTRICT cache, const b2Dis
 
 		// Compute a tentative new simplex vertex using support points.
 		b2SimplexVertex* vertex = vertices[simplex.count];
-		vertex->indexA = b2FindSupport(proxyA, b2InvRotateVector(transformA.q, b2Neg(d)));
+		b2Vec2 dA = b2InvRotateVector(transformA.q, b2Neg(d));
+		b2Vec2 dB = b2InvRotateVector(transformB.q, d);
+		if (scalarSupport)
+		{
+			vertex->indexA = b2FindSupportScalar(proxyA, dA);
+			vertex->indexB = b2FindSupportScalar(proxyB, dB);
+		}
+		else
+		{
+			vertex->indexA = b2FindSupport(proxyA, dA);
+			vertex->indexB = b2FindSupport(proxyB, dB);
+		}
+
 		vertex->wA = b2TransformPoint(transformA, proxyA->vertices[vertex->indexA]);
-		vertex->indexB = b2FindSupport(proxyB, b2InvRotateVector(transformB.q, d));
 		vertex->wB = b2TransformPoint(transformB, proxyB->vertices[vertex->indexB]);
 		vertex->w = b2Sub(vertex->wB, vertex->wA);
 
@@ -650,6 +740,17 @@ b2DistanceOutput b2ShapeDistance(b2DistanceCache* B2_RESTRICT cache, const b2Dis
 	return output;
 }
 
+b2DistanceOutput b2ShapeDistance(b2DistanceCache* B2_RESTRICT cache, const b2DistanceInput* B2_RESTRICT input)
+{
+	return b2ShapeDistanceInternal(cache, input, false);
+}
+
+// b2ShapeDistance using b2FindSupportScalar
+b2DistanceOutput b2ShapeDistanceScalar(b2DistanceCache* B2_RESTRICT cache, const b2DistanceInput* B2_RESTRICT input)
+{
+	return b2ShapeDistanceInternal(cache, input, true);
+}
+
 // GJK-raycast
 // Algorithm by Gino van den Bergen.
 // "Smooth Mesh Contacts with GJK" in Game Physics Pearls. 2010
@@ -0,0 +1,13 @@
+// SPDX-FileCopyrightText: 2023 Erin Catto
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "box2d/distance.h"
+
+// Support functions. The SIMD version matches the scalar version exactly, including ties.
+int32_t b2FindSupportScalar(const b2DistanceProxy* proxy, b2Vec2 direction);
+int32_t b2FindSupportSIMD(const b2DistanceProxy* proxy, b2Vec2 direction);
+
+// b2ShapeDistance using b2FindSupportScalar. Kept as a reference for testing and benchmarking.
+b2DistanceOutput b2ShapeDistanceScalar(b2DistanceCache* cache, const b2DistanceInput* input);
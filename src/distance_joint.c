@@ -36,26 +36,26 @@ void b2PrepareDistanceJoint(b2Joint* base, b2StepContext* context)
 
 	int32_t indexA = base->edges[0].bodyIndex;
 	int32_t indexB = base->edges[1].bodyIndex;
-	b2Body* bodyA = context->bodies + indexA;
-	b2Body* bodyB = context->bodies + indexB;
+	b2BodySim* bodySimA = context->bodySims + indexA;
+	b2BodySim* bodySimB = context->bodySims + indexB;
 
-	B2_ASSERT(b2ObjectValid(&bodyA->object));
-	B2_ASSERT(b2ObjectValid(&bodyB->object));
+	B2_ASSERT(b2ObjectValid(&context->bodies[indexA].object));
+	B2_ASSERT(b2ObjectValid(&context->bodies[indexB].object));
 
 	b2DistanceJoint* joint = &base->distanceJoint;
 
 	joint->indexA = context->bodyToSolverMap[indexA];
 	joint->indexB = context->bodyToSolverMap[indexB];
 
-	float mA = bodyA->invMass;
-	float iA = bodyA->invI;
-	float mB = bodyB->invMass;
-	float iB = bodyB->invI;
+	float mA = bodySimA->invMass;
+	float iA = bodySimA->invI;
+	float mB = bodySimB->invMass;
+	float iB = bodySimB->invI;
 
 	// Compute the effective masses.
-	joint->rA = b2RotateVector(bodyA->transform.q, b2Sub(base->localAnchorA, bodyA->localCenter));
-	joint->rB = b2RotateVector(bodyB->transform.q, b2Sub(base->localAnchorB, bodyB->localCenter));
-	joint->separation = b2Add(b2Sub(joint->rB, joint->rA), b2Sub(bodyB->position, bodyA->position));
+	joint->rA = b2RotateVector(bodySimA->transform.q, b2Sub(base->localAnchorA, bodySimA->localCenter));
+	joint->rB = b2RotateVector(bodySimB->transform.q, b2Sub(base->localAnchorB, bodySimB->localCenter));
+	joint->separation = b2Add(b2Sub(joint->rB, joint->rA), b2Sub(bodySimB->position, bodySimA->position));
 
 	b2Vec2 rA = joint->rA;
 	b2Vec2 rB = joint->rB;
@@ -346,14 +346,14 @@ float b2DistanceJoint_GetCurrentLength(b2JointId jointId)
 
 	int32_t indexA = base->edges[0].bodyIndex;
 	int32_t indexB = base->edges[1].bodyIndex;
-	b2Body* bodyA = world->bodies + indexA;
-	b2Body* bodyB = world->bodies + indexB;
 
-	B2_ASSERT(b2ObjectValid(&bodyA->object));
-	B2_ASSERT(b2ObjectValid(&bodyB->object));
+	B2_ASSERT(b2ObjectValid(&world->bodies[indexA].object));
+	B2_ASSERT(b2ObjectValid(&world->bodies[indexB].object));
 
-	b2Vec2 pA = b2TransformPoint(bodyA->transform, base->localAnchorA);
-	b2Vec2 pB = b2TransformPoint(bodyB->transform, base->localAnchorB);
+	b2BodySim* bodySimA = world->bodySimArray + indexA;
+	b2BodySim* bodySimB = world->bodySimArray + indexB;
+	b2Vec2 pA = b2TransformPoint(bodySimA->transform, base->localAnchorA);
+	b2Vec2 pB = b2TransformPoint(bodySimB->transform, base->localAnchorB);
 	b2Vec2 d = b2Sub(pB, pA);
 	float length = b2Length(d);
 	return length;
@@ -388,14 +388,14 @@ void b2DistanceJoint::Dump()
 }
 #endif
 
-void b2DrawDistance(b2DebugDraw* draw, b2Joint* base, b2Body* bodyA, b2Body* bodyB)
+void b2DrawDistance(b2DebugDraw* draw, b2Joint* base, b2BodySim* bodySimA, b2BodySim* bodySimB)
 {
 	B2_ASSERT(base->type == b2_distanceJoint);
 
 	b2DistanceJoint* joint = &base->distanceJoint;
 
-	b2Transform xfA = bodyA->transform;
-	b2Transform xfB = bodyB->transform;
+	b2Transform xfA = bodySimA->transform;
+	b2Transform xfB = bodySimB->transform;
 	b2Vec2 pA = b2TransformPoint(xfA, base->localAnchorA);
 	b2Vec2 pB = b2TransformPoint(xfB, base->localAnchorB);
 
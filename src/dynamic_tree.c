@@ -4,6 +4,7 @@
 #include "box2d/dynamic_tree.h"
 
 #include "allocate.h"
+#include "broad_phase.h"
 #include "array.h"
 #include "core.h"
 
@@ -28,15 +29,21 @@ static inline bool b2IsLeaf(const b2TreeNode* node)
 }
 
 b2DynamicTree b2DynamicTree_Create(void)
+{
+	return b2CreateDynamicTree(NULL);
+}
+
+b2DynamicTree b2CreateDynamicTree(b2Allocator* allocator)
 {
 	_Static_assert((sizeof(b2TreeNode) & 0xF) == 0, "tree node size not a multiple of 16");
 
 	b2DynamicTree tree;
+	tree.allocator = allocator;
 	tree.root = B2_NULL_INDEX;
 
 	tree.nodeCapacity = 16;
 	tree.nodeCount = 0;
-	tree.nodes = (b2TreeNode*)b2Alloc(tree.nodeCapacity * sizeof(b2TreeNode));
+	tree.nodes = (b2TreeNode*)b2Alloc(allocator, tree.nodeCapacity * sizeof(b2TreeNode));
 	memset(tree.nodes, 0, tree.nodeCapacity * sizeof(b2TreeNode));
 
 	// Build a linked list for the free list.
@@ -62,11 +69,11 @@ b2DynamicTree b2DynamicTree_Create(void)
 
 void b2DynamicTree_Destroy(b2DynamicTree* tree)
 {
-	b2Free(tree->nodes, tree->nodeCapacity * sizeof(b2TreeNode));
-	b2Free(tree->leafIndices, tree->rebuildCapacity * sizeof(int32_t));
-	b2Free(tree->leafBoxes, tree->rebuildCapacity * sizeof(b2AABB));
-	b2Free(tree->leafCenters, tree->rebuildCapacity * sizeof(b2Vec2));
-	b2Free(tree->binIndices, tree->rebuildCapacity * sizeof(int32_t));
+	b2Free(tree->allocator, tree->nodes, tree->nodeCapacity * sizeof(b2TreeNode));
+	b2Free(tree->allocator, tree->leafIndices, tree->rebuildCapacity * sizeof(int32_t));
+	b2Free(tree->allocator, tree->leafBoxes, tree->rebuildCapacity * sizeof(b2AABB));
+	b2Free(tree->allocator, tree->leafCenters, tree->rebuildCapacity * sizeof(b2Vec2));
+	b2Free(tree->allocator, tree->binIndices, tree->rebuildCapacity * sizeof(int32_t));
 
 	memset(tree, 0, sizeof(b2DynamicTree));
 }
@@ -75,9 +82,9 @@ void b2DynamicTree_Clone(b2DynamicTree* outTree, const b2DynamicTree* inTree)
 {
 	if (outTree->nodeCapacity < inTree->nodeCapacity)
 	{
-		b2Free(outTree->nodes, outTree->nodeCapacity * sizeof(b2TreeNode));
+		b2Free(outTree->allocator, outTree->nodes, outTree->nodeCapacity * sizeof(b2TreeNode));
 		outTree->nodeCapacity = inTree->nodeCapacity;
-		outTree->nodes = (b2TreeNode*)b2Alloc(outTree->nodeCapacity * sizeof(b2TreeNode));
+		outTree->nodes = (b2TreeNode*)b2Alloc(outTree->allocator, outTree->nodeCapacity * sizeof(b2TreeNode));
 	}
 
 	memcpy(outTree->nodes, inTree->nodes, inTree->nodeCapacity * sizeof(b2TreeNode));
@@ -116,9 +123,9 @@ static int32_t b2AllocateNode(b2DynamicTree* tree)
 		b2TreeNode* oldNodes = tree->nodes;
 		int32_t oldCapcity = tree->nodeCapacity;
 		tree->nodeCapacity += oldCapcity >> 1;
-		tree->nodes = (b2TreeNode*)b2Alloc(tree->nodeCapacity * sizeof(b2TreeNode));
+		tree->nodes = (b2TreeNode*)b2Alloc(tree->allocator, tree->nodeCapacity * sizeof(b2TreeNode));
 		memcpy(tree->nodes, oldNodes, tree->nodeCount * sizeof(b2TreeNode));
-		b2Free(oldNodes, oldCapcity * sizeof(b2TreeNode));
+		b2Free(tree->allocator, oldNodes, oldCapcity * sizeof(b2TreeNode));
 
 		// Build a linked list for the free list. The parent
 		// pointer becomes the "next" pointer.
@@ -152,6 +159,101 @@ static void b2FreeNode(b2DynamicTree* tree, int32_t nodeId)
 	--tree->nodeCount;
 }
 
+// Link the free nodes in index order so the lowest nodes are allocated first
+static void b2SortFreeNodes(b2DynamicTree* tree)
+{
+	tree->freeList = B2_NULL_INDEX;
+	for (int32_t i = tree->nodeCapacity - 1; i >= 0; --i)
+	{
+		if (tree->nodes[i].height == -1)
+		{
+			tree->nodes[i].next = tree->freeList;
+			tree->freeList = i;
+		}
+	}
+}
+
+void b2ShrinkDynamicTree(b2DynamicTree* tree)
+{
+	b2TreeNode* nodes = tree->nodes;
+	b2SortFreeNodes(tree);
+
+	// Proxies must keep their ids, but internal nodes can move down into free nodes
+	for (int32_t nodeId = tree->nodeCapacity - 1; nodeId >= 0; --nodeId)
+	{
+		if (tree->freeList == B2_NULL_INDEX || tree->freeList >= nodeId)
+		{
+			break;
+		}
+
+		b2TreeNode* node = nodes + nodeId;
+		if (node->height <= 0)
+		{
+			continue;
+		}
+
+		int32_t newId = tree->freeList;
+		tree->freeList = nodes[newId].next;
+		nodes[newId] = *node;
+
+		int32_t parent = node->parent;
+		if (parent == B2_NULL_INDEX)
+		{
+			B2_ASSERT(tree->root == nodeId);
+			tree->root = newId;
+		}
+		else if (nodes[parent].child1 == nodeId)
+		{
+			nodes[parent].child1 = newId;
+		}
+		else
+		{
+			B2_ASSERT(nodes[parent].child2 == nodeId);
+			nodes[parent].child2 = newId;
+		}
+
+		nodes[node->child1].parent = newId;
+		nodes[node->child2].parent = newId;
+
+		// Released below or linked again when the free list is rebuilt
+		node->height = -1;
+	}
+
+	int32_t oldCapacity = tree->nodeCapacity;
+	int32_t needed = oldCapacity;
+	while (needed > 0 && nodes[needed - 1].height == -1)
+	{
+		needed -= 1;
+	}
+
+	int32_t newCapacity = b2GetShrinkCapacity(oldCapacity, needed, 16);
+	if (newCapacity < oldCapacity)
+	{
+		tree->nodes = (b2TreeNode*)b2Alloc(tree->allocator, newCapacity * sizeof(b2TreeNode));
+		memcpy(tree->nodes, nodes, newCapacity * sizeof(b2TreeNode));
+		b2Free(tree->allocator, nodes, oldCapacity * sizeof(b2TreeNode));
+		tree->nodeCapacity = newCapacity;
+	}
+
+	b2SortFreeNodes(tree);
+
+	// The rebuild buffers are allocated again on demand
+	if (tree->rebuildCapacity > 2 * tree->proxyCount)
+	{
+		b2Free(tree->allocator, tree->leafIndices, tree->rebuildCapacity * sizeof(int32_t));
+		b2Free(tree->allocator, tree->leafBoxes, tree->rebuildCapacity * sizeof(b2AABB));
+		b2Free(tree->allocator, tree->leafCenters, tree->rebuildCapacity * sizeof(b2Vec2));
+		b2Free(tree->allocator, tree->binIndices, tree->rebuildCapacity * sizeof(int32_t));
+		tree->leafIndices = NULL;
+		tree->leafBoxes = NULL;
+		tree->leafCenters = NULL;
+		tree->binIndices = NULL;
+		tree->rebuildCapacity = 0;
+	}
+
+	b2DynamicTree_Validate(tree);
+}
+
 // Greedy algorithm for sibling selection using the SAH
 // We have three nodes A-(B,C) and want to add a leaf D, there are three choices.
 // 1: make a new parent for A and D : E-(A-(B,C), D)
@@ -1052,7 +1154,8 @@ int32_t b2DynamicTree_GetMaxBalance(const b2DynamicTree* tree)
 
 void b2DynamicTree_RebuildBottomUp(b2DynamicTree* tree)
 {
-	int32_t* nodes = (int32_t*)b2Alloc(tree->nodeCount * sizeof(int32_t));
+	int32_t nodeCount = tree->nodeCount;
+	int32_t* nodes = (int32_t*)b2Alloc(tree->allocator, nodeCount * sizeof(int32_t));
 	int32_t count = 0;
 
 	// Build array of leaves. Free the rest.
@@ -1121,7 +1224,7 @@ void b2DynamicTree_RebuildBottomUp(b2DynamicTree* tree)
 	}
 
 	tree->root = nodes[0];
-	b2Free(nodes, tree->nodeCount * sizeof(b2TreeNode));
+	b2Free(tree->allocator, nodes, nodeCount * sizeof(int32_t));
 
 	b2DynamicTree_Validate(tree);
 }
@@ -1883,17 +1986,17 @@ int32_t b2DynamicTree_Rebuild(b2DynamicTree* tree, bool fullBuild)
 	{
 		int32_t newCapacity = proxyCount + proxyCount / 2;
 
-		b2Free(tree->leafIndices, tree->rebuildCapacity * sizeof(int32_t));
-		tree->leafIndices = b2Alloc(newCapacity * sizeof(int32_t));
+		b2Free(tree->allocator, tree->leafIndices, tree->rebuildCapacity * sizeof(int32_t));
+		tree->leafIndices = b2Alloc(tree->allocator, newCapacity * sizeof(int32_t));
 
 #if B2_TREE_HEURISTIC == 0
-		b2Free(tree->leafCenters, tree->rebuildCapacity * sizeof(b2Vec2));
-		tree->leafCenters = b2Alloc(newCapacity * sizeof(b2Vec2));
+		b2Free(tree->allocator, tree->leafCenters, tree->rebuildCapacity * sizeof(b2Vec2));
+		tree->leafCenters = b2Alloc(tree->allocator, newCapacity * sizeof(b2Vec2));
 #else
-		b2Free(tree->leafBoxes, tree->rebuildCapacity * sizeof(b2AABB));
-		tree->leafBoxes = b2Alloc(newCapacity * sizeof(b2AABB));
-		b2Free(tree->binIndices, tree->rebuildCapacity * sizeof(int32_t));
-		tree->binIndices = b2Alloc(newCapacity * sizeof(int32_t));
+		b2Free(tree->allocator, tree->leafBoxes, tree->rebuildCapacity * sizeof(b2AABB));
+		tree->leafBoxes = b2Alloc(tree->allocator, newCapacity * sizeof(b2AABB));
+		b2Free(tree->allocator, tree->binIndices, tree->rebuildCapacity * sizeof(int32_t));
+		tree->binIndices = b2Alloc(tree->allocator, newCapacity * sizeof(int32_t));
 #endif
 		tree->rebuildCapacity = newCapacity;
 	}
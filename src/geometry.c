@@ -5,6 +5,7 @@
 
 #include "aabb.h"
 #include "core.h"
+#include "heightfield.h"
 #include "shape.h"
 
 #include "box2d/distance.h"
@@ -180,6 +181,31 @@ b2Polygon b2TransformPolygon(b2Transform transform, const b2Polygon* polygon)
 	return p;
 }
 
+b2Heightfield b2MakeHeightfield(const float* heights, int32_t count, float cellWidth)
+{
+	B2_ASSERT(heights != NULL && count >= 2);
+	B2_ASSERT(b2IsValid(cellWidth) && cellWidth > 0.0f);
+
+	b2Heightfield heightfield;
+	heightfield.heights = heights;
+	heightfield.count = count;
+	heightfield.cellWidth = cellWidth;
+	heightfield.minHeight = heights[0];
+	heightfield.maxHeight = heights[0];
+
+	for (int32_t i = 1; i < count; ++i)
+	{
+		B2_ASSERT(b2IsValid(heights[i]));
+		heightfield.minHeight = B2_MIN(heightfield.minHeight, heights[i]);
+		heightfield.maxHeight = B2_MAX(heightfield.maxHeight, heights[i]);
+	}
+
+	// Give flat terrain some depth so that shapes just below the surface are inside the solid
+	heightfield.minHeight -= cellWidth * (count - 1);
+
+	return heightfield;
+}
+
 b2MassData b2ComputeCircleMass(const b2Circle* shape, float density)
 {
 	float rr = shape->radius * shape->radius;
@@ -422,6 +448,21 @@ b2AABB b2ComputeSegmentAABB(const b2Segment* shape, b2Transform xf)
 	return aabb;
 }
 
+b2AABB b2ComputeHeightfieldAABB(const b2Heightfield* shape, b2Transform xf)
+{
+	float width = shape->cellWidth * (shape->count - 1);
+	b2Vec2 v1 = b2TransformPoint(xf, (b2Vec2){0.0f, shape->minHeight});
+	b2Vec2 v2 = b2TransformPoint(xf, (b2Vec2){width, shape->minHeight});
+	b2Vec2 v3 = b2TransformPoint(xf, (b2Vec2){width, shape->maxHeight});
+	b2Vec2 v4 = b2TransformPoint(xf, (b2Vec2){0.0f, shape->maxHeight});
+
+	b2Vec2 lower = b2Min(b2Min(v1, v2), b2Min(v3, v4));
+	b2Vec2 upper = b2Max(b2Max(v1, v2), b2Max(v3, v4));
+
+	b2AABB aabb = {lower, upper};
+	return aabb;
+}
+
 bool b2PointInCircle(b2Vec2 point, const b2Circle* shape)
 {
 	b2Vec2 center = shape->point;
@@ -830,6 +871,46 @@ b2RayCastOutput b2RayCastPolygon(const b2RayCastInput* input, const b2Polygon* s
 	return b2ShapeCast(&castInput);
 }
 
+b2RayCastOutput b2RayCastHeightfield(const b2RayCastInput* input, const b2Heightfield* shape)
+{
+	b2RayCastOutput output = {0};
+
+	b2Vec2 p1 = input->origin;
+	b2Vec2 p2 = b2MulAdd(p1, input->maxFraction, input->translation);
+
+	// Pad the box so rays along a cell boundary test both cells
+	b2Vec2 r = {b2_linearSlop, b2_linearSlop};
+	b2AABB box = {b2Sub(b2Min(p1, p2), r), b2Add(b2Max(p1, p2), r)};
+
+	int32_t first, last;
+	if (b2GetHeightfieldCellRange(shape, box, &first, &last) == false)
+	{
+		return output;
+	}
+
+	// Visit the cells in the direction of the ray. The cell hit first is the closest.
+	int32_t step = 1;
+	if (input->translation.x < 0.0f)
+	{
+		int32_t temp = first;
+		first = last;
+		last = temp;
+		step = -1;
+	}
+
+	for (int32_t cell = first; cell != last + step; cell += step)
+	{
+		b2SmoothSegment smoothSegment = b2GetHeightfieldSegment(shape, cell);
+		output = b2RayCastSegment(input, &smoothSegment.segment, true);
+		if (output.hit)
+		{
+			return output;
+		}
+	}
+
+	return output;
+}
+
 b2RayCastOutput b2ShapeCastCircle(const b2ShapeCastInput* input, const b2Circle* shape)
 {
 	b2ShapeCastPairInput pairInput;
@@ -885,3 +966,40 @@ b2RayCastOutput b2ShapeCastPolygon(const b2ShapeCastInput* input, const b2Polygo
 	b2RayCastOutput output = b2ShapeCast(&pairInput);
 	return output;
 }
+
+b2RayCastOutput b2ShapeCastHeightfield(const b2ShapeCastInput* input, const b2Heightfield* shape)
+{
+	b2RayCastOutput output = {0};
+
+	b2AABB box = {input->points[0], input->points[0]};
+	for (int32_t i = 1; i < input->count; ++i)
+	{
+		box.lowerBound = b2Min(box.lowerBound, input->points[i]);
+		box.upperBound = b2Max(box.upperBound, input->points[i]);
+	}
+
+	b2Vec2 delta = b2MulSV(input->maxFraction, input->translation);
+	box.lowerBound = b2Sub(b2Add(box.lowerBound, b2Min(delta, b2Vec2_zero)), (b2Vec2){input->radius, input->radius});
+	box.upperBound = b2Add(b2Add(box.upperBound, b2Max(delta, b2Vec2_zero)), (b2Vec2){input->radius, input->radius});
+
+	int32_t first, last;
+	if (b2GetHeightfieldCellRange(shape, box, &first, &last) == false)
+	{
+		return output;
+	}
+
+	// The cast shape has extent, so all overlapping cells are tested and the closest hit is kept
+	b2ShapeCastInput cellInput = *input;
+	for (int32_t cell = first; cell <= last; ++cell)
+	{
+		b2SmoothSegment smoothSegment = b2GetHeightfieldSegment(shape, cell);
+		b2RayCastOutput cellOutput = b2ShapeCastSegment(&cellInput, &smoothSegment.segment);
+		if (cellOutput.hit)
+		{
+			output = cellOutput;
+			cellInput.maxFraction = cellOutput.fraction;
+		}
+	}
+
+	return output;
+}
@@ -12,6 +12,7 @@
 #include "contact.h"
 #include "contact_solver.h"
 #include "core.h"
+#include "heightfield.h"
 #include "joint.h"
 #include "shape.h"
 #include "solver_data.h"
@@ -44,7 +45,7 @@ typedef struct b2WorkerContext
 	void* userTask;
 } b2WorkerContext;
 
-void b2CreateGraph(b2Graph* graph, int32_t bodyCapacity, int32_t contactCapacity, int32_t jointCapacity)
+void b2CreateGraph(b2Graph* graph, b2Allocator* allocator, int32_t bodyCapacity, int32_t contactCapacity, int32_t jointCapacity)
 {
 	*graph = (b2Graph){0};
 
@@ -55,16 +56,16 @@ void b2CreateGraph(b2Graph* graph, int32_t bodyCapacity, int32_t contactCapacity
 	for (int32_t i = 0; i < b2_graphColorCount; ++i)
 	{
 		b2GraphColor* color = graph->colors + i;
-		color->bodySet = b2CreateBitSet(bodyCapacity);
+		color->bodySet = b2CreateBitSet(allocator, bodyCapacity);
 		b2SetBitCountAndClear(&color->bodySet, bodyCapacity);
 
-		color->contactArray = b2CreateArray(sizeof(int32_t), contactCapacity);
-		color->jointArray = b2CreateArray(sizeof(int32_t), jointCapacity);
+		color->contactArray = b2CreateArray(allocator, sizeof(int32_t), contactCapacity);
+		color->jointArray = b2CreateArray(allocator, sizeof(int32_t), jointCapacity);
 		color->contactConstraints = NULL;
 	}
 
-	graph->overflow.contactArray = b2CreateArray(sizeof(int32_t), contactCapacity);
-	graph->overflow.jointArray = b2CreateArray(sizeof(int32_t), jointCapacity);
+	graph->overflow.contactArray = b2CreateArray(allocator, sizeof(int32_t), contactCapacity);
+	graph->overflow.jointArray = b2CreateArray(allocator, sizeof(int32_t), jointCapacity);
 	graph->overflow.contactConstraints = NULL;
 }
 
@@ -425,31 +426,28 @@ static void b2IntegrateVelocitiesTask(int32_t startIndex, int32_t endIndex, b2So
 	b2TracyCZoneNC(integrate_velocity, "IntVel", b2_colorDeepPink, true);
 
 	b2Vec2 gravity = context->world->gravity;
-	b2Body** bodies = context->awakeBodies;
+	const b2BodySim* bodySims = context->world->bodySimArray;
 	b2SolverBody* solverBodies = context->solverBodies;
-	int32_t* bodyToSolverMap = context->bodyToSolverMap;
+	const int32_t* solverToBodyMap = context->solverToBodyMap;
 
 	float h = context->timeStep;
 
 	// Integrate velocities and apply damping. Initialize the body state.
 	for (int32_t i = startIndex; i < endIndex; ++i)
 	{
-		b2Body* body = bodies[i];
-		//_m_prefetch(bodies[i + 1]);
-
-		// create body map used to prepare constraints
-		B2_ASSERT(body->object.index < context->world->bodyPool.capacity);
-		bodyToSolverMap[body->object.index] = i;
+		int32_t bodyIndex = solverToBodyMap[i];
+		B2_ASSERT(0 <= bodyIndex && bodyIndex < context->world->bodyPool.capacity);
+		const b2BodySim* bodySim = bodySims + bodyIndex;
 
-		float invMass = body->invMass;
-		float invI = body->invI;
+		float invMass = bodySim->invMass;
+		float invI = bodySim->invI;
 
-		b2Vec2 v = body->linearVelocity;
-		float w = body->angularVelocity;
+		b2Vec2 v = bodySim->linearVelocity;
+		float w = bodySim->angularVelocity;
 
 		// Integrate velocities
-		v = b2Add(v, b2MulSV(h * invMass, b2MulAdd(body->force, body->gravityScale * body->mass, gravity)));
-		w = w + h * invI * body->torque;
+		v = b2Add(v, b2MulSV(h * invMass, b2MulAdd(bodySim->force, bodySim->gravityScale * bodySim->mass, gravity)));
+		w = w + h * invI * bodySim->torque;
 
 		// Apply damping.
 		// ODE: dv/dt + c * v = 0
@@ -458,8 +456,8 @@ static void b2IntegrateVelocitiesTask(int32_t startIndex, int32_t endIndex, b2So
 		// v2 = exp(-c * dt) * v1
 		// Pade approximation:
 		// v2 = v1 * 1 / (1 + c * dt)
-		v = b2MulSV(1.0f / (1.0f + h * body->linearDamping), v);
-		w *= 1.0f / (1.0f + h * body->angularDamping);
+		v = b2MulSV(1.0f / (1.0f + h * bodySim->linearDamping), v);
+		w *= 1.0f / (1.0f + h * bodySim->angularDamping);
 
 		b2SolverBody* solverBody = solverBodies + i;
 		solverBody->linearVelocity = v;
@@ -571,6 +569,7 @@ static void b2FinalizeBodiesTask(int32_t startIndex, int32_t endIndex, uint32_t
 	b2World* world = context->world;
 	bool enableSleep = world->enableSleep;
 	b2Body* bodies = world->bodies;
+	b2BodySim* bodySims = world->bodySimArray;
 	const b2SolverBody* solverBodies = context->solverBodies;
 	b2Contact* contacts = world->contacts;
 	const int32_t* solverToBodyMap = context->solverToBodyMap;
@@ -579,6 +578,8 @@ static void b2FinalizeBodiesTask(int32_t startIndex, int32_t endIndex, uint32_t
 
 	b2BitSet* awakeContactBitSet = &world->taskContextArray[threadIndex].awakeContactBitSet;
 	b2BitSet* shapeBitSet = &world->taskContextArray[threadIndex].shapeBitSet;
+	b2BitSet* compoundBitSet = &world->taskContextArray[threadIndex].compoundBitSet;
+	b2BitSet* fastBodyBitSet = &world->taskContextArray[threadIndex].fastBodyBitSet;
 	b2BitSet* awakeIslandBitSet = &world->taskContextArray[threadIndex].awakeIslandBitSet;
 	bool enableContinuous = world->enableContinuous;
 
@@ -596,6 +597,7 @@ static void b2FinalizeBodiesTask(int32_t startIndex, int32_t endIndex, uint32_t
 
 		int32_t bodyIndex = solverToBodyMap[i];
 		b2Body* body = bodies + bodyIndex;
+		b2BodySim* bodySim = bodySims + bodyIndex;
 		B2_ASSERT(b2ObjectValid(&body->object));
 
 		b2Vec2 v = solverBody->linearVelocity;
@@ -622,18 +624,18 @@ static void b2FinalizeBodiesTask(int32_t startIndex, int32_t endIndex, uint32_t
 		v = b2MulSV(ratio, v);
 		w = ratio * w;
 
-		body->linearVelocity = v;
-		body->angularVelocity = w;
+		bodySim->linearVelocity = v;
+		bodySim->angularVelocity = w;
 
-		body->position = b2Add(body->position, solverBody->deltaPosition);
-		body->angle += solverBody->deltaAngle;
+		bodySim->position = b2Add(bodySim->position, solverBody->deltaPosition);
+		bodySim->angle += solverBody->deltaAngle;
 
 		// TODO_ERIN separate loop to compute rotations in SIMD
-		body->transform.q = b2MakeRot(body->angle);
-		body->transform.p = b2Sub(body->position, b2RotateVector(body->transform.q, body->localCenter));
+		bodySim->transform.q = b2MakeRot(bodySim->angle);
+		bodySim->transform.p = b2Sub(bodySim->position, b2RotateVector(bodySim->transform.q, bodySim->localCenter));
 
-		body->force = b2Vec2_zero;
-		body->torque = 0.0f;
+		bodySim->force = b2Vec2_zero;
+		bodySim->torque = 0.0f;
 		body->isFast = false;
 
 		if (enableSleep == false || body->enableSleep == false || w * w > angTolSqr || b2Dot(v, v) > linTolSqr)
@@ -641,25 +643,24 @@ static void b2FinalizeBodiesTask(int32_t startIndex, int32_t endIndex, uint32_t
 			body->sleepTime = 0.0f;
 
 			const float saftetyFactor = 0.5f;
-			if (enableContinuous && (b2Length(v) + B2_ABS(w) * body->maxExtent) * timeStep > saftetyFactor * body->minExtent)
+			if (enableContinuous && (b2Length(v) + B2_ABS(w) * bodySim->maxExtent) * timeStep > saftetyFactor * bodySim->minExtent)
 			{
-				// Store in fast array for the continuous collision stage
-				int fastIndex = atomic_fetch_add(&world->fastBodyCount, 1);
-				world->fastBodies[fastIndex] = bodyIndex;
+				// Bit-set to keep the fast body array sorted for the continuous collision stage
+				b2SetBit(fastBodyBitSet, bodyIndex);
 				body->isFast = true;
 			}
 			else
 			{
 				// Body is safe to advance
-				body->position0 = body->position;
-				body->angle0 = body->angle;
+				bodySim->position0 = bodySim->position;
+				bodySim->angle0 = bodySim->angle;
 			}
 		}
 		else
 		{
 			// Body is safe to advance
-			body->position0 = body->position;
-			body->angle0 = body->angle;
+			bodySim->position0 = bodySim->position;
+			bodySim->angle0 = bodySim->angle;
 			body->sleepTime += timeStep;
 		}
 
@@ -672,6 +673,7 @@ static void b2FinalizeBodiesTask(int32_t startIndex, int32_t endIndex, uint32_t
 
 		// Update shapes AABBs
 		bool isFast = body->isFast;
+		bool isCompound = body->isCompound;
 		int32_t shapeIndex = body->shapeList;
 		while (shapeIndex != B2_NULL_INDEX)
 		{
@@ -685,26 +687,43 @@ static void b2FinalizeBodiesTask(int32_t startIndex, int32_t endIndex, uint32_t
 				// Add to moved shapes regardless of AABB changes.
 				shape->isFast = true;
 
-				// Bit-set to keep the move array sorted
-				b2SetBit(shapeBitSet, shapeIndex);
+				if (isCompound == false)
+				{
+					// Bit-set to keep the move array sorted
+					b2SetBit(shapeBitSet, shapeIndex);
+				}
 			}
 			else
 			{
-				shape->aabb = b2ComputeShapeAABB(shape, body->transform);
+				shape->aabb = b2ComputeShapeAABB(shape, bodySim->transform);
 
 				if (b2AABB_Contains(shape->fatAABB, shape->aabb) == false)
 				{
 					shape->fatAABB.lowerBound = b2Sub(shape->aabb.lowerBound, aabbMargin);
 					shape->fatAABB.upperBound = b2Add(shape->aabb.upperBound, aabbMargin);
 
-					// Bit-set to keep the move array sorted
-					b2SetBit(shapeBitSet, shapeIndex);
+					if (isCompound)
+					{
+						// The shape tree is owned by this body so it is safe to modify here
+						b2DynamicTree_MoveProxy(&body->shapeTree, shape->proxyKey, shape->fatAABB);
+						b2SetBit(compoundBitSet, bodyIndex);
+					}
+					else
+					{
+						// Bit-set to keep the move array sorted
+						b2SetBit(shapeBitSet, shapeIndex);
+					}
 				}
 			}
 
 			shapeIndex = shape->nextShapeIndex;
 		}
 
+		if (isFast && isCompound)
+		{
+			b2SetBit(compoundBitSet, bodyIndex);
+		}
+
 		// Wake contacts
 		int32_t contactKey = body->contactList;
 		while (contactKey != B2_NULL_INDEX)
@@ -849,6 +868,17 @@ static void b2ExecuteStage(b2SolverStage* stage, b2SolverTaskContext* context, i
 
 	B2_ASSERT(0 <= startIndex && startIndex < blockCount);
 
+	// With worker affinity a worker only runs forward through its own blocks. The blocks of the next worker
+	// are left to it so that the same worker touches the same memory every iteration. Other blocks are
+	// still taken by the backwards search below, so a late worker cannot stall the stage.
+	int32_t stopIndex = B2_NULL_INDEX;
+	if (context->enableWorkerAffinity)
+	{
+		int32_t workerCount = context->workerCount;
+		int32_t nextIndex = workerIndex + 1 < workerCount ? GetWorkerStartIndex(workerIndex + 1, blockCount, workerCount) : 0;
+		stopIndex = nextIndex == B2_NULL_INDEX ? 0 : nextIndex;
+	}
+
 	int32_t blockIndex = startIndex;
 
 	// Caution: this can change expectedSyncIndex
@@ -868,6 +898,11 @@ static void b2ExecuteStage(b2SolverStage* stage, b2SolverTaskContext* context, i
 			blockIndex = 0;
 		}
 
+		if (blockIndex == stopIndex)
+		{
+			break;
+		}
+
 		expectedSyncIndex = previousSyncIndex;
 	}
 
@@ -896,7 +931,7 @@ static void b2ExecuteStage(b2SolverStage* stage, b2SolverTaskContext* context, i
 	(void)atomic_fetch_add(&stage->completionCount, completedCount);
 }
 
-static void b2ExecuteMainStage(b2SolverStage* stage, b2SolverTaskContext* context, uint32_t syncBits)
+static void b2ExecuteMainStage(b2SolverStage* stage, b2SolverTaskContext* context, uint32_t syncBits, int32_t ownerIndex)
 {
 	int32_t blockCount = stage->blockCount;
 	if (blockCount == 0)
@@ -916,7 +951,7 @@ static void b2ExecuteMainStage(b2SolverStage* stage, b2SolverTaskContext* contex
 		B2_ASSERT(syncIndex > 0);
 		int previousSyncIndex = syncIndex - 1;
 
-		b2ExecuteStage(stage, context, previousSyncIndex, syncIndex, 0);
+		b2ExecuteStage(stage, context, previousSyncIndex, syncIndex, ownerIndex);
 
 		// todo consider using the cycle counter as well
 		while (atomic_load(&stage->completionCount) != blockCount)
@@ -928,12 +963,12 @@ static void b2ExecuteMainStage(b2SolverStage* stage, b2SolverTaskContext* contex
 	}
 }
 
-// This should not use the thread index because thread 0 can be called twice by enkiTS.
-void b2SolverTask(int32_t startIndex, int32_t endIndex, uint32_t threadIndexDontUse, void* taskContext)
+// The worker index decides which task synchronizes the stages. This should not use the thread index
+// for that because thread 0 can be called twice by enkiTS.
+void b2SolverTask(int32_t startIndex, int32_t endIndex, uint32_t threadIndex, void* taskContext)
 {
 	B2_MAYBE_UNUSED(startIndex);
 	B2_MAYBE_UNUSED(endIndex);
-	B2_MAYBE_UNUSED(threadIndexDontUse);
 
 	b2WorkerContext* workerContext = taskContext;
 	int32_t workerIndex = workerContext->workerIndex;
@@ -941,6 +976,12 @@ void b2SolverTask(int32_t startIndex, int32_t endIndex, uint32_t threadIndexDont
 	int32_t activeColorCount = context->activeColorCount;
 	b2SolverStage* stages = context->stages;
 
+	// The owner index decides where a worker starts in each stage. With worker affinity this is the
+	// thread index of the built-in thread pool. Its threads are pinned and each runs at most one solver
+	// task at a time, so the same core starts on the same blocks every iteration and every step.
+	int32_t ownerIndex = context->enableWorkerAffinity ? (int32_t)threadIndex : workerIndex;
+	B2_ASSERT(0 <= ownerIndex && ownerIndex < context->workerCount);
+
 	if (workerIndex == 0)
 	{
 		// Main thread synchronizes the workers and does work itself.
@@ -967,21 +1008,21 @@ void b2SolverTask(int32_t startIndex, int32_t endIndex, uint32_t threadIndexDont
 		int32_t stageIndex = 0;
 		uint32_t syncBits = (bodySyncIndex << 16) | stageIndex;
 		B2_ASSERT(stages[stageIndex].type == b2_stageIntegrateVelocities);
-		b2ExecuteMainStage(stages + stageIndex, context, syncBits);
+		b2ExecuteMainStage(stages + stageIndex, context, syncBits, ownerIndex);
 		stageIndex += 1;
 		bodySyncIndex += 1;
 
 		uint32_t jointSyncIndex = 1;
 		syncBits = (jointSyncIndex << 16) | stageIndex;
 		B2_ASSERT(stages[stageIndex].type == b2_stagePrepareJoints);
-		b2ExecuteMainStage(stages + stageIndex, context, syncBits);
+		b2ExecuteMainStage(stages + stageIndex, context, syncBits, ownerIndex);
 		stageIndex += 1;
 		// jointSyncIndex += 1;
 
 		uint32_t constraintSyncIndex = 1;
 		syncBits = (constraintSyncIndex << 16) | stageIndex;
 		B2_ASSERT(stages[stageIndex].type == b2_stagePrepareContacts);
-		b2ExecuteMainStage(stages + stageIndex, context, syncBits);
+		b2ExecuteMainStage(stages + stageIndex, context, syncBits, ownerIndex);
 		stageIndex += 1;
 		constraintSyncIndex += 1;
 
@@ -990,7 +1031,7 @@ void b2SolverTask(int32_t startIndex, int32_t endIndex, uint32_t threadIndexDont
 		{
 			syncBits = (graphSyncIndex << 16) | stageIndex;
 			B2_ASSERT(stages[stageIndex].type == b2_stageWarmStart);
-			b2ExecuteMainStage(stages + stageIndex, context, syncBits);
+			b2ExecuteMainStage(stages + stageIndex, context, syncBits, ownerIndex);
 			stageIndex += 1;
 		}
 		graphSyncIndex += 1;
@@ -1008,7 +1049,7 @@ void b2SolverTask(int32_t startIndex, int32_t endIndex, uint32_t threadIndexDont
 			{
 				syncBits = (graphSyncIndex << 16) | iterStageIndex;
 				B2_ASSERT(stages[iterStageIndex].type == b2_stageSolve);
-				b2ExecuteMainStage(stages + iterStageIndex, context, syncBits);
+				b2ExecuteMainStage(stages + iterStageIndex, context, syncBits, ownerIndex);
 				iterStageIndex += 1;
 			}
 			graphSyncIndex += 1;
@@ -1018,7 +1059,7 @@ void b2SolverTask(int32_t startIndex, int32_t endIndex, uint32_t threadIndexDont
 
 			B2_ASSERT(stages[iterStageIndex].type == b2_stageIntegratePositions);
 			syncBits = (bodySyncIndex << 16) | iterStageIndex;
-			b2ExecuteMainStage(stages + iterStageIndex, context, syncBits);
+			b2ExecuteMainStage(stages + iterStageIndex, context, syncBits, ownerIndex);
 			bodySyncIndex += 1;
 		}
 
@@ -1034,7 +1075,7 @@ void b2SolverTask(int32_t startIndex, int32_t endIndex, uint32_t threadIndexDont
 			{
 				syncBits = (graphSyncIndex << 16) | iterStageIndex;
 				B2_ASSERT(stages[iterStageIndex].type == b2_stageRelax);
-				b2ExecuteMainStage(stages + iterStageIndex, context, syncBits);
+				b2ExecuteMainStage(stages + iterStageIndex, context, syncBits, ownerIndex);
 				iterStageIndex += 1;
 			}
 			graphSyncIndex += 1;
@@ -1052,7 +1093,7 @@ void b2SolverTask(int32_t startIndex, int32_t endIndex, uint32_t threadIndexDont
 			{
 				syncBits = (graphSyncIndex << 16) | iterStageIndex;
 				B2_ASSERT(stages[iterStageIndex].type == b2_stageRestitution);
-				b2ExecuteMainStage(stages + iterStageIndex, context, syncBits);
+				b2ExecuteMainStage(stages + iterStageIndex, context, syncBits, ownerIndex);
 				iterStageIndex += 1;
 			}
 			// graphSyncIndex += 1;
@@ -1066,7 +1107,7 @@ void b2SolverTask(int32_t startIndex, int32_t endIndex, uint32_t threadIndexDont
 
 		syncBits = (constraintSyncIndex << 16) | stageIndex;
 		B2_ASSERT(stages[stageIndex].type == b2_stageStoreImpulses);
-		b2ExecuteMainStage(stages + stageIndex, context, syncBits);
+		b2ExecuteMainStage(stages + stageIndex, context, syncBits, ownerIndex);
 
 		// Signal workers to finish
 		atomic_store(&context->syncBits, UINT_MAX);
@@ -1104,7 +1145,7 @@ void b2SolverTask(int32_t startIndex, int32_t endIndex, uint32_t threadIndexDont
 		int32_t previousSyncIndex = syncIndex - 1;
 
 		b2SolverStage* stage = stages + stageIndex;
-		b2ExecuteStage(stage, context, previousSyncIndex, syncIndex, workerIndex);
+		b2ExecuteStage(stage, context, previousSyncIndex, syncIndex, ownerIndex);
 
 		lastSyncBits = syncBits;
 	}
@@ -1146,7 +1187,6 @@ static bool b2SolveGraph(b2World* world, b2StepContext* stepContext)
 
 	// Reserve space for awake bodies
 	b2Body* bodies = world->bodies;
-	b2Body** awakeBodies = b2AllocateStackItem(world->stackAllocator, awakeBodyCount * sizeof(b2Body*), "awake bodies");
 	b2SolverBody* solverBodies =
 		b2AllocateStackItem(world->stackAllocator, awakeBodyCount * sizeof(b2SolverBody), "solver bodies");
 
@@ -1160,23 +1200,13 @@ static bool b2SolveGraph(b2World* world, b2StepContext* stepContext)
 	int32_t* bodyToSolverMap = b2AllocateStackItem(world->stackAllocator, bodyCapacity * sizeof(int32_t), "body map");
 	memset(bodyToSolverMap, 0xFF, bodyCapacity * sizeof(int32_t));
 
-	// Build array of awake bodies and also search for an awake island to split
-	int32_t splitIslandIndex = B2_NULL_INDEX;
-	int32_t maxRemovedContacts = 0;
-	int32_t splitIslandBodyCount = 0;
+	// Build array of awake bodies
 	int32_t index = 0;
 	for (int32_t i = 0; i < awakeIslandCount; ++i)
 	{
 		int32_t islandIndex = world->awakeIslandArray[i];
 		b2Island* island = world->islands + islandIndex;
 
-		if (island->constraintRemoveCount > maxRemovedContacts)
-		{
-			maxRemovedContacts = island->constraintRemoveCount;
-			splitIslandIndex = islandIndex;
-			splitIslandBodyCount = island->bodyCount;
-		}
-
 		int32_t bodyIndex = island->headBody;
 		while (bodyIndex != B2_NULL_INDEX)
 		{
@@ -1184,8 +1214,6 @@ static bool b2SolveGraph(b2World* world, b2StepContext* stepContext)
 			B2_ASSERT(b2ObjectValid(&body->object));
 			B2_ASSERT(body->object.index == bodyIndex);
 
-			awakeBodies[index] = body;
-
 			B2_ASSERT(0 <= bodyIndex && bodyIndex < bodyCapacity);
 			bodyToSolverMap[bodyIndex] = index;
 			solverToBodyMap[index] = bodyIndex;
@@ -1198,6 +1226,23 @@ static bool b2SolveGraph(b2World* world, b2StepContext* stepContext)
 	}
 	B2_ASSERT(index == awakeBodyCount);
 
+	// With spatial sorting the bodies are already in a good order in memory, so visit them in
+	// memory order. This also keeps the body and body sim access linear.
+	if (world->spatialSortInterval > 0)
+	{
+		index = 0;
+		for (int32_t bodyIndex = 0; bodyIndex < bodyCapacity; ++bodyIndex)
+		{
+			if (bodyToSolverMap[bodyIndex] != B2_NULL_INDEX)
+			{
+				bodyToSolverMap[bodyIndex] = index;
+				solverToBodyMap[index] = bodyIndex;
+				index += 1;
+			}
+		}
+		B2_ASSERT(index == awakeBodyCount);
+	}
+
 	// Each worker receives at most M blocks of work. The workers may receive less than there is not sufficient work.
 	// Each block of work has a minimum number of elements (block size). This in turn may limit number of blocks.
 	// If there are many elements then the block size is increased so there are still at most M blocks of work per worker.
@@ -1408,18 +1453,18 @@ static bool b2SolveGraph(b2World* world, b2StepContext* stepContext)
 	b2SolverBlock* graphBlocks =
 		b2AllocateStackItem(world->stackAllocator, graphBlockCount * sizeof(b2SolverBlock), "graph blocks");
 
-	// Split an awake island. This modifies:
-	// - stack allocator
-	// - awake island array
-	// - island pool
+	// Split awake islands. This modifies:
+	// - worker stack allocators
+	// - reserved islands in the island pool
 	// - island indices on bodies, contacts, and joints
 	// I'm squeezing this task in here because it may be expensive and this is a safe place to put it.
+	// Each island is split by a separate task item. The awake island array is updated after the solve.
 	// Note: cannot split islands in parallel with FinalizeBodies
-	world->splitIslandIndex = splitIslandIndex;
+	int32_t splitCount = b2PrepareIslandSplits(world);
 	void* splitIslandTask = NULL;
-	if (splitIslandIndex != B2_NULL_INDEX)
+	if (splitCount > 0)
 	{
-		splitIslandTask = world->enqueueTaskFcn(&b2SplitIslandTask, 1, 1, world, world->userTaskContext);
+		splitIslandTask = world->enqueueTaskFcn(&b2SplitIslandTask, splitCount, 1, world, world->userTaskContext);
 		world->taskCount += 1;
 		world->activeTaskCount += splitIslandTask == NULL ? 0 : 1;
 	}
@@ -1613,7 +1658,6 @@ static bool b2SolveGraph(b2World* world, b2StepContext* stepContext)
 	b2SolverTaskContext context;
 	context.world = world;
 	context.graph = graph;
-	context.awakeBodies = awakeBodies;
 	context.solverBodies = solverBodies;
 	context.bodyToSolverMap = bodyToSolverMap;
 	context.solverToBodyMap = solverToBodyMap;
@@ -1625,6 +1669,7 @@ static bool b2SolveGraph(b2World* world, b2StepContext* stepContext)
 	context.velocityIterations = velIters;
 	context.relaxIterations = stepContext->relaxIterations;
 	context.workerCount = workerCount;
+	context.enableWorkerAffinity = world->enableWorkerAffinity;
 	context.stageCount = stageCount;
 	context.stages = stages;
 	context.timeStep = stepContext->dt;
@@ -1652,7 +1697,7 @@ static bool b2SolveGraph(b2World* world, b2StepContext* stepContext)
 		world->activeTaskCount -= 1;
 	}
 
-	world->splitIslandIndex = B2_NULL_INDEX;
+	b2FinishIslandSplits(world);
 
 	// Finish solve
 	for (int32_t i = 0; i < workerCount; ++i)
@@ -1664,14 +1709,16 @@ static bool b2SolveGraph(b2World* world, b2StepContext* stepContext)
 		}
 	}
 
-	// Prepare contact, shape, and island bit sets used in body finalization.
+	// Prepare contact, shape, compound, and island bit sets used in body finalization.
 	int32_t contactCapacity = world->contactPool.capacity;
 	int32_t shapeCapacity = world->shapePool.capacity;
-	int32_t islandCapacity = world->islandPool.capacity + splitIslandBodyCount;
+	int32_t islandCapacity = world->islandPool.capacity;
 	for (uint32_t i = 0; i < world->workerCount; ++i)
 	{
 		b2SetBitCountAndClear(&world->taskContextArray[i].awakeContactBitSet, contactCapacity);
 		b2SetBitCountAndClear(&world->taskContextArray[i].shapeBitSet, shapeCapacity);
+		b2SetBitCountAndClear(&world->taskContextArray[i].compoundBitSet, bodyCapacity);
+		b2SetBitCountAndClear(&world->taskContextArray[i].fastBodyBitSet, bodyCapacity);
 		b2SetBitCountAndClear(&world->taskContextArray[i].awakeIslandBitSet, islandCapacity);
 	}
 
@@ -1695,7 +1742,6 @@ static bool b2SolveGraph(b2World* world, b2StepContext* stepContext)
 	b2FreeStackItem(world->stackAllocator, bodyToSolverMap);
 	b2FreeStackItem(world->stackAllocator, solverToBodyMap);
 	b2FreeStackItem(world->stackAllocator, solverBodies);
-	b2FreeStackItem(world->stackAllocator, awakeBodies);
 
 	b2TracyCZoneNC(awake_islands, "Awake Islands", b2_colorGainsboro, true);
 
@@ -1867,9 +1913,109 @@ struct b2ContinuousContext
 	b2Shape* fastShape;
 	b2Vec2 centroid1, centroid2;
 	b2Sweep sweep;
+	b2AABB box;
 	float fraction;
 };
 
+// Continuous collision of a fast shape versus one smooth segment of a height field or chain.
+// The centroids are in the local frame of the segment.
+static void b2ContinuousSmoothSegment(struct b2ContinuousContext* continuousContext, const b2SmoothSegment* smoothSegment,
+									  b2Vec2 c1, b2Vec2 c2, b2TOIInput* input)
+{
+	// Prevent pausing on segment junctions, same as smooth segment shapes
+	b2Vec2 p1 = smoothSegment->segment.point1;
+	b2Vec2 e = b2Sub(smoothSegment->segment.point2, p1);
+	float offset1 = b2Cross(b2Sub(c1, p1), e);
+	float offset2 = b2Cross(b2Sub(c2, p1), e);
+	if (offset1 < 0.0f || offset2 > 0.0f)
+	{
+		return;
+	}
+
+	input->proxyA = b2MakeProxy(&smoothSegment->segment.point1, 2, 0.0f);
+	input->tMax = continuousContext->fraction;
+
+	b2TOIOutput output = b2TimeOfImpact(input);
+	if (0.0f < output.t && output.t < continuousContext->fraction)
+	{
+		continuousContext->fraction = output.t;
+	}
+}
+
+// Local frame data for continuous collision against a height field or chain
+struct b2ContinuousMeshContext
+{
+	struct b2ContinuousContext* continuousContext;
+	const b2SmoothChain* chain;
+	b2Vec2 c1, c2;
+	b2TOIInput input;
+	b2AABB localBox;
+};
+
+static struct b2ContinuousMeshContext b2MakeContinuousMeshContext(struct b2ContinuousContext* continuousContext,
+																  const b2Body* body, const b2BodySim* bodySim)
+{
+	b2Transform xf = bodySim->transform;
+
+	// Bound the swept box in the local frame
+	b2AABB box = continuousContext->box;
+	b2Vec2 v1 = b2InvTransformPoint(xf, box.lowerBound);
+	b2Vec2 v2 = b2InvTransformPoint(xf, (b2Vec2){box.upperBound.x, box.lowerBound.y});
+	b2Vec2 v3 = b2InvTransformPoint(xf, box.upperBound);
+	b2Vec2 v4 = b2InvTransformPoint(xf, (b2Vec2){box.lowerBound.x, box.upperBound.y});
+
+	struct b2ContinuousMeshContext meshContext;
+	meshContext.continuousContext = continuousContext;
+	meshContext.chain = NULL;
+	meshContext.c1 = b2InvTransformPoint(xf, continuousContext->centroid1);
+	meshContext.c2 = b2InvTransformPoint(xf, continuousContext->centroid2);
+	meshContext.input.proxyB = b2MakeShapeDistanceProxy(continuousContext->fastShape);
+	meshContext.input.sweepA = b2MakeSweep(body, bodySim);
+	meshContext.input.sweepB = continuousContext->sweep;
+	meshContext.localBox = (b2AABB){b2Min(b2Min(v1, v2), b2Min(v3, v4)), b2Max(b2Max(v1, v2), b2Max(v3, v4))};
+	return meshContext;
+}
+
+static bool b2ContinuousChainCallback(int32_t proxyId, int32_t segmentIndex, void* context)
+{
+	B2_MAYBE_UNUSED(proxyId);
+
+	struct b2ContinuousMeshContext* meshContext = context;
+	b2SmoothSegment smoothSegment = b2GetSmoothChainSegment(meshContext->chain, segmentIndex);
+	b2ContinuousSmoothSegment(meshContext->continuousContext, &smoothSegment, meshContext->c1, meshContext->c2,
+							  &meshContext->input);
+	return true;
+}
+
+// Continuous collision of a fast shape versus the segments of a static height field or chain
+static void b2ContinuousMesh(struct b2ContinuousContext* continuousContext, const b2Shape* shape, const b2Body* body,
+							 const b2BodySim* bodySim)
+{
+	struct b2ContinuousMeshContext meshContext = b2MakeContinuousMeshContext(continuousContext, body, bodySim);
+
+	if (shape->type == b2_smoothChainShape)
+	{
+		meshContext.chain = shape->smoothChain;
+		b2DynamicTree_Query(&shape->smoothChain->tree, meshContext.localBox, b2ContinuousChainCallback, &meshContext);
+		return;
+	}
+
+	B2_ASSERT(shape->type == b2_heightfieldShape);
+	const b2Heightfield* heightfield = shape->heightfield;
+
+	int32_t first, last;
+	if (b2GetHeightfieldCellRange(heightfield, meshContext.localBox, &first, &last) == false)
+	{
+		return;
+	}
+
+	for (int32_t cell = first; cell <= last; ++cell)
+	{
+		b2SmoothSegment smoothSegment = b2GetHeightfieldSegment(heightfield, cell);
+		b2ContinuousSmoothSegment(continuousContext, &smoothSegment, meshContext.c1, meshContext.c2, &meshContext.input);
+	}
+}
+
 static bool b2ContinuousQueryCallback(int32_t proxyId, int32_t shapeIndex, void* context)
 {
 	B2_MAYBE_UNUSED(proxyId);
@@ -1877,6 +2023,15 @@ static bool b2ContinuousQueryCallback(int32_t proxyId, int32_t shapeIndex, void*
 	struct b2ContinuousContext* continuousContext = context;
 	b2Shape* fastShape = continuousContext->fastShape;
 
+	if (B2_IS_COMPOUND_PROXY(shapeIndex))
+	{
+		// Static compound body, descend into its shape tree
+		b2Body* compoundBody = continuousContext->world->bodies + B2_COMPOUND_BODY_INDEX(shapeIndex);
+		B2_ASSERT(compoundBody->isCompound);
+		b2DynamicTree_Query(&compoundBody->shapeTree, continuousContext->box, b2ContinuousQueryCallback, context);
+		return true;
+	}
+
 	// Skip same shape
 	if (shapeIndex == fastShape->object.index)
 	{
@@ -1903,6 +2058,7 @@ static bool b2ContinuousQueryCallback(int32_t proxyId, int32_t shapeIndex, void*
 
 	B2_ASSERT(0 <= shape->bodyIndex && shape->bodyIndex < world->bodyPool.capacity);
 	b2Body* body = world->bodies + shape->bodyIndex;
+	b2BodySim* bodySim = world->bodySimArray + shape->bodyIndex;
 	B2_ASSERT(body->type == b2_staticBody);
 
 	// Skip filtered bodies
@@ -1912,11 +2068,17 @@ static bool b2ContinuousQueryCallback(int32_t proxyId, int32_t shapeIndex, void*
 		return true;
 	}
 
+	if (shape->type == b2_heightfieldShape || shape->type == b2_smoothChainShape)
+	{
+		b2ContinuousMesh(continuousContext, shape, body, bodySim);
+		return true;
+	}
+
 	// Prevent pausing on smooth segment junctions
 	if (shape->type == b2_smoothSegmentShape)
 	{
-		b2Vec2 p1 = shape->smoothSegment.segment.point1;
-		b2Vec2 p2 = shape->smoothSegment.segment.point2;
+		b2Vec2 p1 = shape->smoothSegment->segment.point1;
+		b2Vec2 p2 = shape->smoothSegment->segment.point2;
 		b2Vec2 e = b2Sub(p2, p1);
 		b2Vec2 c1 = continuousContext->centroid1;
 		b2Vec2 c2 = continuousContext->centroid2;
@@ -1933,7 +2095,7 @@ static bool b2ContinuousQueryCallback(int32_t proxyId, int32_t shapeIndex, void*
 	b2TOIInput input;
 	input.proxyA = b2MakeShapeDistanceProxy(shape);
 	input.proxyB = b2MakeShapeDistanceProxy(fastShape);
-	input.sweepA = b2MakeSweep(body);
+	input.sweepA = b2MakeSweep(body, bodySim);
 	input.sweepB = continuousContext->sweep;
 	input.tMax = continuousContext->fraction;
 
@@ -1950,18 +2112,19 @@ static bool b2ContinuousQueryCallback(int32_t proxyId, int32_t shapeIndex, void*
 static void b2SolveContinuous(b2World* world, int32_t bodyIndex)
 {
 	b2Body* fastBody = world->bodies + bodyIndex;
+	b2BodySim* fastBodySim = world->bodySimArray + bodyIndex;
 	B2_ASSERT(b2ObjectValid(&fastBody->object));
 	B2_ASSERT(fastBody->type == b2_dynamicBody && fastBody->isFast);
 
 	b2Shape* shapes = world->shapes;
 
-	b2Sweep sweep = b2MakeSweep(fastBody);
+	b2Sweep sweep = b2MakeSweep(fastBody, fastBodySim);
 
 	b2Transform xf1;
 	xf1.q = b2MakeRot(sweep.a1);
 	xf1.p = b2Sub(sweep.c1, b2RotateVector(xf1.q, sweep.localCenter));
 
-	b2Transform xf2 = fastBody->transform;
+	b2Transform xf2 = fastBodySim->transform;
 
 	b2DynamicTree* staticTree = world->broadPhase.trees + b2_staticBody;
 
@@ -1991,6 +2154,7 @@ static void b2SolveContinuous(b2World* world, int32_t bodyIndex)
 		// Store this for later
 		fastShape->aabb = box2;
 
+		context.box = box;
 		b2DynamicTree_Query(staticTree, box, b2ContinuousQueryCallback, &context);
 
 		shapeIndex = fastShape->nextShapeIndex;
@@ -2004,15 +2168,15 @@ static void b2SolveContinuous(b2World* world, int32_t bodyIndex)
 		float a = sweep.a1 + context.fraction * (sweep.a2 - sweep.a1);
 
 		// Advance body
-		fastBody->angle0 = a;
-		fastBody->angle = a;
-		fastBody->position0 = c;
-		fastBody->position = c;
+		fastBodySim->angle0 = a;
+		fastBodySim->angle = a;
+		fastBodySim->position0 = c;
+		fastBodySim->position = c;
 
 		b2Transform xf;
 		xf.q = b2MakeRot(a);
-		xf.p = b2Sub(c, b2RotateVector(fastBody->transform.q, sweep.localCenter));
-		fastBody->transform = xf;
+		xf.p = b2Sub(c, b2RotateVector(fastBodySim->transform.q, sweep.localCenter));
+		fastBodySim->transform = xf;
 
 		// Prepare AABBs for broad-phase
 		shapeIndex = fastBody->shapeList;
@@ -2028,6 +2192,11 @@ static void b2SolveContinuous(b2World* world, int32_t bodyIndex)
 				shape->fatAABB = b2ExtendAABB(shape->aabb);
 				shape->enlargedAABB = true;
 				fastBody->enlargeAABB = true;
+
+				if (fastBody->isCompound)
+				{
+					b2DynamicTree_MoveProxy(&fastBody->shapeTree, shape->proxyKey, shape->fatAABB);
+				}
 			}
 
 			shapeIndex = shape->nextShapeIndex;
@@ -2038,8 +2207,8 @@ static void b2SolveContinuous(b2World* world, int32_t bodyIndex)
 		// No time of impact event
 
 		// Advance body
-		fastBody->angle0 = fastBody->angle;
-		fastBody->position0 = fastBody->position;
+		fastBodySim->angle0 = fastBodySim->angle;
+		fastBodySim->position0 = fastBodySim->position;
 
 		// Prepare AABBs for broad-phase
 		shapeIndex = fastBody->shapeList;
@@ -2054,6 +2223,11 @@ static void b2SolveContinuous(b2World* world, int32_t bodyIndex)
 				shape->fatAABB = b2ExtendAABB(shape->aabb);
 				shape->enlargedAABB = true;
 				fastBody->enlargeAABB = true;
+
+				if (fastBody->isCompound)
+				{
+					b2DynamicTree_MoveProxy(&fastBody->shapeTree, shape->proxyKey, shape->fatAABB);
+				}
 			}
 
 			shapeIndex = shape->nextShapeIndex;
@@ -2161,6 +2335,79 @@ void b2Solve(b2World* world, b2StepContext* context)
 				word = word & (word - 1);
 			}
 		}
+
+		// Compound bodies have a single proxy that bounds their shape tree
+		bitSet = &world->taskContextArray[0].compoundBitSet;
+		for (uint32_t i = 1; i < world->workerCount; ++i)
+		{
+			b2InPlaceUnion(bitSet, &world->taskContextArray[i].compoundBitSet);
+		}
+
+		b2Body* bodies = world->bodies;
+		wordCount = bitSet->blockCount;
+		bits = bitSet->bits;
+		for (uint32_t k = 0; k < wordCount; ++k)
+		{
+			word = bits[k];
+			while (word != 0)
+			{
+				uint32_t ctz = b2CTZ(word);
+				uint32_t bodyIndex = 64 * k + ctz;
+
+				b2Body* body = bodies + bodyIndex;
+				B2_ASSERT(b2ObjectValid(&body->object) && body->isCompound);
+				if (body->proxyKey != B2_NULL_INDEX)
+				{
+					// A shape moved so the compound needs a new pair query even if the proxy still covers the tree
+					b2AABB treeAABB = body->shapeTree.nodes[body->shapeTree.root].aabb;
+					b2AABB proxyAABB = b2DynamicTree_GetAABB(broadPhase->trees + B2_PROXY_TYPE(body->proxyKey),
+															 B2_PROXY_ID(body->proxyKey));
+					if (body->isFast == false && b2AABB_Contains(proxyAABB, treeAABB) == false)
+					{
+						b2BroadPhase_EnlargeProxy(broadPhase, body->proxyKey, treeAABB);
+					}
+					else
+					{
+						// Fast compound proxies are enlarged after continuous collision
+						b2BufferMove(broadPhase, body->proxyKey);
+					}
+				}
+
+				// Clear the smallest set bit
+				word = word & (word - 1);
+			}
+		}
+
+		// Gather fast bodies in body order. Then continuous collision and the serial proxy
+		// enlargement below do not depend on the thread count.
+		bitSet = &world->taskContextArray[0].fastBodyBitSet;
+		for (uint32_t i = 1; i < world->workerCount; ++i)
+		{
+			b2InPlaceUnion(bitSet, &world->taskContextArray[i].fastBodyBitSet);
+		}
+
+		int32_t* fastBodies = world->fastBodies;
+		int32_t fastBodyCount = 0;
+		wordCount = bitSet->blockCount;
+		bits = bitSet->bits;
+		for (uint32_t k = 0; k < wordCount; ++k)
+		{
+			word = bits[k];
+			while (word != 0)
+			{
+				uint32_t ctz = b2CTZ(word);
+				int32_t bodyIndex = 64 * k + ctz;
+
+				B2_ASSERT(bodies[bodyIndex].isFast);
+				fastBodies[fastBodyCount] = bodyIndex;
+				fastBodyCount += 1;
+
+				// Clear the smallest set bit
+				word = word & (word - 1);
+			}
+		}
+
+		world->fastBodyCount = fastBodyCount;
 	}
 
 	b2TracyCZoneEnd(enlarge_proxies);
@@ -2191,7 +2438,7 @@ void b2Solve(b2World* world, b2StepContext* context)
 		int32_t fastBodyCount = world->fastBodyCount;
 		b2DynamicTree* tree = broadPhase->trees + b2_dynamicBody;
 
-		// Warning: this loop has non-deterministic order
+		// Fast bodies are in body order so this is deterministic
 		for (int32_t i = 0; i < fastBodyCount; ++i)
 		{
 			b2Body* fastBody = bodies + fastBodies[i];
@@ -2203,6 +2450,32 @@ void b2Solve(b2World* world, b2StepContext* context)
 			// clear flag
 			fastBody->enlargeAABB = false;
 
+			if (fastBody->isCompound)
+			{
+				if (fastBody->proxyKey != B2_NULL_INDEX)
+				{
+					b2DynamicTree* shapeTree = &fastBody->shapeTree;
+					b2AABB treeAABB = shapeTree->nodes[shapeTree->root].aabb;
+					int32_t proxyId = B2_PROXY_ID(fastBody->proxyKey);
+					B2_ASSERT(B2_PROXY_TYPE(fastBody->proxyKey) == b2_dynamicBody);
+
+					if (b2AABB_Contains(b2DynamicTree_GetAABB(tree, proxyId), treeAABB) == false)
+					{
+						b2DynamicTree_EnlargeProxy(tree, proxyId, treeAABB);
+					}
+				}
+
+				int32_t shapeIndex = fastBody->shapeList;
+				while (shapeIndex != B2_NULL_INDEX)
+				{
+					b2Shape* shape = shapes + shapeIndex;
+					shape->enlargedAABB = false;
+					shapeIndex = shape->nextShapeIndex;
+				}
+
+				continue;
+			}
+
 			int32_t shapeIndex = fastBody->shapeList;
 			while (shapeIndex != B2_NULL_INDEX)
 			{
@@ -48,7 +48,7 @@ typedef struct b2Graph
 	b2GraphOverflow overflow;
 } b2Graph;
 
-void b2CreateGraph(b2Graph* graph, int32_t bodyCapacity, int32_t contactCapacity, int32_t jointCapacity);
+void b2CreateGraph(b2Graph* graph, b2Allocator* allocator, int32_t bodyCapacity, int32_t contactCapacity, int32_t jointCapacity);
 void b2DestroyGraph(b2Graph* graph);
 
 void b2AddContactToGraph(b2World* world, b2Contact* contact);
@@ -0,0 +1,88 @@
+// SPDX-FileCopyrightText: 2023 Erin Catto
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "core.h"
+
+#include "box2d/geometry.h"
+#include "box2d/math.h"
+
+#include <math.h>
+
+// Get the range of height field cells that overlap a bounding box in the height field frame.
+// Returns false if there is no overlap.
+static inline bool b2GetHeightfieldCellRange(const b2Heightfield* heightfield, b2AABB box, int32_t* first, int32_t* last)
+{
+	float width = heightfield->cellWidth * (heightfield->count - 1);
+	if (box.upperBound.x < 0.0f || width < box.lowerBound.x || heightfield->maxHeight < box.lowerBound.y)
+	{
+		return false;
+	}
+
+	// Clamp before converting to integers to keep large boxes in range
+	float invWidth = 1.0f / heightfield->cellWidth;
+	float lastCell = (float)(heightfield->count - 2);
+	float x1 = B2_CLAMP(floorf(box.lowerBound.x * invWidth), 0.0f, lastCell);
+	float x2 = B2_CLAMP(floorf(box.upperBound.x * invWidth), 0.0f, lastCell);
+	*first = (int32_t)x1;
+	*last = (int32_t)x2;
+	return true;
+}
+
+// Is a point in the height field frame inside the solid region below the surface?
+static inline bool b2IsBelowHeightfield(const b2Heightfield* heightfield, b2Vec2 localPoint)
+{
+	float x = localPoint.x / heightfield->cellWidth;
+	if (x < 0.0f || heightfield->count - 1 < x || localPoint.y < heightfield->minHeight)
+	{
+		return false;
+	}
+
+	int32_t cell = B2_MIN((int32_t)x, heightfield->count - 2);
+	float alpha = x - cell;
+	float height = (1.0f - alpha) * heightfield->heights[cell] + alpha * heightfield->heights[cell + 1];
+	return localPoint.y <= height;
+}
+
+// Get the vertex of a height field sample in the height field frame
+static inline b2Vec2 b2GetHeightfieldVertex(const b2Heightfield* heightfield, int32_t index)
+{
+	return (b2Vec2){index * heightfield->cellWidth, heightfield->heights[index]};
+}
+
+// Get the smooth segment of a height field cell. The segment runs right to left so
+// that the one-sided normal points up, out of the terrain. Ghost vertices beyond the
+// ends of the height field are extrapolated.
+static inline b2SmoothSegment b2GetHeightfieldSegment(const b2Heightfield* heightfield, int32_t cell)
+{
+	B2_ASSERT(0 <= cell && cell < heightfield->count - 1);
+
+	b2SmoothSegment smoothSegment;
+	smoothSegment.segment.point1 = b2GetHeightfieldVertex(heightfield, cell + 1);
+	smoothSegment.segment.point2 = b2GetHeightfieldVertex(heightfield, cell);
+
+	b2Vec2 p1 = smoothSegment.segment.point1;
+	b2Vec2 p2 = smoothSegment.segment.point2;
+
+	if (cell + 2 < heightfield->count)
+	{
+		smoothSegment.ghost1 = b2GetHeightfieldVertex(heightfield, cell + 2);
+	}
+	else
+	{
+		smoothSegment.ghost1 = b2MulSub(p1, 1.0f, b2Sub(p2, p1));
+	}
+
+	if (cell > 0)
+	{
+		smoothSegment.ghost2 = b2GetHeightfieldVertex(heightfield, cell - 1);
+	}
+	else
+	{
+		smoothSegment.ghost2 = b2MulAdd(p2, 1.0f, b2Sub(p2, p1));
+	}
+
+	smoothSegment.chainIndex = B2_NULL_INDEX;
+	return smoothSegment;
+}
@@ -236,7 +236,7 @@ void b2WakeIsland(b2Island* island)
 // https://en.wikipedia.org/wiki/Disjoint-set_data_structure
 void b2LinkContact(b2World* world, b2Contact* contact)
 {
-	B2_ASSERT(contact->manifold.pointCount > 0);
+	B2_ASSERT(b2GetContactManifold(world, contact)->pointCount > 0);
 
 	b2Body* bodyA = world->bodies + contact->edges[0].bodyIndex;
 	b2Body* bodyB = world->bodies + contact->edges[1].bodyIndex;
@@ -508,20 +508,18 @@ void b2UnlinkJoint(b2World* world, b2Joint* joint)
 
 // Merge an island into its root island.
 // Returns the body count of the merged island.
-static int32_t b2MergeIsland(b2Island* island)
+// Point the bodies, contacts, and joints of a child island at the root island. This walks
+// the whole island but only touches the island's own elements, so islands are remapped in parallel.
+static void b2RemapIsland(b2World* world, const b2Island* island)
 {
 	B2_ASSERT(island->parentIsland != B2_NULL_INDEX);
 
-	b2World* world = island->world;
 	b2Body* bodies = world->bodies;
 	b2Contact* contacts = world->contacts;
 	b2Joint* joints = world->joints;
 
 	int32_t rootIndex = island->parentIsland;
-	b2Island* rootIsland = world->islands + rootIndex;
-	B2_ASSERT(rootIsland->parentIsland == B2_NULL_INDEX);
 
-	// remap island indices
 	int32_t bodyIndex = island->headBody;
 	while (bodyIndex != B2_NULL_INDEX)
 	{
@@ -545,6 +543,37 @@ static int32_t b2MergeIsland(b2Island* island)
 		joint->islandIndex = rootIndex;
 		jointIndex = joint->islandNext;
 	}
+}
+
+static void b2RemapIslandsTask(int32_t startIndex, int32_t endIndex, uint32_t threadIndex, void* context)
+{
+	B2_MAYBE_UNUSED(threadIndex);
+
+	b2TracyCZoneNC(remap_islands, "Remap Islands", b2_colorLightSteelBlue, true);
+
+	b2World* world = context;
+	const int32_t* mergeIslands = world->mergeIslands;
+	for (int32_t i = startIndex; i < endIndex; ++i)
+	{
+		b2RemapIsland(world, world->islands + mergeIslands[i]);
+	}
+
+	b2TracyCZoneEnd(remap_islands);
+}
+
+// Splice the lists of a remapped child island onto the root island. This is constant time.
+static void b2MergeIsland(b2Island* island)
+{
+	B2_ASSERT(island->parentIsland != B2_NULL_INDEX);
+
+	b2World* world = island->world;
+	b2Body* bodies = world->bodies;
+	b2Contact* contacts = world->contacts;
+	b2Joint* joints = world->joints;
+
+	int32_t rootIndex = island->parentIsland;
+	b2Island* rootIsland = world->islands + rootIndex;
+	B2_ASSERT(rootIsland->parentIsland == B2_NULL_INDEX);
 
 	// connect body lists
 	B2_ASSERT(rootIsland->tailBody != B2_NULL_INDEX);
@@ -616,8 +645,6 @@ static int32_t b2MergeIsland(b2Island* island)
 	// Merging a dirty islands means that splitting may still be needed
 	rootIsland->constraintRemoveCount += island->constraintRemoveCount;
 	b2ValidateIsland(rootIsland, true);
-
-	return rootIsland->bodyCount;
 }
 
 // Iterate over all awake islands and merge any that need merging
@@ -630,6 +657,7 @@ void b2MergeAwakeIslands(b2World* world)
 
 	// Step 1: Ensure every child island points to its root island. This avoids merging a child island with
 	// a parent island that has already been merged with a grand-parent island.
+	int32_t mergeCount = 0;
 	for (int32_t i = 0; i < awakeIslandCount; ++i)
 	{
 		int32_t islandIndex = world->awakeIslandArray[i];
@@ -651,32 +679,226 @@ void b2MergeAwakeIslands(b2World* world)
 		if (rootIsland != island)
 		{
 			island->parentIsland = rootIsland->object.index;
+			mergeCount += 1;
 		}
 	}
 
-	// Step 2: merge every awake island into its parent (which must be a root island)
-	// Reverse to support removal from awake array.
-	int32_t maxBodyCount = 0;
+	if (mergeCount == 0)
+	{
+		return;
+	}
+
+	// Step 2: point the elements of every child island at the root island, in parallel.
+	// Children are gathered in reverse awake order to match step 3.
+	int32_t* mergeIslands = b2AllocateStackItem(world->stackAllocator, mergeCount * sizeof(int32_t), "merge islands");
+	int32_t mergeIndex = 0;
 	for (int32_t i = awakeIslandCount - 1; i >= 0; --i)
 	{
 		int32_t islandIndex = world->awakeIslandArray[i];
-		b2Island* island = islands + islandIndex;
-
-		if (island->parentIsland == B2_NULL_INDEX)
+		if (islands[islandIndex].parentIsland != B2_NULL_INDEX)
 		{
-			maxBodyCount = B2_MAX(maxBodyCount, island->bodyCount);
-			continue;
+			mergeIslands[mergeIndex++] = islandIndex;
 		}
+	}
+	B2_ASSERT(mergeIndex == mergeCount);
 
-		int32_t mergedBodyCount = b2MergeIsland(island);
-		maxBodyCount = B2_MAX(maxBodyCount, mergedBodyCount);
+	world->mergeIslands = mergeIslands;
+	void* userRemapTask = world->enqueueTaskFcn(&b2RemapIslandsTask, mergeCount, 4, world, world->userTaskContext);
+	world->taskCount += 1;
+	if (userRemapTask != NULL)
+	{
+		world->finishTaskFcn(userRemapTask, world->userTaskContext);
+	}
+	world->mergeIslands = NULL;
 
+	// Step 3: splice every child island onto its root island. The splice order determines the body order
+	// in the root island, so this is serial and deterministic.
+	// Reverse awake order to support removal from awake array.
+	// Note: the island pool is grown for splitting in b2PrepareIslandSplits
+	for (int32_t i = 0; i < mergeCount; ++i)
+	{
+		b2Island* island = islands + mergeIslands[i];
+		b2MergeIsland(island);
 		b2DestroyIsland(island);
 	}
 
-	// Step 3: ensure island pool has sufficient space to split the largest island
-	b2GrowPool(&world->islandPool, world->islandPool.count + maxBodyCount);
+	b2FreeStackItem(world->stackAllocator, mergeIslands);
+}
+
+// Islands reserved for each parallel split. Larger splits finish serially.
+#define B2_MAX_SPLIT_RESERVE 8
+
+static void b2SplitIsland(b2World* world, b2IslandSplit* split, b2StackAllocator* alloc, bool serial);
+
+// Most removed constraints first. Ties keep the awake order.
+static int b2CompareIslandSplits(const void* a, const void* b)
+{
+	const b2IslandSplit* sa = a;
+	const b2IslandSplit* sb = b;
+
+	if (sa->removeCount != sb->removeCount)
+	{
+		return sa->removeCount > sb->removeCount ? -1 : 1;
+	}
+
+	return sa->awakeIndex - sb->awakeIndex;
+}
+
+int32_t b2PrepareIslandSplits(b2World* world)
+{
+	b2Array_Clear(world->islandSplitArray);
+	b2Array_Clear(world->reservedIslandArray);
+
+	int32_t awakeIslandCount = b2Array(world->awakeIslandArray).count;
+	const b2Island* islands = world->islands;
+
+	int32_t candidateCount = 0;
+	int32_t bestIndex = B2_NULL_INDEX;
+	int32_t maxRemoveCount = 0;
+	for (int32_t i = 0; i < awakeIslandCount; ++i)
+	{
+		const b2Island* island = islands + world->awakeIslandArray[i];
+		if (island->constraintRemoveCount > 0)
+		{
+			candidateCount += 1;
+		}
+
+		if (island->constraintRemoveCount > maxRemoveCount)
+		{
+			maxRemoveCount = island->constraintRemoveCount;
+			bestIndex = i;
+		}
+	}
+
+	if (candidateCount == 0)
+	{
+		return 0;
+	}
+
+	// Without a budget only the island with the most removed constraints is split
+	int32_t budget = world->islandSplitBudget;
+	if (budget == 0)
+	{
+		b2IslandSplit split = {world->awakeIslandArray[bestIndex], bestIndex, maxRemoveCount, 0, 0, 0, B2_NULL_INDEX};
+		b2Array_Push(world->islandSplitArray, split);
+		candidateCount = 1;
+	}
+	else
+	{
+		for (int32_t i = 0; i < awakeIslandCount; ++i)
+		{
+			int32_t islandIndex = world->awakeIslandArray[i];
+			const b2Island* island = islands + islandIndex;
+			if (island->constraintRemoveCount > 0)
+			{
+				b2IslandSplit split = {islandIndex, i, island->constraintRemoveCount, 0, 0, 0, B2_NULL_INDEX};
+				b2Array_Push(world->islandSplitArray, split);
+			}
+		}
+
+		qsort(world->islandSplitArray, candidateCount, sizeof(b2IslandSplit), b2CompareIslandSplits);
+	}
+
+	// The first candidate is always split. Others are split while their bodies fit in the budget.
+	b2IslandSplit* splits = world->islandSplitArray;
+	int32_t splitCount = 0;
+	int32_t budgetBodyCount = 0;
+	int32_t reserveCount = 0;
+	for (int32_t i = 0; i < candidateCount; ++i)
+	{
+		int32_t bodyCount = islands[splits[i].islandIndex].bodyCount;
+		if (splitCount > 0 && budgetBodyCount + bodyCount > budget)
+		{
+			continue;
+		}
+
+		// The first piece reuses the split island. Usually an island loses a few contacts and splits in
+		// two, so only a few islands are reserved.
+		b2IslandSplit* split = splits + splitCount;
+		*split = splits[i];
+		split->reserveIndex = reserveCount;
+		split->reserveCount = B2_MIN(B2_MIN(bodyCount - 1, split->removeCount), B2_MAX_SPLIT_RESERVE);
+		split->newIslandCount = 0;
+		split->overflowIslandIndex = B2_NULL_INDEX;
+
+		splitCount += 1;
+		budgetBodyCount += bodyCount;
+		reserveCount += split->reserveCount;
+	}
+
+	b2Array(world->islandSplitArray).count = splitCount;
+
+	// Reserve the new islands now because the pool cannot grow while islands are split in parallel
+	b2GrowPool(&world->islandPool, world->islandPool.count + reserveCount);
 	world->islands = (b2Island*)world->islandPool.memory;
+
+	b2Array_Resize((void**)&world->reservedIslandArray, sizeof(int32_t), reserveCount);
+	for (int32_t i = 0; i < reserveCount; ++i)
+	{
+		b2Object* object = b2AllocObject(&world->islandPool);
+		world->reservedIslandArray[i] = object->index;
+	}
+
+	return splitCount;
+}
+
+void b2FinishIslandSplits(b2World* world)
+{
+	b2IslandSplit* splits = world->islandSplitArray;
+	int32_t splitCount = b2Array(splits).count;
+	const int32_t* reservedIslands = world->reservedIslandArray;
+	b2Island* islands = world->islands;
+
+	// Make the new islands awake in split order for determinism
+	for (int32_t i = 0; i < splitCount; ++i)
+	{
+		const b2IslandSplit* split = splits + i;
+		for (int32_t j = 0; j < split->newIslandCount; ++j)
+		{
+			int32_t islandIndex = reservedIslands[split->reserveIndex + j];
+			islands[islandIndex].awakeIndex = b2Array(world->awakeIslandArray).count;
+			b2Array_Push(world->awakeIslandArray, islandIndex);
+		}
+	}
+
+	// Return the unused islands in reverse order of reservation, which restores the free list
+	for (int32_t i = splitCount - 1; i >= 0; --i)
+	{
+		const b2IslandSplit* split = splits + i;
+		for (int32_t j = split->reserveCount - 1; j >= split->newIslandCount; --j)
+		{
+			int32_t islandIndex = reservedIslands[split->reserveIndex + j];
+			b2FreeObject(&world->islandPool, &islands[islandIndex].object);
+		}
+	}
+
+	// Finish the splits that ran out of reserved islands. The new islands are allocated one at a time.
+	for (int32_t i = 0; i < splitCount; ++i)
+	{
+		const b2IslandSplit* split = splits + i;
+		if (split->overflowIslandIndex != B2_NULL_INDEX)
+		{
+			b2Island* island = world->islands + split->overflowIslandIndex;
+			b2IslandSplit overflowSplit = {split->overflowIslandIndex, island->awakeIndex, 0, 0, 0, 0, B2_NULL_INDEX};
+			b2SplitIsland(world, &overflowSplit, world->stackAllocator, true);
+		}
+	}
+	islands = world->islands;
+
+#if B2_VALIDATE
+	for (int32_t i = 0; i < splitCount; ++i)
+	{
+		const b2IslandSplit* split = splits + i;
+		b2ValidateIsland(islands + split->islandIndex, true);
+		for (int32_t j = 0; j < split->newIslandCount; ++j)
+		{
+			b2ValidateIsland(islands + reservedIslands[split->reserveIndex + j], true);
+		}
+	}
+#endif
+
+	b2Array_Clear(world->islandSplitArray);
+	b2Array_Clear(world->reservedIslandArray);
 }
 
 #define B2_CONTACT_REMOVE_THRESHOLD 1
@@ -686,21 +908,12 @@ void b2MergeAwakeIslands(b2World* world)
 // so it can be quite slow.
 // Note: contacts/joints connected to static bodies must belong to an island but don't affect island connectivity
 // Note: static bodies are never in an island
-// Note: this task interacts with some allocators without locks under the assumption that no other tasks
-// are interacting with these data structures.
-void b2SplitIslandTask(int32_t startIndex, int32_t endIndex, uint32_t threadIndex, void* context)
+// Note: several islands may be split at the same time. Islands share no bodies or constraints and the new
+// islands were reserved in b2PrepareIslandSplits, so no locks are needed. A serial split allocates new
+// islands as it finds them instead.
+static void b2SplitIsland(b2World* world, b2IslandSplit* split, b2StackAllocator* alloc, bool serial)
 {
-	b2TracyCZoneNC(split, "Split Island", b2_colorHoneydew2, true);
-
-	B2_MAYBE_UNUSED(startIndex);
-	B2_MAYBE_UNUSED(endIndex);
-	B2_MAYBE_UNUSED(threadIndex);
-
-	b2World* world = context;
-
-	B2_ASSERT(world->splitIslandIndex != B2_NULL_INDEX);
-
-	b2Island* baseIsland = world->islands + world->splitIslandIndex;
+	b2Island* baseIsland = world->islands + split->islandIndex;
 
 	b2ValidateIsland(baseIsland, true);
 
@@ -710,9 +923,6 @@ void b2SplitIslandTask(int32_t startIndex, int32_t endIndex, uint32_t threadInde
 	b2Contact* contacts = world->contacts;
 	b2Joint* joints = world->joints;
 
-	b2StackAllocator* alloc = world->stackAllocator;
-
-	// No lock is needed because I ensure these are not used while this task is active.
 	int32_t* stack = b2AllocateStackItem(alloc, bodyCount * sizeof(int32_t), "island stack");
 	int32_t* bodyIndices = b2AllocateStackItem(alloc, bodyCount * sizeof(int32_t), "body indices");
 
@@ -751,11 +961,15 @@ void b2SplitIslandTask(int32_t startIndex, int32_t endIndex, uint32_t threadInde
 		nextJoint = joint->islandNext;
 	}
 
-	// Done with the base split island.
-	b2DestroyIsland(baseIsland);
+	// The base island is reused for the first new island and stays in the awake island array
+	int32_t baseIslandIndex = split->islandIndex;
+	int32_t baseAwakeIndex = baseIsland->awakeIndex;
+	B2_ASSERT(baseAwakeIndex != B2_NULL_INDEX);
 	baseIsland = NULL;
+	const int32_t* reservedIslands = world->reservedIslandArray + split->reserveIndex;
 
 	// Each island is found as a depth first search starting from a seed body
+	int32_t islandIndex = B2_NULL_INDEX;
 	for (int32_t i = 0; i < bodyCount; ++i)
 	{
 		int32_t seedIndex = bodyIndices[i];
@@ -774,16 +988,44 @@ void b2SplitIslandTask(int32_t startIndex, int32_t endIndex, uint32_t threadInde
 		stack[stackCount++] = seedIndex;
 		seed->isMarked = true;
 
+		bool isNewIsland = true;
+
 		// Create new island
-		// No lock needed because only a single island can split per time step
-		// However, it is not safe to cause the island pool to grow because other islands are being processed.
-		// So this allocation must come from the free list.
-		B2_ASSERT(world->islandPool.capacity > world->islandPool.count);
-		b2Island* island = (b2Island*)b2AllocObject(&world->islandPool);
-		b2CreateIsland(island);
-		island->world = world;
+		if (i == 0)
+		{
+			islandIndex = baseIslandIndex;
+		}
+		else if (split->newIslandCount < split->reserveCount)
+		{
+			islandIndex = reservedIslands[split->newIslandCount];
+			split->newIslandCount += 1;
+		}
+		else if (serial)
+		{
+			b2Object* object = b2AllocObject(&world->islandPool);
+			world->islands = (b2Island*)world->islandPool.memory;
+			islandIndex = object->index;
+		}
+		else
+		{
+			// Out of reserved islands. The remaining pieces join the last island and are split later.
+			split->overflowIslandIndex = islandIndex;
+			isNewIsland = false;
+		}
+
+		b2Island* island = world->islands + islandIndex;
+		if (isNewIsland)
+		{
+			b2CreateIsland(island);
+			island->world = world;
+			island->awakeIndex = islandIndex == baseIslandIndex ? baseAwakeIndex : B2_NULL_INDEX;
 
-		int32_t islandIndex = island->object.index;
+			if (serial && islandIndex != baseIslandIndex)
+			{
+				island->awakeIndex = b2Array(world->awakeIslandArray).count;
+				b2Array_Push(world->awakeIslandArray, islandIndex);
+			}
+		}
 
 		// Perform a depth first search (DFS) on the constraint graph.
 		while (stackCount > 0)
@@ -830,12 +1072,6 @@ void b2SplitIslandTask(int32_t startIndex, int32_t endIndex, uint32_t threadInde
 					continue;
 				}
 
-				// Skip sensors
-				if (contact->flags & b2_contactSensorFlag)
-				{
-					continue;
-				}
-
 				// Is this contact enabled and touching?
 				if ((contact->flags & b2_contactTouchingFlag) == 0)
 				{
@@ -932,17 +1168,26 @@ void b2SplitIslandTask(int32_t startIndex, int32_t endIndex, uint32_t threadInde
 			}
 		}
 
-		// For consistency, this island must be added to the awake island array. This should
-		// be safe because no other task is accessing this and the solver has already gathered
-		// all awake bodies.
-		island->awakeIndex = b2Array(world->awakeIslandArray).count;
-		b2Array_Push(world->awakeIslandArray, islandIndex);
-
-		b2ValidateIsland(island, true);
+		// The new islands of a parallel split are added to the awake island array in b2FinishIslandSplits
 	}
 
 	b2FreeStackItem(alloc, bodyIndices);
 	b2FreeStackItem(alloc, stack);
+}
+
+void b2SplitIslandTask(int32_t startIndex, int32_t endIndex, uint32_t threadIndex, void* context)
+{
+	b2TracyCZoneNC(split, "Split Island", b2_colorHoneydew2, true);
+
+	b2World* world = context;
+
+	// Scratch memory comes from the stack of this worker thread, so no lock is needed.
+	b2StackAllocator* alloc = world->taskContextArray[threadIndex].stackAllocator;
+
+	for (int32_t i = startIndex; i < endIndex; ++i)
+	{
+		b2SplitIsland(world, world->islandSplitArray + i, alloc, false);
+	}
 
 	b2TracyCZoneEnd(split);
 }
@@ -73,7 +73,30 @@ void b2UnlinkJoint(b2World* world, b2Joint* joint);
 
 void b2MergeAwakeIslands(b2World* world);
 
+// An awake island that lost constraints and is split during the solve
+typedef struct b2IslandSplit
+{
+	int32_t islandIndex;
+	int32_t awakeIndex;
+	int32_t removeCount;
+
+	// Range in the world reserved island array. The first new island reuses the split island.
+	// Removing k constraints leaves at most k + 1 pieces, so that is reserved up to a small cap.
+	int32_t reserveIndex;
+	int32_t reserveCount;
+	int32_t newIslandCount;
+
+	// When the reserved islands run out, the remaining pieces stay together in this island and
+	// are split serially in b2FinishIslandSplits
+	int32_t overflowIslandIndex;
+} b2IslandSplit;
+
+// Choose the islands to split this step and reserve their new islands. Returns the number of
+// islands to split with b2SplitIslandTask, one item per island.
+int32_t b2PrepareIslandSplits(b2World* world);
 void b2SplitIslandTask(int32_t startIndex, int32_t endIndex, uint32_t threadIndex, void* context);
-void b2CompleteSplitIsland(b2Island* island);
+
+// Add the new islands to the awake island array and release unused reserved islands
+void b2FinishIslandSplits(b2World* world);
 
 void b2ValidateIsland(b2Island* island, bool checkSleep);
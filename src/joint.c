@@ -53,14 +53,11 @@ void b2LinearStiffness(float* stiffness, float* damping, float frequencyHertz, f
 	B2_ASSERT(bodyIdA.world == bodyIdB.world);
 
 	b2World* world = b2GetWorldFromIndex(bodyIdA.world);
-	B2_ASSERT(0 <= bodyIdA.index && bodyIdA.index < world->bodyPool.capacity);
-	B2_ASSERT(0 <= bodyIdB.index && bodyIdB.index < world->bodyPool.capacity);
+	b2BodySim* bodySimA = b2GetBodySim(world, b2GetBody(world, bodyIdA));
+	b2BodySim* bodySimB = b2GetBodySim(world, b2GetBody(world, bodyIdB));
 
-	b2Body* bodyA = world->bodies + bodyIdA.index;
-	b2Body* bodyB = world->bodies + bodyIdB.index;
-
-	float massA = bodyA->mass;
-	float massB = bodyB->mass;
+	float massA = bodySimA->mass;
+	float massB = bodySimB->mass;
 	float mass;
 	if (massA > 0.0f && massB > 0.0f)
 	{
@@ -86,14 +83,11 @@ void b2AngularStiffness(float* stiffness, float* damping, float frequencyHertz,
 	B2_ASSERT(bodyIdA.world == bodyIdB.world);
 
 	b2World* world = b2GetWorldFromIndex(bodyIdA.world);
-	B2_ASSERT(0 <= bodyIdA.index && bodyIdA.index < world->bodyPool.capacity);
-	B2_ASSERT(0 <= bodyIdB.index && bodyIdB.index < world->bodyPool.capacity);
-
-	b2Body* bodyA = world->bodies + bodyIdA.index;
-	b2Body* bodyB = world->bodies + bodyIdB.index;
+	b2BodySim* bodySimA = b2GetBodySim(world, b2GetBody(world, bodyIdA));
+	b2BodySim* bodySimB = b2GetBodySim(world, b2GetBody(world, bodyIdB));
 
-	float IA = bodyA->I;
-	float IB = bodyB->I;
+	float IA = bodySimA->I;
+	float IB = bodySimB->I;
 	float I;
 	if (IA > 0.0f && IB > 0.0f)
 	{
@@ -220,8 +214,8 @@ b2JointId b2CreateDistanceJoint(b2WorldId worldId, const b2DistanceJointDef* def
 	B2_ASSERT(b2IsBodyIdValid(world, def->bodyIdA));
 	B2_ASSERT(b2IsBodyIdValid(world, def->bodyIdB));
 
-	b2Body* bodyA = world->bodies + def->bodyIdA.index;
-	b2Body* bodyB = world->bodies + def->bodyIdB.index;
+	b2Body* bodyA = b2GetBody(world, def->bodyIdA);
+	b2Body* bodyB = b2GetBody(world, def->bodyIdB);
 
 	b2Joint* joint = b2CreateJoint(world, bodyA, bodyB);
 
@@ -265,8 +259,8 @@ b2JointId b2CreateMotorJoint(b2WorldId worldId, const b2MotorJointDef* def)
 	B2_ASSERT(b2IsBodyIdValid(world, def->bodyIdA));
 	B2_ASSERT(b2IsBodyIdValid(world, def->bodyIdB));
 
-	b2Body* bodyA = world->bodies + def->bodyIdA.index;
-	b2Body* bodyB = world->bodies + def->bodyIdB.index;
+	b2Body* bodyA = b2GetBody(world, def->bodyIdA);
+	b2Body* bodyB = b2GetBody(world, def->bodyIdB);
 
 	b2Joint* joint = b2CreateJoint(world, bodyA, bodyB);
 
@@ -300,14 +294,16 @@ b2JointId b2CreateMouseJoint(b2WorldId worldId, const b2MouseJointDef* def)
 	B2_ASSERT(b2IsBodyIdValid(world, def->bodyIdA));
 	B2_ASSERT(b2IsBodyIdValid(world, def->bodyIdB));
 
-	b2Body* bodyA = world->bodies + def->bodyIdA.index;
-	b2Body* bodyB = world->bodies + def->bodyIdB.index;
+	b2Body* bodyA = b2GetBody(world, def->bodyIdA);
+	b2Body* bodyB = b2GetBody(world, def->bodyIdB);
 
 	b2Joint* joint = b2CreateJoint(world, bodyA, bodyB);
 
 	joint->type = b2_mouseJoint;
-	joint->localAnchorA = b2InvTransformPoint(bodyA->transform, def->target);
-	joint->localAnchorB = b2InvTransformPoint(bodyB->transform, def->target);
+	b2Transform transformA = b2GetBodySim(world, bodyA)->transform;
+	b2Transform transformB = b2GetBodySim(world, bodyB)->transform;
+	joint->localAnchorA = b2InvTransformPoint(transformA, def->target);
+	joint->localAnchorB = b2InvTransformPoint(transformB, def->target);
 	joint->collideConnected = true;
 
 	b2MouseJoint empty = {0};
@@ -335,8 +331,8 @@ b2JointId b2CreateRevoluteJoint(b2WorldId worldId, const b2RevoluteJointDef* def
 	B2_ASSERT(b2IsBodyIdValid(world, def->bodyIdA));
 	B2_ASSERT(b2IsBodyIdValid(world, def->bodyIdB));
 
-	b2Body* bodyA = world->bodies + def->bodyIdA.index;
-	b2Body* bodyB = world->bodies + def->bodyIdB.index;
+	b2Body* bodyA = b2GetBody(world, def->bodyIdA);
+	b2Body* bodyB = b2GetBody(world, def->bodyIdB);
 
 	b2Joint* joint = b2CreateJoint(world, bodyA, bodyB);
 
@@ -386,8 +382,8 @@ b2JointId b2CreatePrismaticJoint(b2WorldId worldId, const b2PrismaticJointDef* d
 	B2_ASSERT(b2IsBodyIdValid(world, def->bodyIdA));
 	B2_ASSERT(b2IsBodyIdValid(world, def->bodyIdB));
 
-	b2Body* bodyA = world->bodies + def->bodyIdA.index;
-	b2Body* bodyB = world->bodies + def->bodyIdB.index;
+	b2Body* bodyA = b2GetBody(world, def->bodyIdA);
+	b2Body* bodyB = b2GetBody(world, def->bodyIdB);
 
 	b2Joint* joint = b2CreateJoint(world, bodyA, bodyB);
 
@@ -437,8 +433,8 @@ b2JointId b2CreateWeldJoint(b2WorldId worldId, const b2WeldJointDef* def)
 	B2_ASSERT(b2IsBodyIdValid(world, def->bodyIdA));
 	B2_ASSERT(b2IsBodyIdValid(world, def->bodyIdB));
 
-	b2Body* bodyA = world->bodies + def->bodyIdA.index;
-	b2Body* bodyB = world->bodies + def->bodyIdB.index;
+	b2Body* bodyA = b2GetBody(world, def->bodyIdA);
+	b2Body* bodyB = b2GetBody(world, def->bodyIdB);
 
 	b2Joint* joint = b2CreateJoint(world, bodyA, bodyB);
 
@@ -481,8 +477,8 @@ b2JointId b2CreateWheelJoint(b2WorldId worldId, const b2WheelJointDef* def)
 	B2_ASSERT(b2IsBodyIdValid(world, def->bodyIdA));
 	B2_ASSERT(b2IsBodyIdValid(world, def->bodyIdB));
 
-	b2Body* bodyA = world->bodies + def->bodyIdA.index;
-	b2Body* bodyB = world->bodies + def->bodyIdB.index;
+	b2Body* bodyA = b2GetBody(world, def->bodyIdA);
+	b2Body* bodyB = b2GetBody(world, def->bodyIdB);
 
 	b2Joint* joint = b2CreateJoint(world, bodyA, bodyB);
 
@@ -610,8 +606,7 @@ b2BodyId b2Joint_GetBodyA(b2JointId jointId)
 	int32_t bodyIndex = joint->edges[0].bodyIndex;
 	B2_ASSERT(0 <= bodyIndex && bodyIndex < world->bodyPool.capacity);
 	b2Body* body = world->bodies + bodyIndex;
-	b2BodyId bodyId = {bodyIndex, jointId.world, body->object.revision};
-	return bodyId;
+	return b2MakeBodyId(world, body);
 }
 
 b2BodyId b2Joint_GetBodyB(b2JointId jointId)
@@ -622,8 +617,7 @@ b2BodyId b2Joint_GetBodyB(b2JointId jointId)
 	int32_t bodyIndex = joint->edges[1].bodyIndex;
 	B2_ASSERT(0 <= bodyIndex && bodyIndex < world->bodyPool.capacity);
 	b2Body* body = world->bodies + bodyIndex;
-	b2BodyId bodyId = {bodyIndex, jointId.world, body->object.revision};
-	return bodyId;
+	return b2MakeBodyId(world, body);
 }
 
 extern void b2PrepareDistanceJoint(b2Joint* base, b2StepContext* context);
@@ -866,31 +860,33 @@ b2JointId b2Body_GetNextJoint(b2BodyId bodyId, b2JointId jointId)
 	return id;
 }
 
-extern void b2DrawDistance(b2DebugDraw* draw, b2Joint* base, b2Body* bodyA, b2Body* bodyB);
-extern void b2DrawPrismatic(b2DebugDraw* draw, b2Joint* base, b2Body* bodyA, b2Body* bodyB);
-extern void b2DrawRevolute(b2DebugDraw* draw, b2Joint* base, b2Body* bodyA, b2Body* bodyB);
-extern void b2DrawWheelJoint(b2DebugDraw* draw, b2Joint* base, b2Body* bodyA, b2Body* bodyB);
+extern void b2DrawDistance(b2DebugDraw* draw, b2Joint* base, b2BodySim* bodySimA, b2BodySim* bodySimB);
+extern void b2DrawPrismatic(b2DebugDraw* draw, b2Joint* base, b2BodySim* bodySimA, b2BodySim* bodySimB);
+extern void b2DrawRevolute(b2DebugDraw* draw, b2Joint* base, b2BodySim* bodySimA, b2BodySim* bodySimB);
+extern void b2DrawWheelJoint(b2DebugDraw* draw, b2Joint* base, b2BodySim* bodySimA, b2BodySim* bodySimB);
 
 void b2DrawJoint(b2DebugDraw* draw, b2World* world, b2Joint* joint)
 {
 	b2Body* bodyA = world->bodies + joint->edges[0].bodyIndex;
 	b2Body* bodyB = world->bodies + joint->edges[1].bodyIndex;
+	b2BodySim* bodySimA = world->bodySimArray + joint->edges[0].bodyIndex;
+	b2BodySim* bodySimB = world->bodySimArray + joint->edges[1].bodyIndex;
 	if (bodyA->isEnabled == false || bodyB->isEnabled == false)
 	{
 		return;
 	}
 
-	b2Transform xfA = bodyA->transform;
-	b2Transform xfB = bodyB->transform;
-	b2Vec2 pA = b2TransformPoint(bodyA->transform, joint->localAnchorA);
-	b2Vec2 pB = b2TransformPoint(bodyB->transform, joint->localAnchorB);
+	b2Transform xfA = bodySimA->transform;
+	b2Transform xfB = bodySimB->transform;
+	b2Vec2 pA = b2TransformPoint(bodySimA->transform, joint->localAnchorA);
+	b2Vec2 pB = b2TransformPoint(bodySimB->transform, joint->localAnchorB);
 
 	b2Color color = {0.5f, 0.8f, 0.8f, 1.0f};
 
 	switch (joint->type)
 	{
 		case b2_distanceJoint:
-			b2DrawDistance(draw, joint, bodyA, bodyB);
+			b2DrawDistance(draw, joint, bodySimA, bodySimB);
 			break;
 
 			// case b2_pulleyJoint:
@@ -918,15 +914,15 @@ void b2DrawJoint(b2DebugDraw* draw, b2World* world, b2Joint* joint)
 		break;
 
 		case b2_prismaticJoint:
-			b2DrawPrismatic(draw, joint, bodyA, bodyB);
+			b2DrawPrismatic(draw, joint, bodySimA, bodySimB);
 			break;
 
 		case b2_revoluteJoint:
-			b2DrawRevolute(draw, joint, bodyA, bodyB);
+			b2DrawRevolute(draw, joint, bodySimA, bodySimB);
 			break;
 
 		case b2_wheelJoint:
-			b2DrawWheelJoint(draw, joint, bodyA, bodyB);
+			b2DrawWheelJoint(draw, joint, bodySimA, bodySimB);
 			break;
 
 		default:
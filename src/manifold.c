@@ -4,6 +4,8 @@
 #include "box2d/manifold.h"
 
 #include "core.h"
+#include "heightfield.h"
+#include "shape.h"
 
 #include "box2d/distance.h"
 #include "box2d/geometry.h"
@@ -1209,3 +1211,311 @@ b2Manifold b2CollideSmoothSegmentAndPolygon(const b2SmoothSegment* segmentA, b2T
 
 	return manifold;
 }
+
+// Smooth segments of a height field or chain that are this close to parallel share a manifold
+#define b2_segmentNormalTolerance 0.995f
+
+// Tag a segment manifold point id with the segment index so that ids persist as shapes slide across segments.
+// The low byte keeps the convex feature indices, which are less than b2_maxPolygonVertices.
+static uint32_t b2MakeSegmentId(int32_t segmentIndex, uint32_t id)
+{
+	B2_ASSERT(0 <= segmentIndex && segmentIndex < (1 << 24));
+	return ((uint32_t)segmentIndex << 8) | (((id >> 8) & 0xF) << 4) | (id & 0xF);
+}
+
+// The manifold of a height field or chain, accumulated one smooth segment at a time
+typedef struct b2MeshManifold
+{
+	b2Manifold manifold;
+
+	// Does the normal come from the segment faces rather than from shape B or a segment vertex?
+	bool faceNormal;
+} b2MeshManifold;
+
+// Merge a segment manifold into the accumulated manifold. The points are pooled, keeping the deepest of any
+// coincident points, then the deepest point and the point furthest from it along the surface. Where two segment faces form a
+// valley, the normal becomes the bisector of the face normals so that both slopes support the shape.
+// Otherwise the deeper manifold wins when the normals differ.
+static void b2MergeSegmentManifold(b2MeshManifold* meshManifold, const b2Manifold* segmentManifold, bool faceNormal)
+{
+	b2Manifold* manifold = &meshManifold->manifold;
+	if (manifold->pointCount == 0)
+	{
+		*manifold = *segmentManifold;
+		meshManifold->faceNormal = faceNormal;
+		return;
+	}
+
+	// Separation is measured along the segment normals
+	float separationScale = 1.0f;
+	if (b2Dot(manifold->normal, segmentManifold->normal) < b2_segmentNormalTolerance)
+	{
+		const b2ManifoldPoint* mp1 = manifold->points;
+		if (manifold->pointCount == 2 && manifold->points[1].separation < mp1->separation)
+		{
+			mp1 = manifold->points + 1;
+		}
+
+		const b2ManifoldPoint* mp2 = segmentManifold->points;
+		if (segmentManifold->pointCount == 2 && segmentManifold->points[1].separation < mp2->separation)
+		{
+			mp2 = segmentManifold->points + 1;
+		}
+
+		// In a valley each contact point is in front of the other face
+		bool valley = meshManifold->faceNormal && faceNormal &&
+					  b2Dot(b2Sub(mp2->point, mp1->point), manifold->normal) > b2_linearSlop &&
+					  b2Dot(b2Sub(mp1->point, mp2->point), segmentManifold->normal) > b2_linearSlop;
+
+		float length = 0.0f;
+		b2Vec2 normal = b2GetLengthAndNormalize(&length, b2Add(manifold->normal, segmentManifold->normal));
+		if (valley == false || length < 0.5f)
+		{
+			if (mp2->separation < mp1->separation)
+			{
+				*manifold = *segmentManifold;
+				meshManifold->faceNormal = faceNormal;
+			}
+			return;
+		}
+
+		manifold->normal = normal;
+		separationScale = 2.0f / length;
+	}
+
+	b2ManifoldPoint points[4];
+	int32_t count = 0;
+	for (int32_t i = 0; i < manifold->pointCount; ++i)
+	{
+		points[count] = manifold->points[i];
+		points[count].separation *= separationScale;
+		count += 1;
+	}
+
+	for (int32_t i = 0; i < segmentManifold->pointCount; ++i)
+	{
+		b2ManifoldPoint mp = segmentManifold->points[i];
+		mp.separation *= separationScale;
+
+		bool duplicate = false;
+		for (int32_t j = 0; j < count; ++j)
+		{
+			if (b2DistanceSquared(mp.point, points[j].point) < b2_linearSlop * b2_linearSlop)
+			{
+				if (mp.separation < points[j].separation)
+				{
+					points[j] = mp;
+				}
+				duplicate = true;
+				break;
+			}
+		}
+
+		if (duplicate == false)
+		{
+			points[count++] = mp;
+		}
+	}
+
+	if (count <= 2)
+	{
+		for (int32_t i = 0; i < count; ++i)
+		{
+			manifold->points[i] = points[i];
+		}
+		manifold->pointCount = count;
+		return;
+	}
+
+	// Keep the deepest point and the point furthest from it along the surface
+	int32_t i1 = 0;
+	for (int32_t i = 1; i < count; ++i)
+	{
+		if (points[i].separation < points[i1].separation)
+		{
+			i1 = i;
+		}
+	}
+
+	b2Vec2 tangent = b2LeftPerp(manifold->normal);
+	int32_t i2 = i1;
+	float maxDistance = 0.0f;
+	for (int32_t i = 0; i < count; ++i)
+	{
+		float distance = B2_ABS(b2Dot(tangent, b2Sub(points[i].point, points[i1].point)));
+		if (distance > maxDistance)
+		{
+			maxDistance = distance;
+			i2 = i;
+		}
+	}
+
+	manifold->points[0] = points[i1];
+	manifold->points[1] = points[i2];
+	manifold->pointCount = i1 == i2 ? 1 : 2;
+}
+
+// Bound shape B in the frame of shape A, padded by the speculative distance
+static b2AABB b2ComputeLocalAABB(const void* shapeB, b2ShapeType typeB, b2Transform xf)
+{
+	b2AABB box;
+	switch (typeB)
+	{
+		case b2_circleShape:
+			box = b2ComputeCircleAABB(shapeB, xf);
+			break;
+		case b2_capsuleShape:
+			box = b2ComputeCapsuleAABB(shapeB, xf);
+			break;
+		case b2_polygonShape:
+			box = b2ComputePolygonAABB(shapeB, xf);
+			break;
+		default:
+			B2_ASSERT(false);
+			box = (b2AABB){xf.p, xf.p};
+			break;
+	}
+
+	box.lowerBound = b2Sub(box.lowerBound, (b2Vec2){b2_speculativeDistance, b2_speculativeDistance});
+	box.upperBound = b2Add(box.upperBound, (b2Vec2){b2_speculativeDistance, b2_speculativeDistance});
+	return box;
+}
+
+// Collide one smooth segment of a height field or chain and merge the result. The distance cache belongs to
+// the shape pair and is shared by the segments. It only warm starts GJK, and the vertex indices of one segment
+// are valid for any other segment. Circles don't use the cache.
+static void b2CollideSegmentPiece(b2MeshManifold* meshManifold, const b2SmoothSegment* smoothSegment, int32_t segmentIndex,
+								  b2Transform xfA, const void* shapeB, b2ShapeType typeB, b2Transform xfB,
+								  b2DistanceCache* cache)
+{
+	b2Manifold segmentManifold;
+	switch (typeB)
+	{
+		case b2_circleShape:
+			segmentManifold = b2CollideSmoothSegmentAndCircle(smoothSegment, xfA, shapeB, xfB);
+			break;
+		case b2_capsuleShape:
+			segmentManifold = b2CollideSmoothSegmentAndCapsule(smoothSegment, xfA, shapeB, xfB, cache);
+			break;
+		default:
+			segmentManifold = b2CollideSmoothSegmentAndPolygon(smoothSegment, xfA, shapeB, xfB, cache);
+			break;
+	}
+
+	if (segmentManifold.pointCount == 0)
+	{
+		return;
+	}
+
+	for (int32_t i = 0; i < segmentManifold.pointCount; ++i)
+	{
+		segmentManifold.points[i].id = b2MakeSegmentId(segmentIndex, segmentManifold.points[i].id);
+	}
+
+	// The one-sided segment normal points out of the solid side
+	b2Vec2 segmentNormal = b2Normalize(b2RightPerp(b2Sub(smoothSegment->segment.point2, smoothSegment->segment.point1)));
+	segmentNormal = b2RotateVector(xfA.q, segmentNormal);
+	bool faceNormal = b2Dot(segmentManifold.normal, segmentNormal) > b2_segmentNormalTolerance;
+
+	b2MergeSegmentManifold(meshManifold, &segmentManifold, faceNormal);
+}
+
+// Collide each height field cell overlapping shape B as a smooth segment and reduce the results to a single manifold
+static b2Manifold b2CollideHeightfield(const b2Heightfield* heightfieldA, b2Transform xfA, const void* shapeB, b2ShapeType typeB,
+									   b2Transform xfB, b2DistanceCache* cache)
+{
+	b2MeshManifold meshManifold;
+	meshManifold.manifold = b2_emptyManifold;
+	meshManifold.faceNormal = false;
+
+	b2AABB box = b2ComputeLocalAABB(shapeB, typeB, b2InvMulTransforms(xfA, xfB));
+
+	int32_t first, last;
+	if (b2GetHeightfieldCellRange(heightfieldA, box, &first, &last) == false)
+	{
+		return meshManifold.manifold;
+	}
+
+	for (int32_t cell = first; cell <= last; ++cell)
+	{
+		b2SmoothSegment smoothSegment = b2GetHeightfieldSegment(heightfieldA, cell);
+		b2CollideSegmentPiece(&meshManifold, &smoothSegment, cell, xfA, shapeB, typeB, xfB, cache);
+	}
+
+	return meshManifold.manifold;
+}
+
+b2Manifold b2CollideHeightfieldAndCircle(const b2Heightfield* heightfieldA, b2Transform xfA, const b2Circle* circleB,
+										 b2Transform xfB)
+{
+	return b2CollideHeightfield(heightfieldA, xfA, circleB, b2_circleShape, xfB, NULL);
+}
+
+b2Manifold b2CollideHeightfieldAndCapsule(const b2Heightfield* heightfieldA, b2Transform xfA, const b2Capsule* capsuleB,
+										  b2Transform xfB, b2DistanceCache* cache)
+{
+	return b2CollideHeightfield(heightfieldA, xfA, capsuleB, b2_capsuleShape, xfB, cache);
+}
+
+b2Manifold b2CollideHeightfieldAndPolygon(const b2Heightfield* heightfieldA, b2Transform xfA, const b2Polygon* polygonB,
+										  b2Transform xfB, b2DistanceCache* cache)
+{
+	return b2CollideHeightfield(heightfieldA, xfA, polygonB, b2_polygonShape, xfB, cache);
+}
+
+typedef struct b2SmoothChainContext
+{
+	b2MeshManifold manifold;
+	const b2SmoothChain* chain;
+	b2Transform xfA, xfB;
+	const void* shapeB;
+	b2ShapeType typeB;
+	b2DistanceCache* cache;
+} b2SmoothChainContext;
+
+static bool b2SmoothChainQueryCallback(int32_t proxyId, int32_t segmentIndex, void* context)
+{
+	B2_MAYBE_UNUSED(proxyId);
+
+	b2SmoothChainContext* chainContext = context;
+	b2SmoothSegment smoothSegment = b2GetSmoothChainSegment(chainContext->chain, segmentIndex);
+	b2CollideSegmentPiece(&chainContext->manifold, &smoothSegment, segmentIndex, chainContext->xfA, chainContext->shapeB,
+						  chainContext->typeB, chainContext->xfB, chainContext->cache);
+	return true;
+}
+
+// Collide the chain segments found in the segment tree and reduce the results to a single manifold
+static b2Manifold b2CollideSmoothChain(const b2SmoothChain* chainA, b2Transform xfA, const void* shapeB, b2ShapeType typeB,
+									   b2Transform xfB, b2DistanceCache* cache)
+{
+	b2SmoothChainContext context;
+	context.manifold.manifold = b2_emptyManifold;
+	context.manifold.faceNormal = false;
+	context.chain = chainA;
+	context.xfA = xfA;
+	context.xfB = xfB;
+	context.shapeB = shapeB;
+	context.typeB = typeB;
+	context.cache = cache;
+
+	b2AABB box = b2ComputeLocalAABB(shapeB, typeB, b2InvMulTransforms(xfA, xfB));
+	b2DynamicTree_Query(&chainA->tree, box, b2SmoothChainQueryCallback, &context);
+	return context.manifold.manifold;
+}
+
+b2Manifold b2CollideSmoothChainAndCircle(const b2SmoothChain* chainA, b2Transform xfA, const b2Circle* circleB, b2Transform xfB)
+{
+	return b2CollideSmoothChain(chainA, xfA, circleB, b2_circleShape, xfB, NULL);
+}
+
+b2Manifold b2CollideSmoothChainAndCapsule(const b2SmoothChain* chainA, b2Transform xfA, const b2Capsule* capsuleB,
+										  b2Transform xfB, b2DistanceCache* cache)
+{
+	return b2CollideSmoothChain(chainA, xfA, capsuleB, b2_capsuleShape, xfB, cache);
+}
+
+b2Manifold b2CollideSmoothChainAndPolygon(const b2SmoothChain* chainA, b2Transform xfA, const b2Polygon* polygonB,
+										  b2Transform xfB, b2DistanceCache* cache)
+{
+	return b2CollideSmoothChain(chainA, xfA, polygonB, b2_polygonShape, xfB, cache);
+}
@@ -77,3 +77,93 @@ b2Vec2 b2GetLengthAndNormalize(float* length, b2Vec2 v)
 	b2Vec2 n = {invLength * v.x, invLength * v.y};
 	return n;
 }
+
+// These only use add, subtract, multiply, divide, and floor. They are correctly rounded by IEEE 754 on
+// all supported platforms, so the results are bitwise identical as long as the compiler does not fuse
+// operations. BOX2D_STRICT_DETERMINISM turns that off.
+
+// pi / 2 split in two. The high part has few bits so that k * hi is exact for a large range of k.
+#define B2_HALF_PI_HI 1.5703125f
+#define B2_HALF_PI_LO 4.8382679e-4f
+
+b2Rot b2ComputeRot(float angle)
+{
+	// Reduce to [-pi/4, pi/4] and a quadrant
+	float k = floorf(0.63661977f * angle + 0.5f);
+	float x = (angle - k * B2_HALF_PI_HI) - k * B2_HALF_PI_LO;
+	int quadrant = (int)(k - 4.0f * floorf(0.25f * k));
+
+	// Taylor series are accurate to float precision on this range
+	float x2 = x * x;
+	float s = x + x * x2 * (-1.6666667e-1f + x2 * (8.3333333e-3f + x2 * (-1.9841270e-4f + x2 * 2.7557319e-6f)));
+	float c = 1.0f + x2 * (-0.5f + x2 * (4.1666667e-2f + x2 * (-1.3888889e-3f + x2 * 2.4801587e-5f)));
+
+	b2Rot q;
+	switch (quadrant)
+	{
+		case 0:
+			q.s = s;
+			q.c = c;
+			break;
+
+		case 1:
+			q.s = c;
+			q.c = -s;
+			break;
+
+		case 2:
+			q.s = -s;
+			q.c = -c;
+			break;
+
+		default:
+			q.s = -c;
+			q.c = s;
+			break;
+	}
+
+	return q;
+}
+
+float b2Atan2(float y, float x)
+{
+	float ax = B2_ABS(x);
+	float ay = B2_ABS(y);
+	float mx = B2_MAX(ax, ay);
+	float mn = B2_MIN(ax, ay);
+	if (mx == 0.0f)
+	{
+		return 0.0f;
+	}
+
+	// Reduce to [0, 1] then to [-tan(pi/8), tan(pi/8)] using atan(a) = pi/4 + atan((a - 1) / (a + 1))
+	float a = mn / mx;
+	float r = 0.0f;
+	if (a > 0.41421356f)
+	{
+		a = (a - 1.0f) / (a + 1.0f);
+		r = 0.25f * b2_pi;
+	}
+
+	float a2 = a * a;
+	float p = -0.076923077f + a2 * 0.066666667f;
+	p = 0.090909091f + a2 * p;
+	p = -0.11111111f + a2 * p;
+	p = 0.14285714f + a2 * p;
+	p = -0.2f + a2 * p;
+	p = 0.33333333f + a2 * p;
+	r += a - a * a2 * p;
+
+	// Map to the full circle
+	if (ay > ax)
+	{
+		r = 0.5f * b2_pi - r;
+	}
+
+	if (x < 0.0f)
+	{
+		r = b2_pi - r;
+	}
+
+	return y < 0.0f ? -r : r;
+}
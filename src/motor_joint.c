@@ -34,24 +34,24 @@ void b2PrepareMotorJoint(b2Joint* base, b2StepContext* context)
 	B2_ASSERT(0 <= indexA && indexA < context->bodyCapacity);
 	B2_ASSERT(0 <= indexB && indexB < context->bodyCapacity);
 
-	b2Body* bodyA = context->bodies + indexA;
-	b2Body* bodyB = context->bodies + indexB;
-	B2_ASSERT(bodyA->object.index == bodyA->object.next);
-	B2_ASSERT(bodyB->object.index == bodyB->object.next);
+	b2BodySim* bodySimA = context->bodySims + indexA;
+	b2BodySim* bodySimB = context->bodySims + indexB;
+	B2_ASSERT(b2ObjectValid(&context->bodies[indexA].object));
+	B2_ASSERT(b2ObjectValid(&context->bodies[indexB].object));
 
-	float mA = bodyA->invMass;
-	float iA = bodyA->invI;
-	float mB = bodyB->invMass;
-	float iB = bodyB->invI;
+	float mA = bodySimA->invMass;
+	float iA = bodySimA->invI;
+	float mB = bodySimB->invMass;
+	float iB = bodySimB->invI;
 
 	b2MotorJoint* joint = &base->motorJoint;
 	joint->indexA = context->bodyToSolverMap[indexA];
 	joint->indexB = context->bodyToSolverMap[indexB];
 
-	joint->rA = b2RotateVector(bodyA->transform.q, b2Sub(base->localAnchorA, bodyA->localCenter));
-	joint->rB = b2RotateVector(bodyB->transform.q, b2Sub(base->localAnchorB, bodyB->localCenter));
-	joint->linearSeparation = b2Sub(b2Add(b2Sub(joint->rB, joint->rA), b2Sub(bodyB->position, bodyA->position)), joint->linearOffset);
-	joint->angularSeparation = bodyB->angle - bodyA->angle - joint->angularOffset;
+	joint->rA = b2RotateVector(bodySimA->transform.q, b2Sub(base->localAnchorA, bodySimA->localCenter));
+	joint->rB = b2RotateVector(bodySimB->transform.q, b2Sub(base->localAnchorB, bodySimB->localCenter));
+	joint->linearSeparation = b2Sub(b2Add(b2Sub(joint->rB, joint->rA), b2Sub(bodySimB->position, bodySimA->position)), joint->linearOffset);
+	joint->angularSeparation = bodySimB->angle - bodySimA->angle - joint->angularOffset;
 
 	b2Vec2 rA = joint->rA;
 	b2Vec2 rB = joint->rB;
@@ -43,17 +43,17 @@ void b2PrepareMouseJoint(b2Joint* base, b2StepContext* context)
 	int32_t indexB = base->edges[1].bodyIndex;
 	B2_ASSERT(0 <= indexB && indexB < context->bodyCapacity);
 
-	b2Body* bodyB = context->bodies + indexB;
-	B2_ASSERT(bodyB->object.index == bodyB->object.next);
+	b2BodySim* bodySimB = context->bodySims + indexB;
+	B2_ASSERT(b2ObjectValid(&context->bodies[indexB].object));
 
 	b2MouseJoint* joint = &base->mouseJoint;
 	joint->indexB = context->bodyToSolverMap[indexB];
-	joint->localCenterB = bodyB->localCenter;
+	joint->localCenterB = bodySimB->localCenter;
 
-	b2Vec2 cB = bodyB->position;
-	b2Rot qB = bodyB->transform.q;
-	float mB = bodyB->invMass;
-	float iB = bodyB->invI;
+	b2Vec2 cB = bodySimB->position;
+	b2Rot qB = bodySimB->transform.q;
+	float mB = bodySimB->invMass;
+	float iB = bodySimB->invI;
 
 	float d = joint->damping;
 	float k = joint->stiffness;
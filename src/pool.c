@@ -35,15 +35,17 @@ void b2ValidatePool(const b2Pool* pool)
 #endif
 }
 
-b2Pool b2CreatePool(int32_t objectSize, int32_t capacity)
+b2Pool b2CreatePool(b2Allocator* allocator, int32_t objectSize, int32_t capacity)
 {
 	B2_ASSERT(objectSize >= (int32_t)sizeof(b2Object));
 
 	b2Pool pool;
+	pool.allocator = allocator;
 	pool.objectSize = objectSize;
 	pool.capacity = capacity > 1 ? capacity : 1;
 	pool.count = 0;
-	pool.memory = (char*)b2Alloc(pool.capacity * objectSize);
+	pool.baseRevision = 0;
+	pool.memory = (char*)b2Alloc(allocator, pool.capacity * objectSize);
 
 	pool.freeList = 0;
 	for (int32_t i = 0; i < pool.capacity - 1; ++i)
@@ -64,7 +66,7 @@ b2Pool b2CreatePool(int32_t objectSize, int32_t capacity)
 
 void b2DestroyPool(b2Pool* pool)
 {
-	b2Free(pool->memory, pool->capacity * pool->objectSize);
+	b2Free(pool->allocator, pool->memory, pool->capacity * pool->objectSize);
 	pool->memory = NULL;
 	pool->capacity = 0;
 	pool->count = 0;
@@ -82,9 +84,9 @@ void b2GrowPool(b2Pool* pool, int32_t capacity)
 
 	int32_t newCapacity = capacity > 2 ? capacity : 2;
 	pool->capacity = newCapacity;
-	char* newMemory = (char*)b2Alloc(pool->capacity * pool->objectSize);
+	char* newMemory = (char*)b2Alloc(pool->allocator, pool->capacity * pool->objectSize);
 	memcpy(newMemory, pool->memory, oldCapacity * pool->objectSize);
-	b2Free(pool->memory, oldCapacity * pool->objectSize);
+	b2Free(pool->allocator, pool->memory, oldCapacity * pool->objectSize);
 	pool->memory = newMemory;
 
 	int32_t oldFreeList = pool->freeList;
@@ -94,14 +96,14 @@ void b2GrowPool(b2Pool* pool, int32_t capacity)
 		b2Object* object = (b2Object*)(pool->memory + i * pool->objectSize);
 		object->index = i;
 		object->next = i + 1;
-		object->revision = 0;
+		object->revision = pool->baseRevision;
 	}
 
 	// Tail of free list
 	b2Object* object = (b2Object*)(pool->memory + (newCapacity - 1) * pool->objectSize);
 	object->index = newCapacity - 1;
 	object->next = oldFreeList;
-	object->revision = 0;
+	object->revision = pool->baseRevision;
 
 #if B2_VALIDATE
 	b2ValidatePool(pool);
@@ -127,14 +129,14 @@ b2Object* b2AllocObject(b2Pool* pool)
 		int32_t addedCapacity = B2_MAX(2, oldCapacity / 2);
 		int32_t newCapacity = B2_MAX(2, oldCapacity + addedCapacity);
 		pool->capacity = newCapacity;
-		char* newMemory = (char*)b2Alloc(pool->capacity * pool->objectSize);
+		char* newMemory = (char*)b2Alloc(pool->allocator, pool->capacity * pool->objectSize);
 		memcpy(newMemory, pool->memory, oldCapacity * pool->objectSize);
-		b2Free(pool->memory, oldCapacity * pool->objectSize);
+		b2Free(pool->allocator, pool->memory, oldCapacity * pool->objectSize);
 		pool->memory = newMemory;
 
 		newObject = (b2Object*)(pool->memory + oldCapacity * pool->objectSize);
 		newObject->index = oldCapacity;
-		newObject->revision = 0;
+		newObject->revision = pool->baseRevision;
 		newObject->next = newObject->index;
 
 		// This assumes added capacity >= 2
@@ -144,13 +146,13 @@ b2Object* b2AllocObject(b2Pool* pool)
 			b2Object* object = (b2Object*)(pool->memory + i * pool->objectSize);
 			object->index = i;
 			object->next = i + 1;
-			object->revision = 0;
+			object->revision = pool->baseRevision;
 		}
 
 		b2Object* object = (b2Object*)(pool->memory + (newCapacity - 1) * pool->objectSize);
 		object->index = newCapacity - 1;
 		object->next = B2_NULL_INDEX;
-		object->revision = 0;
+		object->revision = pool->baseRevision;
 
 		pool->count += 1;
 
@@ -162,6 +164,62 @@ b2Object* b2AllocObject(b2Pool* pool)
 	}
 }
 
+bool b2ShrinkPool(b2Pool* pool, bool sortFreeList)
+{
+	int32_t objectSize = pool->objectSize;
+	int32_t oldCapacity = pool->capacity;
+
+	int32_t needed = oldCapacity;
+	while (needed > 0 && b2ObjectValid((b2Object*)(pool->memory + (needed - 1) * objectSize)) == false)
+	{
+		needed -= 1;
+	}
+
+	int32_t newCapacity = b2GetShrinkCapacity(oldCapacity, needed, 2);
+	bool moved = newCapacity < oldCapacity;
+
+	if (moved)
+	{
+		// Keep the trimmed revisions so a regrown slot starts above any id handed out for it
+		for (int32_t i = newCapacity; i < oldCapacity; ++i)
+		{
+			b2Object* object = (b2Object*)(pool->memory + i * objectSize);
+			if (object->revision >= pool->baseRevision)
+			{
+				pool->baseRevision = object->revision + 1;
+			}
+		}
+
+		char* newMemory = (char*)b2Alloc(pool->allocator, newCapacity * objectSize);
+		memcpy(newMemory, pool->memory, newCapacity * objectSize);
+		b2Free(pool->allocator, pool->memory, oldCapacity * objectSize);
+		pool->memory = newMemory;
+		pool->capacity = newCapacity;
+	}
+
+	if (moved || sortFreeList)
+	{
+		// Link the free slots in reverse so the list is in index order. Revisions are kept.
+		pool->freeList = B2_NULL_INDEX;
+		for (int32_t i = pool->capacity - 1; i >= 0; --i)
+		{
+			b2Object* object = (b2Object*)(pool->memory + i * objectSize);
+			if (b2ObjectValid(object) == false)
+			{
+				object->index = i;
+				object->next = pool->freeList;
+				pool->freeList = i;
+			}
+		}
+	}
+
+#if B2_VALIDATE
+	b2ValidatePool(pool);
+#endif
+
+	return moved;
+}
+
 void b2FreeObject(b2Pool* pool, b2Object* object)
 {
 	B2_ASSERT(pool->memory <= (char*)object && (char*)object < pool->memory + pool->capacity * pool->objectSize);
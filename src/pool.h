@@ -20,14 +20,19 @@ typedef struct b2Object
 
 typedef struct b2Pool
 {
+	b2Allocator* allocator;
 	char* memory;
 	int32_t objectSize;
 	int32_t capacity;
 	int32_t count;
 	int32_t freeList;
+
+	// First revision for slots added by growth. Raised when slots are trimmed so stale ids
+	// for trimmed slots cannot match objects created after the pool grows again.
+	uint16_t baseRevision;
 } b2Pool;
 
-b2Pool b2CreatePool(int32_t objectSize, int32_t capacity);
+b2Pool b2CreatePool(b2Allocator* allocator, int32_t objectSize, int32_t capacity);
 void b2DestroyPool(b2Pool* pool);
 
 b2Object* b2AllocObject(b2Pool* pool);
@@ -35,6 +40,12 @@ void b2FreeObject(b2Pool* pool, b2Object* object);
 
 void b2GrowPool(b2Pool* pool, int32_t capacity);
 
+// Release free slots at the end of the pool. Live objects never move, so this is limited by the
+// highest live index. The free list is rebuilt in index order if the pool shrinks or if requested,
+// which makes new objects fill the lowest free slots first. Trimmed revisions carry over to the
+// slots added by later growth. Returns true if the memory moved.
+bool b2ShrinkPool(b2Pool* pool, bool sortFreeList);
+
 static inline bool b2ObjectValid(const b2Object* object)
 {
 	// this means the object is not on the free list
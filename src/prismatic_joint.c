@@ -64,34 +64,34 @@ void b2PreparePrismaticJoint(b2Joint* base, b2StepContext* context)
 
 	int32_t indexA = base->edges[0].bodyIndex;
 	int32_t indexB = base->edges[1].bodyIndex;
-	b2Body* bodyA = context->bodies + indexA;
-	b2Body* bodyB = context->bodies + indexB;
+	b2BodySim* bodySimA = context->bodySims + indexA;
+	b2BodySim* bodySimB = context->bodySims + indexB;
 
-	B2_ASSERT(b2ObjectValid(&bodyA->object));
-	B2_ASSERT(b2ObjectValid(&bodyB->object));
+	B2_ASSERT(b2ObjectValid(&context->bodies[indexA].object));
+	B2_ASSERT(b2ObjectValid(&context->bodies[indexB].object));
 
 	b2PrismaticJoint* joint = &base->prismaticJoint;
 
 	joint->indexA = context->bodyToSolverMap[indexA];
 	joint->indexB = context->bodyToSolverMap[indexB];
 
-	float mA = bodyA->invMass;
-	float iA = bodyA->invI;
-	float mB = bodyB->invMass;
-	float iB = bodyB->invI;
+	float mA = bodySimA->invMass;
+	float iA = bodySimA->invI;
+	float mB = bodySimB->invMass;
+	float iB = bodySimB->invI;
 
-	float angleA = bodyA->angle;
-	float angleB = bodyB->angle;
-	b2Rot qA = bodyA->transform.q;
-	b2Rot qB = bodyB->transform.q;
+	float angleA = bodySimA->angle;
+	float angleB = bodySimB->angle;
+	b2Rot qA = bodySimA->transform.q;
+	b2Rot qB = bodySimB->transform.q;
 
 	// Compute the effective masses.
-	b2Vec2 rA = b2RotateVector(qA, b2Sub(base->localAnchorA, bodyA->localCenter));
-	b2Vec2 rB = b2RotateVector(qB, b2Sub(base->localAnchorB, bodyB->localCenter));
+	b2Vec2 rA = b2RotateVector(qA, b2Sub(base->localAnchorA, bodySimA->localCenter));
+	b2Vec2 rB = b2RotateVector(qB, b2Sub(base->localAnchorB, bodySimB->localCenter));
 
 	joint->rA = rA;
 	joint->rB = rB;
-	b2Vec2 d = b2Add(b2Sub(bodyB->position, bodyA->position), b2Sub(rB, rA));
+	b2Vec2 d = b2Add(b2Sub(bodySimB->position, bodySimA->position), b2Sub(rB, rA));
 	joint->pivotSeparation = d;
 	joint->angleSeparation = angleB - angleA - joint->referenceAngle;
 
@@ -507,14 +507,14 @@ void b2PrismaticJoint::Dump()
 }
 #endif
 
-void b2DrawPrismatic(b2DebugDraw* draw, b2Joint* base, b2Body* bodyA, b2Body* bodyB)
+void b2DrawPrismatic(b2DebugDraw* draw, b2Joint* base, b2BodySim* bodySimA, b2BodySim* bodySimB)
 {
 	B2_ASSERT(base->type == b2_prismaticJoint);
 
 	b2PrismaticJoint* joint = &base->prismaticJoint;
 
-	b2Transform xfA = bodyA->transform;
-	b2Transform xfB = bodyB->transform;
+	b2Transform xfA = bodySimA->transform;
+	b2Transform xfB = bodySimB->transform;
 	b2Vec2 pA = b2TransformPoint(xfA, base->localAnchorA);
 	b2Vec2 pB = b2TransformPoint(xfB, base->localAnchorB);
 
@@ -34,22 +34,22 @@ void b2PrepareRevoluteJoint(b2Joint* base, b2StepContext* context)
 
 	int32_t indexA = base->edges[0].bodyIndex;
 	int32_t indexB = base->edges[1].bodyIndex;
-	b2Body* bodyA = context->bodies + indexA;
-	b2Body* bodyB = context->bodies + indexB;
-	B2_ASSERT(b2ObjectValid(&bodyA->object));
-	B2_ASSERT(b2ObjectValid(&bodyB->object));
+	b2BodySim* bodySimA = context->bodySims + indexA;
+	b2BodySim* bodySimB = context->bodySims + indexB;
+	B2_ASSERT(b2ObjectValid(&context->bodies[indexA].object));
+	B2_ASSERT(b2ObjectValid(&context->bodies[indexB].object));
 
-	float mA = bodyA->invMass;
-	float iA = bodyA->invI;
-	float mB = bodyB->invMass;
-	float iB = bodyB->invI;
+	float mA = bodySimA->invMass;
+	float iA = bodySimA->invI;
+	float mB = bodySimB->invMass;
+	float iB = bodySimB->invI;
 
 	b2RevoluteJoint* joint = &base->revoluteJoint;
 
 	joint->indexA = context->bodyToSolverMap[indexA];
 	joint->indexB = context->bodyToSolverMap[indexB];
-	joint->angleA = bodyA->angle;
-	joint->angleB = bodyB->angle;
+	joint->angleA = bodySimA->angle;
+	joint->angleB = bodySimB->angle;
 
 	joint->axialMass = iA + iB;
 	bool fixedRotation;
@@ -63,9 +63,9 @@ void b2PrepareRevoluteJoint(b2Joint* base, b2StepContext* context)
 		fixedRotation = true;
 	}
 
-	joint->rA = b2RotateVector(bodyA->transform.q, b2Sub(base->localAnchorA, bodyA->localCenter));
-	joint->rB = b2RotateVector(bodyB->transform.q, b2Sub(base->localAnchorB, bodyB->localCenter));
-	joint->separation = b2Add(b2Sub(joint->rB, joint->rA), b2Sub(bodyB->position, bodyA->position));
+	joint->rA = b2RotateVector(bodySimA->transform.q, b2Sub(base->localAnchorA, bodySimA->localCenter));
+	joint->rB = b2RotateVector(bodySimB->transform.q, b2Sub(base->localAnchorB, bodySimB->localCenter));
+	joint->separation = b2Add(b2Sub(joint->rB, joint->rA), b2Sub(bodySimB->position, bodySimA->position));
 
 	b2Vec2 rA = joint->rA;
 	b2Vec2 rB = joint->rB;
@@ -426,14 +426,14 @@ void b2RevoluteJoint::Dump()
 }
 #endif
 
-void b2DrawRevolute(b2DebugDraw* draw, b2Joint* base, b2Body* bodyA, b2Body* bodyB)
+void b2DrawRevolute(b2DebugDraw* draw, b2Joint* base, b2BodySim* bodySimA, b2BodySim* bodySimB)
 {
 	B2_ASSERT(base->type == b2_revoluteJoint);
 
 	b2RevoluteJoint* joint = &base->revoluteJoint;
 
-	b2Transform xfA = bodyA->transform;
-	b2Transform xfB = bodyB->transform;
+	b2Transform xfA = bodySimA->transform;
+	b2Transform xfB = bodySimB->transform;
 	b2Vec2 pA = b2TransformPoint(xfA, base->localAnchorA);
 	b2Vec2 pB = b2TransformPoint(xfB, base->localAnchorB);
 
@@ -446,8 +446,8 @@ void b2DrawRevolute(b2DebugDraw* draw, b2Joint* base, b2Body* bodyA, b2Body* bod
 	draw->DrawPoint(pA, 5.0f, c4, draw->context);
 	draw->DrawPoint(pB, 5.0f, c5, draw->context);
 
-	float aA = bodyA->angle;
-	float aB = bodyB->angle;
+	float aA = bodySimA->angle;
+	float aB = bodySimB->angle;
 	float angle = aB - aA - joint->referenceAngle;
 
 	const float L = base->drawSize;
@@ -0,0 +1,689 @@
+// SPDX-FileCopyrightText: 2023 Erin Catto
+// SPDX-License-Identifier: MIT
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+// For pthread_setaffinity_np
+#define _GNU_SOURCE
+#endif
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "scheduler.h"
+
+#include "allocate.h"
+#include "core.h"
+
+#include "box2d/constants.h"
+#include "box2d/math.h"
+
+#include "x86/sse2.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <string.h>
+
+#if defined(_WIN32)
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <windows.h>
+
+typedef SRWLOCK b2Mutex;
+typedef CONDITION_VARIABLE b2Condition;
+typedef HANDLE b2Thread;
+
+static void b2InitMutex(b2Mutex* mutex)
+{
+	InitializeSRWLock(mutex);
+}
+
+static void b2DestroyMutex(b2Mutex* mutex)
+{
+	B2_MAYBE_UNUSED(mutex);
+}
+
+static void b2LockMutex(b2Mutex* mutex)
+{
+	AcquireSRWLockExclusive(mutex);
+}
+
+static void b2UnlockMutex(b2Mutex* mutex)
+{
+	ReleaseSRWLockExclusive(mutex);
+}
+
+static void b2InitCondition(b2Condition* condition)
+{
+	InitializeConditionVariable(condition);
+}
+
+static void b2DestroyCondition(b2Condition* condition)
+{
+	B2_MAYBE_UNUSED(condition);
+}
+
+static void b2WaitCondition(b2Condition* condition, b2Mutex* mutex)
+{
+	SleepConditionVariableSRW(condition, mutex, INFINITE, 0);
+}
+
+static void b2WakeAll(b2Condition* condition)
+{
+	WakeAllConditionVariable(condition);
+}
+
+#else
+
+#include <pthread.h>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+typedef pthread_mutex_t b2Mutex;
+typedef pthread_cond_t b2Condition;
+typedef pthread_t b2Thread;
+
+static void b2InitMutex(b2Mutex* mutex)
+{
+	pthread_mutex_init(mutex, NULL);
+}
+
+static void b2DestroyMutex(b2Mutex* mutex)
+{
+	pthread_mutex_destroy(mutex);
+}
+
+static void b2LockMutex(b2Mutex* mutex)
+{
+	pthread_mutex_lock(mutex);
+}
+
+static void b2UnlockMutex(b2Mutex* mutex)
+{
+	pthread_mutex_unlock(mutex);
+}
+
+static void b2InitCondition(b2Condition* condition)
+{
+	pthread_cond_init(condition, NULL);
+}
+
+static void b2DestroyCondition(b2Condition* condition)
+{
+	pthread_cond_destroy(condition);
+}
+
+static void b2WaitCondition(b2Condition* condition, b2Mutex* mutex)
+{
+	pthread_cond_wait(condition, mutex);
+}
+
+static void b2WakeAll(b2Condition* condition)
+{
+	pthread_cond_broadcast(condition);
+}
+
+#endif
+
+// Box2D has a handful of tasks in flight at once plus one solver task per worker
+#define B2_SCHEDULER_TASK_CAPACITY (2 * b2_maxWorkers + 32)
+
+// Ranges per deque. Enqueue runs the task inline if all deques are full.
+#define B2_DEQUE_CAPACITY 256
+
+// How many times an idle worker checks for work before going to sleep
+#define B2_WORKER_SPIN_COUNT 1000
+
+typedef struct b2SchedulerTask
+{
+	b2TaskCallback* fcn;
+	void* context;
+
+	// Ranges that have not finished executing
+	_Atomic int32_t remaining;
+
+	// Only accessed by the thread that enqueues and finishes tasks
+	bool inUse;
+} b2SchedulerTask;
+
+typedef struct b2TaskRange
+{
+	b2SchedulerTask* task;
+	int32_t startIndex;
+	int32_t endIndex;
+} b2TaskRange;
+
+// The owner pops from the bottom and thieves steal from the top. A lock is simpler than a
+// lock-free deque and the ranges are coarse enough that contention is low.
+typedef struct b2Deque
+{
+	b2Mutex mutex;
+	int32_t top;
+	int32_t bottom;
+	b2TaskRange ranges[B2_DEQUE_CAPACITY];
+} b2Deque;
+
+typedef enum b2MainTaskState
+{
+	b2_mainTaskIdle,
+	b2_mainTaskPending,
+	b2_mainTaskFinished,
+} b2MainTaskState;
+
+typedef struct b2Worker
+{
+	b2Thread thread;
+	struct b2Scheduler* scheduler;
+	int32_t workerIndex;
+} b2Worker;
+
+typedef struct b2Scheduler
+{
+	b2Allocator* allocator;
+	int32_t workerCount;
+
+	// One deque per worker, including worker 0 which is the calling thread
+	b2Deque* deques;
+
+	// Background threads for workers [1, workerCount)
+	b2Worker* workers;
+
+	b2SchedulerTask tasks[B2_SCHEDULER_TASK_CAPACITY];
+	int32_t nextTask;
+	int32_t nextDeque;
+	bool pinThreads;
+
+	// Ranges waiting in the deques
+	_Atomic int32_t pendingCount;
+	_Atomic bool running;
+
+	b2Mutex sleepMutex;
+	b2Condition sleepCondition;
+
+	// Optional thread that runs a task as worker 0, used for asynchronous steps.
+	// Created on first use.
+	b2Worker mainWorker;
+	bool hasMainThread;
+	b2TaskCallback* mainTask;
+	void* mainContext;
+	b2MainTaskState mainState;
+	b2Mutex mainMutex;
+	b2Condition mainCondition;
+} b2Scheduler;
+
+static bool b2PushRange(b2Deque* deque, b2TaskRange range)
+{
+	b2LockMutex(&deque->mutex);
+	bool pushed = deque->bottom - deque->top < B2_DEQUE_CAPACITY;
+	if (pushed)
+	{
+		deque->ranges[deque->bottom % B2_DEQUE_CAPACITY] = range;
+		deque->bottom += 1;
+	}
+	b2UnlockMutex(&deque->mutex);
+	return pushed;
+}
+
+static bool b2PopRange(b2Deque* deque, b2TaskRange* range)
+{
+	b2LockMutex(&deque->mutex);
+	bool popped = deque->bottom > deque->top;
+	if (popped)
+	{
+		deque->bottom -= 1;
+		*range = deque->ranges[deque->bottom % B2_DEQUE_CAPACITY];
+	}
+	b2UnlockMutex(&deque->mutex);
+	return popped;
+}
+
+static bool b2StealRange(b2Deque* deque, b2TaskRange* range)
+{
+	b2LockMutex(&deque->mutex);
+	bool stolen = deque->bottom > deque->top;
+	if (stolen)
+	{
+		*range = deque->ranges[deque->top % B2_DEQUE_CAPACITY];
+		deque->top += 1;
+
+		// Keep the indices small
+		if (deque->top == deque->bottom)
+		{
+			deque->top = 0;
+			deque->bottom = 0;
+		}
+	}
+	b2UnlockMutex(&deque->mutex);
+	return stolen;
+}
+
+// Execute one range from this worker's deque or one stolen from another worker
+static bool b2ExecuteRange(b2Scheduler* scheduler, int32_t workerIndex)
+{
+	if (atomic_load_explicit(&scheduler->pendingCount, memory_order_acquire) <= 0)
+	{
+		return false;
+	}
+
+	int32_t workerCount = scheduler->workerCount;
+	b2TaskRange range;
+	bool found = b2PopRange(scheduler->deques + workerIndex, &range);
+	for (int32_t i = 1; i < workerCount && found == false; ++i)
+	{
+		int32_t victimIndex = (workerIndex + i) % workerCount;
+		found = b2StealRange(scheduler->deques + victimIndex, &range);
+	}
+
+	if (found == false)
+	{
+		return false;
+	}
+
+	atomic_fetch_sub_explicit(&scheduler->pendingCount, 1, memory_order_relaxed);
+
+	b2SchedulerTask* task = range.task;
+	task->fcn(range.startIndex, range.endIndex, (uint32_t)workerIndex, task->context);
+
+	// The task may be recycled as soon as this reaches zero
+	atomic_fetch_sub_explicit(&task->remaining, 1, memory_order_release);
+	return true;
+}
+
+static void b2WorkerLoop(b2Worker* worker)
+{
+	b2Scheduler* scheduler = worker->scheduler;
+	int32_t workerIndex = worker->workerIndex;
+
+	while (atomic_load_explicit(&scheduler->running, memory_order_relaxed))
+	{
+		if (b2ExecuteRange(scheduler, workerIndex))
+		{
+			continue;
+		}
+
+		// Box2D enqueues many small tasks per step with some serial work in between.
+		// Spin a bit before sleeping to keep the wake latency low.
+		int32_t spinCount = 0;
+		while (spinCount < B2_WORKER_SPIN_COUNT && atomic_load_explicit(&scheduler->pendingCount, memory_order_relaxed) <= 0)
+		{
+			simde_mm_pause();
+			spinCount += 1;
+		}
+
+		if (spinCount < B2_WORKER_SPIN_COUNT)
+		{
+			continue;
+		}
+
+		b2LockMutex(&scheduler->sleepMutex);
+		while (atomic_load(&scheduler->pendingCount) <= 0 && atomic_load(&scheduler->running))
+		{
+			b2WaitCondition(&scheduler->sleepCondition, &scheduler->sleepMutex);
+		}
+		b2UnlockMutex(&scheduler->sleepMutex);
+	}
+}
+
+static void b2MainLoop(b2Worker* worker)
+{
+	b2Scheduler* scheduler = worker->scheduler;
+
+	b2LockMutex(&scheduler->mainMutex);
+	for (;;)
+	{
+		while (scheduler->mainState != b2_mainTaskPending && atomic_load(&scheduler->running))
+		{
+			b2WaitCondition(&scheduler->mainCondition, &scheduler->mainMutex);
+		}
+
+		if (scheduler->mainState != b2_mainTaskPending)
+		{
+			break;
+		}
+
+		b2UnlockMutex(&scheduler->mainMutex);
+		scheduler->mainTask(0, 1, 0, scheduler->mainContext);
+		b2LockMutex(&scheduler->mainMutex);
+
+		scheduler->mainState = b2_mainTaskFinished;
+		b2WakeAll(&scheduler->mainCondition);
+	}
+	b2UnlockMutex(&scheduler->mainMutex);
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI b2WorkerMain(LPVOID param)
+{
+	b2WorkerLoop(param);
+	return 0;
+}
+
+static DWORD WINAPI b2MainThreadMain(LPVOID param)
+{
+	b2MainLoop(param);
+	return 0;
+}
+#else
+static void* b2WorkerMain(void* param)
+{
+	b2WorkerLoop(param);
+	return NULL;
+}
+
+static void* b2MainThreadMain(void* param)
+{
+	b2MainLoop(param);
+	return NULL;
+}
+#endif
+
+static void b2StartThread(b2Worker* worker, bool isMain)
+{
+#if defined(_WIN32)
+	worker->thread = CreateThread(NULL, 0, isMain ? b2MainThreadMain : b2WorkerMain, worker, 0, NULL);
+	B2_ASSERT(worker->thread != NULL);
+#else
+	int result = pthread_create(&worker->thread, NULL, isMain ? b2MainThreadMain : b2WorkerMain, worker);
+	B2_ASSERT(result == 0);
+	B2_MAYBE_UNUSED(result);
+#endif
+}
+
+// Pin a thread to the n-th core the process may run on. Worker 0 maps to the first core, so background
+// workers start on the second core and the calling thread is likely to have the first to itself.
+// Not all platforms support this, macOS only has affinity hints, so this is best effort.
+static void b2PinThread(b2Worker* worker)
+{
+#if defined(_WIN32)
+	DWORD_PTR processMask, systemMask;
+	if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask) == 0 || processMask == 0)
+	{
+		return;
+	}
+
+	int32_t coreCount = 0;
+	for (DWORD_PTR mask = processMask; mask != 0; mask &= mask - 1)
+	{
+		coreCount += 1;
+	}
+
+	int32_t n = worker->workerIndex % coreCount;
+	DWORD_PTR mask = processMask;
+	for (int32_t i = 0; i < n; ++i)
+	{
+		mask &= mask - 1;
+	}
+
+	// Lowest remaining bit
+	SetThreadAffinityMask(worker->thread, mask & (~mask + 1));
+#elif defined(__linux__)
+	cpu_set_t allowed;
+	if (pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &allowed) != 0)
+	{
+		return;
+	}
+
+	int32_t coreCount = CPU_COUNT(&allowed);
+	if (coreCount == 0)
+	{
+		return;
+	}
+
+	int32_t n = worker->workerIndex % coreCount;
+	for (int32_t cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+	{
+		if (CPU_ISSET(cpu, &allowed) == 0)
+		{
+			continue;
+		}
+
+		if (n == 0)
+		{
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(cpu, &set);
+			pthread_setaffinity_np(worker->thread, sizeof(cpu_set_t), &set);
+			return;
+		}
+
+		n -= 1;
+	}
+#else
+	B2_MAYBE_UNUSED(worker);
+#endif
+}
+
+static void b2JoinThread(b2Worker* worker)
+{
+#if defined(_WIN32)
+	WaitForSingleObject(worker->thread, INFINITE);
+	CloseHandle(worker->thread);
+#else
+	pthread_join(worker->thread, NULL);
+#endif
+}
+
+b2Scheduler* b2CreateScheduler(b2Allocator* allocator, int32_t workerCount, bool pinThreads)
+{
+	B2_ASSERT(0 < workerCount && workerCount <= b2_maxWorkers);
+
+	b2Scheduler* scheduler = b2Alloc(allocator, sizeof(b2Scheduler));
+	memset(scheduler, 0, sizeof(b2Scheduler));
+	scheduler->allocator = allocator;
+	scheduler->workerCount = workerCount;
+	scheduler->pinThreads = pinThreads;
+
+	scheduler->deques = b2Alloc(allocator, workerCount * sizeof(b2Deque));
+	for (int32_t i = 0; i < workerCount; ++i)
+	{
+		b2Deque* deque = scheduler->deques + i;
+		b2InitMutex(&deque->mutex);
+		deque->top = 0;
+		deque->bottom = 0;
+	}
+
+	atomic_store(&scheduler->pendingCount, 0);
+	atomic_store(&scheduler->running, true);
+	b2InitMutex(&scheduler->sleepMutex);
+	b2InitCondition(&scheduler->sleepCondition);
+
+	scheduler->hasMainThread = false;
+	scheduler->mainState = b2_mainTaskIdle;
+	b2InitMutex(&scheduler->mainMutex);
+	b2InitCondition(&scheduler->mainCondition);
+
+	scheduler->workers = b2Alloc(allocator, workerCount * sizeof(b2Worker));
+	for (int32_t i = 1; i < workerCount; ++i)
+	{
+		b2Worker* worker = scheduler->workers + i;
+		worker->scheduler = scheduler;
+		worker->workerIndex = i;
+		b2StartThread(worker, false);
+
+		if (pinThreads)
+		{
+			b2PinThread(worker);
+		}
+	}
+
+	return scheduler;
+}
+
+void b2DestroyScheduler(b2Scheduler* scheduler)
+{
+	B2_ASSERT(scheduler->mainState == b2_mainTaskIdle);
+
+	b2LockMutex(&scheduler->sleepMutex);
+	atomic_store(&scheduler->running, false);
+	b2WakeAll(&scheduler->sleepCondition);
+	b2UnlockMutex(&scheduler->sleepMutex);
+
+	b2LockMutex(&scheduler->mainMutex);
+	b2WakeAll(&scheduler->mainCondition);
+	b2UnlockMutex(&scheduler->mainMutex);
+
+	if (scheduler->hasMainThread)
+	{
+		b2JoinThread(&scheduler->mainWorker);
+	}
+
+	int32_t workerCount = scheduler->workerCount;
+	for (int32_t i = 1; i < workerCount; ++i)
+	{
+		b2JoinThread(scheduler->workers + i);
+	}
+
+	for (int32_t i = 0; i < workerCount; ++i)
+	{
+		b2DestroyMutex(&scheduler->deques[i].mutex);
+	}
+
+	b2DestroyCondition(&scheduler->mainCondition);
+	b2DestroyMutex(&scheduler->mainMutex);
+	b2DestroyCondition(&scheduler->sleepCondition);
+	b2DestroyMutex(&scheduler->sleepMutex);
+
+	b2Allocator* allocator = scheduler->allocator;
+	b2Free(allocator, scheduler->workers, workerCount * sizeof(b2Worker));
+	b2Free(allocator, scheduler->deques, workerCount * sizeof(b2Deque));
+	b2Free(allocator, scheduler, sizeof(b2Scheduler));
+}
+
+static b2SchedulerTask* b2AllocateSchedulerTask(b2Scheduler* scheduler)
+{
+	for (int32_t i = 0; i < B2_SCHEDULER_TASK_CAPACITY; ++i)
+	{
+		int32_t index = (scheduler->nextTask + i) % B2_SCHEDULER_TASK_CAPACITY;
+		b2SchedulerTask* task = scheduler->tasks + index;
+		if (task->inUse == false)
+		{
+			task->inUse = true;
+			scheduler->nextTask = (index + 1) % B2_SCHEDULER_TASK_CAPACITY;
+			return task;
+		}
+	}
+
+	return NULL;
+}
+
+void* b2EnqueueSchedulerTask(b2TaskCallback* task, int32_t itemCount, int32_t minRange, void* taskContext, void* userContext)
+{
+	b2Scheduler* scheduler = userContext;
+	if (itemCount <= 0)
+	{
+		return NULL;
+	}
+
+	b2SchedulerTask* schedulerTask = b2AllocateSchedulerTask(scheduler);
+	if (schedulerTask == NULL)
+	{
+		// This is not fatal but the task capacity should be increased
+		B2_ASSERT(false);
+		task(0, itemCount, 0, taskContext);
+		return NULL;
+	}
+
+	// A few ranges per worker leaves room for stealing to balance uneven work
+	int32_t workerCount = scheduler->workerCount;
+	int32_t maxRangeCount = 4 * workerCount;
+	int32_t rangeSize = B2_MAX(B2_MAX(minRange, 1), (itemCount + maxRangeCount - 1) / maxRangeCount);
+	int32_t rangeCount = (itemCount + rangeSize - 1) / rangeSize;
+
+	schedulerTask->fcn = task;
+	schedulerTask->context = taskContext;
+	atomic_store_explicit(&schedulerTask->remaining, rangeCount, memory_order_relaxed);
+
+	// Count the ranges before they are visible so workers never see a negative count
+	atomic_fetch_add_explicit(&scheduler->pendingCount, rangeCount, memory_order_release);
+
+	int32_t dequeIndex = scheduler->nextDeque;
+	for (int32_t i = 0; i < rangeCount; ++i)
+	{
+		b2TaskRange range;
+		range.task = schedulerTask;
+		range.startIndex = i * rangeSize;
+		range.endIndex = B2_MIN(range.startIndex + rangeSize, itemCount);
+
+		// Spread the ranges over the deques. Try the other deques if this one is full.
+		bool pushed = false;
+		for (int32_t j = 0; j < workerCount && pushed == false; ++j)
+		{
+			pushed = b2PushRange(scheduler->deques + dequeIndex, range);
+			dequeIndex = (dequeIndex + 1) % workerCount;
+		}
+
+		if (pushed == false)
+		{
+			atomic_fetch_sub_explicit(&scheduler->pendingCount, 1, memory_order_relaxed);
+			task(range.startIndex, range.endIndex, 0, taskContext);
+			atomic_fetch_sub_explicit(&schedulerTask->remaining, 1, memory_order_release);
+		}
+	}
+	scheduler->nextDeque = dequeIndex;
+
+	b2LockMutex(&scheduler->sleepMutex);
+	b2WakeAll(&scheduler->sleepCondition);
+	b2UnlockMutex(&scheduler->sleepMutex);
+
+	return schedulerTask;
+}
+
+void b2FinishSchedulerTask(void* userTask, void* userContext)
+{
+	b2Scheduler* scheduler = userContext;
+	b2SchedulerTask* task = userTask;
+	B2_ASSERT(task->inUse);
+
+	// Help out instead of blocking
+	while (atomic_load_explicit(&task->remaining, memory_order_acquire) > 0)
+	{
+		if (b2ExecuteRange(scheduler, 0) == false)
+		{
+			simde_mm_pause();
+		}
+	}
+
+	task->inUse = false;
+}
+
+void b2StartMainTask(b2Scheduler* scheduler, b2TaskCallback* task, void* taskContext)
+{
+	if (scheduler->hasMainThread == false)
+	{
+		scheduler->mainWorker.scheduler = scheduler;
+		scheduler->mainWorker.workerIndex = 0;
+		b2StartThread(&scheduler->mainWorker, true);
+		scheduler->hasMainThread = true;
+
+		// This thread takes the place of worker 0
+		if (scheduler->pinThreads)
+		{
+			b2PinThread(&scheduler->mainWorker);
+		}
+	}
+
+	b2LockMutex(&scheduler->mainMutex);
+	B2_ASSERT(scheduler->mainState == b2_mainTaskIdle);
+	scheduler->mainTask = task;
+	scheduler->mainContext = taskContext;
+	scheduler->mainState = b2_mainTaskPending;
+	b2WakeAll(&scheduler->mainCondition);
+	b2UnlockMutex(&scheduler->mainMutex);
+}
+
+void b2FinishMainTask(b2Scheduler* scheduler)
+{
+	b2LockMutex(&scheduler->mainMutex);
+	B2_ASSERT(scheduler->mainState != b2_mainTaskIdle);
+	while (scheduler->mainState != b2_mainTaskFinished)
+	{
+		b2WaitCondition(&scheduler->mainCondition, &scheduler->mainMutex);
+	}
+	scheduler->mainState = b2_mainTaskIdle;
+	b2UnlockMutex(&scheduler->mainMutex);
+}
@@ -0,0 +1,28 @@
+// SPDX-FileCopyrightText: 2023 Erin Catto
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "box2d/types.h"
+
+typedef struct b2Allocator b2Allocator;
+typedef struct b2Scheduler b2Scheduler;
+
+// A small work stealing thread pool. The world uses this when the world definition has a worker
+// count but no task callbacks. Each worker has a deque of task ranges. Idle workers steal ranges
+// from the other deques. The thread that steps the world is worker 0 and it only executes ranges
+// while it waits in b2FinishSchedulerTask.
+// With pinThreads each background thread is pinned to its own core where the platform supports it.
+// The calling thread is left alone.
+b2Scheduler* b2CreateScheduler(b2Allocator* allocator, int32_t workerCount, bool pinThreads);
+void b2DestroyScheduler(b2Scheduler* scheduler);
+
+// These implement b2EnqueueTaskCallback and b2FinishTaskCallback. The user context is the scheduler.
+// Tasks must be enqueued and finished by the same thread.
+void* b2EnqueueSchedulerTask(b2TaskCallback* task, int32_t itemCount, int32_t minRange, void* taskContext, void* userContext);
+void b2FinishSchedulerTask(void* userTask, void* userContext);
+
+// Run a single task on a separate thread that takes the place of worker 0. The caller is free
+// to do other work until b2FinishMainTask. The caller must not enqueue tasks in the meantime.
+void b2StartMainTask(b2Scheduler* scheduler, b2TaskCallback* task, void* taskContext);
+void b2FinishMainTask(b2Scheduler* scheduler);
@@ -0,0 +1,306 @@
+// SPDX-FileCopyrightText: 2023 Erin Catto
+// SPDX-License-Identifier: MIT
+
+#include "sensor.h"
+
+#include "array.h"
+#include "body.h"
+#include "broad_phase.h"
+#include "contact.h"
+#include "core.h"
+#include "shape.h"
+#include "task_graph.h"
+#include "world.h"
+
+#include "box2d/event_types.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void b2CreateSensor(b2World* world, b2Shape* shape)
+{
+	B2_ASSERT(shape->isSensor && shape->sensorIndex == B2_NULL_INDEX);
+
+	b2Sensor sensor;
+	sensor.overlaps1 = b2CreateArray(&world->allocator, sizeof(b2ShapeRef), 4);
+	sensor.overlaps2 = b2CreateArray(&world->allocator, sizeof(b2ShapeRef), 4);
+	sensor.shapeIndex = shape->object.index;
+
+	shape->sensorIndex = b2Array(world->sensorArray).count;
+	b2Array_Push(world->sensorArray, sensor);
+}
+
+void b2DestroySensor(b2World* world, b2Shape* shape)
+{
+	int32_t sensorIndex = shape->sensorIndex;
+	if (sensorIndex == B2_NULL_INDEX)
+	{
+		return;
+	}
+
+	b2Sensor* sensor = world->sensorArray + sensorIndex;
+	B2_ASSERT(sensor->shapeIndex == shape->object.index);
+	b2DestroyArray(sensor->overlaps1, sizeof(b2ShapeRef));
+	b2DestroyArray(sensor->overlaps2, sizeof(b2ShapeRef));
+
+	// Fix the index of the sensor that moves into the hole
+	b2Array_RemoveSwap(world->sensorArray, sensorIndex);
+	if (sensorIndex < b2Array(world->sensorArray).count)
+	{
+		int32_t movedShapeIndex = world->sensorArray[sensorIndex].shapeIndex;
+		world->shapes[movedShapeIndex].sensorIndex = sensorIndex;
+	}
+
+	shape->sensorIndex = B2_NULL_INDEX;
+}
+
+void b2ClearSensor(b2World* world, b2Shape* shape)
+{
+	if (shape->sensorIndex != B2_NULL_INDEX)
+	{
+		b2Sensor* sensor = world->sensorArray + shape->sensorIndex;
+		b2Array_Clear(sensor->overlaps1);
+	}
+}
+
+typedef struct b2SensorQueryContext
+{
+	b2World* world;
+	b2Sensor* sensor;
+	b2Shape* sensorShape;
+	b2Body* sensorBody;
+} b2SensorQueryContext;
+
+static bool b2SensorQueryCallback(int32_t proxyId, int32_t shapeIndex, void* context)
+{
+	B2_MAYBE_UNUSED(proxyId);
+
+	b2SensorQueryContext* queryContext = context;
+	b2World* world = queryContext->world;
+
+	if (B2_IS_COMPOUND_PROXY(shapeIndex))
+	{
+		b2Body* compoundBody = world->bodies + B2_COMPOUND_BODY_INDEX(shapeIndex);
+		B2_ASSERT(compoundBody->isCompound);
+		b2DynamicTree_Query(&compoundBody->shapeTree, queryContext->sensorShape->aabb, b2SensorQueryCallback, context);
+		return true;
+	}
+
+	b2Shape* sensorShape = queryContext->sensorShape;
+	if (shapeIndex == sensorShape->object.index)
+	{
+		return true;
+	}
+
+	B2_ASSERT(0 <= shapeIndex && shapeIndex < world->shapePool.capacity);
+	b2Shape* otherShape = world->shapes + shapeIndex;
+
+	// Sensors don't detect each other. Otherwise both sensors of a pair would report the overlap.
+	if (otherShape->sensorIndex != B2_NULL_INDEX)
+	{
+		return true;
+	}
+
+	// Same rules as contact creation
+	if (otherShape->bodyIndex == sensorShape->bodyIndex)
+	{
+		return true;
+	}
+
+	if (sensorShape->enableSensorEvents == false && otherShape->enableSensorEvents == false)
+	{
+		return true;
+	}
+
+	if (b2ShouldShapesCollide(sensorShape->filter, otherShape->filter) == false)
+	{
+		return true;
+	}
+
+	if (b2ShouldShapeTypesCollide(sensorShape->type, otherShape->type) == false)
+	{
+		return true;
+	}
+
+	b2Body* otherBody = world->bodies + otherShape->bodyIndex;
+	if (b2ShouldBodiesCollide(world, queryContext->sensorBody, otherBody) == false)
+	{
+		return true;
+	}
+
+	b2Transform sensorTransform = world->bodySimArray[sensorShape->bodyIndex].transform;
+	b2Transform otherTransform = world->bodySimArray[otherShape->bodyIndex].transform;
+	bool overlaps = b2TestShapeOverlap(sensorShape, sensorTransform, otherShape, otherTransform);
+	if (overlaps == false)
+	{
+		return true;
+	}
+
+	b2ShapeRef shapeRef = {shapeIndex, otherShape->object.revision};
+	b2Array_Push(queryContext->sensor->overlaps2, shapeRef);
+	return true;
+}
+
+static int b2CompareShapeRefs(const void* a, const void* b)
+{
+	const b2ShapeRef* sa = a;
+	const b2ShapeRef* sb = b;
+
+	if (sa->shapeIndex != sb->shapeIndex)
+	{
+		return sa->shapeIndex < sb->shapeIndex ? -1 : 1;
+	}
+
+	return (int)sa->revision - (int)sb->revision;
+}
+
+static void b2OverlapSensorsTask(int32_t startIndex, int32_t endIndex, uint32_t threadIndex, void* context)
+{
+	B2_MAYBE_UNUSED(threadIndex);
+
+	b2TracyCZoneNC(sensor_task, "Overlap Sensors", b2_colorBrown, true);
+
+	b2World* world = context;
+	B2_ASSERT(startIndex < endIndex);
+
+	for (int32_t sensorIndex = startIndex; sensorIndex < endIndex; ++sensorIndex)
+	{
+		b2Sensor* sensor = world->sensorArray + sensorIndex;
+		b2Shape* sensorShape = world->shapes + sensor->shapeIndex;
+		b2Body* sensorBody = world->bodies + sensorShape->bodyIndex;
+
+		b2Array_Clear(sensor->overlaps2);
+
+		// Disabled bodies are not in the broad-phase
+		if (sensorBody->isEnabled == false)
+		{
+			continue;
+		}
+
+		// A sensor on a sleeping body keeps its overlaps until the body wakes
+		if (sensorBody->type != b2_staticBody && b2IsBodyAwake(world, sensorBody) == false)
+		{
+			int32_t count = b2Array(sensor->overlaps1).count;
+			b2Array_Resize((void**)&sensor->overlaps2, sizeof(b2ShapeRef), count);
+			memcpy(sensor->overlaps2, sensor->overlaps1, count * sizeof(b2ShapeRef));
+			continue;
+		}
+
+		// Same tree rules as the pair finder. Static and kinematic sensors only see dynamic shapes.
+		b2SensorQueryContext queryContext = {world, sensor, sensorShape, sensorBody};
+		b2DynamicTree* trees = world->broadPhase.trees;
+		if (sensorBody->type == b2_dynamicBody)
+		{
+			b2DynamicTree_Query(trees + b2_staticBody, sensorShape->aabb, b2SensorQueryCallback, &queryContext);
+			b2DynamicTree_Query(trees + b2_kinematicBody, sensorShape->aabb, b2SensorQueryCallback, &queryContext);
+		}
+		b2DynamicTree_Query(trees + b2_dynamicBody, sensorShape->aabb, b2SensorQueryCallback, &queryContext);
+
+		// Sort for determinism and to make the comparison with the previous step linear
+		int32_t count = b2Array(sensor->overlaps2).count;
+		qsort(sensor->overlaps2, count, sizeof(b2ShapeRef), b2CompareShapeRefs);
+	}
+
+	b2TracyCZoneEnd(sensor_task);
+}
+
+// Serially compare the sorted overlaps of each sensor to generate events in a deterministic order
+static void b2SensorEventsTask(int32_t startIndex, int32_t endIndex, uint32_t threadIndex, void* context)
+{
+	B2_MAYBE_UNUSED(startIndex);
+	B2_MAYBE_UNUSED(endIndex);
+	B2_MAYBE_UNUSED(threadIndex);
+
+	b2TracyCZoneNC(sensor_events, "Sensor Events", b2_colorMediumPurple, true);
+
+	b2World* world = context;
+	int32_t sensorCount = b2Array(world->sensorArray).count;
+	const b2Shape* shapes = world->shapes;
+	int16_t worldIndex = world->index;
+
+	for (int32_t sensorIndex = 0; sensorIndex < sensorCount; ++sensorIndex)
+	{
+		b2Sensor* sensor = world->sensorArray + sensorIndex;
+		const b2Shape* sensorShape = shapes + sensor->shapeIndex;
+		b2ShapeId sensorId = {sensor->shapeIndex, worldIndex, sensorShape->object.revision};
+
+		const b2ShapeRef* refs1 = sensor->overlaps1;
+		const b2ShapeRef* refs2 = sensor->overlaps2;
+		int32_t count1 = b2Array(refs1).count;
+		int32_t count2 = b2Array(refs2).count;
+
+		int32_t index1 = 0, index2 = 0;
+		while (index1 < count1 || index2 < count2)
+		{
+			int order;
+			if (index1 == count1)
+			{
+				order = 1;
+			}
+			else if (index2 == count2)
+			{
+				order = -1;
+			}
+			else
+			{
+				order = b2CompareShapeRefs(refs1 + index1, refs2 + index2);
+			}
+
+			if (order < 0)
+			{
+				// Stopped overlapping. Destroyed shapes don't get events, same as destroyed contacts.
+				b2ShapeRef ref = refs1[index1];
+				const b2Shape* otherShape = shapes + ref.shapeIndex;
+				if (b2ObjectValid(&otherShape->object) && otherShape->object.revision == ref.revision)
+				{
+					b2ShapeId otherId = {ref.shapeIndex, worldIndex, ref.revision};
+					b2SensorEndTouchEvent event = {sensorId, otherId};
+					b2Array_Push(world->sensorEndEventArray, event);
+				}
+
+				index1 += 1;
+			}
+			else if (order > 0)
+			{
+				// Started overlapping
+				b2ShapeRef ref = refs2[index2];
+				b2ShapeId otherId = {ref.shapeIndex, worldIndex, ref.revision};
+				b2SensorBeginTouchEvent event = {sensorId, otherId};
+				b2Array_Push(world->sensorBeginEventArray, event);
+				index2 += 1;
+			}
+			else
+			{
+				// Still overlapping
+				index1 += 1;
+				index2 += 1;
+			}
+		}
+
+		// The current overlaps become the previous overlaps
+		b2ShapeRef* temp = sensor->overlaps1;
+		sensor->overlaps1 = sensor->overlaps2;
+		sensor->overlaps2 = temp;
+	}
+
+	b2TracyCZoneEnd(sensor_events);
+}
+
+void b2AddSensorNodes(b2World* world, b2TaskGraph* graph, int32_t treeNode, uint32_t dependencies)
+{
+	B2_ASSERT(0 <= treeNode && treeNode < graph->nodeCount);
+
+	b2Array_Clear(world->sensorBeginEventArray);
+	b2Array_Clear(world->sensorEndEventArray);
+
+	int32_t sensorCount = b2Array(world->sensorArray).count;
+	if (sensorCount == 0)
+	{
+		return;
+	}
+
+	int32_t minRange = 16;
+	uint32_t overlapDependencies = b2NodeBit(treeNode) | dependencies;
+	int32_t overlapNode = b2AddParallelNode(graph, &b2OverlapSensorsTask, sensorCount, minRange, world, overlapDependencies);
+	b2AddSerialNode(graph, &b2SensorEventsTask, world, b2NodeBit(overlapNode));
+}
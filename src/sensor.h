@@ -0,0 +1,42 @@
+// SPDX-FileCopyrightText: 2023 Erin Catto
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stdint.h>
+
+typedef struct b2Shape b2Shape;
+typedef struct b2TaskGraph b2TaskGraph;
+typedef struct b2World b2World;
+
+// A reference to a shape that survives the shape being destroyed
+typedef struct b2ShapeRef
+{
+	int32_t shapeIndex;
+	uint16_t revision;
+} b2ShapeRef;
+
+// Sensors don't create contacts. Instead each sensor queries the broad-phase every time step
+// and keeps a sorted list of the shapes it overlaps. The lists of consecutive steps are compared
+// to generate begin and end touch events. Sensors follow the pairing rules of contacts, so static and
+// kinematic sensors only detect dynamic shapes. Sensors don't detect other sensors, so a pair of
+// overlapping sensors reports no events. Sensors on sleeping bodies are not updated.
+typedef struct b2Sensor
+{
+	// Overlaps of the previous and current time step, sorted by shape index
+	b2ShapeRef* overlaps1;
+	b2ShapeRef* overlaps2;
+
+	int32_t shapeIndex;
+} b2Sensor;
+
+void b2CreateSensor(b2World* world, b2Shape* shape);
+void b2DestroySensor(b2World* world, b2Shape* shape);
+
+// Forget the current overlaps without generating end events. Used when the sensor body is disabled.
+void b2ClearSensor(b2World* world, b2Shape* shape);
+
+// Add nodes that update all sensor overlaps in parallel and then generate sensor events. Sensors query
+// the broad-phase trees, so they always wait for the tree rebuild node. They also read the island sleep
+// state, so the other dependencies must include the contact state update when there is one.
+void b2AddSensorNodes(b2World* world, b2TaskGraph* graph, int32_t treeNode, uint32_t dependencies);
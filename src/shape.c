@@ -3,29 +3,48 @@
 
 #include "shape.h"
 
+#include "allocate.h"
+#include "block_allocator.h"
 #include "body.h"
 #include "broad_phase.h"
 #include "contact.h"
+#include "heightfield.h"
 #include "world.h"
 
 // needed for dll export
 #include "box2d/box2d.h"
 #include "box2d/event_types.h"
 
+#include <float.h>
+
 b2AABB b2ComputeShapeAABB(const b2Shape* shape, b2Transform xf)
 {
 	switch (shape->type)
 	{
 		case b2_capsuleShape:
-			return b2ComputeCapsuleAABB(&shape->capsule, xf);
+			return b2ComputeCapsuleAABB(shape->capsule, xf);
 		case b2_circleShape:
-			return b2ComputeCircleAABB(&shape->circle, xf);
+			return b2ComputeCircleAABB(shape->circle, xf);
 		case b2_polygonShape:
-			return b2ComputePolygonAABB(&shape->polygon, xf);
+			return b2ComputePolygonAABB(shape->polygon, xf);
 		case b2_segmentShape:
-			return b2ComputeSegmentAABB(&shape->segment, xf);
+			return b2ComputeSegmentAABB(shape->segment, xf);
 		case b2_smoothSegmentShape:
-			return b2ComputeSegmentAABB(&shape->smoothSegment.segment, xf);
+			return b2ComputeSegmentAABB(&shape->smoothSegment->segment, xf);
+		case b2_heightfieldShape:
+			return b2ComputeHeightfieldAABB(shape->heightfield, xf);
+		case b2_smoothChainShape:
+		{
+			// Bound the local tree box
+			const b2DynamicTree* tree = &shape->smoothChain->tree;
+			b2AABB box = tree->nodes[tree->root].aabb;
+			b2Vec2 v1 = b2TransformPoint(xf, box.lowerBound);
+			b2Vec2 v2 = b2TransformPoint(xf, (b2Vec2){box.upperBound.x, box.lowerBound.y});
+			b2Vec2 v3 = b2TransformPoint(xf, box.upperBound);
+			b2Vec2 v4 = b2TransformPoint(xf, (b2Vec2){box.lowerBound.x, box.upperBound.y});
+			b2AABB aabb = {b2Min(b2Min(v1, v2), b2Min(v3, v4)), b2Max(b2Max(v1, v2), b2Max(v3, v4))};
+			return aabb;
+		}
 		default:
 		{
 			B2_ASSERT(false);
@@ -40,15 +59,26 @@ b2Vec2 b2GetShapeCentroid(const b2Shape* shape)
 	switch (shape->type)
 	{
 		case b2_capsuleShape:
-			return b2Lerp(shape->capsule.point1, shape->capsule.point2, 0.5f);
+			return b2Lerp(shape->capsule->point1, shape->capsule->point2, 0.5f);
 		case b2_circleShape:
-			return shape->circle.point;
+			return shape->circle->point;
 		case b2_polygonShape:
-			return shape->polygon.centroid;
+			return shape->polygon->centroid;
 		case b2_segmentShape:
-			return b2Lerp(shape->segment.point1, shape->segment.point2, 0.5f);
+			return b2Lerp(shape->segment->point1, shape->segment->point2, 0.5f);
 		case b2_smoothSegmentShape:
-			return b2Lerp(shape->smoothSegment.segment.point1, shape->smoothSegment.segment.point2, 0.5f);
+			return b2Lerp(shape->smoothSegment->segment.point1, shape->smoothSegment->segment.point2, 0.5f);
+		case b2_heightfieldShape:
+		{
+			const b2Heightfield* heightfield = shape->heightfield;
+			float width = heightfield->cellWidth * (heightfield->count - 1);
+			return (b2Vec2){0.5f * width, 0.5f * (heightfield->minHeight + heightfield->maxHeight)};
+		}
+		case b2_smoothChainShape:
+		{
+			const b2DynamicTree* tree = &shape->smoothChain->tree;
+			return b2AABB_Center(tree->nodes[tree->root].aabb);
+		}
 		default:
 			return b2Vec2_zero;
 	}
@@ -59,11 +89,11 @@ b2MassData b2ComputeShapeMass(const b2Shape* shape)
 	switch (shape->type)
 	{
 		case b2_capsuleShape:
-			return b2ComputeCapsuleMass(&shape->capsule, shape->density);
+			return b2ComputeCapsuleMass(shape->capsule, shape->density);
 		case b2_circleShape:
-			return b2ComputeCircleMass(&shape->circle, shape->density);
+			return b2ComputeCircleMass(shape->circle, shape->density);
 		case b2_polygonShape:
-			return b2ComputePolygonMass(&shape->polygon, shape->density);
+			return b2ComputePolygonMass(shape->polygon, shape->density);
 		default:
 		{
 			return (b2MassData){0};
@@ -79,23 +109,23 @@ b2ShapeExtent b2ComputeShapeExtent(const b2Shape* shape)
 	{
 		case b2_capsuleShape:
 		{
-			float radius = shape->capsule.radius;
+			float radius = shape->capsule->radius;
 			extent.minExtent = radius;
-			extent.maxExtent = B2_MAX(b2Length(shape->capsule.point1), b2Length(shape->capsule.point2)) + radius;
+			extent.maxExtent = B2_MAX(b2Length(shape->capsule->point1), b2Length(shape->capsule->point2)) + radius;
 		}
 		break;
 
 		case b2_circleShape:
 		{
-			float radius = shape->circle.radius;
+			float radius = shape->circle->radius;
 			extent.minExtent = radius;
-			extent.maxExtent = b2Length(shape->circle.point) + radius;
+			extent.maxExtent = b2Length(shape->circle->point) + radius;
 		}
 		break;
 
 		case b2_polygonShape:
 		{
-			const b2Polygon* poly = &shape->polygon;
+			const b2Polygon* poly = shape->polygon;
 			float minExtent = b2_huge;
 			float maxExtent = 0.0f;
 			int32_t count = poly->count;
@@ -120,6 +150,44 @@ b2ShapeExtent b2ComputeShapeExtent(const b2Shape* shape)
 	return extent;
 }
 
+typedef struct b2SmoothChainCastContext
+{
+	const b2SmoothChain* chain;
+	b2RayCastOutput output;
+} b2SmoothChainCastContext;
+
+static float b2SmoothChainRayCastCallback(const b2RayCastInput* input, int32_t proxyId, int32_t segmentIndex, void* context)
+{
+	B2_MAYBE_UNUSED(proxyId);
+
+	b2SmoothChainCastContext* castContext = context;
+	b2SmoothSegment smoothSegment = b2GetSmoothChainSegment(castContext->chain, segmentIndex);
+	b2RayCastOutput output = b2RayCastSegment(input, &smoothSegment.segment, true);
+	if (output.hit)
+	{
+		castContext->output = output;
+		return output.fraction;
+	}
+
+	return input->maxFraction;
+}
+
+static float b2SmoothChainShapeCastCallback(const b2ShapeCastInput* input, int32_t proxyId, int32_t segmentIndex, void* context)
+{
+	B2_MAYBE_UNUSED(proxyId);
+
+	b2SmoothChainCastContext* castContext = context;
+	b2SmoothSegment smoothSegment = b2GetSmoothChainSegment(castContext->chain, segmentIndex);
+	b2RayCastOutput output = b2ShapeCastSegment(input, &smoothSegment.segment);
+	if (output.hit)
+	{
+		castContext->output = output;
+		return output.fraction;
+	}
+
+	return input->maxFraction;
+}
+
 b2RayCastOutput b2RayCastShape(const b2RayCastInput* input, const b2Shape* shape, b2Transform xf)
 {
 	b2RayCastInput localInput = *input;
@@ -130,20 +198,33 @@ b2RayCastOutput b2RayCastShape(const b2RayCastInput* input, const b2Shape* shape
 	switch (shape->type)
 	{
 		case b2_capsuleShape:
-			output = b2RayCastCapsule(&localInput, &shape->capsule);
+			output = b2RayCastCapsule(&localInput, shape->capsule);
 			break;
 		case b2_circleShape:
-			output = b2RayCastCircle(&localInput, &shape->circle);
+			output = b2RayCastCircle(&localInput, shape->circle);
 			break;
 		case b2_polygonShape:
-			output = b2RayCastPolygon(&localInput, &shape->polygon);
+			output = b2RayCastPolygon(&localInput, shape->polygon);
 			break;
 		case b2_segmentShape:
-			output = b2RayCastSegment(&localInput, &shape->segment, false);
+			output = b2RayCastSegment(&localInput, shape->segment, false);
 			break;
 		case b2_smoothSegmentShape:
-			output = b2RayCastSegment(&localInput, &shape->smoothSegment.segment, true);
+			output = b2RayCastSegment(&localInput, &shape->smoothSegment->segment, true);
 			break;
+		case b2_heightfieldShape:
+			output = b2RayCastHeightfield(&localInput, shape->heightfield);
+			break;
+		case b2_smoothChainShape:
+		{
+			b2SmoothChainCastContext context;
+			context.chain = shape->smoothChain;
+			context.output = output;
+			b2DynamicTree_RayCast(&shape->smoothChain->tree, &localInput, b2_defaultMaskBits, b2SmoothChainRayCastCallback,
+								  &context);
+			output = context.output;
+		}
+		break;
 		default:
 			return output;
 	}
@@ -168,20 +249,33 @@ b2RayCastOutput b2ShapeCastShape(const b2ShapeCastInput* input, const b2Shape* s
 	switch (shape->type)
 	{
 		case b2_capsuleShape:
-			output = b2ShapeCastCapsule(&localInput, &shape->capsule);
+			output = b2ShapeCastCapsule(&localInput, shape->capsule);
 			break;
 		case b2_circleShape:
-			output = b2ShapeCastCircle(&localInput, &shape->circle);
+			output = b2ShapeCastCircle(&localInput, shape->circle);
 			break;
 		case b2_polygonShape:
-			output = b2ShapeCastPolygon(&localInput, &shape->polygon);
+			output = b2ShapeCastPolygon(&localInput, shape->polygon);
 			break;
 		case b2_segmentShape:
-			output = b2ShapeCastSegment(&localInput, &shape->segment);
+			output = b2ShapeCastSegment(&localInput, shape->segment);
 			break;
 		case b2_smoothSegmentShape:
-			output = b2ShapeCastSegment(&localInput, &shape->smoothSegment.segment);
+			output = b2ShapeCastSegment(&localInput, &shape->smoothSegment->segment);
 			break;
+		case b2_heightfieldShape:
+			output = b2ShapeCastHeightfield(&localInput, shape->heightfield);
+			break;
+		case b2_smoothChainShape:
+		{
+			b2SmoothChainCastContext context;
+			context.chain = shape->smoothChain;
+			context.output = output;
+			b2DynamicTree_ShapeCast(&shape->smoothChain->tree, &localInput, b2_defaultMaskBits, b2SmoothChainShapeCastCallback,
+									&context);
+			output = context.output;
+		}
+		break;
 		default:
 			return output;
 	}
@@ -218,20 +312,46 @@ void b2DestroyShapeProxy(b2Shape* shape, b2BroadPhase* bp)
 	}
 }
 
+void b2CreateCompoundShapeProxy(b2Shape* shape, b2DynamicTree* tree, b2BodyType type, b2Transform xf)
+{
+	B2_ASSERT(shape->proxyKey == B2_NULL_INDEX);
+
+	shape->aabb = b2ComputeShapeAABB(shape, xf);
+
+	// Same margins as the broad-phase
+	float margin = type == b2_staticBody ? 4.0f * b2_linearSlop : b2_aabbMargin;
+	shape->fatAABB.lowerBound.x = shape->aabb.lowerBound.x - margin;
+	shape->fatAABB.lowerBound.y = shape->aabb.lowerBound.y - margin;
+	shape->fatAABB.upperBound.x = shape->aabb.upperBound.x + margin;
+	shape->fatAABB.upperBound.y = shape->aabb.upperBound.y + margin;
+
+	// The proxy key is a plain tree proxy id for compound shapes
+	shape->proxyKey = b2DynamicTree_CreateProxy(tree, shape->fatAABB, shape->filter.categoryBits, shape->object.index);
+}
+
+void b2DestroyCompoundShapeProxy(b2Shape* shape, b2DynamicTree* tree)
+{
+	if (shape->proxyKey != B2_NULL_INDEX)
+	{
+		b2DynamicTree_DestroyProxy(tree, shape->proxyKey);
+		shape->proxyKey = B2_NULL_INDEX;
+	}
+}
+
 b2DistanceProxy b2MakeShapeDistanceProxy(const b2Shape* shape)
 {
 	switch (shape->type)
 	{
 		case b2_capsuleShape:
-			return b2MakeProxy(&shape->capsule.point1, 2, shape->capsule.radius);
+			return b2MakeProxy(&shape->capsule->point1, 2, shape->capsule->radius);
 		case b2_circleShape:
-			return b2MakeProxy(&shape->circle.point, 1, shape->circle.radius);
+			return b2MakeProxy(&shape->circle->point, 1, shape->circle->radius);
 		case b2_polygonShape:
-			return b2MakeProxy(shape->polygon.vertices, shape->polygon.count, shape->polygon.radius);
+			return b2MakeProxy(shape->polygon->vertices, shape->polygon->count, shape->polygon->radius);
 		case b2_segmentShape:
-			return b2MakeProxy(&shape->segment.point1, 2, 0.0f);
+			return b2MakeProxy(&shape->segment->point1, 2, 0.0f);
 		case b2_smoothSegmentShape:
-			return b2MakeProxy(&shape->smoothSegment.segment.point1, 2, 0.0f);
+			return b2MakeProxy(&shape->smoothSegment->segment.point1, 2, 0.0f);
 		default:
 		{
 			B2_ASSERT(false);
@@ -241,6 +361,211 @@ b2DistanceProxy b2MakeShapeDistanceProxy(const b2Shape* shape)
 	}
 }
 
+// The region below the surface is solid, so a proxy with any vertex below the surface overlaps even
+// when it is far from the surface segments
+float b2HeightfieldDistance(const b2Heightfield* heightfield, b2Transform xfA, const b2DistanceProxy* proxyB, b2Transform xfB)
+{
+	// Bound proxy B in the height field frame
+	b2Transform xf = b2InvMulTransforms(xfA, xfB);
+	b2Vec2 v = b2TransformPoint(xf, proxyB->vertices[0]);
+	b2AABB box = {v, v};
+	bool below = b2IsBelowHeightfield(heightfield, v);
+	for (int32_t i = 1; i < proxyB->count; ++i)
+	{
+		v = b2TransformPoint(xf, proxyB->vertices[i]);
+		box.lowerBound = b2Min(box.lowerBound, v);
+		box.upperBound = b2Max(box.upperBound, v);
+		below = below || b2IsBelowHeightfield(heightfield, v);
+	}
+
+	if (below)
+	{
+		return 0.0f;
+	}
+
+	b2Vec2 r = {proxyB->radius, proxyB->radius};
+	box.lowerBound = b2Sub(box.lowerBound, r);
+	box.upperBound = b2Add(box.upperBound, r);
+
+	int32_t first, last;
+	if (b2GetHeightfieldCellRange(heightfield, box, &first, &last) == false)
+	{
+		return FLT_MAX;
+	}
+
+	b2DistanceInput input;
+	input.proxyB = *proxyB;
+	input.transformA = xfA;
+	input.transformB = xfB;
+	input.useRadii = true;
+
+	float distance = FLT_MAX;
+	for (int32_t cell = first; cell <= last; ++cell)
+	{
+		b2SmoothSegment smoothSegment = b2GetHeightfieldSegment(heightfield, cell);
+		input.proxyA = b2MakeProxy(&smoothSegment.segment.point1, 2, 0.0f);
+
+		b2DistanceCache cache = {0};
+		b2DistanceOutput output = b2ShapeDistance(&cache, &input);
+		distance = B2_MIN(distance, output.distance);
+	}
+
+	return distance;
+}
+
+typedef struct b2SmoothChainDistanceContext
+{
+	const b2SmoothChain* chain;
+	b2DistanceInput input;
+	float distance;
+} b2SmoothChainDistanceContext;
+
+static bool b2SmoothChainDistanceCallback(int32_t proxyId, int32_t segmentIndex, void* context)
+{
+	B2_MAYBE_UNUSED(proxyId);
+
+	b2SmoothChainDistanceContext* distanceContext = context;
+	b2SmoothSegment smoothSegment = b2GetSmoothChainSegment(distanceContext->chain, segmentIndex);
+	distanceContext->input.proxyA = b2MakeProxy(&smoothSegment.segment.point1, 2, 0.0f);
+
+	b2DistanceCache cache = {0};
+	b2DistanceOutput output = b2ShapeDistance(&cache, &distanceContext->input);
+	distanceContext->distance = B2_MIN(distanceContext->distance, output.distance);
+
+	// Overlap found, no need to keep looking
+	return distanceContext->distance > 0.0f;
+}
+
+float b2SmoothChainDistance(const b2SmoothChain* chain, b2Transform xfA, const b2DistanceProxy* proxyB, b2Transform xfB)
+{
+	b2Transform xf = b2InvMulTransforms(xfA, xfB);
+	b2Vec2 v = b2TransformPoint(xf, proxyB->vertices[0]);
+	b2AABB box = {v, v};
+	for (int32_t i = 1; i < proxyB->count; ++i)
+	{
+		v = b2TransformPoint(xf, proxyB->vertices[i]);
+		box.lowerBound = b2Min(box.lowerBound, v);
+		box.upperBound = b2Max(box.upperBound, v);
+	}
+
+	b2Vec2 r = {proxyB->radius, proxyB->radius};
+	box.lowerBound = b2Sub(box.lowerBound, r);
+	box.upperBound = b2Add(box.upperBound, r);
+
+	b2SmoothChainDistanceContext context;
+	context.chain = chain;
+	context.input.proxyB = *proxyB;
+	context.input.transformA = xfA;
+	context.input.transformB = xfB;
+	context.input.useRadii = true;
+	context.distance = FLT_MAX;
+
+	b2DynamicTree_Query(&chain->tree, box, b2SmoothChainDistanceCallback, &context);
+	return context.distance;
+}
+
+float b2ComputeShapeDistance(const b2Shape* shape, b2Transform xf, const b2DistanceProxy* proxy, b2Transform proxyTransform)
+{
+	switch (shape->type)
+	{
+		case b2_heightfieldShape:
+			return b2HeightfieldDistance(shape->heightfield, xf, proxy, proxyTransform);
+
+		case b2_smoothChainShape:
+			return b2SmoothChainDistance(shape->smoothChain, xf, proxy, proxyTransform);
+
+		default:
+		{
+			b2DistanceInput input;
+			input.proxyA = b2MakeShapeDistanceProxy(shape);
+			input.proxyB = *proxy;
+			input.transformA = xf;
+			input.transformB = proxyTransform;
+			input.useRadii = true;
+
+			b2DistanceCache cache = {0};
+			b2DistanceOutput output = b2ShapeDistance(&cache, &input);
+			return output.distance;
+		}
+	}
+}
+
+bool b2TestShapeOverlap(const b2Shape* shapeA, b2Transform xfA, const b2Shape* shapeB, b2Transform xfB)
+{
+	if (shapeB->type == b2_heightfieldShape || shapeB->type == b2_smoothChainShape)
+	{
+		// These have no single distance proxy, so they must be shape A
+		const b2Shape* tempShape = shapeA;
+		shapeA = shapeB;
+		shapeB = tempShape;
+
+		b2Transform tempTransform = xfA;
+		xfA = xfB;
+		xfB = tempTransform;
+	}
+
+	b2DistanceProxy proxyB = b2MakeShapeDistanceProxy(shapeB);
+	float distance = b2ComputeShapeDistance(shapeA, xfA, &proxyB, xfB);
+	return distance < 10.0f * FLT_EPSILON;
+}
+
+void b2BuildSmoothChain(b2World* world, b2SmoothChain* chain)
+{
+	chain->tree = b2CreateDynamicTree(&world->allocator);
+
+	for (int32_t i = 0; i < chain->segmentCount; ++i)
+	{
+		b2SmoothSegment smoothSegment = b2GetSmoothChainSegment(chain, i);
+		b2AABB box = b2ComputeSegmentAABB(&smoothSegment.segment, b2Transform_identity);
+		b2DynamicTree_CreateProxy(&chain->tree, box, b2_defaultCategoryBits, i);
+	}
+
+	// The segments never move, so build the best tree once
+	b2DynamicTree_Rebuild(&chain->tree, true);
+}
+
+int32_t b2GetShapeGeometrySize(b2ShapeType type)
+{
+	switch (type)
+	{
+		case b2_capsuleShape:
+			return sizeof(b2Capsule);
+		case b2_circleShape:
+			return sizeof(b2Circle);
+		case b2_polygonShape:
+			return sizeof(b2Polygon);
+		case b2_segmentShape:
+			return sizeof(b2Segment);
+		case b2_smoothSegmentShape:
+			return sizeof(b2SmoothSegment);
+		case b2_heightfieldShape:
+			return sizeof(b2Heightfield);
+		case b2_smoothChainShape:
+			return sizeof(b2SmoothChain);
+		default:
+			B2_ASSERT(false);
+			return 0;
+	}
+}
+
+void b2DestroyShapeAllocations(b2World* world, b2Shape* shape)
+{
+	if (shape->type == b2_heightfieldShape && shape->heightfield->heights != NULL)
+	{
+		b2Free(&world->allocator, (void*)shape->heightfield->heights, shape->heightfield->count * sizeof(float));
+		shape->heightfield->heights = NULL;
+	}
+	else if (shape->type == b2_smoothChainShape && shape->smoothChain->points != NULL)
+	{
+		b2DynamicTree_Destroy(&shape->smoothChain->tree);
+		b2Free(&world->allocator, shape->smoothChain->points, shape->smoothChain->pointCount * sizeof(b2Vec2));
+		shape->smoothChain->points = NULL;
+	}
+
+	b2FreeBlock(world->blockAllocator, shape->geometry, b2GetShapeGeometrySize(shape->type));
+	shape->geometry = NULL;
+}
+
 b2Shape* b2GetShape(b2World* world, b2ShapeId shapeId)
 {
 	B2_ASSERT(0 <= shapeId.index && shapeId.index < world->shapePool.capacity);
@@ -258,8 +583,7 @@ b2BodyId b2Shape_GetBody(b2ShapeId shapeId)
 	b2Body* body = world->bodies + shape->bodyIndex;
 	B2_ASSERT(b2ObjectValid(&body->object));
 
-	b2BodyId bodyId = {body->object.index, shapeId.world, body->object.revision};
-	return bodyId;
+	return b2MakeBodyId(world, body);
 }
 
 void* b2Shape_GetUserData(b2ShapeId shapeId)
@@ -287,18 +611,22 @@ bool b2Shape_TestPoint(b2ShapeId shapeId, b2Vec2 point)
 	b2Body* body = world->bodies + shape->bodyIndex;
 	B2_ASSERT(b2ObjectValid(&body->object));
 
-	b2Vec2 localPoint = b2InvTransformPoint(body->transform, point);
+	b2BodySim* bodySim = b2GetBodySim(world, body);
+	b2Vec2 localPoint = b2InvTransformPoint(bodySim->transform, point);
 
 	switch (shape->type)
 	{
 		case b2_capsuleShape:
-			return b2PointInCapsule(localPoint, &shape->capsule);
+			return b2PointInCapsule(localPoint, shape->capsule);
 
 		case b2_circleShape:
-			return b2PointInCircle(localPoint, &shape->circle);
+			return b2PointInCircle(localPoint, shape->circle);
 
 		case b2_polygonShape:
-			return b2PointInPolygon(localPoint, &shape->polygon);
+			return b2PointInPolygon(localPoint, shape->polygon);
+
+		case b2_heightfieldShape:
+			return b2IsBelowHeightfield(shape->heightfield, localPoint);
 
 		default:
 			return false;
@@ -397,6 +725,7 @@ void b2Shape_SetFilter(b2ShapeId shapeId, b2Filter filter)
 
 	b2Body* body = world->bodies + shape->bodyIndex;
 	B2_ASSERT(b2ObjectValid(&body->object));
+	b2BodySim* bodySim = b2GetBodySim(world, body);
 
 	// Destroy any contacts associated with the shape
 	int32_t contactKey = body->contactList;
@@ -414,10 +743,18 @@ void b2Shape_SetFilter(b2ShapeId shapeId, b2Filter filter)
 		}
 	}
 
-	if (body->isEnabled)
+	if (body->isEnabled && body->isCompound)
+	{
+		// The compound proxy carries the union of the shape categories
+		b2DestroyCompoundShapeProxy(shape, &body->shapeTree);
+		b2CreateCompoundShapeProxy(shape, &body->shapeTree, body->type, bodySim->transform);
+		b2DestroyCompoundProxy(world, body);
+		b2CreateCompoundProxy(world, body);
+	}
+	else if (body->isEnabled)
 	{
 		b2DestroyShapeProxy(shape, &world->broadPhase);
-		b2CreateShapeProxy(shape, &world->broadPhase, body->type, body->transform);
+		b2CreateShapeProxy(shape, &world->broadPhase, body->type, bodySim->transform);
 	}
 	else
 	{
@@ -437,7 +774,7 @@ const b2Circle* b2Shape_GetCircle(b2ShapeId shapeId)
 	b2World* world = b2GetWorldFromIndex(shapeId.world);
 	b2Shape* shape = b2GetShape(world, shapeId);
 	B2_ASSERT(shape->type == b2_circleShape);
-	return &shape->circle;
+	return shape->circle;
 }
 
 const b2Segment* b2Shape_GetSegment(b2ShapeId shapeId)
@@ -445,7 +782,7 @@ const b2Segment* b2Shape_GetSegment(b2ShapeId shapeId)
 	b2World* world = b2GetWorldFromIndex(shapeId.world);
 	b2Shape* shape = b2GetShape(world, shapeId);
 	B2_ASSERT(shape->type == b2_segmentShape);
-	return &shape->segment;
+	return shape->segment;
 }
 
 const b2SmoothSegment* b2Shape_GetSmoothSegment(b2ShapeId shapeId)
@@ -453,7 +790,15 @@ const b2SmoothSegment* b2Shape_GetSmoothSegment(b2ShapeId shapeId)
 	b2World* world = b2GetWorldFromIndex(shapeId.world);
 	b2Shape* shape = b2GetShape(world, shapeId);
 	B2_ASSERT(shape->type == b2_smoothSegmentShape);
-	return &shape->smoothSegment;
+	return shape->smoothSegment;
+}
+
+const b2Heightfield* b2Shape_GetHeightfield(b2ShapeId shapeId)
+{
+	b2World* world = b2GetWorldFromIndex(shapeId.world);
+	b2Shape* shape = b2GetShape(world, shapeId);
+	B2_ASSERT(shape->type == b2_heightfieldShape);
+	return shape->heightfield;
 }
 
 const b2Capsule* b2Shape_GetCapsule(b2ShapeId shapeId)
@@ -461,7 +806,7 @@ const b2Capsule* b2Shape_GetCapsule(b2ShapeId shapeId)
 	b2World* world = b2GetWorldFromIndex(shapeId.world);
 	b2Shape* shape = b2GetShape(world, shapeId);
 	B2_ASSERT(shape->type == b2_capsuleShape);
-	return &shape->capsule;
+	return shape->capsule;
 }
 
 const b2Polygon* b2Shape_GetPolygon(b2ShapeId shapeId)
@@ -469,16 +814,16 @@ const b2Polygon* b2Shape_GetPolygon(b2ShapeId shapeId)
 	b2World* world = b2GetWorldFromIndex(shapeId.world);
 	b2Shape* shape = b2GetShape(world, shapeId);
 	B2_ASSERT(shape->type == b2_polygonShape);
-	return &shape->polygon;
+	return shape->polygon;
 }
 
 b2ChainId b2Shape_GetParentChain(b2ShapeId shapeId)
 {
 	b2World* world = b2GetWorldFromIndex(shapeId.world);
 	b2Shape* shape = b2GetShape(world, shapeId);
-	if (shape->type == b2_smoothSegmentShape)
+	if (shape->type == b2_smoothSegmentShape || shape->type == b2_smoothChainShape)
 	{
-		int32_t chainIndex = shape->smoothSegment.chainIndex;
+		int32_t chainIndex = shape->type == b2_smoothSegmentShape ? shape->smoothSegment->chainIndex : shape->smoothChain->chainIndex;
 		if (chainIndex != B2_NULL_INDEX)
 		{
 			B2_ASSERT(0 <= chainIndex && chainIndex < world->chainPool.capacity);
@@ -588,7 +933,7 @@ int32_t b2Shape_GetContactData(b2ShapeId shapeId, b2ContactData* contactData, in
 
 			contactData[index].shapeIdA = (b2ShapeId){shapeA->object.index, shapeId.world, shapeA->object.revision};
 			contactData[index].shapeIdB = (b2ShapeId){shapeB->object.index, shapeId.world, shapeB->object.revision};
-			contactData[index].manifold = contact->manifold;
+			contactData[index].manifold = *b2GetContactManifold(world, contact);
 			index += 1;
 		}
 
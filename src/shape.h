@@ -3,34 +3,47 @@
 
 #pragma once
 
+#include "core.h"
 #include "pool.h"
 
 #include "box2d/distance.h"
+#include "box2d/dynamic_tree.h"
 #include "box2d/geometry.h"
 #include "box2d/id.h"
+#include "box2d/manifold.h"
 #include "box2d/types.h"
 
 typedef struct b2BroadPhase b2BroadPhase;
+typedef struct b2DynamicTree b2DynamicTree;
 typedef struct b2World b2World;
 
+// A whole chain stored in a single shape. The segments live in a local space tree
+// and smooth segments are built on demand for collision and queries.
+typedef struct b2SmoothChain
+{
+	b2DynamicTree tree;
+	b2Vec2* points;
+	int32_t pointCount;
+	int32_t segmentCount;
+	int32_t chainIndex;
+	bool loop;
+} b2SmoothChain;
+
 typedef struct b2Shape
 {
 	b2Object object;
-	int32_t bodyIndex;
-	int32_t nextShapeIndex;
-	b2ShapeType type;
-	float density;
-	float friction;
-	float restitution;
 
+	// Hot data used every time step by body finalization, the broad-phase and contact updates
 	b2AABB aabb;
 	b2AABB fatAABB;
-	b2Vec2 localCentroid;
-	int32_t proxyKey;
-
 	b2Filter filter;
-	void* userData;
+	int32_t bodyIndex;
+	int32_t nextShapeIndex;
+
+	// Broad-phase proxy key, or the proxy id in the body shape tree for compound bodies
+	int32_t proxyKey;
 
+	b2ShapeType type;
 	bool isSensor;
 	bool enableSensorEvents;
 	bool enableContactEvents;
@@ -38,15 +51,30 @@ typedef struct b2Shape
 	bool enlargedAABB;
 	bool isFast;
 
-	// TODO_ERIN maybe not anonymous, check asm
+	// The geometry is stored separately in the world block allocator with a size that depends on the
+	// shape type. This keeps the shape pool small and the geometry of small shapes packed together.
 	union
 	{
-		b2Capsule capsule;
-		b2Circle circle;
-		b2Polygon polygon;
-		b2Segment segment;
-		b2SmoothSegment smoothSegment;
+		void* geometry;
+		b2Capsule* capsule;
+		b2Circle* circle;
+		b2Polygon* polygon;
+		b2Segment* segment;
+		b2SmoothSegment* smoothSegment;
+		b2Heightfield* heightfield;
+		b2SmoothChain* smoothChain;
 	};
+
+	// Cold data
+	float density;
+	float friction;
+	float restitution;
+	b2Vec2 localCentroid;
+
+	// Index into the world sensor array, or B2_NULL_INDEX if this is not a sensor
+	int32_t sensorIndex;
+
+	void* userData;
 } b2Shape;
 
 typedef struct b2ChainShape
@@ -67,6 +95,10 @@ typedef struct b2ShapeExtent
 void b2CreateShapeProxy(b2Shape* shape, b2BroadPhase* bp, b2BodyType type, b2Transform xf);
 void b2DestroyShapeProxy(b2Shape* shape, b2BroadPhase* bp);
 
+// Compound shapes live in the body's shape tree instead of the broad-phase
+void b2CreateCompoundShapeProxy(b2Shape* shape, b2DynamicTree* tree, b2BodyType type, b2Transform xf);
+void b2DestroyCompoundShapeProxy(b2Shape* shape, b2DynamicTree* tree);
+
 b2MassData b2ComputeShapeMass(const b2Shape* shape);
 b2ShapeExtent b2ComputeShapeExtent(const b2Shape* shape);
 b2AABB b2ComputeShapeAABB(const b2Shape* shape, b2Transform xf);
@@ -74,6 +106,60 @@ b2Vec2 b2GetShapeCentroid(const b2Shape* shape);
 
 b2DistanceProxy b2MakeShapeDistanceProxy(const b2Shape* shape);
 
+// Height fields have no single distance proxy, so the distance is the minimum over the cells near proxy B
+float b2HeightfieldDistance(const b2Heightfield* heightfield, b2Transform xfA, const b2DistanceProxy* proxyB, b2Transform xfB);
+
+// Distance between a shape and a distance proxy, including shapes without a single distance proxy
+float b2ComputeShapeDistance(const b2Shape* shape, b2Transform xf, const b2DistanceProxy* proxy, b2Transform proxyTransform);
+
+// Exact overlap test of two shapes, used for sensors
+bool b2TestShapeOverlap(const b2Shape* shapeA, b2Transform xfA, const b2Shape* shapeB, b2Transform xfB);
+
+float b2SmoothChainDistance(const b2SmoothChain* chain, b2Transform xfA, const b2DistanceProxy* proxyB, b2Transform xfB);
+
+// Size of the separately stored geometry of a shape type
+int32_t b2GetShapeGeometrySize(b2ShapeType type);
+
+// Free the shape geometry and any memory it owns
+void b2DestroyShapeAllocations(b2World* world, b2Shape* shape);
+
+// Build the segment tree of a smooth chain from its points
+void b2BuildSmoothChain(b2World* world, b2SmoothChain* chain);
+
+b2Manifold b2CollideSmoothChainAndCircle(const b2SmoothChain* chainA, b2Transform xfA, const b2Circle* circleB, b2Transform xfB);
+b2Manifold b2CollideSmoothChainAndCapsule(const b2SmoothChain* chainA, b2Transform xfA, const b2Capsule* capsuleB,
+										  b2Transform xfB, b2DistanceCache* cache);
+b2Manifold b2CollideSmoothChainAndPolygon(const b2SmoothChain* chainA, b2Transform xfA, const b2Polygon* polygonB,
+										  b2Transform xfB, b2DistanceCache* cache);
+
+// Get a segment of a smooth chain, same layout as the segments created for a chain
+static inline b2SmoothSegment b2GetSmoothChainSegment(const b2SmoothChain* chain, int32_t index)
+{
+	B2_ASSERT(0 <= index && index < chain->segmentCount);
+
+	const b2Vec2* points = chain->points;
+	int32_t n = chain->pointCount;
+
+	b2SmoothSegment smoothSegment;
+	if (chain->loop)
+	{
+		smoothSegment.ghost1 = points[(index + n - 1) % n];
+		smoothSegment.segment.point1 = points[index];
+		smoothSegment.segment.point2 = points[(index + 1) % n];
+		smoothSegment.ghost2 = points[(index + 2) % n];
+	}
+	else
+	{
+		smoothSegment.ghost1 = points[index];
+		smoothSegment.segment.point1 = points[index + 1];
+		smoothSegment.segment.point2 = points[index + 2];
+		smoothSegment.ghost2 = points[index + 3];
+	}
+
+	smoothSegment.chainIndex = chain->chainIndex;
+	return smoothSegment;
+}
+
 b2RayCastOutput b2RayCastShape(const b2RayCastInput* input, const b2Shape* shape, b2Transform xf);
 b2RayCastOutput b2ShapeCastShape(const b2ShapeCastInput* input, const b2Shape* shape, b2Transform xf);
 
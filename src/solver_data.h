@@ -28,6 +28,7 @@ typedef struct b2StepContext
 
 	// TODO_ERIN for joints
 	struct b2Body* bodies;
+	struct b2BodySim* bodySims;
 	int32_t bodyCapacity;
 
 	// Map from world body pool index to solver body
@@ -92,7 +93,6 @@ typedef struct b2SolverTaskContext
 {
 	struct b2World* world;
 	struct b2Graph* graph;
-	struct b2Body** awakeBodies;
 	struct b2SolverBody* solverBodies;
 	
 	int32_t* bodyToSolverMap;
@@ -108,6 +108,9 @@ typedef struct b2SolverTaskContext
 	int32_t relaxIterations;
 	int32_t workerCount;
 
+	// Blocks are owned by threads instead of solver tasks, see b2WorldDef::enableWorkerAffinity
+	bool enableWorkerAffinity;
+
 	float timeStep;
 	float invTimeStep;
 	float subStep;
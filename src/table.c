@@ -4,6 +4,7 @@
 #include "table.h"
 
 #include "allocate.h"
+#include "array.h"
 #include "core.h"
 
 #include "box2d/types.h"
@@ -39,9 +40,10 @@ static inline uint32_t b2RoundUpPowerOf2(uint32_t x)
 	return x + 1;
 }
 
-b2HashSet b2CreateSet(int32_t capacity)
+b2HashSet b2CreateSet(b2Allocator* allocator, int32_t capacity)
 {
 	b2HashSet set = {0};
+	set.allocator = allocator;
 
 	// Capacity must be a power of 2
 	if (capacity > 16)
@@ -54,16 +56,16 @@ b2HashSet b2CreateSet(int32_t capacity)
 	}
 
 	set.count = 0;
-	set.items = b2Alloc(capacity * sizeof(b2SetItem));
-	memset(set.items, 0, capacity * sizeof(b2SetItem));
+	set.keys = b2Alloc(allocator, set.capacity * sizeof(uint64_t));
+	memset(set.keys, 0, set.capacity * sizeof(uint64_t));
 
 	return set;
 }
 
 void b2DestroySet(b2HashSet* set)
 {
-	b2Free(set->items, set->capacity * sizeof(b2SetItem));
-	set->items = NULL;
+	b2Free(set->allocator, set->keys, set->capacity * sizeof(uint64_t));
+	set->keys = NULL;
 	set->count = 0;
 	set->capacity = 0;
 }
@@ -71,7 +73,7 @@ void b2DestroySet(b2HashSet* set)
 void b2ClearSet(b2HashSet* set)
 {
 	set->count = 0;
-	memset(set->items, 0, set->capacity * sizeof(b2SetItem));
+	memset(set->keys, 0, set->capacity * sizeof(uint64_t));
 }
 
 // I need a good hash because the keys are built from pairs of increasing integers.
@@ -91,67 +93,82 @@ static inline uint32_t b2KeyHash(uint64_t key)
 	return (uint32_t)h;
 }
 
-#if B2_DEBUG
-int32_t g_probeCount;
-#endif
-
-int32_t b2FindSlot(const b2HashSet* set, uint64_t key, uint32_t hash)
+// The slots only hold keys. The hash is cheap to compute again when an item moves and this
+// halves the size of the table compared to storing the hash. Probing touches fewer cache lines.
+static int32_t b2FindSlot(const b2HashSet* set, uint64_t key, uint32_t hash)
 {
-	uint32_t capacity = set->capacity;
-	int32_t index = hash & (capacity - 1);
-	const b2SetItem* items = set->items;
-	while (items[index].hash != 0 && items[index].key != key)
+	uint32_t mask = set->capacity - 1;
+	uint32_t index = hash & mask;
+	const uint64_t* keys = set->keys;
+	while (keys[index] != 0 && keys[index] != key)
 	{
 #if B2_DEBUG
 		g_probeCount += 1;
 #endif
-		index = (index + 1) & (capacity - 1);
+		index = (index + 1) & mask;
 	}
 
-	return index;
+	return (int32_t)index;
 }
 
 static void b2AddKeyHaveCapacity(b2HashSet* set, uint64_t key, uint32_t hash)
 {
 	int32_t index = b2FindSlot(set, key, hash);
-	b2SetItem* items = set->items;
-	B2_ASSERT(items[index].hash == 0);
+	B2_ASSERT(set->keys[index] == 0);
 
-	items[index].key = key;
-	items[index].hash = hash;
+	set->keys[index] = key;
 	set->count += 1;
 }
 
-static void b2GrowTable(b2HashSet* set)
+static void b2ResizeTable(b2HashSet* set, uint32_t newCapacity)
 {
 	uint32_t oldCount = set->count;
 	B2_MAYBE_UNUSED(oldCount);
 
 	uint32_t oldCapacity = set->capacity;
-	b2SetItem* oldItems = set->items;
+	uint64_t* oldKeys = set->keys;
 
-	set->count = 0;
 	// Capacity must be a power of 2
-	set->capacity = 2 * oldCapacity;
-	set->items = b2Alloc(set->capacity * sizeof(b2SetItem));
-	memset(set->items, 0, set->capacity * sizeof(b2SetItem));
+	B2_ASSERT(b2IsPowerOf2(newCapacity) && oldCount < newCapacity);
+
+	set->count = 0;
+	set->capacity = newCapacity;
+	set->keys = b2Alloc(set->allocator, set->capacity * sizeof(uint64_t));
+	memset(set->keys, 0, set->capacity * sizeof(uint64_t));
 
-	// Transfer items into new array
+	// Transfer keys into new array
 	for (uint32_t i = 0; i < oldCapacity; ++i)
 	{
-		b2SetItem* item = oldItems + i;
-		if (item->hash == 0)
+		uint64_t key = oldKeys[i];
+		if (key == 0)
 		{
-			// this item was empty
+			// this slot was empty
 			continue;
 		}
 
-		b2AddKeyHaveCapacity(set, item->key, item->hash);
+		b2AddKeyHaveCapacity(set, key, b2KeyHash(key));
 	}
 
 	B2_ASSERT(set->count == oldCount);
 
-	b2Free(oldItems, oldCapacity * sizeof(b2SetItem));
+	b2Free(set->allocator, oldKeys, oldCapacity * sizeof(uint64_t));
+}
+
+static void b2GrowTable(b2HashSet* set)
+{
+	b2ResizeTable(set, 2 * set->capacity);
+}
+
+void b2ShrinkSet(b2HashSet* set)
+{
+	// Keep the load factor below the growth threshold
+	int32_t needed = (int32_t)(B2_SET_LOAD_DENOMINATOR * set->count / B2_SET_LOAD_NUMERATOR) + 1;
+	int32_t newCapacity = b2GetShrinkCapacity((int32_t)set->capacity, needed, 16);
+	newCapacity = (int32_t)b2RoundUpPowerOf2((uint32_t)newCapacity);
+	if (newCapacity < (int32_t)set->capacity)
+	{
+		b2ResizeTable(set, (uint32_t)newCapacity);
+	}
 }
 
 bool b2ContainsKey(const b2HashSet* set, uint64_t key)
@@ -160,7 +177,7 @@ bool b2ContainsKey(const b2HashSet* set, uint64_t key)
 	B2_ASSERT(key != 0);
 	uint32_t hash = b2KeyHash(key);
 	int32_t index = b2FindSlot(set, key, hash);
-	return set->items[index].key == key;
+	return set->keys[index] == key;
 }
 
 bool b2AddKey(b2HashSet* set, uint64_t key)
@@ -169,22 +186,24 @@ bool b2AddKey(b2HashSet* set, uint64_t key)
 	B2_ASSERT(key != 0);
 
 	uint32_t hash = b2KeyHash(key);
-	B2_ASSERT(hash != 0);
-
 	int32_t index = b2FindSlot(set, key, hash);
-	if (set->items[index].hash != 0)
+	if (set->keys[index] != 0)
 	{
 		// Already in set
-		B2_ASSERT(set->items[index].hash == hash && set->items[index].key == key);
+		B2_ASSERT(set->keys[index] == key);
 		return true;
 	}
 
-	if (2 * set->count >= set->capacity)
+	if (B2_SET_LOAD_DENOMINATOR * set->count >= B2_SET_LOAD_NUMERATOR * set->capacity)
 	{
 		b2GrowTable(set);
+		b2AddKeyHaveCapacity(set, key, hash);
+		return false;
 	}
 
-	b2AddKeyHaveCapacity(set, key, hash);
+	// The slot from the search is still good
+	set->keys[index] = key;
+	set->count += 1;
 	return false;
 }
 
@@ -193,33 +212,32 @@ bool b2RemoveKey(b2HashSet* set, uint64_t key)
 {
 	uint32_t hash = b2KeyHash(key);
 	int32_t i = b2FindSlot(set, key, hash);
-	b2SetItem* items = set->items;
-	if (items[i].hash == 0)
+	uint64_t* keys = set->keys;
+	if (keys[i] == 0)
 	{
 		// Not in set
 		return false;
 	}
 
-	// Mark item i as unoccupied
-	items[i].key = 0;
-	items[i].hash = 0;
+	// Mark slot i as unoccupied
+	keys[i] = 0;
 
 	B2_ASSERT(set->count > 0);
 	set->count -= 1;
 
-	// Attempt to fill item i
+	// Attempt to fill slot i
 	int32_t j = i;
-	uint32_t capacity = set->capacity;
+	uint32_t mask = set->capacity - 1;
 	for (;;)
 	{
-		j = (j + 1) & (capacity - 1);
-		if (items[j].hash == 0)
+		j = (j + 1) & mask;
+		if (keys[j] == 0)
 		{
 			break;
 		}
 
-		// k is the first item for the hash of j
-		int32_t k = items[j].hash & (capacity - 1);
+		// k is the first slot for the key in j
+		int32_t k = b2KeyHash(keys[j]) & mask;
 
 		// determine if k lies cyclically in (i,j]
 		// i <= j: | i..k..j |
@@ -240,11 +258,10 @@ bool b2RemoveKey(b2HashSet* set, uint64_t key)
 		}
 
 		// Move j into i
-		items[i] = items[j];
+		keys[i] = keys[j];
 
-		// Mark item j as unoccupied
-		items[j].key = 0;
-		items[j].hash = 0;
+		// Mark slot j as unoccupied
+		keys[j] = 0;
 
 		i = j;
 	}
@@ -6,26 +6,31 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+typedef struct b2Allocator b2Allocator;
+
 #define B2_SHAPE_PAIR_KEY(K1, K2) K1 < K2 ? (uint64_t)K1 << 32 | (uint64_t)K2 : (uint64_t)K2 << 32 | (uint64_t)K1
 
-typedef struct b2SetItem
-{
-	uint64_t key;
-	uint32_t hash;
-} b2SetItem;
+// The set grows when the load factor reaches this fraction
+#define B2_SET_LOAD_NUMERATOR 1
+#define B2_SET_LOAD_DENOMINATOR 2
 
+// Open addressing with linear probing. Zero is not a valid key and marks empty slots.
 typedef struct b2HashSet
 {
-	b2SetItem* items;
+	b2Allocator* allocator;
+	uint64_t* keys;
 	uint32_t capacity;
 	uint32_t count;
 } b2HashSet;
 
-b2HashSet b2CreateSet(int32_t capacity);
+b2HashSet b2CreateSet(b2Allocator* allocator, int32_t capacity);
 void b2DestroySet(b2HashSet* set);
 
 void b2ClearSet(b2HashSet* set);
 
+// Release capacity if the set is mostly empty
+void b2ShrinkSet(b2HashSet* set);
+
 // Returns true if key was already in set
 bool b2AddKey(b2HashSet* set, uint64_t key);
 
@@ -0,0 +1,215 @@
+// SPDX-FileCopyrightText: 2023 Erin Catto
+// SPDX-License-Identifier: MIT
+
+#include "task_graph.h"
+
+#include "core.h"
+#include "world.h"
+
+#include "box2d/timer.h"
+
+void b2InitTaskGraph(b2TaskGraph* graph, b2World* world)
+{
+	graph->world = world;
+	graph->nodeCount = 0;
+}
+
+static int32_t b2AddNode(b2TaskGraph* graph, b2TaskCallback* task, int32_t itemCount, int32_t minRange, void* context,
+						 uint32_t dependencies, bool isSerial)
+{
+	B2_ASSERT(graph->nodeCount < b2_maxGraphNodes);
+
+	int32_t nodeIndex = graph->nodeCount;
+
+	// Only earlier nodes can be dependencies
+	B2_ASSERT((dependencies >> nodeIndex) == 0);
+
+	b2GraphNode* node = graph->nodes + nodeIndex;
+	node->task = task;
+	node->context = context;
+	node->itemCount = itemCount;
+	node->minRange = minRange;
+	node->dependencies = dependencies;
+	node->isSerial = isSerial;
+	node->isDetached = false;
+	node->userTask = NULL;
+	node->isStarted = false;
+	node->isFinished = false;
+
+	graph->nodeCount += 1;
+	return nodeIndex;
+}
+
+int32_t b2AddParallelNode(b2TaskGraph* graph, b2TaskCallback* task, int32_t itemCount, int32_t minRange, void* context,
+						  uint32_t dependencies)
+{
+	return b2AddNode(graph, task, itemCount, minRange, context, dependencies, false);
+}
+
+int32_t b2AddSerialNode(b2TaskGraph* graph, b2TaskCallback* task, void* context, uint32_t dependencies)
+{
+	return b2AddNode(graph, task, 1, 1, context, dependencies, true);
+}
+
+static bool b2CanStartNode(const b2TaskGraph* graph, const b2GraphNode* node)
+{
+	bool useDependencies = graph->world->enqueueTaskWithDependenciesFcn != NULL;
+
+	for (int32_t i = 0; i < graph->nodeCount; ++i)
+	{
+		if ((node->dependencies & b2NodeBit(i)) == 0)
+		{
+			continue;
+		}
+
+		const b2GraphNode* dependency = graph->nodes + i;
+		if (dependency->isFinished)
+		{
+			continue;
+		}
+
+		// The task system can only wait on parallel nodes it has already been given
+		if (useDependencies == false || node->isSerial || dependency->isSerial || dependency->isStarted == false)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void b2StartNode(b2TaskGraph* graph, b2GraphNode* node)
+{
+	b2World* world = graph->world;
+	node->isStarted = true;
+
+	if (node->isSerial)
+	{
+		node->task(0, node->itemCount, 0, node->context);
+		node->isFinished = true;
+		return;
+	}
+
+	void* dependencies[b2_maxGraphNodes];
+	int32_t dependencyCount = 0;
+	for (int32_t i = 0; i < graph->nodeCount; ++i)
+	{
+		const b2GraphNode* dependency = graph->nodes + i;
+		if ((node->dependencies & b2NodeBit(i)) != 0 && dependency->isFinished == false)
+		{
+			B2_ASSERT(dependency->userTask != NULL);
+			dependencies[dependencyCount++] = dependency->userTask;
+		}
+	}
+
+	if (dependencyCount > 0)
+	{
+		node->userTask = world->enqueueTaskWithDependenciesFcn(node->task, node->itemCount, node->minRange, node->context,
+															   dependencies, dependencyCount, world->userTaskContext);
+	}
+	else
+	{
+		node->userTask =
+			world->enqueueTaskFcn(node->task, node->itemCount, node->minRange, node->context, world->userTaskContext);
+	}
+
+	world->taskCount += 1;
+
+	if (node->userTask == NULL)
+	{
+		// The task ran during the enqueue
+		node->isFinished = true;
+	}
+	else
+	{
+		world->activeTaskCount += 1;
+	}
+}
+
+static void b2FinishNode(b2TaskGraph* graph, b2GraphNode* node)
+{
+	B2_ASSERT(node->isStarted && node->isFinished == false && node->userTask != NULL);
+
+	b2World* world = graph->world;
+	world->finishTaskFcn(node->userTask, world->userTaskContext);
+	world->activeTaskCount -= 1;
+	node->userTask = NULL;
+	node->isFinished = true;
+}
+
+void b2RunTaskGraph(b2TaskGraph* graph)
+{
+	b2TracyCZoneNC(task_graph, "Task Graph", b2_colorLightSlateGray, true);
+
+	int32_t nodeCount = graph->nodeCount;
+	b2GraphNode* nodes = graph->nodes;
+
+	for (;;)
+	{
+		// Start all nodes that are ready in order. Serial nodes run right here and may make later nodes ready.
+		uint32_t waitingDependencies = 0;
+		for (int32_t i = 0; i < nodeCount; ++i)
+		{
+			b2GraphNode* node = nodes + i;
+			if (node->isStarted)
+			{
+				continue;
+			}
+
+			if (b2CanStartNode(graph, node))
+			{
+				b2StartNode(graph, node);
+			}
+			else
+			{
+				waitingDependencies |= node->dependencies;
+			}
+		}
+
+		// Finish the first running node that a waiting node depends on. Otherwise finish the
+		// first running node that is not detached.
+		int32_t finishIndex = B2_NULL_INDEX;
+		for (int32_t i = 0; i < nodeCount && finishIndex == B2_NULL_INDEX; ++i)
+		{
+			const b2GraphNode* node = nodes + i;
+			if (node->isStarted && node->isFinished == false && (waitingDependencies & b2NodeBit(i)) != 0)
+			{
+				finishIndex = i;
+			}
+		}
+
+		for (int32_t i = 0; i < nodeCount && finishIndex == B2_NULL_INDEX; ++i)
+		{
+			const b2GraphNode* node = nodes + i;
+			if (node->isStarted && node->isFinished == false && node->isDetached == false)
+			{
+				finishIndex = i;
+			}
+		}
+
+		if (finishIndex == B2_NULL_INDEX)
+		{
+			break;
+		}
+
+		b2FinishNode(graph, nodes + finishIndex);
+	}
+
+#ifndef NDEBUG
+	for (int32_t i = 0; i < nodeCount; ++i)
+	{
+		B2_ASSERT(nodes[i].isStarted);
+		B2_ASSERT(nodes[i].isFinished || nodes[i].isDetached);
+	}
+#endif
+
+	b2TracyCZoneEnd(task_graph);
+}
+
+void* b2GetDetachedTask(b2TaskGraph* graph, int32_t nodeIndex)
+{
+	B2_ASSERT(0 <= nodeIndex && nodeIndex < graph->nodeCount);
+	b2GraphNode* node = graph->nodes + nodeIndex;
+	B2_ASSERT(node->isDetached && node->isStarted);
+	return node->isFinished ? NULL : node->userTask;
+}
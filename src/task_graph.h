@@ -0,0 +1,65 @@
+// SPDX-FileCopyrightText: 2023 Erin Catto
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "core.h"
+
+#include "box2d/types.h"
+
+typedef struct b2World b2World;
+
+#define b2_maxGraphNodes 16
+
+// A node of a task graph. A parallel node is a parallel-for on the world task system. A serial node runs
+// on the thread that runs the graph and may enqueue its own tasks.
+typedef struct b2GraphNode
+{
+	b2TaskCallback* task;
+	void* context;
+	int32_t itemCount;
+	int32_t minRange;
+
+	// Nodes that must finish before this node starts, see b2NodeBit
+	uint32_t dependencies;
+
+	bool isSerial;
+
+	// The graph does not wait for a detached node unless another node depends on it
+	bool isDetached;
+
+	void* userTask;
+	bool isStarted;
+	bool isFinished;
+} b2GraphNode;
+
+// Describes part of a time step as tasks with dependencies. Independent nodes overlap. Nodes can only
+// depend on nodes added before them, so the graph has no cycles.
+// Only the collide phase uses a graph: the tree rebuild, narrow-phase, contact state update and the
+// sensor stages. Continuous collision and event finalization still run serially after it in b2Solve.
+typedef struct b2TaskGraph
+{
+	b2World* world;
+	b2GraphNode nodes[b2_maxGraphNodes];
+	int32_t nodeCount;
+} b2TaskGraph;
+
+static inline uint32_t b2NodeBit(int32_t nodeIndex)
+{
+	return nodeIndex == B2_NULL_INDEX ? 0 : 1u << nodeIndex;
+}
+
+void b2InitTaskGraph(b2TaskGraph* graph, b2World* world);
+
+// These return the node index
+int32_t b2AddParallelNode(b2TaskGraph* graph, b2TaskCallback* task, int32_t itemCount, int32_t minRange, void* context,
+						  uint32_t dependencies);
+int32_t b2AddSerialNode(b2TaskGraph* graph, b2TaskCallback* task, void* context, uint32_t dependencies);
+
+// Start every node once its dependencies are finished and wait for all nodes that are not detached.
+// If the world has an enqueue with dependencies callback, parallel nodes are handed to the task system
+// before their parallel dependencies finish.
+void b2RunTaskGraph(b2TaskGraph* graph);
+
+// The user task of a detached node that is still running, otherwise NULL. The caller must finish it.
+void* b2GetDetachedTask(b2TaskGraph* graph, int32_t nodeIndex);
@@ -20,8 +20,11 @@
 #include "island.h"
 #include "joint.h"
 #include "pool.h"
+#include "scheduler.h"
+#include "sensor.h"
 #include "shape.h"
 #include "solver_data.h"
+#include "task_graph.h"
 
 // needed for dll export
 #include "box2d/box2d.h"
@@ -35,6 +38,9 @@
 #include <stdio.h>
 #include <string.h>
 
+// Initial size of the scratch stack of each worker thread. These grow as needed.
+#define B2_TASK_STACK_CAPACITY (16 * 1024)
+
 b2World b2_worlds[b2_maxWorlds];
 
 b2World* b2GetWorldFromId(b2WorldId id)
@@ -106,41 +112,60 @@ b2WorldId b2CreateWorld(const b2WorldDef* def)
 
 	world->index = id.index;
 
-	world->blockAllocator = b2CreateBlockAllocator();
-	world->stackAllocator = b2CreateStackAllocator(def->arenaAllocatorCapacity);
+	if (def->allocFcn != NULL && def->freeFcn != NULL)
+	{
+		world->allocator.allocFcn = def->allocFcn;
+		world->allocator.freeFcn = def->freeFcn;
+		world->allocator.context = def->allocContext;
+	}
+
+	// The world lives in a static array, so containers can keep a pointer to its allocator
+	b2Allocator* allocator = &world->allocator;
 
-	b2CreateBroadPhase(&world->broadPhase);
-	b2CreateGraph(&world->graph, def->bodyCapacity, def->contactCapacity, def->jointCapacity);
+	world->blockAllocator = b2CreateBlockAllocator(allocator);
+	world->stackAllocator = b2CreateStackAllocator(allocator, def->arenaAllocatorCapacity);
+
+	b2CreateBroadPhase(&world->broadPhase, allocator);
+	b2CreateGraph(&world->graph, allocator, def->bodyCapacity, def->contactCapacity, def->jointCapacity);
 
 	// pools
-	world->bodyPool = b2CreatePool(sizeof(b2Body), B2_MAX(def->bodyCapacity, 1));
+	world->bodyPool = b2CreatePool(allocator, sizeof(b2Body), B2_MAX(def->bodyCapacity, 1));
 	world->bodies = (b2Body*)world->bodyPool.memory;
+	world->bodySimArray = b2CreateArray(allocator, sizeof(b2BodySim), B2_MAX(def->bodyCapacity, 1));
+	world->bodyHandlePool = b2CreatePool(allocator, sizeof(b2BodyHandle), B2_MAX(def->bodyCapacity, 1));
+	world->bodyHandles = (b2BodyHandle*)world->bodyHandlePool.memory;
 
-	world->shapePool = b2CreatePool(sizeof(b2Shape), B2_MAX(def->shapeCapacity, 1));
+	world->shapePool = b2CreatePool(allocator, sizeof(b2Shape), B2_MAX(def->shapeCapacity, 1));
 	world->shapes = (b2Shape*)world->shapePool.memory;
 
-	world->chainPool = b2CreatePool(sizeof(b2ChainShape), 4);
+	world->chainPool = b2CreatePool(allocator, sizeof(b2ChainShape), 4);
 	world->chains = (b2ChainShape*)world->chainPool.memory;
 
-	world->contactPool = b2CreatePool(sizeof(b2Contact), B2_MAX(def->contactCapacity, 1));
+	world->contactPool = b2CreatePool(allocator, sizeof(b2Contact), B2_MAX(def->contactCapacity, 1));
 	world->contacts = (b2Contact*)world->contactPool.memory;
 
-	world->jointPool = b2CreatePool(sizeof(b2Joint), B2_MAX(def->jointCapacity, 1));
+	world->jointPool = b2CreatePool(allocator, sizeof(b2Joint), B2_MAX(def->jointCapacity, 1));
 	world->joints = (b2Joint*)world->jointPool.memory;
 
-	world->islandPool = b2CreatePool(sizeof(b2Island), B2_MAX(def->bodyCapacity, 1));
+	world->islandPool = b2CreatePool(allocator, sizeof(b2Island), B2_MAX(def->bodyCapacity, 1));
 	world->islands = (b2Island*)world->islandPool.memory;
 
-	world->awakeIslandArray = b2CreateArray(sizeof(int32_t), B2_MAX(def->bodyCapacity, 1));
+	world->manifoldPool = b2CreatePool(allocator, sizeof(b2ContactManifold), B2_MAX(def->contactCapacity, 1));
+	world->manifolds = (b2ContactManifold*)world->manifoldPool.memory;
+
+	world->awakeIslandArray = b2CreateArray(allocator, sizeof(int32_t), B2_MAX(def->bodyCapacity, 1));
+	world->islandSplitArray = b2CreateArray(allocator, sizeof(b2IslandSplit), 4);
+	world->reservedIslandArray = b2CreateArray(allocator, sizeof(int32_t), 4);
 
-	world->awakeContactArray = b2CreateArray(sizeof(int32_t), B2_MAX(def->contactCapacity, 1));
-	world->contactAwakeIndexArray = b2CreateArray(sizeof(int32_t), world->contactPool.capacity);
+	world->awakeContactArray = b2CreateArray(allocator, sizeof(int32_t), B2_MAX(def->contactCapacity, 1));
+	world->contactAwakeIndexArray = b2CreateArray(allocator, sizeof(int32_t), world->contactPool.capacity);
 
-	world->sensorBeginEventArray = b2CreateArray(sizeof(b2SensorBeginTouchEvent), 4);
-	world->sensorEndEventArray = b2CreateArray(sizeof(b2SensorEndTouchEvent), 4);
+	world->sensorArray = b2CreateArray(allocator, sizeof(b2Sensor), 4);
+	world->sensorBeginEventArray = b2CreateArray(allocator, sizeof(b2SensorBeginTouchEvent), 4);
+	world->sensorEndEventArray = b2CreateArray(allocator, sizeof(b2SensorEndTouchEvent), 4);
 
-	world->contactBeginArray = b2CreateArray(sizeof(b2ContactBeginTouchEvent), 4);
-	world->contactEndArray = b2CreateArray(sizeof(b2ContactEndTouchEvent), 4);
+	world->contactBeginArray = b2CreateArray(allocator, sizeof(b2ContactBeginTouchEvent), 4);
+	world->contactEndArray = b2CreateArray(allocator, sizeof(b2ContactEndTouchEvent), 4);
 
 	world->stepId = 0;
 	world->activeTaskCount = 0;
@@ -159,9 +184,13 @@ b2WorldId b2CreateWorld(const b2WorldDef* def)
 	world->locked = false;
 	world->enableWarmStarting = true;
 	world->enableContinuous = true;
+	B2_ASSERT(def->spatialSortInterval >= 0);
+	world->spatialSortInterval = B2_MAX(def->spatialSortInterval, 0);
 	world->profile = b2_emptyProfile;
 	world->userTreeTask = NULL;
-	world->splitIslandIndex = B2_NULL_INDEX;
+	world->mergeIslands = NULL;
+	B2_ASSERT(def->islandSplitBudget >= 0);
+	world->islandSplitBudget = B2_MAX(def->islandSplitBudget, 0);
 
 	id.revision = world->revision;
 
@@ -169,9 +198,20 @@ b2WorldId b2CreateWorld(const b2WorldDef* def)
 	{
 		world->workerCount = B2_MIN(def->workerCount, b2_maxWorkers);
 		world->enqueueTaskFcn = def->enqueueTask;
+		world->enqueueTaskWithDependenciesFcn = def->enqueueTaskWithDependencies;
 		world->finishTaskFcn = def->finishTask;
 		world->userTaskContext = def->userTaskContext;
 	}
+	else if (def->workerCount > 1)
+	{
+		// No task system was provided, so use the built-in one
+		world->workerCount = B2_MIN(def->workerCount, b2_maxWorkers);
+		world->scheduler = b2CreateScheduler(allocator, world->workerCount, def->enableWorkerAffinity);
+		world->enableWorkerAffinity = def->enableWorkerAffinity;
+		world->enqueueTaskFcn = b2EnqueueSchedulerTask;
+		world->finishTaskFcn = b2FinishSchedulerTask;
+		world->userTaskContext = world->scheduler;
+	}
 	else
 	{
 		world->workerCount = 1;
@@ -180,13 +220,17 @@ b2WorldId b2CreateWorld(const b2WorldDef* def)
 		world->userTaskContext = NULL;
 	}
 
-	world->taskContextArray = b2CreateArray(sizeof(b2TaskContext), world->workerCount);
+	world->taskContextArray = b2CreateArray(allocator, sizeof(b2TaskContext), world->workerCount);
 	for (uint32_t i = 0; i < world->workerCount; ++i)
 	{
-		world->taskContextArray[i].contactStateBitSet = b2CreateBitSet(def->contactCapacity);
-		world->taskContextArray[i].awakeContactBitSet = b2CreateBitSet(def->contactCapacity);
-		world->taskContextArray[i].shapeBitSet = b2CreateBitSet(def->shapeCapacity);
-		world->taskContextArray[i].awakeIslandBitSet = b2CreateBitSet(256);
+		world->taskContextArray[i].contactStateBitSet = b2CreateBitSet(allocator, def->contactCapacity);
+		world->taskContextArray[i].awakeContactBitSet = b2CreateBitSet(allocator, def->contactCapacity);
+		world->taskContextArray[i].shapeBitSet = b2CreateBitSet(allocator, def->shapeCapacity);
+		world->taskContextArray[i].compoundBitSet = b2CreateBitSet(allocator, def->bodyCapacity);
+		world->taskContextArray[i].fastBodyBitSet = b2CreateBitSet(allocator, def->bodyCapacity);
+		world->taskContextArray[i].awakeIslandBitSet = b2CreateBitSet(allocator, 256);
+		world->taskContextArray[i].pendingManifoldArray = b2CreateArray(allocator, sizeof(b2PendingManifold), 16);
+		world->taskContextArray[i].stackAllocator = b2CreateStackAllocator(allocator, B2_TASK_STACK_CAPACITY);
 	}
 
 	return id;
@@ -194,6 +238,9 @@ b2WorldId b2CreateWorld(const b2WorldDef* def)
 
 void b2DestroyWorld(b2WorldId id)
 {
+	// Let a step in flight finish
+	b2World_WaitStep(id);
+
 	b2World* world = b2GetWorldFromId(id);
 
 	for (uint32_t i = 0; i < world->workerCount; ++i)
@@ -201,14 +248,28 @@ void b2DestroyWorld(b2WorldId id)
 		b2DestroyBitSet(&world->taskContextArray[i].contactStateBitSet);
 		b2DestroyBitSet(&world->taskContextArray[i].awakeContactBitSet);
 		b2DestroyBitSet(&world->taskContextArray[i].shapeBitSet);
+		b2DestroyBitSet(&world->taskContextArray[i].compoundBitSet);
+		b2DestroyBitSet(&world->taskContextArray[i].fastBodyBitSet);
 		b2DestroyBitSet(&world->taskContextArray[i].awakeIslandBitSet);
+		b2DestroyArray(world->taskContextArray[i].pendingManifoldArray, sizeof(b2PendingManifold));
+		b2DestroyStackAllocator(world->taskContextArray[i].stackAllocator);
 	}
 
 	b2DestroyArray(world->taskContextArray, sizeof(b2TaskContext));
 	b2DestroyArray(world->awakeContactArray, sizeof(int32_t));
 	b2DestroyArray(world->awakeIslandArray, sizeof(int32_t));
+	b2DestroyArray(world->islandSplitArray, sizeof(b2IslandSplit));
+	b2DestroyArray(world->reservedIslandArray, sizeof(int32_t));
 	b2DestroyArray(world->contactAwakeIndexArray, sizeof(int32_t));
 
+	int32_t sensorCount = b2Array(world->sensorArray).count;
+	for (int32_t i = 0; i < sensorCount; ++i)
+	{
+		b2DestroyArray(world->sensorArray[i].overlaps1, sizeof(b2ShapeRef));
+		b2DestroyArray(world->sensorArray[i].overlaps2, sizeof(b2ShapeRef));
+	}
+
+	b2DestroyArray(world->sensorArray, sizeof(b2Sensor));
 	b2DestroyArray(world->sensorBeginEventArray, sizeof(b2SensorBeginTouchEvent));
 	b2DestroyArray(world->sensorEndEventArray, sizeof(b2SensorEndTouchEvent));
 
@@ -216,8 +277,20 @@ void b2DestroyWorld(b2WorldId id)
 	b2DestroyArray(world->contactEndArray, sizeof(b2ContactEndTouchEvent));
 
 	b2DestroyPool(&world->islandPool);
+	b2DestroyPool(&world->manifoldPool);
 	b2DestroyPool(&world->jointPool);
 	b2DestroyPool(&world->contactPool);
+
+	int32_t shapeCapacity = world->shapePool.capacity;
+	for (int32_t i = 0; i < shapeCapacity; ++i)
+	{
+		b2Shape* shape = world->shapes + i;
+		if (b2ObjectValid(&shape->object))
+		{
+			b2DestroyShapeAllocations(world, shape);
+		}
+	}
+
 	b2DestroyPool(&world->shapePool);
 
 	int32_t chainCapacity = world->chainPool.capacity;
@@ -226,11 +299,29 @@ void b2DestroyWorld(b2WorldId id)
 		b2ChainShape* chain = world->chains + i;
 		if (b2ObjectValid(&chain->object))
 		{
-			b2Free(chain->shapeIndices, chain->count * sizeof(int32_t));
+			b2Free(&world->allocator, chain->shapeIndices, chain->count * sizeof(int32_t));
 		}
 	}
 
 	b2DestroyPool(&world->chainPool);
+
+	int32_t bodyCapacity = world->bodyPool.capacity;
+	for (int32_t i = 0; i < bodyCapacity; ++i)
+	{
+		b2Body* body = world->bodies + i;
+		if (b2ObjectValid(&body->object) && body->isCompound)
+		{
+			b2DynamicTree_Destroy(&body->shapeTree);
+		}
+	}
+
+	if (world->scheduler != NULL)
+	{
+		b2DestroyScheduler(world->scheduler);
+	}
+
+	b2DestroyArray(world->bodySimArray, sizeof(b2BodySim));
+	b2DestroyPool(&world->bodyHandlePool);
 	b2DestroyPool(&world->bodyPool);
 
 	b2DestroyGraph(&world->graph);
@@ -250,8 +341,9 @@ static void b2CollideTask(int32_t startIndex, int32_t endIndex, uint32_t threadI
 	B2_ASSERT(threadIndex < world->workerCount);
 	b2TaskContext* taskContext = world->taskContextArray + threadIndex;
 	b2Shape* shapes = world->shapes;
-	b2Body* bodies = world->bodies;
+	b2BodySim* bodySims = world->bodySimArray;
 	b2Contact* contacts = world->contacts;
+	b2ContactManifold* manifolds = world->manifolds;
 	int32_t awakeCount = b2Array(world->awakeContactArray).count;
 	int32_t* awakeContactArray = world->awakeContactArray;
 	int32_t* contactAwakeIndexArray = world->contactAwakeIndexArray;
@@ -295,9 +387,25 @@ static void b2CollideTask(int32_t startIndex, int32_t endIndex, uint32_t threadI
 			B2_ASSERT(wasTouching || contact->islandIndex == B2_NULL_INDEX);
 
 			// Update contact respecting shape/body order (A,B)
-			b2Body* bodyA = bodies + shapeA->bodyIndex;
-			b2Body* bodyB = bodies + shapeB->bodyIndex;
-			b2UpdateContact(world, contact, shapeA, bodyA, shapeB, bodyB);
+			b2BodySim* bodySimA = bodySims + shapeA->bodyIndex;
+			b2BodySim* bodySimB = bodySims + shapeB->bodyIndex;
+
+			// Touching contacts update their manifold in place. The pool cannot grow during this task.
+			b2PendingManifold pending;
+			b2Manifold* manifold;
+			if (contact->manifoldIndex != B2_NULL_INDEX)
+			{
+				B2_ASSERT(wasTouching);
+				manifold = &manifolds[contact->manifoldIndex].manifold;
+			}
+			else
+			{
+				pending.contactIndex = contactIndex;
+				pending.manifold = b2_emptyManifold;
+				manifold = &pending.manifold;
+			}
+
+			b2UpdateContact(world, contact, manifold, shapeA, bodySimA, shapeB, bodySimB);
 
 			bool touching = (contact->flags & b2_contactTouchingFlag) != 0;
 
@@ -306,6 +414,7 @@ static void b2CollideTask(int32_t startIndex, int32_t endIndex, uint32_t threadI
 			{
 				contact->flags |= b2_contactStartedTouching;
 				b2SetBit(&taskContext->contactStateBitSet, awakeIndex);
+				b2Array_Push(taskContext->pendingManifoldArray, pending);
 			}
 			else if (touching == false && wasTouching == true)
 			{
@@ -332,44 +441,83 @@ static void b2UpdateTreesTask(int32_t startIndex, int32_t endIndex, uint32_t thr
 	b2TracyCZoneEnd(tree_task);
 }
 
-// Narrow-phase collision
-static void b2Collide(b2World* world)
+// A contact that started or stopped touching, or stopped overlapping, during the narrow-phase
+typedef struct b2ContactStateChange
 {
-	B2_ASSERT(world->workerCount > 0);
+	int32_t contactIndex;
+	int32_t shapeIndexA;
+	int32_t shapeIndexB;
+	int32_t manifoldIndex;
 
-	b2TracyCZoneNC(collide, "Collide", b2_colorDarkOrchid, true);
+	// Event slots or B2_NULL_INDEX
+	int32_t beginIndex;
+	int32_t endIndex;
+} b2ContactStateChange;
 
-	// Tasks that can be done in parallel with the narrow-phase
-	// - rebuild the collision tree for dynamic and kinematic bodies to keep their query performance good
-	world->userTreeTask = world->enqueueTaskFcn(&b2UpdateTreesTask, 1, 1, world, world->userTaskContext);
-	world->taskCount += 1;
-	world->activeTaskCount += world->userTreeTask == NULL ? 0 : 1;
+typedef struct b2ContactEventContext
+{
+	b2World* world;
+	const b2ContactStateChange* changes;
+	const b2ContactManifold* manifolds;
+} b2ContactEventContext;
 
-	int32_t awakeContactCount = b2Array(world->awakeContactArray).count;
+// Each event has a reserved slot, so the event order does not depend on the task ranges
+static void b2ContactEventTask(int32_t startIndex, int32_t endIndex, uint32_t threadIndex, void* context)
+{
+	B2_MAYBE_UNUSED(threadIndex);
 
-	if (awakeContactCount == 0)
-	{
-		b2TracyCZoneEnd(collide);
-		return;
-	}
+	b2TracyCZoneNC(contact_events, "Contact Events", b2_colorCoral, true);
 
-	for (uint32_t i = 0; i < world->workerCount; ++i)
-	{
-		b2SetBitCountAndClear(&world->taskContextArray[i].contactStateBitSet, awakeContactCount);
-	}
+	b2ContactEventContext* eventContext = context;
+	b2World* world = eventContext->world;
+	const b2Shape* shapes = world->shapes;
+	int16_t worldIndex = world->index;
+	b2ContactBeginTouchEvent* beginEvents = world->contactBeginArray;
+	b2ContactEndTouchEvent* endEvents = world->contactEndArray;
 
-	// Task should take at least 40us on a 4GHz CPU (10K cycles)
-	int32_t minRange = 64;
-	void* userCollideTask = world->enqueueTaskFcn(&b2CollideTask, awakeContactCount, minRange, world, world->userTaskContext);
-	world->taskCount += 1;
-	if (userCollideTask != NULL)
+	for (int32_t i = startIndex; i < endIndex; ++i)
 	{
-		world->finishTaskFcn(userCollideTask, world->userTaskContext);
+		const b2ContactStateChange* change = eventContext->changes + i;
+		if (change->beginIndex == B2_NULL_INDEX && change->endIndex == B2_NULL_INDEX)
+		{
+			continue;
+		}
+
+		const b2Shape* shapeA = shapes + change->shapeIndexA;
+		const b2Shape* shapeB = shapes + change->shapeIndexB;
+		b2ShapeId shapeIdA = {shapeA->object.index, worldIndex, shapeA->object.revision};
+		b2ShapeId shapeIdB = {shapeB->object.index, worldIndex, shapeB->object.revision};
+
+		if (change->beginIndex != B2_NULL_INDEX)
+		{
+			B2_ASSERT(change->manifoldIndex != B2_NULL_INDEX);
+			b2ContactBeginTouchEvent* event = beginEvents + change->beginIndex;
+			event->shapeIdA = shapeIdA;
+			event->shapeIdB = shapeIdB;
+			event->manifold = eventContext->manifolds[change->manifoldIndex].manifold;
+		}
+		else
+		{
+			b2ContactEndTouchEvent* event = endEvents + change->endIndex;
+			event->shapeIdA = shapeIdA;
+			event->shapeIdB = shapeIdB;
+		}
 	}
 
-	// Serially update contact state
+	b2TracyCZoneEnd(contact_events);
+}
+
+// Serially update contact state after the narrow-phase
+static void b2UpdateContactStatesTask(int32_t startIndex, int32_t endIndex, uint32_t threadIndex, void* context)
+{
+	B2_MAYBE_UNUSED(startIndex);
+	B2_MAYBE_UNUSED(endIndex);
+	B2_MAYBE_UNUSED(threadIndex);
+
 	b2TracyCZoneNC(contact_state, "Contact State", b2_colorCoral, true);
 
+	b2World* world = context;
+
 	// Bitwise OR all contact bits
 	b2BitSet* bitSet = &world->taskContextArray[0].contactStateBitSet;
 	for (uint32_t i = 1; i < world->workerCount; ++i)
@@ -377,16 +525,30 @@ static void b2Collide(b2World* world)
 		b2InPlaceUnion(bitSet, &world->taskContextArray[i].contactStateBitSet);
 	}
 
-	// Prepare to capture events
-	b2Array_Clear(world->sensorBeginEventArray);
-	b2Array_Clear(world->sensorEndEventArray);
-	b2Array_Clear(world->contactBeginArray);
-	b2Array_Clear(world->contactEndArray);
+	// Give new touching contacts storage in the manifold pool. The order of the pool
+	// slots does not affect the simulation, so the threads are simply visited in order.
+	for (uint32_t i = 0; i < world->workerCount; ++i)
+	{
+		b2PendingManifold* pendingArray = world->taskContextArray[i].pendingManifoldArray;
+		int32_t pendingCount = b2Array(pendingArray).count;
+		for (int32_t j = 0; j < pendingCount; ++j)
+		{
+			b2Contact* contact = world->contacts + pendingArray[j].contactIndex;
+			b2AddContactManifold(world, contact, &pendingArray[j].manifold);
+		}
+	}
 
-	const b2Shape* shapes = world->shapes;
-	int16_t worldIndex = world->index;
+	// Gather the contacts that changed state and reserve a slot for each event. Events keep the
+	// order of the awake contact array, same as a serial loop would produce.
+	int32_t changeCount = (int32_t)b2CountSetBits(bitSet);
+	b2ContactStateChange* changes =
+		b2AllocateStackItem(world->stackAllocator, changeCount * sizeof(b2ContactStateChange), "contact changes");
 
-	// Process contact state changes. Iterate over set bits
+	int32_t beginCount = 0;
+	int32_t endCount = 0;
+	int32_t changeIndex = 0;
+
+	// Iterate over set bits
 	uint64_t word;
 	for (uint32_t k = 0; k < bitSet->blockCount; ++k)
 	{
@@ -395,126 +557,175 @@ static void b2Collide(b2World* world)
 		{
 			uint32_t ctz = b2CTZ(word);
 			uint32_t awakeIndex = 64 * k + ctz;
-			B2_ASSERT(awakeIndex < (uint32_t)awakeContactCount);
+			B2_ASSERT(awakeIndex < (uint32_t)b2Array(world->awakeContactArray).count);
 
 			int32_t contactIndex = world->awakeContactArray[awakeIndex];
 			B2_ASSERT(contactIndex != B2_NULL_INDEX);
 
-			b2Contact* contact = world->contacts + contactIndex;
-			const b2Shape* shapeA = shapes + contact->shapeIndexA;
-			const b2Shape* shapeB = shapes + contact->shapeIndexB;
-			b2ShapeId shapeIdA = {shapeA->object.index, worldIndex, shapeA->object.revision};
-			b2ShapeId shapeIdB = {shapeB->object.index, worldIndex, shapeB->object.revision};
+			const b2Contact* contact = world->contacts + contactIndex;
 			uint32_t flags = contact->flags;
 
-			if (flags & b2_contactDisjoint)
-			{
-				// Was touching?
-				if ((flags & b2_contactTouchingFlag) != 0 && (flags & b2_contactEnableContactEvents) != 0)
-				{
-					b2ContactEndTouchEvent event = {shapeIdA, shapeIdB};
-					b2Array_Push(world->contactEndArray, event);
-				}
+			b2ContactStateChange* change = changes + changeIndex;
+			change->contactIndex = contactIndex;
+			change->shapeIndexA = contact->shapeIndexA;
+			change->shapeIndexB = contact->shapeIndexB;
+			change->manifoldIndex = contact->manifoldIndex;
+			change->beginIndex = B2_NULL_INDEX;
+			change->endIndex = B2_NULL_INDEX;
 
-				// Bounding boxes no longer overlap
-				b2DestroyContact(world, contact);
-			}
-			else if (flags & b2_contactStartedTouching)
+			if (flags & b2_contactEnableContactEvents)
 			{
-				B2_ASSERT(contact->islandIndex == B2_NULL_INDEX);
-				if ((flags & b2_contactSensorFlag) != 0 && (flags & b2_contactEnableSensorEvents) != 0)
+				if (flags & b2_contactDisjoint)
 				{
-					if (shapeA->isSensor)
+					// Was touching?
+					if (flags & b2_contactTouchingFlag)
 					{
-						b2SensorBeginTouchEvent event = {shapeIdA, shapeIdB};
-						b2Array_Push(world->sensorBeginEventArray, event);
-					}
-
-					if (shapeB->isSensor)
-					{
-						b2SensorBeginTouchEvent event = {shapeIdB, shapeIdA};
-						b2Array_Push(world->sensorBeginEventArray, event);
+						change->endIndex = endCount++;
 					}
 				}
-				else
+				else if (flags & b2_contactStartedTouching)
 				{
-					if (flags & b2_contactEnableContactEvents)
-					{
-						b2ContactBeginTouchEvent event = {shapeIdA, shapeIdB, contact->manifold};
-						b2Array_Push(world->contactBeginArray, event);
-					}
-
-					b2LinkContact(world, contact);
-					b2AddContactToGraph(world, contact);
-				}
-
-				contact->flags &= ~b2_contactStartedTouching;
-			}
-			else
-			{
-				B2_ASSERT(contact->flags & b2_contactStoppedTouching);
-				if ((flags & b2_contactSensorFlag) != 0 && (flags & b2_contactEnableSensorEvents) != 0)
-				{
-					if (shapeA->isSensor)
-					{
-						b2SensorEndTouchEvent event = {shapeIdA, shapeIdB};
-						b2Array_Push(world->sensorEndEventArray, event);
-					}
-
-					if (shapeB->isSensor)
-					{
-						b2SensorEndTouchEvent event = {shapeIdB, shapeIdA};
-						b2Array_Push(world->sensorEndEventArray, event);
-					}
+					change->beginIndex = beginCount++;
 				}
 				else
 				{
-					if (contact->flags & b2_contactEnableContactEvents)
-					{
-						b2ContactEndTouchEvent event = {shapeIdA, shapeIdB};
-						b2Array_Push(world->contactEndArray, event);
-					}
-
-					b2UnlinkContact(world, contact);
-					b2RemoveContactFromGraph(world, contact);
+					change->endIndex = endCount++;
 				}
-
-				contact->flags &= ~b2_contactStoppedTouching;
 			}
 
+			changeIndex += 1;
+
 			// Clear the smallest set bit
 			word = word & (word - 1);
 		}
 	}
 
-	b2TracyCZoneEnd(contact_state);
+	B2_ASSERT(changeIndex == changeCount);
 
-	b2TracyCZoneEnd(collide);
+	b2Array_Resize((void**)&world->contactBeginArray, sizeof(b2ContactBeginTouchEvent), beginCount);
+	b2Array_Resize((void**)&world->contactEndArray, sizeof(b2ContactEndTouchEvent), endCount);
+
+	// Fill in the events in parallel with the serial contact updates below. The task
+	// only reads data that the contact updates leave alone.
+	void* userEventTask = NULL;
+	b2ContactEventContext eventContext = {world, changes, world->manifolds};
+	if (beginCount + endCount > 0)
+	{
+		userEventTask = world->enqueueTaskFcn(&b2ContactEventTask, changeCount, 64, &eventContext, world->userTaskContext);
+		world->taskCount += 1;
+		world->activeTaskCount += userEventTask == NULL ? 0 : 1;
+	}
+
+	// Link and unlink the contacts. This touches islands and the constraint graph, so it is serial.
+	for (int32_t i = 0; i < changeCount; ++i)
+	{
+		b2Contact* contact = world->contacts + changes[i].contactIndex;
+		uint32_t flags = contact->flags;
+
+		if (flags & b2_contactDisjoint)
+		{
+			// Bounding boxes no longer overlap
+			b2DestroyContact(world, contact);
+		}
+		else if (flags & b2_contactStartedTouching)
+		{
+			B2_ASSERT(contact->islandIndex == B2_NULL_INDEX);
+			b2LinkContact(world, contact);
+			b2AddContactToGraph(world, contact);
+
+			contact->flags &= ~b2_contactStartedTouching;
+		}
+		else
+		{
+			B2_ASSERT(flags & b2_contactStoppedTouching);
+			b2UnlinkContact(world, contact);
+			b2RemoveContactFromGraph(world, contact);
+			b2RemoveContactManifold(world, contact);
+
+			contact->flags &= ~b2_contactStoppedTouching;
+		}
+	}
+
+	if (userEventTask != NULL)
+	{
+		world->finishTaskFcn(userEventTask, world->userTaskContext);
+		world->activeTaskCount -= 1;
+	}
+
+	b2FreeStackItem(world->stackAllocator, changes);
+
+	b2TracyCZoneEnd(contact_state);
 }
 
-void b2World_Step(b2WorldId worldId, float timeStep, int32_t velocityIterations, int32_t relaxIterations)
+// Narrow-phase collision and sensors
+static void b2Collide(b2World* world)
 {
-	if (timeStep == 0.0f)
+	B2_ASSERT(world->workerCount > 0);
+
+	b2TracyCZoneNC(collide, "Collide", b2_colorDarkOrchid, true);
+
+	// Events from the previous step are dropped even if no contacts are awake
+	b2Array_Clear(world->contactBeginArray);
+	b2Array_Clear(world->contactEndArray);
+
+	int32_t awakeContactCount = b2Array(world->awakeContactArray).count;
+	for (uint32_t i = 0; i < world->workerCount && awakeContactCount > 0; ++i)
 	{
-		// TODO_ERIN would be useful to still process collision while paused
-		return;
+		b2SetBitCountAndClear(&world->taskContextArray[i].contactStateBitSet, awakeContactCount);
+		b2Array_Clear(world->taskContextArray[i].pendingManifoldArray);
 	}
 
-	b2TracyCZoneNC(world_step, "Step", b2_colorChartreuse, true);
+	// Independent work overlaps:
+	// - rebuild the collision tree for dynamic and kinematic bodies to keep their query performance good.
+	//   The solver finishes this task unless sensors need the trees first.
+	// - the narrow-phase, followed by contact state changes which update islands and the constraint graph
+	// - sensor overlaps, followed by sensor events. Sensors query the trees, so they wait for the tree
+	//   rebuild, and they read the island sleep state, so they wait for the contact state changes.
+	b2TaskGraph graph;
+	b2InitTaskGraph(&graph, world);
 
-	b2World* world = b2GetWorldFromId(worldId);
-	B2_ASSERT(world->locked == false);
-	if (world->locked)
+	int32_t treeNode = b2AddParallelNode(&graph, &b2UpdateTreesTask, 1, 1, world, 0);
+	graph.nodes[treeNode].isDetached = true;
+	uint32_t sensorDependencies = 0;
+
+	if (awakeContactCount > 0)
 	{
-		return;
+		// Task should take at least 40us on a 4GHz CPU (10K cycles)
+		int32_t minRange = 64;
+		int32_t collideNode = b2AddParallelNode(&graph, &b2CollideTask, awakeContactCount, minRange, world, 0);
+		int32_t stateNode = b2AddSerialNode(&graph, &b2UpdateContactStatesTask, world, b2NodeBit(collideNode));
+		sensorDependencies |= b2NodeBit(stateNode);
 	}
 
+	b2AddSensorNodes(world, &graph, treeNode, sensorDependencies);
+
+	b2RunTaskGraph(&graph);
+
+	world->userTreeTask = b2GetDetachedTask(&graph, treeNode);
+
+	b2TracyCZoneEnd(collide);
+}
+
+// The caller locks the world
+static void b2StepWorld(b2World* world, float timeStep, int32_t velocityIterations, int32_t relaxIterations)
+{
+	B2_ASSERT(world->locked);
+
+	b2TracyCZoneNC(world_step, "Step", b2_colorChartreuse, true);
+
 	world->profile = b2_emptyProfile;
 	world->activeTaskCount = 0;
 	world->taskCount = 0;
 
 	b2Timer stepTimer = b2CreateTimer();
 
+	// Keep the awake bodies in space filling curve order in memory. Bodies move slowly, so the order stays good
+	// for a while. This happens before contacts are created so nothing is in flight.
+	if (world->spatialSortInterval > 0 && world->stepId % (uint64_t)world->spatialSortInterval == 0)
+	{
+		b2SortAwakeBodies(world);
+	}
+
 	// Update collision pairs and create contacts
 	{
 		b2Timer timer = b2CreateTimer();
@@ -522,9 +733,6 @@ void b2World_Step(b2WorldId worldId, float timeStep, int32_t velocityIterations,
 		world->profile.pairs = b2GetMilliseconds(&timer);
 	}
 
-	// TODO_ERIN atomic
-	world->locked = true;
-
 	b2StepContext context = {0};
 	context.dt = timeStep;
 	context.velocityIterations = velocityIterations;
@@ -542,6 +750,7 @@ void b2World_Step(b2WorldId worldId, float timeStep, int32_t velocityIterations,
 	context.restitutionThreshold = world->restitutionThreshold;
 	context.enableWarmStarting = world->enableWarmStarting;
 	context.bodies = world->bodies;
+	context.bodySims = world->bodySimArray;
 	context.bodyCapacity = world->bodyPool.capacity;
 
 	// Update contacts
@@ -564,14 +773,17 @@ void b2World_Step(b2WorldId worldId, float timeStep, int32_t velocityIterations,
 		world->inv_dt0 = context.inv_dt;
 	}
 
-	world->locked = false;
-
 	world->profile.step = b2GetMilliseconds(&stepTimer);
 
 	B2_ASSERT(b2GetStackAllocation(world->stackAllocator) == 0);
 
-	// Ensure stack is large enough
+	// Ensure stacks are large enough
 	b2GrowStack(world->stackAllocator);
+	for (uint32_t i = 0; i < world->workerCount; ++i)
+	{
+		B2_ASSERT(b2GetStackAllocation(world->taskContextArray[i].stackAllocator) == 0);
+		b2GrowStack(world->taskContextArray[i].stackAllocator);
+	}
 
 	// Make sure all tasks that were started were also finished
 	B2_ASSERT(world->activeTaskCount == 0);
@@ -579,13 +791,252 @@ void b2World_Step(b2WorldId worldId, float timeStep, int32_t velocityIterations,
 	b2TracyCZoneEnd(world_step);
 }
 
+void b2World_Step(b2WorldId worldId, float timeStep, int32_t velocityIterations, int32_t relaxIterations)
+{
+	if (timeStep == 0.0f)
+	{
+		// TODO_ERIN would be useful to still process collision while paused
+		return;
+	}
+
+	b2World* world = b2GetWorldFromId(worldId);
+	B2_ASSERT(world->locked == false);
+	if (world->locked)
+	{
+		return;
+	}
+
+	world->locked = true;
+	b2StepWorld(world, timeStep, velocityIterations, relaxIterations);
+	world->locked = false;
+}
+
+// A step that runs inside a task of a user task system must not enqueue more tasks there. The solver
+// workers spin while they wait for each other, and with the step holding a thread they could take every
+// thread while worker 0 stays queued. So such a step runs serially with a single worker. Call these on
+// the thread that owns the world, outside the step.
+static void b2BeginSerialStep(b2World* world)
+{
+	world->savedWorkerCount = world->workerCount;
+	world->savedEnqueueTaskFcn = world->enqueueTaskFcn;
+	world->savedEnqueueTaskWithDependenciesFcn = world->enqueueTaskWithDependenciesFcn;
+	world->savedFinishTaskFcn = world->finishTaskFcn;
+
+	world->workerCount = 1;
+	world->enqueueTaskFcn = b2DefaultAddTaskFcn;
+	world->enqueueTaskWithDependenciesFcn = NULL;
+	world->finishTaskFcn = b2DefaultFinishTaskFcn;
+}
+
+static void b2EndSerialStep(b2World* world)
+{
+	world->workerCount = world->savedWorkerCount;
+	world->enqueueTaskFcn = world->savedEnqueueTaskFcn;
+	world->enqueueTaskWithDependenciesFcn = world->savedEnqueueTaskWithDependenciesFcn;
+	world->finishTaskFcn = world->savedFinishTaskFcn;
+}
+
+typedef struct b2StepWorldsContext
+{
+	b2World** worlds;
+	float timeStep;
+	int32_t velocityIterations;
+	int32_t relaxIterations;
+} b2StepWorldsContext;
+
+static void b2StepWorldsTask(int32_t startIndex, int32_t endIndex, uint32_t threadIndex, void* context)
+{
+	B2_MAYBE_UNUSED(threadIndex);
+
+	b2StepWorldsContext* stepContext = context;
+	for (int32_t i = startIndex; i < endIndex; ++i)
+	{
+		b2StepWorld(stepContext->worlds[i], stepContext->timeStep, stepContext->velocityIterations, stepContext->relaxIterations);
+	}
+}
+
+int32_t b2StepWorlds(const b2WorldId* worldIds, int32_t worldCount, float timeStep, int32_t velocityIterations,
+					 int32_t relaxIterations, b2EnqueueTaskCallback* enqueueTask, b2FinishTaskCallback* finishTask,
+					 void* userTaskContext)
+{
+	B2_ASSERT(0 <= worldCount && worldCount <= b2_maxWorlds);
+	if (timeStep == 0.0f || worldCount <= 0)
+	{
+		return 0;
+	}
+
+	// Lock the worlds. This also catches a world that is listed twice.
+	b2World* worlds[b2_maxWorlds];
+	int32_t costs[b2_maxWorlds];
+	int32_t count = 0;
+	int32_t totalBodyCount = 0;
+	for (int32_t i = 0; i < worldCount && count < b2_maxWorlds; ++i)
+	{
+		b2World* world = b2GetWorldFromId(worldIds[i]);
+		if (world->locked)
+		{
+			// Reported through the returned count
+			continue;
+		}
+
+		world->locked = true;
+		totalBodyCount += world->bodyPool.count;
+
+		// Start the busiest worlds first so a big world doesn't finish last on its own.
+		// Awake contacts are a fair estimate of the step cost.
+		int32_t cost = b2Array(world->awakeContactArray).count;
+		int32_t j = count;
+		while (j > 0 && costs[j - 1] < cost)
+		{
+			worlds[j] = worlds[j - 1];
+			costs[j] = costs[j - 1];
+			j -= 1;
+		}
+		worlds[j] = world;
+		costs[j] = cost;
+		count += 1;
+	}
+
+	if (enqueueTask != NULL && finishTask != NULL)
+	{
+		// A world with most of the bodies would bound the batch if stepped on one thread, so it
+		// takes the normal parallel step on its own task system while the other worlds run.
+		b2World* largeWorld = NULL;
+		for (int32_t i = 0; i < count; ++i)
+		{
+			if (count == 1 || 2 * worlds[i]->bodyPool.count > totalBodyCount)
+			{
+				// Move it past the batch and keep the batch in cost order
+				largeWorld = worlds[i];
+				for (int32_t j = i + 1; j < count; ++j)
+				{
+					worlds[j - 1] = worlds[j];
+				}
+				worlds[count - 1] = largeWorld;
+				break;
+			}
+		}
+
+		int32_t batchCount = largeWorld != NULL ? count - 1 : count;
+
+		// Each world in the batch steps inside a task, so the worlds step serially
+		for (int32_t i = 0; i < batchCount; ++i)
+		{
+			b2BeginSerialStep(worlds[i]);
+		}
+
+		b2StepWorldsContext context = {worlds, timeStep, velocityIterations, relaxIterations};
+		void* userTask = batchCount > 0 ? enqueueTask(b2StepWorldsTask, batchCount, 1, &context, userTaskContext) : NULL;
+
+		if (largeWorld != NULL)
+		{
+			b2StepWorld(largeWorld, timeStep, velocityIterations, relaxIterations);
+		}
+
+		if (userTask != NULL)
+		{
+			finishTask(userTask, userTaskContext);
+		}
+
+		for (int32_t i = 0; i < batchCount; ++i)
+		{
+			b2EndSerialStep(worlds[i]);
+		}
+	}
+	else
+	{
+		b2StepWorldsContext context = {worlds, timeStep, velocityIterations, relaxIterations};
+		b2StepWorldsTask(0, count, 0, &context);
+	}
+
+	for (int32_t i = 0; i < count; ++i)
+	{
+		worlds[i]->locked = false;
+	}
+
+	return count;
+}
+
+static void b2StepWorldTask(int32_t startIndex, int32_t endIndex, uint32_t threadIndex, void* context)
+{
+	B2_MAYBE_UNUSED(startIndex);
+	B2_MAYBE_UNUSED(endIndex);
+	B2_MAYBE_UNUSED(threadIndex);
+
+	b2World* world = context;
+	b2StepWorld(world, world->asyncTimeStep, world->asyncVelocityIterations, world->asyncRelaxIterations);
+}
+
+void b2World_StepAsync(b2WorldId worldId, float timeStep, int32_t velocityIterations, int32_t relaxIterations)
+{
+	if (timeStep == 0.0f)
+	{
+		return;
+	}
+
+	b2World* world = b2GetWorldFromId(worldId);
+	B2_ASSERT(world->locked == false);
+	if (world->locked)
+	{
+		return;
+	}
+
+	// The world stays locked until b2World_WaitStep
+	world->locked = true;
+	world->asyncStepActive = true;
+	world->asyncTimeStep = timeStep;
+	world->asyncVelocityIterations = velocityIterations;
+	world->asyncRelaxIterations = relaxIterations;
+
+	if (world->scheduler != NULL)
+	{
+		// The step must not run on a pool thread because the solver needs all workers
+		b2StartMainTask(world->scheduler, b2StepWorldTask, world);
+		world->userStepTask = NULL;
+	}
+	else
+	{
+		// The step becomes a task of the user's task system. Without a task system this steps right away.
+		// The task setup is restored in b2World_WaitStep.
+		b2BeginSerialStep(world);
+		world->userStepTask = world->savedEnqueueTaskFcn(b2StepWorldTask, 1, 1, world, world->userTaskContext);
+	}
+}
+
+void b2World_WaitStep(b2WorldId worldId)
+{
+	b2World* world = b2GetWorldFromId(worldId);
+	if (world->asyncStepActive == false)
+	{
+		return;
+	}
+
+	if (world->scheduler != NULL)
+	{
+		b2FinishMainTask(world->scheduler);
+	}
+	else
+	{
+		if (world->userStepTask != NULL)
+		{
+			world->savedFinishTaskFcn(world->userStepTask, world->userTaskContext);
+			world->userStepTask = NULL;
+		}
+
+		b2EndSerialStep(world);
+	}
+
+	world->asyncStepActive = false;
+	world->locked = false;
+}
+
 static void b2DrawShape(b2DebugDraw* draw, b2Shape* shape, b2Transform xf, b2Color color)
 {
 	switch (shape->type)
 	{
 		case b2_capsuleShape:
 		{
-			b2Capsule* capsule = &shape->capsule;
+			b2Capsule* capsule = shape->capsule;
 			b2Vec2 p1 = b2TransformPoint(xf, capsule->point1);
 			b2Vec2 p2 = b2TransformPoint(xf, capsule->point2);
 			draw->DrawSolidCapsule(p1, p2, capsule->radius, color, draw->context);
@@ -594,7 +1045,7 @@ static void b2DrawShape(b2DebugDraw* draw, b2Shape* shape, b2Transform xf, b2Col
 
 		case b2_circleShape:
 		{
-			b2Circle* circle = &shape->circle;
+			b2Circle* circle = shape->circle;
 			b2Vec2 center = b2TransformPoint(xf, circle->point);
 			b2Vec2 axis = b2RotateVector(xf.q, (b2Vec2){1.0f, 0.0f});
 			draw->DrawSolidCircle(center, circle->radius, axis, color, draw->context);
@@ -605,7 +1056,7 @@ static void b2DrawShape(b2DebugDraw* draw, b2Shape* shape, b2Transform xf, b2Col
 		{
 			b2Color fillColor = {0.5f * color.r, 0.5f * color.g, 0.5f * color.b, 0.5f};
 
-			b2Polygon* poly = &shape->polygon;
+			b2Polygon* poly = shape->polygon;
 			int32_t count = poly->count;
 			B2_ASSERT(count <= b2_maxPolygonVertices);
 			b2Vec2 vertices[b2_maxPolygonVertices];
@@ -628,7 +1079,7 @@ static void b2DrawShape(b2DebugDraw* draw, b2Shape* shape, b2Transform xf, b2Col
 
 		case b2_segmentShape:
 		{
-			b2Segment* segment = &shape->segment;
+			b2Segment* segment = shape->segment;
 			b2Vec2 p1 = b2TransformPoint(xf, segment->point1);
 			b2Vec2 p2 = b2TransformPoint(xf, segment->point2);
 			draw->DrawSegment(p1, p2, color, draw->context);
@@ -637,7 +1088,7 @@ static void b2DrawShape(b2DebugDraw* draw, b2Shape* shape, b2Transform xf, b2Col
 
 		case b2_smoothSegmentShape:
 		{
-			b2Segment* segment = &shape->smoothSegment.segment;
+			b2Segment* segment = &shape->smoothSegment->segment;
 			b2Vec2 p1 = b2TransformPoint(xf, segment->point1);
 			b2Vec2 p2 = b2TransformPoint(xf, segment->point2);
 			draw->DrawSegment(p1, p2, color, draw->context);
@@ -646,6 +1097,32 @@ static void b2DrawShape(b2DebugDraw* draw, b2Shape* shape, b2Transform xf, b2Col
 		}
 		break;
 
+		case b2_smoothChainShape:
+		{
+			const b2SmoothChain* chain = shape->smoothChain;
+			for (int32_t i = 0; i < chain->segmentCount; ++i)
+			{
+				b2SmoothSegment smoothSegment = b2GetSmoothChainSegment(chain, i);
+				b2Vec2 p1 = b2TransformPoint(xf, smoothSegment.segment.point1);
+				b2Vec2 p2 = b2TransformPoint(xf, smoothSegment.segment.point2);
+				draw->DrawSegment(p1, p2, color, draw->context);
+			}
+		}
+		break;
+
+		case b2_heightfieldShape:
+		{
+			const b2Heightfield* heightfield = shape->heightfield;
+			b2Vec2 p1 = b2TransformPoint(xf, (b2Vec2){0.0f, heightfield->heights[0]});
+			for (int32_t i = 1; i < heightfield->count; ++i)
+			{
+				b2Vec2 p2 = b2TransformPoint(xf, (b2Vec2){i * heightfield->cellWidth, heightfield->heights[i]});
+				draw->DrawSegment(p1, p2, color, draw->context);
+				p1 = p2;
+			}
+		}
+		break;
+
 		default:
 			break;
 	}
@@ -677,14 +1154,15 @@ void b2World_Draw(b2WorldId worldId, b2DebugDraw* draw)
 				isAwake = world->islands[b->islandIndex].awakeIndex != B2_NULL_INDEX;
 			}
 
-			b2Transform xf = b->transform;
+			b2BodySim* bodySim = world->bodySimArray + i;
+			b2Transform xf = bodySim->transform;
 			int32_t shapeIndex = b->shapeList;
 			while (shapeIndex != B2_NULL_INDEX)
 			{
 				b2Shape* shape = world->shapes + shapeIndex;
 				b2Color color;
 
-				if (b->type == b2_dynamicBody && b->mass == 0.0f)
+				if (b->type == b2_dynamicBody && bodySim->mass == 0.0f)
 				{
 					// Bad body
 					color = b2MakeColor(b2_colorRed, 0.5f);
@@ -758,7 +1236,7 @@ void b2World_Draw(b2WorldId worldId, b2DebugDraw* draw)
 
 			char buffer[32];
 			sprintf(buffer, "%d", b->object.index);
-			draw->DrawString(b->position, buffer, draw->context);
+			draw->DrawString(world->bodySimArray[i].position, buffer, draw->context);
 
 			int32_t shapeIndex = b->shapeList;
 			while (shapeIndex != B2_NULL_INDEX)
@@ -791,13 +1269,14 @@ void b2World_Draw(b2WorldId worldId, b2DebugDraw* draw)
 				continue;
 			}
 
-			b2Transform transform = {body->position, body->transform.q};
+			b2BodySim* bodySim = world->bodySimArray + i;
+			b2Transform transform = {bodySim->position, bodySim->transform.q};
 			draw->DrawTransform(transform, draw->context);
 
 			b2Vec2 p = b2TransformPoint(transform, offset);
 
 			char buffer[32];
-			sprintf(buffer, "%.2f", body->mass);
+			sprintf(buffer, "%.2f", bodySim->mass);
 			draw->DrawString(p, buffer, draw->context);
 		}
 	}
@@ -828,14 +1307,15 @@ void b2World_Draw(b2WorldId worldId, b2DebugDraw* draw)
 			}
 
 			b2Contact* contact = world->contacts + index;
-			int pointCount = contact->manifold.pointCount;
+			const b2Manifold* manifold = b2GetContactManifold(world, contact);
+			int pointCount = manifold->pointCount;
 			int colorIndex = contact->colorIndex;
-			b2Vec2 normal = contact->manifold.normal;
+			b2Vec2 normal = manifold->normal;
 			char buffer[32];
 
 			for (int j = 0; j < pointCount; ++j)
 			{
-				b2ManifoldPoint* point = contact->manifold.points + j;
+				const b2ManifoldPoint* point = manifold->points + j;
 
 				if (draw->drawGraphColors && 0 <= colorIndex && colorIndex <= b2_graphColorCount)
 				{
@@ -941,18 +1421,18 @@ bool b2Body_IsValid(b2BodyId id)
 
 	b2World* world = b2_worlds + id.world;
 
-	if (id.index < 0 || world->bodyPool.capacity <= id.index)
+	if (id.index < 0 || world->bodyHandlePool.capacity <= id.index)
 	{
 		return false;
 	}
 
-	b2Body* body = world->bodies + id.index;
-	if (b2ObjectValid(&body->object) == false)
+	b2BodyHandle* handle = world->bodyHandles + id.index;
+	if (b2ObjectValid(&handle->object) == false)
 	{
 		return false;
 	}
 
-	return id.revision == body->object.revision;
+	return id.revision == handle->object.revision;
 }
 
 bool b2Shape_IsValid(b2ShapeId id)
@@ -1079,6 +1559,32 @@ void b2World_EnableContinuous(b2WorldId worldId, bool flag)
 	world->enableContinuous = flag;
 }
 
+void b2World_SetSpatialSortInterval(b2WorldId worldId, int32_t interval)
+{
+	b2World* world = b2GetWorldFromId(worldId);
+	B2_ASSERT(world->locked == false);
+	B2_ASSERT(interval >= 0);
+	if (world->locked)
+	{
+		return;
+	}
+
+	world->spatialSortInterval = B2_MAX(interval, 0);
+}
+
+void b2World_SetIslandSplitBudget(b2WorldId worldId, int32_t bodyCount)
+{
+	b2World* world = b2GetWorldFromId(worldId);
+	B2_ASSERT(world->locked == false);
+	B2_ASSERT(bodyCount >= 0);
+	if (world->locked)
+	{
+		return;
+	}
+
+	world->islandSplitBudget = B2_MAX(bodyCount, 0);
+}
+
 void b2World_SetRestitutionThreshold(b2WorldId worldId, float value)
 {
 	b2World* world = b2GetWorldFromId(worldId);
@@ -1126,6 +1632,12 @@ b2Counters b2World_GetCounters(b2WorldId worldId)
 	s.treeHeight = b2DynamicTree_GetHeight(tree);
 	s.stackCapacity = b2GetStackCapacity(world->stackAllocator);
 	s.stackUsed = b2GetMaxStackAllocation(world->stackAllocator);
+	for (uint32_t i = 0; i < world->workerCount; ++i)
+	{
+		b2StackAllocator* taskStack = world->taskContextArray[i].stackAllocator;
+		s.stackCapacity += b2GetStackCapacity(taskStack);
+		s.stackUsed += b2GetMaxStackAllocation(taskStack);
+	}
 	s.byteCount = b2GetByteCount();
 	s.taskCount = world->taskCount;
 	for (int32_t i = 0; i <= b2_graphColorCount; ++i)
@@ -1135,12 +1647,251 @@ b2Counters b2World_GetCounters(b2WorldId worldId)
 	return s;
 }
 
+static void b2AddPoolUsage(b2MemoryUsage* usage, const b2Pool* pool)
+{
+	usage->used += (int64_t)pool->count * pool->objectSize;
+	usage->reserved += (int64_t)pool->capacity * pool->objectSize;
+}
+
+static void b2AddArrayUsage(b2MemoryUsage* usage, const void* a, int32_t elementSize)
+{
+	usage->used += (int64_t)b2Array(a).count * elementSize;
+	usage->reserved += sizeof(b2ArrayHeader) + (int64_t)b2Array(a).capacity * elementSize;
+}
+
+static void b2AddBitSetUsage(b2MemoryUsage* usage, const b2BitSet* bitSet)
+{
+	usage->used += (int64_t)bitSet->blockCount * sizeof(uint64_t);
+	usage->reserved += (int64_t)bitSet->blockCapacity * sizeof(uint64_t);
+}
+
+static void b2AddSetUsage(b2MemoryUsage* usage, const b2HashSet* set)
+{
+	usage->used += (int64_t)set->count * sizeof(uint64_t);
+	usage->reserved += (int64_t)set->capacity * sizeof(uint64_t);
+}
+
+static void b2AddTreeUsage(b2MemoryUsage* usage, const b2DynamicTree* tree)
+{
+	usage->used += (int64_t)tree->nodeCount * sizeof(b2TreeNode);
+	usage->reserved += (int64_t)tree->nodeCapacity * sizeof(b2TreeNode);
+
+	// Rebuild scratch space. Which buffers exist depends on the rebuild heuristic.
+	int64_t rebuildSize = 0;
+	rebuildSize += tree->leafIndices != NULL ? sizeof(int32_t) : 0;
+	rebuildSize += tree->leafBoxes != NULL ? sizeof(b2AABB) : 0;
+	rebuildSize += tree->leafCenters != NULL ? sizeof(b2Vec2) : 0;
+	rebuildSize += tree->binIndices != NULL ? sizeof(int32_t) : 0;
+	usage->reserved += rebuildSize * tree->rebuildCapacity;
+}
+
+static void b2AddUsage(b2MemoryUsage* sum, b2MemoryUsage usage)
+{
+	sum->used += usage.used;
+	sum->reserved += usage.reserved;
+}
+
+b2MemoryStats b2World_GetMemoryStats(b2WorldId worldId)
+{
+	b2World* world = b2GetWorldFromId(worldId);
+	b2MemoryStats s = {0};
+
+	b2AddPoolUsage(&s.bodies, &world->bodyPool);
+	b2AddArrayUsage(&s.bodies, world->bodySimArray, sizeof(b2BodySim));
+	b2AddPoolUsage(&s.bodies, &world->bodyHandlePool);
+
+	b2AddPoolUsage(&s.shapes, &world->shapePool);
+	b2AddPoolUsage(&s.chains, &world->chainPool);
+
+	b2AddPoolUsage(&s.contacts, &world->contactPool);
+	b2AddPoolUsage(&s.contacts, &world->manifoldPool);
+	b2AddArrayUsage(&s.contacts, world->awakeContactArray, sizeof(int32_t));
+	b2AddArrayUsage(&s.contacts, world->contactAwakeIndexArray, sizeof(int32_t));
+
+	b2AddPoolUsage(&s.joints, &world->jointPool);
+
+	b2AddPoolUsage(&s.islands, &world->islandPool);
+	b2AddArrayUsage(&s.islands, world->awakeIslandArray, sizeof(int32_t));
+	b2AddArrayUsage(&s.islands, world->islandSplitArray, sizeof(b2IslandSplit));
+	b2AddArrayUsage(&s.islands, world->reservedIslandArray, sizeof(int32_t));
+
+	b2Graph* graph = &world->graph;
+	for (int32_t i = 0; i < b2_graphColorCount; ++i)
+	{
+		b2GraphColor* color = graph->colors + i;
+		b2AddBitSetUsage(&s.graph, &color->bodySet);
+		b2AddArrayUsage(&s.graph, color->contactArray, sizeof(int32_t));
+		b2AddArrayUsage(&s.graph, color->jointArray, sizeof(int32_t));
+	}
+	b2AddArrayUsage(&s.graph, graph->overflow.contactArray, sizeof(int32_t));
+	b2AddArrayUsage(&s.graph, graph->overflow.jointArray, sizeof(int32_t));
+
+	b2BroadPhase* bp = &world->broadPhase;
+	for (int32_t i = 0; i < b2_bodyTypeCount; ++i)
+	{
+		b2AddTreeUsage(&s.broadPhase, bp->trees + i);
+	}
+	b2AddArrayUsage(&s.broadPhase, bp->moveArray, sizeof(int32_t));
+
+	b2AddSetUsage(&s.hashSets, &bp->moveSet);
+	b2AddSetUsage(&s.hashSets, &bp->pairSet);
+
+	s.stackAllocator.used = b2GetMaxStackAllocation(world->stackAllocator);
+	s.stackAllocator.reserved = b2GetStackCapacity(world->stackAllocator);
+	for (uint32_t i = 0; i < world->workerCount; ++i)
+	{
+		b2StackAllocator* taskStack = world->taskContextArray[i].stackAllocator;
+		s.stackAllocator.used += b2GetMaxStackAllocation(taskStack);
+		s.stackAllocator.reserved += b2GetStackCapacity(taskStack);
+	}
+
+	s.blockAllocator.used = b2GetBlockAllocation(world->blockAllocator);
+	s.blockAllocator.reserved = b2GetBlockCapacity(world->blockAllocator);
+
+	b2AddArrayUsage(&s.taskContexts, world->taskContextArray, sizeof(b2TaskContext));
+	for (uint32_t i = 0; i < world->workerCount; ++i)
+	{
+		b2TaskContext* taskContext = world->taskContextArray + i;
+		b2AddBitSetUsage(&s.taskContexts, &taskContext->contactStateBitSet);
+		b2AddBitSetUsage(&s.taskContexts, &taskContext->awakeContactBitSet);
+		b2AddBitSetUsage(&s.taskContexts, &taskContext->shapeBitSet);
+		b2AddBitSetUsage(&s.taskContexts, &taskContext->compoundBitSet);
+		b2AddBitSetUsage(&s.taskContexts, &taskContext->fastBodyBitSet);
+		b2AddBitSetUsage(&s.taskContexts, &taskContext->awakeIslandBitSet);
+		b2AddArrayUsage(&s.taskContexts, taskContext->pendingManifoldArray, sizeof(b2PendingManifold));
+	}
+
+	b2MemoryUsage known = {0};
+	b2AddUsage(&known, s.bodies);
+	b2AddUsage(&known, s.shapes);
+	b2AddUsage(&known, s.chains);
+	b2AddUsage(&known, s.contacts);
+	b2AddUsage(&known, s.joints);
+	b2AddUsage(&known, s.islands);
+	b2AddUsage(&known, s.graph);
+	b2AddUsage(&known, s.broadPhase);
+	b2AddUsage(&known, s.hashSets);
+	b2AddUsage(&known, s.stackAllocator);
+	b2AddUsage(&known, s.blockAllocator);
+	b2AddUsage(&known, s.taskContexts);
+
+	// The allocator count is exact. Stack chunks added during a step are part of the stack capacity above, and
+	// the chunk and entry arrays of the stacks fall into other.
+	s.total.reserved = atomic_load_explicit(&world->allocator.byteCount, memory_order_relaxed);
+	s.other.reserved = B2_MAX(s.total.reserved - known.reserved, 0);
+	s.other.used = s.other.reserved;
+	s.total.used = known.used + s.other.used;
+
+	return s;
+}
+
+void b2World_Compact(b2WorldId worldId, bool defragment)
+{
+	b2World* world = b2GetWorldFromId(worldId);
+	B2_ASSERT(world->locked == false);
+	if (world->locked)
+	{
+		return;
+	}
+
+	if (defragment)
+	{
+		b2DefragmentBodies(world);
+	}
+
+	// Pools. Trimmed revisions carry over to regrown slots, so stale ids stay invalid.
+	b2ShrinkPool(&world->bodyPool, defragment);
+	b2ShrinkPool(&world->bodyHandlePool, defragment);
+	b2ShrinkPool(&world->shapePool, defragment);
+	b2ShrinkPool(&world->chainPool, defragment);
+	b2ShrinkPool(&world->contactPool, defragment);
+	b2ShrinkPool(&world->manifoldPool, defragment);
+	b2ShrinkPool(&world->jointPool, defragment);
+	b2ShrinkPool(&world->islandPool, defragment);
+
+	world->bodies = (b2Body*)world->bodyPool.memory;
+	world->bodyHandles = (b2BodyHandle*)world->bodyHandlePool.memory;
+	world->shapes = (b2Shape*)world->shapePool.memory;
+	world->chains = (b2ChainShape*)world->chainPool.memory;
+	world->contacts = (b2Contact*)world->contactPool.memory;
+	world->manifolds = (b2ContactManifold*)world->manifoldPool.memory;
+	world->joints = (b2Joint*)world->jointPool.memory;
+	world->islands = (b2Island*)world->islandPool.memory;
+
+	int32_t bodyCapacity = world->bodyPool.capacity;
+	int32_t contactCapacity = world->contactPool.capacity;
+
+	// Arrays that are parallel to pools
+	b2Array(world->bodySimArray).count = B2_MIN(b2Array(world->bodySimArray).count, bodyCapacity);
+	b2Array_Shrink((void**)&world->bodySimArray, sizeof(b2BodySim));
+	b2Array(world->contactAwakeIndexArray).count = B2_MIN(b2Array(world->contactAwakeIndexArray).count, contactCapacity);
+	b2Array_Shrink((void**)&world->contactAwakeIndexArray, sizeof(int32_t));
+
+	b2Array_Shrink((void**)&world->awakeContactArray, sizeof(int32_t));
+	b2Array_Shrink((void**)&world->awakeIslandArray, sizeof(int32_t));
+	b2Array_Shrink((void**)&world->islandSplitArray, sizeof(b2IslandSplit));
+	b2Array_Shrink((void**)&world->reservedIslandArray, sizeof(int32_t));
+
+	b2Graph* graph = &world->graph;
+	for (int32_t i = 0; i < b2_graphColorCount; ++i)
+	{
+		b2GraphColor* color = graph->colors + i;
+		b2ShrinkBitSet(&color->bodySet, bodyCapacity);
+		b2Array_Shrink((void**)&color->contactArray, sizeof(int32_t));
+		b2Array_Shrink((void**)&color->jointArray, sizeof(int32_t));
+	}
+	b2Array_Shrink((void**)&graph->overflow.contactArray, sizeof(int32_t));
+	b2Array_Shrink((void**)&graph->overflow.jointArray, sizeof(int32_t));
+
+	b2BroadPhase* bp = &world->broadPhase;
+	for (int32_t i = 0; i < b2_bodyTypeCount; ++i)
+	{
+		b2ShrinkDynamicTree(bp->trees + i);
+	}
+	b2Array_Shrink((void**)&bp->moveArray, sizeof(int32_t));
+	b2ShrinkSet(&bp->moveSet);
+	b2ShrinkSet(&bp->pairSet);
+
+	// Per thread scratch is sized again each step
+	for (uint32_t i = 0; i < world->workerCount; ++i)
+	{
+		b2TaskContext* taskContext = world->taskContextArray + i;
+		b2ShrinkBitSet(&taskContext->contactStateBitSet, contactCapacity);
+		b2ShrinkBitSet(&taskContext->awakeContactBitSet, contactCapacity);
+		b2ShrinkBitSet(&taskContext->shapeBitSet, world->shapePool.capacity);
+		b2ShrinkBitSet(&taskContext->compoundBitSet, bodyCapacity);
+		b2ShrinkBitSet(&taskContext->fastBodyBitSet, bodyCapacity);
+		b2ShrinkBitSet(&taskContext->awakeIslandBitSet, world->islandPool.capacity);
+		b2Array_Shrink((void**)&taskContext->pendingManifoldArray, sizeof(b2PendingManifold));
+		b2ShrinkStack(taskContext->stackAllocator);
+	}
+
+	int32_t sensorCount = b2Array(world->sensorArray).count;
+	for (int32_t i = 0; i < sensorCount; ++i)
+	{
+		b2Sensor* sensor = world->sensorArray + i;
+		b2Array_Shrink((void**)&sensor->overlaps1, sizeof(b2ShapeRef));
+		b2Array_Shrink((void**)&sensor->overlaps2, sizeof(b2ShapeRef));
+	}
+	b2Array_Shrink((void**)&world->sensorArray, sizeof(b2Sensor));
+
+	b2Array_Shrink((void**)&world->sensorBeginEventArray, sizeof(b2SensorBeginTouchEvent));
+	b2Array_Shrink((void**)&world->sensorEndEventArray, sizeof(b2SensorEndTouchEvent));
+	b2Array_Shrink((void**)&world->contactBeginArray, sizeof(b2ContactBeginTouchEvent));
+	b2Array_Shrink((void**)&world->contactEndArray, sizeof(b2ContactEndTouchEvent));
+
+	// The block allocator keeps its chunks for reuse by shape geometry
+	b2ShrinkStack(world->stackAllocator);
+}
+
 typedef struct WorldQueryContext
 {
 	b2World* world;
 	b2QueryResultFcn* fcn;
 	b2QueryFilter filter;
+	b2AABB aabb;
 	void* userContext;
+	bool proceed;
 } WorldQueryContext;
 
 static bool TreeQueryCallback(int32_t proxyId, int32_t shapeIndex, void* context)
@@ -1150,6 +1901,14 @@ static bool TreeQueryCallback(int32_t proxyId, int32_t shapeIndex, void* context
 	WorldQueryContext* worldContext = context;
 	b2World* world = worldContext->world;
 
+	if (B2_IS_COMPOUND_PROXY(shapeIndex))
+	{
+		b2Body* body = world->bodies + B2_COMPOUND_BODY_INDEX(shapeIndex);
+		B2_ASSERT(body->isCompound);
+		b2DynamicTree_Query(&body->shapeTree, worldContext->aabb, TreeQueryCallback, context);
+		return worldContext->proceed;
+	}
+
 	B2_ASSERT(0 <= shapeIndex && shapeIndex < world->shapePool.capacity);
 
 	b2Shape* shape = world->shapes + shapeIndex;
@@ -1165,6 +1924,7 @@ static bool TreeQueryCallback(int32_t proxyId, int32_t shapeIndex, void* context
 
 	b2ShapeId shapeId = {shape->object.index, world->index, shape->object.revision};
 	bool result = worldContext->fcn(shapeId, worldContext->userContext);
+	worldContext->proceed = result;
 	return result;
 }
 
@@ -1177,9 +1937,9 @@ void b2World_QueryAABB(b2WorldId worldId, b2QueryResultFcn* fcn, b2AABB aabb, b2
 		return;
 	}
 
-	WorldQueryContext worldContext = {world, fcn, filter, context};
+	WorldQueryContext worldContext = {world, fcn, filter, aabb, context, true};
 
-	for (int32_t i = 0; i < b2_bodyTypeCount; ++i)
+	for (int32_t i = 0; i < b2_bodyTypeCount && worldContext.proceed; ++i)
 	{
 		b2DynamicTree_Query(world->broadPhase.trees + i, aabb, TreeQueryCallback, &worldContext);
 	}
@@ -1192,7 +1952,9 @@ typedef struct WorldOverlapContext
 	b2QueryFilter filter;
 	b2DistanceProxy proxy;
 	b2Transform transform;
+	b2AABB aabb;
 	void* userContext;
+	bool proceed;
 } WorldOverlapContext;
 
 static bool TreeOverlapCallback(int32_t proxyId, int32_t shapeIndex, void* context)
@@ -1202,6 +1964,14 @@ static bool TreeOverlapCallback(int32_t proxyId, int32_t shapeIndex, void* conte
 	WorldOverlapContext* worldContext = context;
 	b2World* world = worldContext->world;
 
+	if (B2_IS_COMPOUND_PROXY(shapeIndex))
+	{
+		b2Body* body = world->bodies + B2_COMPOUND_BODY_INDEX(shapeIndex);
+		B2_ASSERT(body->isCompound);
+		b2DynamicTree_Query(&body->shapeTree, worldContext->aabb, TreeOverlapCallback, context);
+		return worldContext->proceed;
+	}
+
 	B2_ASSERT(0 <= shapeIndex && shapeIndex < world->shapePool.capacity);
 
 	b2Shape* shape = world->shapes + shapeIndex;
@@ -1215,23 +1985,16 @@ static bool TreeOverlapCallback(int32_t proxyId, int32_t shapeIndex, void* conte
 
 	B2_ASSERT(shape->object.index == shape->object.next);
 
-	b2DistanceInput input;
-	input.proxyA = worldContext->proxy;
-	input.proxyB = b2MakeShapeDistanceProxy(shape);
-	input.transformA = worldContext->transform;
-	input.transformB = world->bodies[shape->bodyIndex].transform;
-	input.useRadii = true;
-
-	b2DistanceCache cache = {0};
-	b2DistanceOutput output = b2ShapeDistance(&cache, &input);
-
-	if (output.distance > 0.0f)
+	b2Transform transform = world->bodySimArray[shape->bodyIndex].transform;
+	float distance = b2ComputeShapeDistance(shape, transform, &worldContext->proxy, worldContext->transform);
+	if (distance > 0.0f)
 	{
 		return true;
 	}
 
 	b2ShapeId shapeId = {shape->object.index, world->index, shape->object.revision};
 	bool result = worldContext->fcn(shapeId, worldContext->userContext);
+	worldContext->proceed = result;
 	return result;
 }
 
@@ -1247,10 +2010,10 @@ void b2World_OverlapCircle(b2WorldId worldId, b2QueryResultFcn* fcn, const b2Cir
 
 	b2AABB aabb = b2ComputeCircleAABB(circle, transform);
 	WorldOverlapContext worldContext = {
-		world, fcn, filter, b2MakeProxy(&circle->point, 1, circle->radius), transform, context,
+		world, fcn, filter, b2MakeProxy(&circle->point, 1, circle->radius), transform, aabb, context, true,
 	};
 
-	for (int32_t i = 0; i < b2_bodyTypeCount; ++i)
+	for (int32_t i = 0; i < b2_bodyTypeCount && worldContext.proceed; ++i)
 	{
 		b2DynamicTree_Query(world->broadPhase.trees + i, aabb, TreeOverlapCallback, &worldContext);
 	}
@@ -1268,10 +2031,10 @@ void b2World_OverlapCapsule(b2WorldId worldId, b2QueryResultFcn* fcn, const b2Ca
 
 	b2AABB aabb = b2ComputeCapsuleAABB(capsule, transform);
 	WorldOverlapContext worldContext = {
-		world, fcn, filter, b2MakeProxy(&capsule->point1, 2, capsule->radius), transform, context,
+		world, fcn, filter, b2MakeProxy(&capsule->point1, 2, capsule->radius), transform, aabb, context, true,
 	};
 
-	for (int32_t i = 0; i < b2_bodyTypeCount; ++i)
+	for (int32_t i = 0; i < b2_bodyTypeCount && worldContext.proceed; ++i)
 	{
 		b2DynamicTree_Query(world->broadPhase.trees + i, aabb, TreeOverlapCallback, &worldContext);
 	}
@@ -1289,10 +2052,10 @@ void b2World_OverlapPolygon(b2WorldId worldId, b2QueryResultFcn* fcn, const b2Po
 
 	b2AABB aabb = b2ComputePolygonAABB(polygon, transform);
 	WorldOverlapContext worldContext = {
-		world, fcn, filter, b2MakeProxy(polygon->vertices, polygon->count, polygon->radius), transform, context,
+		world, fcn, filter, b2MakeProxy(polygon->vertices, polygon->count, polygon->radius), transform, aabb, context, true,
 	};
 
-	for (int32_t i = 0; i < b2_bodyTypeCount; ++i)
+	for (int32_t i = 0; i < b2_bodyTypeCount && worldContext.proceed; ++i)
 	{
 		b2DynamicTree_Query(world->broadPhase.trees + i, aabb, TreeOverlapCallback, &worldContext);
 	}
@@ -1314,6 +2077,16 @@ static float RayCastCallback(const b2RayCastInput* input, int32_t proxyId, int32
 	WorldRayCastContext* worldContext = context;
 	b2World* world = worldContext->world;
 
+	if (B2_IS_COMPOUND_PROXY(shapeIndex))
+	{
+		// The shape tree is in world space so the input carries over
+		b2Body* body = world->bodies + B2_COMPOUND_BODY_INDEX(shapeIndex);
+		B2_ASSERT(body->isCompound);
+		worldContext->fraction = input->maxFraction;
+		b2DynamicTree_RayCast(&body->shapeTree, input, worldContext->filter.maskBits, RayCastCallback, context);
+		return worldContext->fraction;
+	}
+
 	B2_ASSERT(0 <= shapeIndex && shapeIndex < world->shapePool.capacity);
 
 	b2Shape* shape = world->shapes + shapeIndex;
@@ -1328,10 +2101,10 @@ static float RayCastCallback(const b2RayCastInput* input, int32_t proxyId, int32
 	int32_t bodyIndex = shape->bodyIndex;
 	B2_ASSERT(0 <= bodyIndex && bodyIndex < world->bodyPool.capacity);
 
-	b2Body* body = world->bodies + bodyIndex;
-	B2_ASSERT(b2ObjectValid(&body->object));
+	B2_ASSERT(b2ObjectValid(&world->bodies[bodyIndex].object));
 
-	b2RayCastOutput output = b2RayCastShape(input, shape, body->transform);
+	b2Transform transform = world->bodySimArray[bodyIndex].transform;
+	b2RayCastOutput output = b2RayCastShape(input, shape, transform);
 
 	if (output.hit)
 	{
@@ -1420,6 +2193,15 @@ static float ShapeCastCallback(const b2ShapeCastInput* input, int32_t proxyId, i
 	WorldRayCastContext* worldContext = context;
 	b2World* world = worldContext->world;
 
+	if (B2_IS_COMPOUND_PROXY(shapeIndex))
+	{
+		b2Body* body = world->bodies + B2_COMPOUND_BODY_INDEX(shapeIndex);
+		B2_ASSERT(body->isCompound);
+		worldContext->fraction = input->maxFraction;
+		b2DynamicTree_ShapeCast(&body->shapeTree, input, worldContext->filter.maskBits, ShapeCastCallback, context);
+		return worldContext->fraction;
+	}
+
 	B2_ASSERT(0 <= shapeIndex && shapeIndex < world->shapePool.capacity);
 
 	b2Shape* shape = world->shapes + shapeIndex;
@@ -1434,10 +2216,10 @@ static float ShapeCastCallback(const b2ShapeCastInput* input, int32_t proxyId, i
 	int32_t bodyIndex = shape->bodyIndex;
 	B2_ASSERT(0 <= bodyIndex && bodyIndex < world->bodyPool.capacity);
 
-	b2Body* body = world->bodies + bodyIndex;
-	B2_ASSERT(b2ObjectValid(&body->object));
+	B2_ASSERT(b2ObjectValid(&world->bodies[bodyIndex].object));
 
-	b2RayCastOutput output = b2ShapeCastShape(input, shape, body->transform);
+	b2Transform transform = world->bodySimArray[bodyIndex].transform;
+	b2RayCastOutput output = b2ShapeCastShape(input, shape, transform);
 
 	if (output.hit)
 	{
@@ -1647,18 +2429,18 @@ bool b2IsBodyIdValid(b2World* world, b2BodyId id)
 		return false;
 	}
 
-	if (id.index >= world->bodyPool.capacity)
+	if (id.index < 0 || id.index >= world->bodyHandlePool.capacity)
 	{
 		return false;
 	}
 
-	b2Body* body = world->bodies + id.index;
-	if (body->object.index != body->object.next)
+	b2BodyHandle* handle = world->bodyHandles + id.index;
+	if (handle->object.index != handle->object.next)
 	{
 		return false;
 	}
 
-	if (body->object.revision != id.revision)
+	if (handle->object.revision != id.revision)
 	{
 		return false;
 	}
@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include "allocate.h"
 #include "bitset.h"
 #include "broad_phase.h"
 #include "island.h"
@@ -29,8 +30,20 @@ typedef struct b2TaskContext
 	// Used to sort shapes that have enlarged AABBs
 	b2BitSet shapeBitSet;
 
+	// Used to sort compound bodies that have enlarged AABBs
+	b2BitSet compoundBitSet;
+
+	// Used to sort fast bodies for continuous collision
+	b2BitSet fastBodyBitSet;
+
 	// Used to wake islands
 	b2BitSet awakeIslandBitSet;
+
+	// Manifolds of contacts that started touching during the narrow-phase
+	struct b2PendingManifold* pendingManifoldArray;
+
+	// Scratch memory for tasks running on this thread. No lock needed.
+	struct b2StackAllocator* stackAllocator;
 } b2TaskContext;
 
 /// The world class manages all physics entities, dynamic simulation,
@@ -40,6 +53,9 @@ typedef struct b2World
 {
 	int16_t index;
 
+	// All world memory is allocated through this, see b2WorldDef::allocFcn
+	b2Allocator allocator;
+
 	struct b2BlockAllocator* blockAllocator;
 	struct b2StackAllocator* stackAllocator;
 
@@ -52,6 +68,8 @@ typedef struct b2World
 	b2Pool shapePool;
 	b2Pool chainPool;
 	b2Pool islandPool;
+	b2Pool manifoldPool;
+	b2Pool bodyHandlePool;
 
 	// These are sparse arrays that point into the pools above
 	struct b2Body* bodies;
@@ -60,6 +78,11 @@ typedef struct b2World
 	struct b2Shape* shapes;
 	struct b2ChainShape* chains;
 	struct b2Island* islands;
+	struct b2ContactManifold* manifolds;
+	struct b2BodyHandle* bodyHandles;
+
+	// Body simulation data, parallel to the body pool. Sparse like the pool.
+	struct b2BodySim* bodySimArray;
 
 	// Per thread storage
 	b2TaskContext* taskContextArray;
@@ -78,14 +101,17 @@ typedef struct b2World
 	// TODO_ERIN use a bit array somehow?
 	int32_t* contactAwakeIndexArray;
 
+	// Sensor array holds one entry per sensor shape. Sensors don't use contacts.
+	struct b2Sensor* sensorArray;
+
 	struct b2SensorBeginTouchEvent* sensorBeginEventArray;
 	struct b2SensorEndTouchEvent* sensorEndEventArray;
 	struct b2ContactBeginTouchEvent* contactBeginArray;
 	struct b2ContactEndTouchEvent* contactEndArray;
 
-	// Array of fast bodies that need continuous collision handling
+	// Array of fast bodies that need continuous collision handling, in body order
 	int32_t* fastBodies;
-	_Atomic int fastBodyCount;
+	int32_t fastBodyCount;
 
 	// Id that is incremented every time step
 	uint64_t stepId;
@@ -108,12 +134,40 @@ typedef struct b2World
 
 	uint32_t workerCount;
 	b2EnqueueTaskCallback* enqueueTaskFcn;
+	b2EnqueueTaskWithDependenciesCallback* enqueueTaskWithDependenciesFcn;
 	b2FinishTaskCallback* finishTaskFcn;
 	void* userTaskContext;
 
+	// Built-in task system, used when the world definition has no task callbacks
+	struct b2Scheduler* scheduler;
+
+	// The built-in threads are pinned and solver blocks are owned by threads, see b2WorldDef
+	bool enableWorkerAffinity;
+
 	void* userTreeTask;
 
-	int32_t splitIslandIndex;
+	// Step in flight, see b2World_StepAsync
+	bool asyncStepActive;
+	void* userStepTask;
+	float asyncTimeStep;
+	int32_t asyncVelocityIterations;
+	int32_t asyncRelaxIterations;
+
+	// The task setup of the world while it steps serially inside a user task, see b2BeginSerialStep
+	uint32_t savedWorkerCount;
+	b2EnqueueTaskCallback* savedEnqueueTaskFcn;
+	b2EnqueueTaskWithDependenciesCallback* savedEnqueueTaskWithDependenciesFcn;
+	b2FinishTaskCallback* savedFinishTaskFcn;
+
+	// Child islands being merged into their root islands, see b2MergeAwakeIslands
+	int32_t* mergeIslands;
+
+	// Islands being split this step and the islands reserved for them, see b2PrepareIslandSplits
+	struct b2IslandSplit* islandSplitArray;
+	int32_t* reservedIslandArray;
+
+	// Maximum number of bodies in the islands split per step. Zero splits a single island.
+	int32_t islandSplitBudget;
 
 	int32_t activeTaskCount;
 	int32_t taskCount;
@@ -122,6 +176,9 @@ typedef struct b2World
 	bool locked;
 	bool enableWarmStarting;
 	bool enableContinuous;
+
+	// Move awake bodies into space filling curve order every this many steps. Zero to disable.
+	int32_t spatialSortInterval;
 } b2World;
 
 b2World* b2GetWorldFromId(b2WorldId id);
@@ -10,6 +10,7 @@
 #include "TaskScheduler_c.h"
 
 #include <stdio.h>
+#include <string.h>
 
 #ifdef BOX2D_PROFILE
 #include <tracy/TracyC.h>
@@ -22,11 +23,17 @@ enum
 	e_columns = 10,
 	e_rows = 10,
 	e_count = e_columns * e_rows,
+	e_fastCount = 8,
+	e_bodyCount = e_count + e_fastCount,
 	e_maxTasks = 128,
 };
 
-b2Vec2 finalPositions[2][e_count];
-float finalAngles[2][e_count];
+b2Vec2 finalPositions[2][e_bodyCount];
+float finalAngles[2][e_bodyCount];
+
+// Contact events hashed in the order they are reported
+uint32_t eventHashes[2];
+int eventCounts[2];
 
 typedef struct TaskData
 {
@@ -45,6 +52,14 @@ void ExecuteRangeTask(uint32_t start, uint32_t end, uint32_t threadIndex, void*
 	data->box2dTask(start, end, threadIndex, data->box2dContext);
 }
 
+static uint32_t HashEvent(uint32_t hash, b2ShapeId shapeIdA, b2ShapeId shapeIdB)
+{
+	// FNV-1a
+	hash = (hash ^ (uint32_t)shapeIdA.index) * 16777619u;
+	hash = (hash ^ (uint32_t)shapeIdB.index) * 16777619u;
+	return hash;
+}
+
 static void* EnqueueTask(b2TaskCallback* box2dTask, int itemCount, int minRange, void* box2dContext, void* userContext)
 {
 	B2_MAYBE_UNUSED(userContext);
@@ -85,8 +100,37 @@ static void FinishTask(void* userTask, void* userContext)
 	enkiWaitForTaskSet(scheduler, task);
 }
 
-void TiltedStacks(int testIndex, int workerCount)
+// Simplest valid implementation: wait for the dependencies and then enqueue
+static void* EnqueueTaskWithDependencies(b2TaskCallback* box2dTask, int itemCount, int minRange, void* box2dContext,
+										 void** dependencies, int dependencyCount, void* userContext)
+{
+	for (int i = 0; i < dependencyCount; ++i)
+	{
+		enkiWaitForTaskSet(scheduler, dependencies[i]);
+	}
+
+	return EnqueueTask(box2dTask, itemCount, minRange, box2dContext, userContext);
+}
+
+typedef enum TaskMode
+{
+	// enkiTS through the task callbacks
+	e_enkiTasks,
+
+	// enkiTS with the dependency callback as well
+	e_enkiDependencies,
+
+	// The built-in thread pool
+	e_builtInScheduler,
+
+	// The built-in thread pool with pinned threads and solver blocks owned by threads
+	e_builtInAffinity,
+} TaskMode;
+
+void TiltedStacks(int testIndex, int workerCount, int spatialSortInterval, TaskMode taskMode)
 {
+	bool useBuiltInScheduler = taskMode == e_builtInScheduler || taskMode == e_builtInAffinity;
+
 	scheduler = enkiNewTaskScheduler();
 	struct enkiTaskSchedulerConfig config = enkiGetTaskSchedulerConfig(scheduler);
 	config.numTaskThreadsToCreate = workerCount - 1;
@@ -103,16 +147,19 @@ void TiltedStacks(int testIndex, int workerCount)
 	// Construct a world object, which will hold and simulate the rigid bodies.
 	b2WorldDef worldDef = b2_defaultWorldDef;
 	worldDef.gravity = gravity;
-	worldDef.enqueueTask = EnqueueTask;
-	worldDef.finishTask = FinishTask;
+	worldDef.enqueueTask = useBuiltInScheduler ? NULL : EnqueueTask;
+	worldDef.finishTask = useBuiltInScheduler ? NULL : FinishTask;
+	worldDef.enqueueTaskWithDependencies = taskMode == e_enkiDependencies ? EnqueueTaskWithDependencies : NULL;
 	worldDef.workerCount = workerCount;
+	worldDef.enableWorkerAffinity = taskMode == e_builtInAffinity;
 	worldDef.enableSleep = false;
+	worldDef.spatialSortInterval = spatialSortInterval;
 	worldDef.bodyCapacity = 1024;
 	worldDef.contactCapacity = 4 * 1024;
 
 	b2WorldId worldId = b2CreateWorld(&worldDef);
 
-	b2BodyId bodies[e_count];
+	b2BodyId bodies[e_bodyCount];
 
 	{
 		b2BodyDef bd = b2_defaultBodyDef;
@@ -122,6 +169,11 @@ void TiltedStacks(int testIndex, int workerCount)
 		b2Polygon box = b2MakeBox(1000.0f, 1.0f);
 		b2ShapeDef sd = b2_defaultShapeDef;
 		b2CreatePolygonShape(groundId, &sd, &box);
+
+		// Sensor over the lower rows of boxes
+		box = b2MakeOffsetBox(0.5f * e_columns * 5.0f, 2.0f, (b2Vec2){0.0f, 3.0f}, 0.0f);
+		sd.isSensor = true;
+		b2CreatePolygonShape(groundId, &sd, &box);
 	}
 
 	b2Polygon box = b2MakeRoundedBox(0.45f, 0.45f, 0.05f);
@@ -152,17 +204,69 @@ void TiltedStacks(int testIndex, int workerCount)
 		}
 	}
 
+	// Fast bodies that need continuous collision, dropped between the stacks at different times
+	{
+		b2Circle circle = {{0.0f, 0.0f}, 0.25f};
+		for (int i = 0; i < e_fastCount; ++i)
+		{
+			b2BodyDef bd = b2_defaultBodyDef;
+			bd.type = b2_dynamicBody;
+			bd.position = (b2Vec2){xroot + (i + 0.5f) * dx, 20.0f + 20.0f * i};
+			bd.linearVelocity = (b2Vec2){2.0f * (i - 4.0f), -100.0f};
+
+			b2BodyId bodyId = b2CreateBody(worldId, &bd);
+			bodies[e_count + i] = bodyId;
+
+			b2CreateCircleShape(bodyId, &sd, &circle);
+		}
+	}
+
 	float timeStep = 1.0f / 60.0f;
 	int velocityIterations = 6;
 	int relaxIterations = 2;
 
+	uint32_t hash = 2166136261u;
+	int eventCount = 0;
+
 	for (int i = 0; i < 100; ++i)
 	{
+		// Task sets are reused every step
+		taskCount = 0;
 		b2World_Step(worldId, timeStep, velocityIterations, relaxIterations);
 		TracyCFrameMark;
+
+		b2ContactEvents events = b2World_GetContactEvents(worldId);
+		for (int j = 0; j < events.beginCount; ++j)
+		{
+			hash = HashEvent(hash, events.beginEvents[j].shapeIdA, events.beginEvents[j].shapeIdB);
+			hash = (hash ^ (uint32_t)events.beginEvents[j].manifold.pointCount) * 16777619u;
+		}
+
+		for (int j = 0; j < events.endCount; ++j)
+		{
+			hash = HashEvent(hash, events.endEvents[j].shapeIdA, events.endEvents[j].shapeIdB);
+		}
+
+		eventCount += events.beginCount + events.endCount;
+
+		b2SensorEvents sensorEvents = b2World_GetSensorEvents(worldId);
+		for (int j = 0; j < sensorEvents.beginCount; ++j)
+		{
+			hash = HashEvent(hash, sensorEvents.beginEvents[j].sensorShapeId, sensorEvents.beginEvents[j].visitorShapeId);
+		}
+
+		for (int j = 0; j < sensorEvents.endCount; ++j)
+		{
+			hash = HashEvent(hash, sensorEvents.endEvents[j].sensorShapeId, sensorEvents.endEvents[j].visitorShapeId);
+		}
+
+		eventCount += sensorEvents.beginCount + sensorEvents.endCount;
 	}
 
-	for (int i = 0; i < e_count; ++i)
+	eventHashes[testIndex] = hash;
+	eventCounts[testIndex] = eventCount;
+
+	for (int i = 0; i < e_bodyCount; ++i)
 	{
 		finalPositions[testIndex][i] = b2Body_GetPosition(bodies[i]);
 		finalAngles[testIndex][i] = b2Body_GetAngle(bodies[i]);
@@ -178,17 +282,10 @@ void TiltedStacks(int testIndex, int workerCount)
 	enkiDeleteTaskScheduler(scheduler);
 }
 
-// Test multi-threaded determinism.
-int DeterminismTest(void)
+static int CompareFinalStates(void)
 {
-	// Test 1 : 4 threads
-	TiltedStacks(0, 16);
-
-	// Test 2 : 1 thread
-	TiltedStacks(1, 1);
-
 	// Both runs should produce identical results
-	for (int i = 0; i < e_count; ++i)
+	for (int i = 0; i < e_bodyCount; ++i)
 	{
 		b2Vec2 p1 = finalPositions[0][i];
 		b2Vec2 p2 = finalPositions[1][i];
@@ -200,5 +297,286 @@ int DeterminismTest(void)
 		ENSURE(a1 == a2);
 	}
 
+	// Contact events must come out in the same order
+	ENSURE(eventCounts[0] > 0);
+	ENSURE(eventCounts[0] == eventCounts[1]);
+	ENSURE(eventHashes[0] == eventHashes[1]);
+
+	return 0;
+}
+
+enum
+{
+	e_worldCount = 8,
+};
+
+static b2WorldId CreateColumnWorld(int rowCount, int workerCount, b2BodyId* topId)
+{
+	b2WorldDef worldDef = b2_defaultWorldDef;
+	worldDef.enableSleep = false;
+	worldDef.workerCount = workerCount;
+	worldDef.enqueueTask = workerCount > 1 ? EnqueueTask : NULL;
+	worldDef.finishTask = workerCount > 1 ? FinishTask : NULL;
+	b2WorldId worldId = b2CreateWorld(&worldDef);
+
+	b2BodyId groundId = b2CreateBody(worldId, &b2_defaultBodyDef);
+	b2Polygon ground = b2MakeBox(20.0f, 1.0f);
+	b2CreatePolygonShape(groundId, &b2_defaultShapeDef, &ground);
+
+	b2BodyDef bd = b2_defaultBodyDef;
+	bd.type = b2_dynamicBody;
+	b2Polygon box = b2MakeRoundedBox(0.45f, 0.45f, 0.05f);
+	for (int i = 0; i < rowCount; ++i)
+	{
+		bd.position = (b2Vec2){0.1f * i, 1.5f + 1.0f * i};
+		*topId = b2CreateBody(worldId, &bd);
+		b2CreatePolygonShape(*topId, &b2_defaultShapeDef, &box);
+	}
+
+	return worldId;
+}
+
+// Worlds stepped together in one parallel-for match worlds stepped one at a time. Worlds with
+// their own task system step serially inside the parallel-for, unless they hold most of the bodies.
+static int StepManyWorlds(void)
+{
+	scheduler = enkiNewTaskScheduler();
+	struct enkiTaskSchedulerConfig config = enkiGetTaskSchedulerConfig(scheduler);
+	config.numTaskThreadsToCreate = 3;
+	enkiInitTaskSchedulerWithConfig(scheduler, config);
+
+	for (int i = 0; i < e_maxTasks; ++i)
+	{
+		tasks[i] = enkiCreateTaskSet(scheduler, ExecuteRangeTask);
+	}
+
+	b2WorldId worldIds[2][e_worldCount];
+	b2BodyId topIds[2][e_worldCount];
+	for (int i = 0; i < e_worldCount; ++i)
+	{
+		worldIds[0][i] = CreateColumnWorld(2 + 3 * i, (i & 1) ? 4 : 1, topIds[0] + i);
+		worldIds[1][i] = CreateColumnWorld(2 + 3 * i, 1, topIds[1] + i);
+	}
+
+	for (int step = 0; step < 60; ++step)
+	{
+		taskCount = 0;
+		int stepCount = b2StepWorlds(worldIds[0], e_worldCount, 1.0f / 60.0f, 4, 2, EnqueueTask, FinishTask, NULL);
+		ENSURE(stepCount == e_worldCount);
+
+		// The worlds did not enqueue tasks of their own
+		ENSURE(taskCount == 1);
+
+		for (int i = 0; i < e_worldCount; ++i)
+		{
+			b2World_Step(worldIds[1][i], 1.0f / 60.0f, 4, 2);
+		}
+	}
+
+	for (int i = 0; i < e_worldCount; ++i)
+	{
+		b2Vec2 p1 = b2Body_GetPosition(topIds[0][i]);
+		b2Vec2 p2 = b2Body_GetPosition(topIds[1][i]);
+		ENSURE(p1.x == p2.x && p1.y == p2.y);
+		ENSURE(b2Body_GetAngle(topIds[0][i]) == b2Body_GetAngle(topIds[1][i]));
+	}
+
+	// A world with most of the bodies takes the parallel step on its own task system
+	b2BodyId largeTopIds[2];
+	b2WorldId largeIds[2] = {CreateColumnWorld(120, 4, largeTopIds + 0), CreateColumnWorld(120, 1, largeTopIds + 1)};
+	b2WorldId batchIds[3] = {worldIds[0][0], largeIds[0], worldIds[0][1]};
+
+	for (int step = 0; step < 30; ++step)
+	{
+		taskCount = 0;
+		int stepCount = b2StepWorlds(batchIds, 3, 1.0f / 60.0f, 4, 2, EnqueueTask, FinishTask, NULL);
+		ENSURE(stepCount == 3);
+		ENSURE(taskCount > 1);
+
+		// So does a lone world
+		taskCount = 0;
+		stepCount = b2StepWorlds(largeIds + 0, 1, 1.0f / 60.0f, 4, 2, EnqueueTask, FinishTask, NULL);
+		ENSURE(stepCount == 1);
+		ENSURE(taskCount > 0);
+
+		b2World_Step(largeIds[1], 1.0f / 60.0f, 4, 2);
+		b2World_Step(largeIds[1], 1.0f / 60.0f, 4, 2);
+	}
+
+	b2Vec2 p1 = b2Body_GetPosition(largeTopIds[0]);
+	b2Vec2 p2 = b2Body_GetPosition(largeTopIds[1]);
+	ENSURE(p1.x == p2.x && p1.y == p2.y);
+
+	b2DestroyWorld(largeIds[0]);
+	b2DestroyWorld(largeIds[1]);
+
+	// A locked world is skipped and left out of the count
+	b2World_StepAsync(worldIds[1][0], 1.0f / 60.0f, 4, 2);
+	taskCount = 0;
+	int stepCount = b2StepWorlds(worldIds[1], e_worldCount, 1.0f / 60.0f, 4, 2, EnqueueTask, FinishTask, NULL);
+	ENSURE(stepCount == e_worldCount - 1);
+	b2World_WaitStep(worldIds[1][0]);
+
+	for (int i = 0; i < e_worldCount; ++i)
+	{
+		b2DestroyWorld(worldIds[0][i]);
+		b2DestroyWorld(worldIds[1][i]);
+	}
+
+	for (int i = 0; i < e_maxTasks; ++i)
+	{
+		enkiDeleteTaskSet(scheduler, tasks[i]);
+	}
+
+	enkiDeleteTaskScheduler(scheduler);
+
+	return 0;
+}
+
+static uint32_t HashFloat(uint32_t hash, float value)
+{
+	// FNV-1a on the bits so that -0 and 0 differ
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(uint32_t));
+	return (hash ^ bits) * 16777619u;
+}
+
+// Hash of the final state of a small fixed scene
+static uint32_t HashFixedScene(int workerCount)
+{
+	b2WorldDef worldDef = b2_defaultWorldDef;
+	worldDef.workerCount = workerCount;
+	b2WorldId worldId = b2CreateWorld(&worldDef);
+
+	b2BodyId groundId = b2CreateBody(worldId, &b2_defaultBodyDef);
+	b2Polygon ground = b2MakeBox(40.0f, 1.0f);
+	b2CreatePolygonShape(groundId, &b2_defaultShapeDef, &ground);
+
+	enum
+	{
+		e_rowCount = 8,
+		e_sceneBodyCount = e_rowCount * (e_rowCount + 1) / 2 + 2,
+	};
+
+	b2BodyId bodyIds[e_sceneBodyCount];
+	int bodyCount = 0;
+
+	b2BodyDef bd = b2_defaultBodyDef;
+	bd.type = b2_dynamicBody;
+	b2ShapeDef sd = b2_defaultShapeDef;
+	sd.density = 1.0f;
+	sd.friction = 0.6f;
+
+	// Slightly rotated pyramid
+	b2Polygon box = b2MakeRoundedBox(0.4f, 0.4f, 0.1f);
+	for (int i = 0; i < e_rowCount; ++i)
+	{
+		for (int j = i; j < e_rowCount; ++j)
+		{
+			bd.position = (b2Vec2){1.05f * j - 0.525f * (e_rowCount + i), 1.0f + 1.05f * i};
+			bd.angle = 0.01f * (i - j);
+			bodyIds[bodyCount] = b2CreateBody(worldId, &bd);
+			b2CreatePolygonShape(bodyIds[bodyCount], &sd, &box);
+			bodyCount += 1;
+		}
+	}
+
+	// A spinning box thrown at the pyramid
+	bd.position = (b2Vec2){-12.0f, 6.0f};
+	bd.angle = 0.5f;
+	bd.linearVelocity = (b2Vec2){12.0f, 2.0f};
+	bd.angularVelocity = 7.0f;
+	bodyIds[bodyCount] = b2CreateBody(worldId, &bd);
+	b2CreatePolygonShape(bodyIds[bodyCount], &sd, &box);
+	bodyCount += 1;
+
+	// A fast circle for continuous collision
+	b2Circle circle = {{0.0f, 0.0f}, 0.25f};
+	bd.position = (b2Vec2){6.0f, 30.0f};
+	bd.angle = 0.0f;
+	bd.linearVelocity = (b2Vec2){-1.0f, -120.0f};
+	bd.angularVelocity = 0.0f;
+	bodyIds[bodyCount] = b2CreateBody(worldId, &bd);
+	b2CreateCircleShape(bodyIds[bodyCount], &sd, &circle);
+	bodyCount += 1;
+
+	for (int i = 0; i < 120; ++i)
+	{
+		b2World_Step(worldId, 1.0f / 60.0f, 4, 2);
+	}
+
+	uint32_t hash = 2166136261u;
+	for (int i = 0; i < bodyCount; ++i)
+	{
+		b2Vec2 p = b2Body_GetPosition(bodyIds[i]);
+		hash = HashFloat(hash, p.x);
+		hash = HashFloat(hash, p.y);
+		hash = HashFloat(hash, b2Body_GetAngle(bodyIds[i]));
+	}
+
+	b2DestroyWorld(worldId);
+	return hash;
+}
+
+// With BOX2D_STRICT_DETERMINISM the fixed scene must give this hash on every platform. Update it
+// when the simulation is changed on purpose.
+#define GOLDEN_HASH 0xa596feb5u
+
+static int GoldenHash(void)
+{
+	uint32_t hash = HashFixedScene(1);
+	ENSURE(HashFixedScene(4) == hash);
+
+#if defined(BOX2D_STRICT_DETERMINISM)
+	if (hash != GOLDEN_HASH)
+	{
+		printf("golden hash 0x%08x, expected 0x%08x\n", hash, GOLDEN_HASH);
+	}
+
+	ENSURE(hash == GOLDEN_HASH);
+#endif
+
+	return 0;
+}
+
+// Test multi-threaded determinism.
+int DeterminismTest(void)
+{
+	// Test 1 : 4 threads
+	TiltedStacks(0, 16, 0, e_enkiTasks);
+
+	// Test 2 : 1 thread
+	TiltedStacks(1, 1, 0, e_enkiTasks);
+
+	ENSURE(CompareFinalStates() == 0);
+
+	// Spatial sorting changes the solver order but must not depend on the thread count
+	TiltedStacks(0, 16, 4, e_enkiTasks);
+	TiltedStacks(1, 1, 4, e_enkiTasks);
+
+	ENSURE(CompareFinalStates() == 0);
+
+	// The built-in scheduler matches a single thread
+	TiltedStacks(0, 4, 0, e_builtInScheduler);
+	TiltedStacks(1, 1, 0, e_builtInScheduler);
+
+	ENSURE(CompareFinalStates() == 0);
+
+	// Pinned threads that own solver blocks match a single thread
+	TiltedStacks(0, 4, 0, e_builtInAffinity);
+	TiltedStacks(1, 1, 0, e_builtInScheduler);
+
+	ENSURE(CompareFinalStates() == 0);
+
+	// Tasks with dependencies match a single thread
+	TiltedStacks(0, 4, 0, e_enkiDependencies);
+	TiltedStacks(1, 1, 0, e_enkiTasks);
+
+	ENSURE(CompareFinalStates() == 0);
+
+	ENSURE(StepManyWorlds() == 0);
+
+	RUN_SUBTEST(GoldenHash);
+
 	return 0;
 }
@@ -4,9 +4,25 @@
 #include "box2d/constants.h"
 #include "box2d/distance.h"
 #include "box2d/math.h"
+#include "box2d/timer.h"
+#include "distance.h"
 #include "test_macros.h"
 
 #include <float.h>
+#include <math.h>
+
+// Regular polygon with counter-clockwise winding
+static b2DistanceProxy MakeRegularProxy(int32_t count, float radius)
+{
+	b2Vec2 vertices[b2_maxPolygonVertices];
+	for (int32_t i = 0; i < count; ++i)
+	{
+		float angle = 2.0f * b2_pi * i / count;
+		vertices[i] = (b2Vec2){radius * cosf(angle), radius * sinf(angle)};
+	}
+
+	return b2MakeProxy(vertices, count, 0.0f);
+}
 
 static int SegmentDistanceTest(void)
 {
@@ -113,12 +129,96 @@ static int TimeOfImpactTest(void)
 	return 0;
 }
 
+static int SupportTest(void)
+{
+	for (int32_t count = 1; count <= b2_maxPolygonVertices; ++count)
+	{
+		b2DistanceProxy proxy = MakeRegularProxy(count, 1.5f);
+
+		for (int32_t i = 0; i < 97; ++i)
+		{
+			float angle = 2.0f * b2_pi * i / 97.0f;
+			b2Vec2 direction = {cosf(angle), sinf(angle)};
+
+			int32_t index = b2FindSupportScalar(&proxy, direction);
+			ENSURE(b2FindSupportSIMD(&proxy, direction) == index);
+		}
+	}
+
+	return 0;
+}
+
+// Compare b2ShapeDistance against the scalar reference on many polygon pairs
+static int ShapeDistanceBenchmark(void)
+{
+	enum
+	{
+		e_pairCount = 4096,
+		e_iterations = 50,
+	};
+
+	b2DistanceProxy proxyA = MakeRegularProxy(b2_maxPolygonVertices, 1.0f);
+	b2DistanceProxy proxyB = MakeRegularProxy(b2_maxPolygonVertices, 0.5f);
+
+	b2DistanceInput input;
+	input.proxyA = proxyA;
+	input.proxyB = proxyB;
+	input.transformA = b2Transform_identity;
+	input.useRadii = false;
+
+	// Spiral of placements around shape A
+	static b2Transform transforms[e_pairCount];
+	for (int32_t i = 0; i < e_pairCount; ++i)
+	{
+		float angle = 0.01f * i;
+		float distance = 1.0f + 2.0f * i / e_pairCount;
+		transforms[i].p = (b2Vec2){distance * cosf(angle), distance * sinf(angle)};
+		transforms[i].q = b2MakeRot(0.3f * i);
+	}
+
+	float totals[2] = {0.0f, 0.0f};
+	float times[2] = {0.0f, 0.0f};
+
+	for (int32_t pass = 0; pass < 2; ++pass)
+	{
+		b2Timer timer = b2CreateTimer();
+
+		for (int32_t iter = 0; iter < e_iterations; ++iter)
+		{
+			for (int32_t i = 0; i < e_pairCount; ++i)
+			{
+				input.transformB = transforms[i];
+
+				b2DistanceCache cache = {0};
+				b2DistanceOutput output = pass == 0 ? b2ShapeDistanceScalar(&cache, &input) : b2ShapeDistance(&cache, &input);
+				totals[pass] += output.distance;
+			}
+		}
+
+		times[pass] = b2GetMilliseconds(&timer);
+	}
+
+	ENSURE(totals[0] == totals[1]);
+
+#if PRINT_BENCHMARKS
+	int32_t callCount = e_pairCount * e_iterations;
+	printf("distance: calls = %d, scalar = %.5f ms, simd = %.5f ms, ratio = %.2f\n", callCount, times[0], times[1],
+		   times[1] > 0.0f ? times[0] / times[1] : 0.0f);
+#else
+	B2_MAYBE_UNUSED(times);
+#endif
+
+	return 0;
+}
+
 int DistanceTest(void)
 {
 	RUN_SUBTEST(SegmentDistanceTest);
 	RUN_SUBTEST(ShapeDistanceTest);
 	RUN_SUBTEST(ShapeCastTest);
 	RUN_SUBTEST(TimeOfImpactTest);
+	RUN_SUBTEST(SupportTest);
+	RUN_SUBTEST(ShapeDistanceBenchmark);
 
 	return 0;
 }
@@ -5,6 +5,9 @@
 #include <stdio.h>
 #include <assert.h>
 
+// Set to 1 to print benchmark timings
+#define PRINT_BENCHMARKS 0
+
 #define RUN_TEST(T) \
 	do { \
 		int result = T(); \
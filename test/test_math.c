@@ -39,5 +39,20 @@ int MathTest(void)
 	ENSURE_SMALL(v.x - two.x, 8.0f * FLT_EPSILON);
 	ENSURE_SMALL(v.y - two.y, 8.0f * FLT_EPSILON);
 
+	// The portable trigonometry used by BOX2D_STRICT_DETERMINISM is close to the C library
+	for (int i = -1000; i <= 1000; ++i)
+	{
+		float angle = 0.01f * i;
+		b2Rot q = b2ComputeRot(angle);
+		ENSURE_SMALL(q.s - sinf(angle), 4.0f * FLT_EPSILON);
+		ENSURE_SMALL(q.c - cosf(angle), 4.0f * FLT_EPSILON);
+
+		float y = 3.0f * sinf(angle);
+		float x = 3.0f * cosf(angle);
+		ENSURE_SMALL(b2Atan2(y, x) - atan2f(y, x), 8.0f * FLT_EPSILON);
+	}
+
+	ENSURE(b2Atan2(0.0f, 0.0f) == 0.0f);
+
 	return 0;
 }
@@ -12,6 +12,8 @@ static b2Capsule capsule = {{-1.0f, 0.0f}, {1.0f, 0.0f}, 1.0f};
 static b2Circle circle = {{1.0f, 0.0f}, 1.0f};
 static b2Polygon box;
 static b2Segment segment = {{0.0f, 1.0f}, {0.0f, -1.0f}};
+static float heights[4] = {0.0f, 1.0f, 0.0f, 1.0f};
+static b2Heightfield heightfield;
 
 #define N 4
 
@@ -98,6 +100,15 @@ static int ShapeAABBTest(void)
 		ENSURE_SMALL(b.upperBound.y - 1.0f, FLT_EPSILON);
 	}
 
+	{
+		// The solid reaches one field width below the lowest sample
+		b2AABB b = b2ComputeHeightfieldAABB(&heightfield, b2Transform_identity);
+		ENSURE_SMALL(b.lowerBound.x, FLT_EPSILON);
+		ENSURE_SMALL(b.lowerBound.y + 3.0f, FLT_EPSILON);
+		ENSURE_SMALL(b.upperBound.x - 3.0f, FLT_EPSILON);
+		ENSURE_SMALL(b.upperBound.y - 1.0f, FLT_EPSILON);
+	}
+
 	return 0;
 }
 
@@ -153,12 +164,27 @@ static int RayCastShapeTest(void)
 		ENSURE_SMALL(output.fraction - 0.5f, FLT_EPSILON);
 	}
 
+	{
+		// Height fields are hit from above only
+		b2RayCastInput downInput = {{2.5f, 4.0f}, {0.0f, -8.0f}, 1.0f};
+		b2RayCastOutput output = b2RayCastHeightfield(&downInput, &heightfield);
+		ENSURE(output.hit);
+		ENSURE(output.normal.y > 0.0f);
+		ENSURE_SMALL(output.normal.x + output.normal.y, FLT_EPSILON);
+		ENSURE_SMALL(output.fraction - 3.5f / 8.0f, FLT_EPSILON);
+
+		b2RayCastInput upInput = {{2.5f, -4.0f}, {0.0f, 8.0f}, 1.0f};
+		output = b2RayCastHeightfield(&upInput, &heightfield);
+		ENSURE(output.hit == false);
+	}
+
 	return 0;
 }
 
 int ShapeTest(void)
 {
 	box = b2MakeBox(1.0f, 1.0f);
+	heightfield = b2MakeHeightfield(heights, 4, 1.0f);
 
 	RUN_SUBTEST(ShapeMassTest);
 	RUN_SUBTEST(ShapeAABBTest);
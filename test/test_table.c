@@ -5,11 +5,17 @@
 #include "table.h"
 #include "box2d/timer.h"
 
+#include <stdlib.h>
+
 #define SET_SPAN 317
 #define ITEM_COUNT ((SET_SPAN * SET_SPAN - SET_SPAN) / 2)
+#define BENCHMARK_COUNT (1024 * 1024)
 
+#if !NDEBUG
+extern int32_t g_probeCount;
+#endif
 
-int TableTest(void)
+static int SetTest(void)
 {
 	const int32_t N = SET_SPAN;
 	const uint32_t itemCount = ITEM_COUNT;
@@ -17,7 +23,7 @@ int TableTest(void)
 
 	for (int32_t iter = 0; iter < 1; ++iter)
 	{
-		b2HashSet set = b2CreateSet(16);
+		b2HashSet set = b2CreateSet(NULL, 16);
 
 		// Fill set
 		for (int32_t i = 0; i < N; ++i)
@@ -55,7 +61,6 @@ int TableTest(void)
 		ENSURE(set.count == (itemCount - removeCount));
 
 #if !NDEBUG
-		extern int32_t g_probeCount;
 		g_probeCount = 0;
 #endif
 
@@ -102,3 +107,96 @@ int TableTest(void)
 
 	return 0;
 }
+
+// Time the set with a million keys that look like broad-phase pairs. Each shape overlaps a few
+// neighbors with nearby indices.
+static int SetBenchmark(void)
+{
+	const int32_t keyCount = BENCHMARK_COUNT;
+	uint64_t* keys = malloc(keyCount * sizeof(uint64_t));
+
+	int32_t k = 0;
+	for (int32_t i = 0; k < keyCount; ++i)
+	{
+		for (int32_t j = 1; j <= 8 && k < keyCount; ++j)
+		{
+			int32_t other = i + 7 * j;
+			keys[k++] = B2_SHAPE_PAIR_KEY(i, other);
+		}
+	}
+
+	b2HashSet set = b2CreateSet(NULL, 16);
+
+	// add, hit, miss, remove
+	float times[4];
+
+	b2Timer timer = b2CreateTimer();
+	for (int32_t i = 0; i < keyCount; ++i)
+	{
+		ENSURE(b2AddKey(&set, keys[i]) == false);
+	}
+	times[0] = b2GetMilliseconds(&timer);
+
+	ENSURE(set.count == (uint32_t)keyCount);
+
+#if PRINT_BENCHMARKS && !NDEBUG
+	g_probeCount = 0;
+#endif
+
+	timer = b2CreateTimer();
+	for (int32_t i = 0; i < keyCount; ++i)
+	{
+		ENSURE(b2ContainsKey(&set, keys[i]));
+	}
+	times[1] = b2GetMilliseconds(&timer);
+
+#if PRINT_BENCHMARKS && !NDEBUG
+	int32_t hitProbeCount = g_probeCount;
+	g_probeCount = 0;
+#endif
+
+	// Neighbors at an offset that is not a multiple of 7 are never paired
+	timer = b2CreateTimer();
+	for (int32_t i = 0; i < keyCount; ++i)
+	{
+		ENSURE(b2ContainsKey(&set, keys[i] + 1) == false);
+	}
+	times[2] = b2GetMilliseconds(&timer);
+
+#if PRINT_BENCHMARKS && !NDEBUG
+	int32_t missProbeCount = g_probeCount;
+#endif
+
+	timer = b2CreateTimer();
+	for (int32_t i = 0; i < keyCount; ++i)
+	{
+		ENSURE(b2RemoveKey(&set, keys[i]));
+	}
+	times[3] = b2GetMilliseconds(&timer);
+
+	ENSURE(set.count == 0);
+
+#if PRINT_BENCHMARKS
+	printf("set: count = %d, capacity = %u, add = %.2f ms, hit = %.2f ms, miss = %.2f ms, remove = %.2f ms\n", keyCount,
+		   set.capacity, times[0], times[1], times[2], times[3]);
+
+#if !NDEBUG
+	printf("ave probe count: hit = %.2f, miss = %.2f\n", (float)hitProbeCount / keyCount, (float)missProbeCount / keyCount);
+#endif
+#else
+	B2_MAYBE_UNUSED(times);
+#endif
+
+	b2DestroySet(&set);
+	free(keys);
+
+	return 0;
+}
+
+int TableTest(void)
+{
+	RUN_SUBTEST(SetTest);
+	RUN_SUBTEST(SetBenchmark);
+
+	return 0;
+}
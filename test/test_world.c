@@ -6,7 +6,12 @@
 #include "box2d/math.h"
 #include "test_macros.h"
 
+#include "TaskScheduler_c.h"
+
+#include <float.h>
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 // This is a simple example of building and running a simulation
 // using Box2D. Here we create a large ground box and a small dynamic
@@ -166,11 +171,1281 @@ int DestroyAllBodiesWorld(void)
 	return 0;
 }
 
+static bool CountShapesCallback(b2ShapeId shapeId, void* context)
+{
+	B2_MAYBE_UNUSED(shapeId);
+	int* count = context;
+	*count += 1;
+	return true;
+}
+
+// Compound bodies use a single broad-phase proxy but should behave like regular bodies
+int CompoundBodyWorld(void)
+{
+	b2WorldId worldId = b2CreateWorld(&b2_defaultWorldDef);
+
+	// Static compound ground made of many boxes
+	b2BodyDef groundDef = b2_defaultBodyDef;
+	groundDef.isCompound = true;
+	b2BodyId groundId = b2CreateBody(worldId, &groundDef);
+
+	for (int i = 0; i < 20; ++i)
+	{
+		b2Polygon box = b2MakeOffsetBox(0.5f, 0.5f, (b2Vec2){-10.0f + 1.0f * i, -0.5f}, 0.0f);
+		b2CreatePolygonShape(groundId, &b2_defaultShapeDef, &box);
+	}
+
+	// Dynamic compound body made of three boxes, next to a regular body
+	b2BodyDef bodyDef = b2_defaultBodyDef;
+	bodyDef.type = b2_dynamicBody;
+	bodyDef.position = (b2Vec2){-3.0f, 2.0f};
+	bodyDef.isCompound = true;
+	b2BodyId compoundId = b2CreateBody(worldId, &bodyDef);
+
+	b2ShapeDef shapeDef = b2_defaultShapeDef;
+	shapeDef.density = 1.0f;
+	for (int i = 0; i < 3; ++i)
+	{
+		b2Polygon box = b2MakeOffsetBox(0.5f, 0.5f, (b2Vec2){-1.0f + 1.0f * i, 0.0f}, 0.0f);
+		b2CreatePolygonShape(compoundId, &shapeDef, &box);
+	}
+
+	bodyDef.isCompound = false;
+	bodyDef.position = (b2Vec2){3.0f, 2.0f};
+	b2BodyId regularId = b2CreateBody(worldId, &bodyDef);
+	for (int i = 0; i < 3; ++i)
+	{
+		b2Polygon box = b2MakeOffsetBox(0.5f, 0.5f, (b2Vec2){-1.0f + 1.0f * i, 0.0f}, 0.0f);
+		b2CreatePolygonShape(regularId, &shapeDef, &box);
+	}
+
+	for (int i = 0; i < 120; ++i)
+	{
+		b2World_Step(worldId, 1.0f / 60.0f, 4, 2);
+	}
+
+	b2Vec2 compoundPosition = b2Body_GetPosition(compoundId);
+	b2Vec2 regularPosition = b2Body_GetPosition(regularId);
+
+	// Both bodies rest on the ground at the same height
+	ENSURE(B2_ABS(compoundPosition.y - 0.5f) < 0.02f);
+	ENSURE(B2_ABS(compoundPosition.y - regularPosition.y) < 0.005f);
+	ENSURE(B2_ABS(b2Body_GetAngle(compoundId)) < 0.01f);
+
+	// Queries descend into the shape trees
+	int count = 0;
+	b2AABB box = {{-4.2f, -0.2f}, {-1.8f, 2.0f}};
+	b2World_QueryAABB(worldId, CountShapesCallback, box, b2_defaultQueryFilter, &count);
+
+	// 3 compound shapes and the 3 ground boxes under them
+	ENSURE(count == 6);
+
+	b2RayResult result = b2World_RayCastClosest(worldId, (b2Vec2){-3.0f, 5.0f}, (b2Vec2){0.0f, -10.0f}, b2_defaultQueryFilter);
+	ENSURE(result.hit);
+	ENSURE(B2_ID_EQUALS(b2Shape_GetBody(result.shapeId), compoundId));
+	ENSURE(B2_ABS(result.point.y - 1.0f) < 0.02f);
+
+	// Shapes can be removed from a compound body that is resting on a compound body
+	b2ShapeId shapeId = b2Body_GetFirstShape(compoundId);
+	b2DestroyShape(shapeId);
+
+	for (int i = 0; i < 10; ++i)
+	{
+		b2World_Step(worldId, 1.0f / 60.0f, 4, 2);
+	}
+
+	b2DestroyBody(compoundId);
+	b2World_Step(worldId, 1.0f / 60.0f, 4, 2);
+
+	b2DestroyWorld(worldId);
+
+	return 0;
+}
+
+// Height fields act as static terrain for every convex shape type
+int HeightfieldWorld(void)
+{
+	b2WorldId worldId = b2CreateWorld(&b2_defaultWorldDef);
+
+	// Flat in the middle with hills at the ends
+	float heights[41];
+	for (int i = 0; i < 41; ++i)
+	{
+		float x = -10.0f + 0.5f * i;
+		heights[i] = B2_ABS(x) < 6.0f ? 0.0f : 0.5f * (B2_ABS(x) - 6.0f);
+	}
+
+	b2BodyDef groundDef = b2_defaultBodyDef;
+	groundDef.position = (b2Vec2){-10.0f, 0.0f};
+	b2BodyId groundId = b2CreateBody(worldId, &groundDef);
+
+	b2Heightfield heightfield = b2MakeHeightfield(heights, 41, 0.5f);
+	b2ShapeId terrainId = b2CreateHeightfieldShape(groundId, &b2_defaultShapeDef, &heightfield);
+	ENSURE(b2Shape_GetType(terrainId) == b2_heightfieldShape);
+
+	b2BodyDef bodyDef = b2_defaultBodyDef;
+	bodyDef.type = b2_dynamicBody;
+
+	b2ShapeDef shapeDef = b2_defaultShapeDef;
+	shapeDef.density = 1.0f;
+
+	// Straddle cell boundaries to exercise manifold merging
+	bodyDef.position = (b2Vec2){-3.0f, 1.0f};
+	b2BodyId boxId = b2CreateBody(worldId, &bodyDef);
+	b2Polygon box = b2MakeBox(0.6f, 0.5f);
+	b2CreatePolygonShape(boxId, &shapeDef, &box);
+
+	bodyDef.position = (b2Vec2){0.0f, 1.0f};
+	b2BodyId circleId = b2CreateBody(worldId, &bodyDef);
+	b2Circle circle = {{0.0f, 0.0f}, 0.5f};
+	b2CreateCircleShape(circleId, &shapeDef, &circle);
+
+	bodyDef.position = (b2Vec2){3.0f, 1.0f};
+	b2BodyId capsuleId = b2CreateBody(worldId, &bodyDef);
+	b2Capsule capsule = {{-0.5f, 0.0f}, {0.5f, 0.0f}, 0.25f};
+	b2CreateCapsuleShape(capsuleId, &shapeDef, &capsule);
+
+	// Fast enough to tunnel without continuous collision
+	bodyDef.position = (b2Vec2){1.5f, 5.0f};
+	bodyDef.linearVelocity = (b2Vec2){0.0f, -300.0f};
+	b2BodyId fastId = b2CreateBody(worldId, &bodyDef);
+	b2Circle smallCircle = {{0.0f, 0.0f}, 0.1f};
+	b2CreateCircleShape(fastId, &shapeDef, &smallCircle);
+
+	for (int i = 0; i < 120; ++i)
+	{
+		b2World_Step(worldId, 1.0f / 60.0f, 4, 2);
+	}
+
+	ENSURE(B2_ABS(b2Body_GetPosition(boxId).y - 0.5f) < 0.02f);
+	ENSURE(B2_ABS(b2Body_GetAngle(boxId)) < 0.01f);
+	ENSURE(B2_ABS(b2Body_GetPosition(circleId).y - 0.5f) < 0.02f);
+	ENSURE(B2_ABS(b2Body_GetPosition(capsuleId).y - 0.25f) < 0.02f);
+	ENSURE(b2Body_GetPosition(fastId).y > 0.0f);
+
+	b2RayResult result = b2World_RayCastClosest(worldId, (b2Vec2){-8.0f, 5.0f}, (b2Vec2){0.0f, -10.0f}, b2_defaultQueryFilter);
+	ENSURE(result.hit);
+	ENSURE(B2_ID_EQUALS(result.shapeId, terrainId));
+	ENSURE(B2_ABS(result.point.y - 1.0f) < 0.001f);
+
+	int count = 0;
+	b2Circle probe = {{0.0f, 0.0f}, 0.1f};
+	b2World_OverlapCircle(worldId, CountShapesCallback, &probe, (b2Transform){{-5.0f, 0.05f}, b2Rot_identity},
+						  b2_defaultQueryFilter, &count);
+	ENSURE(count == 1);
+
+	// Deep below the surface is still inside the terrain
+	count = 0;
+	b2World_OverlapCircle(worldId, CountShapesCallback, &probe, (b2Transform){{-5.0f, -2.0f}, b2Rot_identity},
+						  b2_defaultQueryFilter, &count);
+	ENSURE(count == 1);
+	ENSURE(b2Shape_TestPoint(terrainId, (b2Vec2){-5.0f, -2.0f}));
+
+	b2DestroyShape(terrainId);
+	b2World_Step(worldId, 1.0f / 60.0f, 4, 2);
+
+	b2DestroyWorld(worldId);
+
+	return 0;
+}
+
+// Shapes resting in a valley touch both slopes and must be held up by both
+int HeightfieldValley(void)
+{
+	b2WorldId worldId = b2CreateWorld(&b2_defaultWorldDef);
+
+	// Two valleys with 45 degree slopes at x = -2.5 and x = 2.5
+	float heights[21];
+	for (int i = 0; i < 21; ++i)
+	{
+		float x = -5.0f + 0.5f * i;
+		heights[i] = B2_ABS(B2_ABS(x) - 2.5f);
+	}
+
+	b2BodyDef groundDef = b2_defaultBodyDef;
+	groundDef.position = (b2Vec2){-5.0f, 0.0f};
+	b2BodyId groundId = b2CreateBody(worldId, &groundDef);
+
+	b2Heightfield heightfield = b2MakeHeightfield(heights, 21, 0.5f);
+	b2CreateHeightfieldShape(groundId, &b2_defaultShapeDef, &heightfield);
+
+	b2BodyDef bodyDef = b2_defaultBodyDef;
+	bodyDef.type = b2_dynamicBody;
+	b2ShapeDef shapeDef = b2_defaultShapeDef;
+	shapeDef.density = 1.0f;
+
+	bodyDef.position = (b2Vec2){-2.5f, 2.0f};
+	b2BodyId circleId = b2CreateBody(worldId, &bodyDef);
+	b2Circle circle = {{0.0f, 0.0f}, 0.5f};
+	b2CreateCircleShape(circleId, &shapeDef, &circle);
+
+	bodyDef.position = (b2Vec2){2.5f, 2.0f};
+	b2BodyId boxId = b2CreateBody(worldId, &bodyDef);
+	b2Polygon box = b2MakeBox(0.5f, 0.5f);
+	b2CreatePolygonShape(boxId, &shapeDef, &box);
+
+	for (int i = 0; i < 120; ++i)
+	{
+		b2World_Step(worldId, 1.0f / 60.0f, 4, 2);
+	}
+
+	// The circle touches both slopes at 45 degrees
+	b2Vec2 p = b2Body_GetPosition(circleId);
+	ENSURE(B2_ABS(p.x + 2.5f) < 0.01f);
+	ENSURE(B2_ABS(p.y - 0.5f * sqrtf(2.0f)) < 0.02f);
+
+	// The box rests on its corners, one on each slope
+	p = b2Body_GetPosition(boxId);
+	ENSURE(B2_ABS(p.x - 2.5f) < 0.01f);
+	ENSURE(B2_ABS(p.y - 1.0f) < 0.02f);
+
+	b2DestroyWorld(worldId);
+
+	return 0;
+}
+
+// Builds a wavy chain and drops a box and a circle on it. Returns the resting heights.
+static void DropOnChain(bool useSegmentTree, int* shapeCount, float* boxY, float* circleY, b2RayResult* result)
+{
+	b2WorldId worldId = b2CreateWorld(&b2_defaultWorldDef);
+
+	enum
+	{
+		e_count = 202
+	};
+
+	b2Vec2 points[e_count];
+	for (int i = 0; i < e_count; ++i)
+	{
+		float x = -50.0f + 0.5f * i;
+		points[i] = (b2Vec2){x, 0.25f * sinf(0.2f * x)};
+	}
+
+	// Points run right to left so the chain collides from above
+	b2Vec2 reversed[e_count];
+	for (int i = 0; i < e_count; ++i)
+	{
+		reversed[i] = points[e_count - 1 - i];
+	}
+
+	b2BodyId groundId = b2CreateBody(worldId, &b2_defaultBodyDef);
+	b2ChainDef chainDef = b2_defaultChainDef;
+	chainDef.points = reversed;
+	chainDef.count = e_count;
+	chainDef.useSegmentTree = useSegmentTree;
+	b2ChainId chainId = b2CreateChain(groundId, &chainDef);
+
+	b2BodyDef bodyDef = b2_defaultBodyDef;
+	bodyDef.type = b2_dynamicBody;
+	b2ShapeDef shapeDef = b2_defaultShapeDef;
+	shapeDef.density = 1.0f;
+
+	bodyDef.position = (b2Vec2){-5.0f, 2.0f};
+	b2BodyId boxId = b2CreateBody(worldId, &bodyDef);
+	b2Polygon box = b2MakeBox(0.5f, 0.5f);
+	b2CreatePolygonShape(boxId, &shapeDef, &box);
+
+	bodyDef.position = (b2Vec2){5.0f, 2.0f};
+	b2BodyId circleId = b2CreateBody(worldId, &bodyDef);
+	b2Circle circle = {{0.0f, 0.0f}, 0.5f};
+	b2CreateCircleShape(circleId, &shapeDef, &circle);
+
+	for (int i = 0; i < 60; ++i)
+	{
+		b2World_Step(worldId, 1.0f / 60.0f, 4, 2);
+	}
+
+	*shapeCount = 0;
+	for (b2ShapeId shapeId = b2Body_GetFirstShape(groundId); B2_IS_NULL(shapeId) == false; shapeId = b2Body_GetNextShape(shapeId))
+	{
+		*shapeCount += 1;
+	}
+	*boxY = b2Body_GetPosition(boxId).y;
+	*circleY = b2Body_GetPosition(circleId).y;
+	*result = b2World_RayCastClosest(worldId, (b2Vec2){0.2f, 5.0f}, (b2Vec2){0.0f, -10.0f}, b2_defaultQueryFilter);
+
+	b2DestroyChain(chainId);
+	b2World_Step(worldId, 1.0f / 60.0f, 4, 2);
+
+	b2DestroyWorld(worldId);
+}
+
+// A chain stored as a single shape with a segment tree should behave like a chain of segment shapes
+int SegmentTreeChainWorld(void)
+{
+	int shapeCount1, shapeCount2;
+	float boxY1, boxY2, circleY1, circleY2;
+	b2RayResult result1, result2;
+
+	DropOnChain(false, &shapeCount1, &boxY1, &circleY1, &result1);
+	DropOnChain(true, &shapeCount2, &boxY2, &circleY2, &result2);
+
+	// One shape and broad-phase proxy per segment versus one for the whole chain
+	ENSURE(shapeCount1 == 199);
+	ENSURE(shapeCount2 == 1);
+
+	ENSURE(B2_ABS(boxY1 - boxY2) < 0.01f);
+	ENSURE(B2_ABS(circleY1 - circleY2) < 0.01f);
+
+	ENSURE(result1.hit && result2.hit);
+	ENSURE(B2_ABS(result1.point.y - result2.point.y) < FLT_EPSILON);
+	ENSURE(B2_ABS(result1.fraction - result2.fraction) < FLT_EPSILON);
+
+	return 0;
+}
+
+// Drops a box into a V shaped chain. Returns the resting position.
+static b2Vec2 DropInChainValley(bool useSegmentTree)
+{
+	b2WorldId worldId = b2CreateWorld(&b2_defaultWorldDef);
+
+	// Right to left so the chain collides from above
+	b2Vec2 points[] = {{6.0f, 6.0f}, {3.0f, 3.0f}, {0.0f, 0.0f}, {-3.0f, 3.0f}, {-6.0f, 6.0f}};
+
+	b2BodyId groundId = b2CreateBody(worldId, &b2_defaultBodyDef);
+	b2ChainDef chainDef = b2_defaultChainDef;
+	chainDef.points = points;
+	chainDef.count = 5;
+	chainDef.useSegmentTree = useSegmentTree;
+	b2CreateChain(groundId, &chainDef);
+
+	b2BodyDef bodyDef = b2_defaultBodyDef;
+	bodyDef.type = b2_dynamicBody;
+	bodyDef.position = (b2Vec2){0.0f, 2.0f};
+	b2BodyId boxId = b2CreateBody(worldId, &bodyDef);
+	b2ShapeDef shapeDef = b2_defaultShapeDef;
+	shapeDef.density = 1.0f;
+	b2Polygon box = b2MakeBox(0.5f, 0.5f);
+	b2CreatePolygonShape(boxId, &shapeDef, &box);
+
+	for (int i = 0; i < 120; ++i)
+	{
+		b2World_Step(worldId, 1.0f / 60.0f, 4, 2);
+	}
+
+	b2Vec2 p = b2Body_GetPosition(boxId);
+	b2DestroyWorld(worldId);
+	return p;
+}
+
+// At a concave corner the merged chain manifold must hold the box like separate segment contacts do
+int SegmentTreeChainValley(void)
+{
+	b2Vec2 p1 = DropInChainValley(false);
+	b2Vec2 p2 = DropInChainValley(true);
+
+	ENSURE(B2_ABS(p1.y - 1.0f) < 0.02f);
+	ENSURE(B2_ABS(p2.y - 1.0f) < 0.02f);
+	ENSURE(B2_ABS(p1.x - p2.x) < 0.01f);
+
+	return 0;
+}
+
+// Sensors report overlaps through events and don't create contacts
+int SensorWorld(void)
+{
+	b2WorldId worldId = b2CreateWorld(&b2_defaultWorldDef);
+
+	b2BodyId groundId = b2CreateBody(worldId, &b2_defaultBodyDef);
+	b2ShapeDef sensorDef = b2_defaultShapeDef;
+	sensorDef.isSensor = true;
+	b2Polygon box = b2MakeBox(2.0f, 1.0f);
+	b2ShapeId sensorId = b2CreatePolygonShape(groundId, &sensorDef, &box);
+
+	// Static and kinematic shapes don't pair with a static sensor, same as contacts
+	b2BodyDef bodyDef = b2_defaultBodyDef;
+	bodyDef.position = (b2Vec2){1.5f, 0.0f};
+	b2BodyId staticId = b2CreateBody(worldId, &bodyDef);
+	b2Polygon smallBox = b2MakeBox(0.25f, 0.25f);
+	b2CreatePolygonShape(staticId, &b2_defaultShapeDef, &smallBox);
+
+	bodyDef.type = b2_kinematicBody;
+	bodyDef.position = (b2Vec2){-1.5f, 0.0f};
+	b2BodyId kinematicId = b2CreateBody(worldId, &bodyDef);
+	b2CreatePolygonShape(kinematicId, &b2_defaultShapeDef, &smallBox);
+
+	bodyDef.type = b2_dynamicBody;
+	bodyDef.position = (b2Vec2){0.0f, 4.0f};
+	b2BodyId bodyId = b2CreateBody(worldId, &bodyDef);
+	b2Circle circle = {{0.0f, 0.0f}, 0.5f};
+	b2ShapeId visitorId = b2CreateCircleShape(bodyId, &b2_defaultShapeDef, &circle);
+
+	// Sensors don't detect each other, so this sensor passing through the static sensor adds no events
+	b2CreateCircleShape(bodyId, &sensorDef, &circle);
+
+	int beginCount = 0, endCount = 0;
+	int beginStep = -1, endStep = -1;
+	for (int i = 0; i < 120; ++i)
+	{
+		b2World_Step(worldId, 1.0f / 60.0f, 4, 2);
+
+		b2Counters counters = b2World_GetCounters(worldId);
+		ENSURE(counters.contactCount == 0);
+
+		b2SensorEvents events = b2World_GetSensorEvents(worldId);
+		for (int j = 0; j < events.beginCount; ++j)
+		{
+			ENSURE(B2_ID_EQUALS(events.beginEvents[j].sensorShapeId, sensorId));
+			ENSURE(B2_ID_EQUALS(events.beginEvents[j].visitorShapeId, visitorId));
+			beginCount += 1;
+			beginStep = i;
+		}
+
+		for (int j = 0; j < events.endCount; ++j)
+		{
+			ENSURE(B2_ID_EQUALS(events.endEvents[j].sensorShapeId, sensorId));
+			ENSURE(B2_ID_EQUALS(events.endEvents[j].visitorShapeId, visitorId));
+			endCount += 1;
+			endStep = i;
+		}
+	}
+
+	// The body falls through the sensor
+	ENSURE(b2Body_GetPosition(bodyId).y < -2.0f);
+	ENSURE(beginCount == 1 && endCount == 1);
+	ENSURE(0 <= beginStep && beginStep < endStep);
+
+	b2DestroyWorld(worldId);
+
+	return 0;
+}
+
+typedef struct AllocStats
+{
+	int64_t byteCount;
+	int allocCount;
+	int freeCount;
+} AllocStats;
+
+static void* CountingAlloc(uint32_t size, int32_t alignment, void* context)
+{
+	AllocStats* stats = context;
+	stats->byteCount += size;
+	stats->allocCount += 1;
+#if defined(_WIN32)
+	return _aligned_malloc(size, alignment);
+#else
+	return aligned_alloc(alignment, size);
+#endif
+}
+
+static void CountingFree(void* mem, uint32_t size, void* context)
+{
+	AllocStats* stats = context;
+	stats->byteCount -= size;
+	stats->freeCount += 1;
+#if defined(_WIN32)
+	_aligned_free(mem);
+#else
+	free(mem);
+#endif
+}
+
+static b2WorldId CreateStackWorld(AllocStats* stats, int count)
+{
+	b2WorldDef worldDef = b2_defaultWorldDef;
+	worldDef.allocFcn = CountingAlloc;
+	worldDef.freeFcn = CountingFree;
+	worldDef.allocContext = stats;
+	b2WorldId worldId = b2CreateWorld(&worldDef);
+
+	b2BodyId groundId = b2CreateBody(worldId, &b2_defaultBodyDef);
+	b2Segment segment = {{-20.0f, 0.0f}, {20.0f, 0.0f}};
+	b2CreateSegmentShape(groundId, &b2_defaultShapeDef, &segment);
+
+	b2BodyDef bodyDef = b2_defaultBodyDef;
+	bodyDef.type = b2_dynamicBody;
+	b2Polygon box = b2MakeBox(0.5f, 0.5f);
+	for (int i = 0; i < count; ++i)
+	{
+		bodyDef.position = (b2Vec2){0.0f, 0.5f + 1.0f * i};
+		b2BodyId bodyId = b2CreateBody(worldId, &bodyDef);
+		b2CreatePolygonShape(bodyId, &b2_defaultShapeDef, &box);
+	}
+
+	return worldId;
+}
+
+// Each world routes its memory through the allocator in its definition
+int AllocatorWorld(void)
+{
+	AllocStats stats1 = {0};
+	AllocStats stats2 = {0};
+
+	b2WorldId worldId1 = CreateStackWorld(&stats1, 10);
+	b2WorldId worldId2 = CreateStackWorld(&stats2, 100);
+
+	for (int i = 0; i < 60; ++i)
+	{
+		b2World_Step(worldId1, 1.0f / 60.0f, 4, 2);
+		b2World_Step(worldId2, 1.0f / 60.0f, 4, 2);
+	}
+
+	ENSURE(stats1.allocCount > 0 && stats2.allocCount > 0);
+	ENSURE(0 < stats1.byteCount && stats1.byteCount < stats2.byteCount);
+
+	b2DestroyWorld(worldId1);
+	ENSURE(stats1.byteCount == 0);
+	ENSURE(stats1.allocCount == stats1.freeCount);
+	ENSURE(stats2.byteCount > 0);
+
+	b2DestroyWorld(worldId2);
+	ENSURE(stats2.byteCount == 0);
+	ENSURE(stats2.allocCount == stats2.freeCount);
+
+	return 0;
+}
+
+// Memory stats are consistent with what the world allocated
+int MemoryStatsWorld(void)
+{
+	AllocStats stats = {0};
+	b2WorldId worldId = CreateStackWorld(&stats, 20);
+
+	for (int i = 0; i < 60; ++i)
+	{
+		b2World_Step(worldId, 1.0f / 60.0f, 4, 2);
+	}
+
+	b2MemoryStats memory = b2World_GetMemoryStats(worldId);
+
+	const b2MemoryUsage parts[] = {memory.bodies,		  memory.shapes,	   memory.chains,		  memory.contacts,
+								   memory.joints,		  memory.islands,	   memory.graph,		  memory.broadPhase,
+								   memory.hashSets,		  memory.stackAllocator, memory.blockAllocator, memory.taskContexts,
+								   memory.other};
+
+	int64_t reserved = 0;
+	for (int i = 0; i < (int)(sizeof(parts) / sizeof(parts[0])); ++i)
+	{
+		ENSURE(0 <= parts[i].used);
+		reserved += parts[i].reserved;
+	}
+
+	ENSURE(memory.bodies.used > 0 && memory.contacts.used > 0 && memory.broadPhase.used > 0);
+	ENSURE(memory.bodies.used <= memory.bodies.reserved);
+	ENSURE(memory.contacts.used <= memory.contacts.reserved);
+	ENSURE(reserved == memory.total.reserved);
+
+	// The allocator hooks see sizes rounded up for alignment
+	ENSURE(0 < memory.total.reserved && memory.total.reserved <= stats.byteCount);
+
+	b2DestroyWorld(worldId);
+
+	return 0;
+}
+
+// A stack allocator that starts too small grows in chunks and then stops allocating
+int StackAllocatorWorld(void)
+{
+	AllocStats stats = {0};
+
+	b2WorldDef worldDef = b2_defaultWorldDef;
+	worldDef.arenaAllocatorCapacity = 1024;
+	worldDef.allocFcn = CountingAlloc;
+	worldDef.freeFcn = CountingFree;
+	worldDef.allocContext = &stats;
+	b2WorldId worldId = b2CreateWorld(&worldDef);
+
+	b2BodyId groundId = b2CreateBody(worldId, &b2_defaultBodyDef);
+	b2Segment segment = {{-20.0f, 0.0f}, {20.0f, 0.0f}};
+	b2CreateSegmentShape(groundId, &b2_defaultShapeDef, &segment);
+
+	b2BodyDef bodyDef = b2_defaultBodyDef;
+	bodyDef.type = b2_dynamicBody;
+	bodyDef.enableSleep = false;
+	b2Polygon box = b2MakeBox(0.5f, 0.5f);
+	for (int i = 0; i < 50; ++i)
+	{
+		bodyDef.position = (b2Vec2){0.0f, 0.5f + 1.0f * i};
+		b2BodyId bodyId = b2CreateBody(worldId, &bodyDef);
+		b2CreatePolygonShape(bodyId, &b2_defaultShapeDef, &box);
+	}
+
+	for (int i = 0; i < 120; ++i)
+	{
+		b2World_Step(worldId, 1.0f / 60.0f, 4, 2);
+	}
+
+	b2Counters counters = b2World_GetCounters(worldId);
+	ENSURE(counters.stackUsed > 1024);
+	ENSURE(counters.stackUsed <= counters.stackCapacity);
+
+	// The settled stack keeps stepping without touching the heap
+	int allocCount = stats.allocCount;
+	for (int i = 0; i < 60; ++i)
+	{
+		b2World_Step(worldId, 1.0f / 60.0f, 4, 2);
+	}
+	ENSURE(stats.allocCount == allocCount);
+
+	b2DestroyWorld(worldId);
+	ENSURE(stats.byteCount == 0);
+	ENSURE(stats.allocCount == stats.freeCount);
+
+	return 0;
+}
+
+// A load spike followed by compaction gives memory back and the world keeps working
+int CompactWorld(void)
+{
+	AllocStats stats = {0};
+	b2WorldId worldId = CreateStackWorld(&stats, 20);
+
+	b2World_Step(worldId, 1.0f / 60.0f, 4, 2);
+	b2MemoryStats before = b2World_GetMemoryStats(worldId);
+
+	enum
+	{
+		e_spikeCount = 1000
+	};
+
+	b2BodyId* spikeIds = malloc(e_spikeCount * sizeof(b2BodyId));
+	b2BodyDef bodyDef = b2_defaultBodyDef;
+	bodyDef.type = b2_dynamicBody;
+	b2Polygon box = b2MakeBox(0.5f, 0.5f);
+	for (int i = 0; i < e_spikeCount; ++i)
+	{
+		bodyDef.position = (b2Vec2){-50.0f + 2.0f * (i % 50), 10.0f + 2.0f * (i / 50)};
+		spikeIds[i] = b2CreateBody(worldId, &bodyDef);
+		b2CreatePolygonShape(spikeIds[i], &b2_defaultShapeDef, &box);
+	}
+
+	for (int i = 0; i < 10; ++i)
+	{
+		b2World_Step(worldId, 1.0f / 60.0f, 4, 2);
+	}
+
+	b2MemoryStats spike = b2World_GetMemoryStats(worldId);
+	ENSURE(spike.total.reserved > before.total.reserved);
+
+	for (int i = 0; i < e_spikeCount; ++i)
+	{
+		b2DestroyBody(spikeIds[i]);
+	}
+	free(spikeIds);
+
+	b2World_Compact(worldId, true);
+
+	b2MemoryStats after = b2World_GetMemoryStats(worldId);
+	ENSURE(after.total.reserved < spike.total.reserved);
+	ENSURE(after.bodies.reserved < spike.bodies.reserved / 4);
+	ENSURE(after.shapes.reserved < spike.shapes.reserved / 4);
+	ENSURE(after.islands.reserved < spike.islands.reserved / 4);
+	ENSURE(after.broadPhase.reserved < spike.broadPhase.reserved / 4);
+	ENSURE(after.hashSets.reserved < spike.hashSets.reserved / 4);
+
+	// Compacting again releases nothing more
+	b2World_Compact(worldId, false);
+	b2MemoryStats again = b2World_GetMemoryStats(worldId);
+	ENSURE(again.bodies.reserved == after.bodies.reserved);
+
+	// The world grows again and the stack keeps simulating
+	bodyDef.position = (b2Vec2){5.0f, 1.0f};
+	b2BodyId bodyId = b2CreateBody(worldId, &bodyDef);
+	b2CreatePolygonShape(bodyId, &b2_defaultShapeDef, &box);
+
+	for (int i = 0; i < 60; ++i)
+	{
+		b2World_Step(worldId, 1.0f / 60.0f, 4, 2);
+	}
+
+	b2Vec2 position = b2Body_GetPosition(bodyId);
+	ENSURE(fabsf(position.y - 0.5f) < 0.05f);
+
+	b2DestroyWorld(worldId);
+	ENSURE(stats.byteCount == 0);
+
+	return 0;
+}
+
+// Ids held across compaction must not match objects created in the trimmed slots later
+int CompactStaleIds(void)
+{
+	b2WorldDef worldDef = b2_defaultWorldDef;
+	b2WorldId worldId = b2CreateWorld(&worldDef);
+
+	enum
+	{
+		e_count = 200
+	};
+
+	b2BodyId bodyIds[e_count];
+	b2ShapeId shapeIds[e_count];
+	b2BodyDef bodyDef = b2_defaultBodyDef;
+	bodyDef.type = b2_dynamicBody;
+	b2Polygon box = b2MakeBox(0.5f, 0.5f);
+	for (int i = 0; i < e_count; ++i)
+	{
+		bodyDef.position = (b2Vec2){2.0f * i, 0.0f};
+		bodyIds[i] = b2CreateBody(worldId, &bodyDef);
+		shapeIds[i] = b2CreatePolygonShape(bodyIds[i], &b2_defaultShapeDef, &box);
+	}
+
+	b2BodyId staleBodyIds[e_count];
+	b2ShapeId staleShapeIds[e_count];
+	for (int i = 0; i < e_count; ++i)
+	{
+		staleBodyIds[i] = bodyIds[i];
+		staleShapeIds[i] = shapeIds[i];
+		b2DestroyBody(bodyIds[i]);
+	}
+
+	b2World_Compact(worldId, true);
+
+	// Grow back into the trimmed slots
+	for (int i = 0; i < e_count; ++i)
+	{
+		bodyDef.position = (b2Vec2){2.0f * i, 0.0f};
+		bodyIds[i] = b2CreateBody(worldId, &bodyDef);
+		shapeIds[i] = b2CreatePolygonShape(bodyIds[i], &b2_defaultShapeDef, &box);
+	}
+
+	// The revision check rejects every stale id that lands on a reused slot
+	int reusedCount = 0;
+	for (int i = 0; i < e_count; ++i)
+	{
+		for (int k = 0; k < e_count; ++k)
+		{
+			if (bodyIds[k].index == staleBodyIds[i].index)
+			{
+				ENSURE(bodyIds[k].revision != staleBodyIds[i].revision);
+				reusedCount += 1;
+			}
+
+			if (shapeIds[k].index == staleShapeIds[i].index)
+			{
+				ENSURE(shapeIds[k].revision != staleShapeIds[i].revision);
+			}
+		}
+	}
+
+	ENSURE(reusedCount == e_count);
+
+	b2DestroyWorld(worldId);
+
+	return 0;
+}
+
+static bool SameBodyId(b2BodyId a, b2BodyId b)
+{
+	return a.index == b.index && a.world == b.world && a.revision == b.revision;
+}
+
+// Build a pyramid and return the top body
+static b2BodyId CreatePyramid(b2WorldId worldId, int baseCount)
+{
+	b2BodyId groundId = b2CreateBody(worldId, &b2_defaultBodyDef);
+	b2Segment segment = {{-40.0f, 0.0f}, {40.0f, 0.0f}};
+	b2CreateSegmentShape(groundId, &b2_defaultShapeDef, &segment);
+
+	b2BodyDef bodyDef = b2_defaultBodyDef;
+	bodyDef.type = b2_dynamicBody;
+	b2Polygon box = b2MakeBox(0.5f, 0.5f);
+	b2BodyId topId = b2_nullBodyId;
+	for (int i = 0; i < baseCount; ++i)
+	{
+		for (int j = i; j < baseCount; ++j)
+		{
+			bodyDef.position = (b2Vec2){(j - 0.5f * i) * 1.05f - 0.5f * baseCount, 0.5f + 1.0f * i};
+			topId = b2CreateBody(worldId, &bodyDef);
+			b2CreatePolygonShape(topId, &b2_defaultShapeDef, &box);
+		}
+	}
+
+	return topId;
+}
+
+// An asynchronous step gives the same result as a blocking step
+typedef struct AsyncTaskData
+{
+	b2TaskCallback* box2dTask;
+	void* box2dContext;
+} AsyncTaskData;
+
+static enkiTaskScheduler* asyncScheduler;
+static enkiTaskSet* asyncTask;
+static AsyncTaskData asyncTaskData;
+static bool asyncTaskBusy;
+static bool asyncTaskOverflow;
+
+static void ExecuteAsyncTask(uint32_t start, uint32_t end, uint32_t threadIndex, void* context)
+{
+	AsyncTaskData* data = context;
+	data->box2dTask(start, end, threadIndex, data->box2dContext);
+}
+
+// A single task set. Tasks that arrive while it is busy run right away.
+static void* EnqueueAsyncTask(b2TaskCallback* box2dTask, int itemCount, int minRange, void* box2dContext, void* userContext)
+{
+	B2_MAYBE_UNUSED(userContext);
+
+	if (asyncTaskBusy)
+	{
+		asyncTaskOverflow = true;
+		box2dTask(0, itemCount, 0, box2dContext);
+		return NULL;
+	}
+
+	asyncTaskBusy = true;
+	asyncTaskData.box2dTask = box2dTask;
+	asyncTaskData.box2dContext = box2dContext;
+
+	struct enkiParamsTaskSet params;
+	params.minRange = minRange;
+	params.setSize = itemCount;
+	params.pArgs = &asyncTaskData;
+	params.priority = 0;
+
+	enkiSetParamsTaskSet(asyncTask, params);
+	enkiAddTaskSet(asyncScheduler, asyncTask);
+
+	return asyncTask;
+}
+
+static void FinishAsyncTask(void* userTask, void* userContext)
+{
+	B2_MAYBE_UNUSED(userContext);
+
+	enkiWaitForTaskSet(asyncScheduler, userTask);
+	asyncTaskBusy = false;
+}
+
+int AsyncStepWorld(void)
+{
+	for (int workerCount = 1; workerCount <= 4; workerCount += 3)
+	{
+		b2WorldDef worldDef = b2_defaultWorldDef;
+		worldDef.workerCount = workerCount;
+		b2WorldId worldId1 = b2CreateWorld(&worldDef);
+		b2WorldId worldId2 = b2CreateWorld(&worldDef);
+		b2BodyId bodyId1 = CreatePyramid(worldId1, 10);
+		b2BodyId bodyId2 = CreatePyramid(worldId2, 10);
+
+		for (int i = 0; i < 60; ++i)
+		{
+			b2World_StepAsync(worldId2, 1.0f / 60.0f, 4, 2);
+			b2World_Step(worldId1, 1.0f / 60.0f, 4, 2);
+			b2World_WaitStep(worldId2);
+
+			// Waiting again does nothing
+			b2World_WaitStep(worldId2);
+		}
+
+		b2Vec2 p1 = b2Body_GetPosition(bodyId1);
+		b2Vec2 p2 = b2Body_GetPosition(bodyId2);
+		ENSURE(p1.x == p2.x && p1.y == p2.y);
+
+		// The world can be modified again after waiting
+		b2BodyId bodyId = b2CreateBody(worldId2, &b2_defaultBodyDef);
+		ENSURE(b2Body_IsValid(bodyId));
+
+		// Destroying a world waits for the step in flight
+		b2World_StepAsync(worldId2, 1.0f / 60.0f, 4, 2);
+		b2DestroyWorld(worldId2);
+		b2DestroyWorld(worldId1);
+	}
+
+	// With enkiTS the step is a single pool task that does not need the caller to finish
+	asyncScheduler = enkiNewTaskScheduler();
+	struct enkiTaskSchedulerConfig config = enkiGetTaskSchedulerConfig(asyncScheduler);
+	config.numTaskThreadsToCreate = 3;
+	enkiInitTaskSchedulerWithConfig(asyncScheduler, config);
+	asyncTask = enkiCreateTaskSet(asyncScheduler, ExecuteAsyncTask);
+
+	b2WorldId worldId1 = b2CreateWorld(&b2_defaultWorldDef);
+
+	b2WorldDef worldDef = b2_defaultWorldDef;
+	worldDef.workerCount = 4;
+	worldDef.enqueueTask = EnqueueAsyncTask;
+	worldDef.finishTask = FinishAsyncTask;
+	b2WorldId worldId2 = b2CreateWorld(&worldDef);
+
+	b2BodyId bodyId1 = CreatePyramid(worldId1, 10);
+	b2BodyId bodyId2 = CreatePyramid(worldId2, 10);
+
+	for (int i = 0; i < 60; ++i)
+	{
+		b2World_StepAsync(worldId2, 1.0f / 60.0f, 4, 2);
+		b2World_Step(worldId1, 1.0f / 60.0f, 4, 2);
+		b2World_WaitStep(worldId2);
+		ENSURE(asyncTaskBusy == false);
+	}
+
+	b2Vec2 p1 = b2Body_GetPosition(bodyId1);
+	b2Vec2 p2 = b2Body_GetPosition(bodyId2);
+	ENSURE(p1.x == p2.x && p1.y == p2.y);
+
+	// The step enqueues nothing else, so a single task set is enough
+	ENSURE(asyncTaskOverflow == false);
+
+	// A regular step still uses the task system
+	b2World_Step(worldId2, 1.0f / 60.0f, 4, 2);
+	ENSURE(asyncTaskOverflow);
+
+	b2DestroyWorld(worldId2);
+	b2DestroyWorld(worldId1);
+
+	enkiDeleteTaskSet(asyncScheduler, asyncTask);
+	enkiDeleteTaskScheduler(asyncScheduler);
+
+	return 0;
+}
+
+// Touching pairs of boxes fly apart in zero gravity. Every pair loses its contact in the same step.
+static int StepsToSplitPairs(int islandSplitBudget, int workerCount)
+{
+	enum
+	{
+		e_pairCount = 8
+	};
+
+	b2WorldDef worldDef = b2_defaultWorldDef;
+	worldDef.gravity = b2Vec2_zero;
+	worldDef.enableSleep = false;
+	worldDef.islandSplitBudget = islandSplitBudget;
+	worldDef.workerCount = workerCount;
+	b2WorldId worldId = b2CreateWorld(&worldDef);
+
+	b2BodyDef bodyDef = b2_defaultBodyDef;
+	bodyDef.type = b2_dynamicBody;
+	b2Polygon box = b2MakeBox(0.5f, 0.5f);
+	for (int i = 0; i < e_pairCount; ++i)
+	{
+		bodyDef.position = (b2Vec2){10.0f * i, 0.0f};
+		bodyDef.linearVelocity = (b2Vec2){-1.0f, 0.0f};
+		b2BodyId bodyId = b2CreateBody(worldId, &bodyDef);
+		b2CreatePolygonShape(bodyId, &b2_defaultShapeDef, &box);
+
+		bodyDef.position = (b2Vec2){10.0f * i + 1.0f, 0.0f};
+		bodyDef.linearVelocity = (b2Vec2){1.0f, 0.0f};
+		bodyId = b2CreateBody(worldId, &bodyDef);
+		b2CreatePolygonShape(bodyId, &b2_defaultShapeDef, &box);
+	}
+
+	// The pairs join into one island each and later split into two
+	int mergedStep = -1;
+	int splitStep = -1;
+	for (int i = 0; i < 120 && splitStep < 0; ++i)
+	{
+		b2World_Step(worldId, 1.0f / 60.0f, 4, 2);
+
+		int islandCount = b2World_GetCounters(worldId).islandCount;
+		if (mergedStep < 0 && islandCount == e_pairCount)
+		{
+			mergedStep = i;
+		}
+		else if (mergedStep >= 0 && islandCount == 2 * e_pairCount)
+		{
+			splitStep = i;
+		}
+	}
+
+	b2DestroyWorld(worldId);
+
+	return mergedStep >= 0 && splitStep >= 0 ? splitStep - mergedStep : -1;
+}
+
+// A split budget lets islands that lose contacts in the same step split in the same step
+int IslandSplitWorld(void)
+{
+	int serialSteps = StepsToSplitPairs(0, 1);
+	int budgetSteps = StepsToSplitPairs(1000, 4);
+	int smallBudgetSteps = StepsToSplitPairs(4, 4);
+
+	ENSURE(serialSteps > 0 && budgetSteps > 0 && smallBudgetSteps > 0);
+
+	// One island per step without a budget. A budget of four bodies fits two pairs per step.
+	ENSURE(budgetSteps < smallBudgetSteps && smallBudgetSteps < serialSteps);
+
+	// An island that breaks into more pieces than were reserved for it still splits in one step
+	for (int workerCount = 1; workerCount <= 4; workerCount += 3)
+	{
+		enum
+		{
+			e_chainCount = 20
+		};
+
+		b2WorldDef worldDef = b2_defaultWorldDef;
+		worldDef.gravity = b2Vec2_zero;
+		worldDef.enableSleep = false;
+		worldDef.workerCount = workerCount;
+		b2WorldId worldId = b2CreateWorld(&worldDef);
+
+		b2BodyDef bodyDef = b2_defaultBodyDef;
+		bodyDef.type = b2_dynamicBody;
+		b2Polygon box = b2MakeBox(0.25f, 0.25f);
+		b2BodyId bodyIds[e_chainCount];
+		b2JointId jointIds[e_chainCount - 1];
+		for (int i = 0; i < e_chainCount; ++i)
+		{
+			bodyDef.position = (b2Vec2){1.0f * i, 0.0f};
+			bodyIds[i] = b2CreateBody(worldId, &bodyDef);
+			b2CreatePolygonShape(bodyIds[i], &b2_defaultShapeDef, &box);
+
+			if (i > 0)
+			{
+				b2DistanceJointDef jointDef = b2_defaultDistanceJointDef;
+				jointDef.bodyIdA = bodyIds[i - 1];
+				jointDef.bodyIdB = bodyIds[i];
+				jointDef.length = 1.0f;
+				jointIds[i - 1] = b2CreateDistanceJoint(worldId, &jointDef);
+			}
+		}
+
+		b2World_Step(worldId, 1.0f / 60.0f, 4, 2);
+		ENSURE(b2World_GetCounters(worldId).islandCount == 1);
+
+		for (int i = 0; i < e_chainCount - 1; ++i)
+		{
+			b2DestroyJoint(jointIds[i]);
+		}
+
+		b2World_Step(worldId, 1.0f / 60.0f, 4, 2);
+		ENSURE(b2World_GetCounters(worldId).islandCount == e_chainCount);
+
+		b2World_Step(worldId, 1.0f / 60.0f, 4, 2);
+		ENSURE(b2World_GetCounters(worldId).islandCount == e_chainCount);
+
+		b2DestroyWorld(worldId);
+	}
+
+	return 0;
+}
+
+// Defragmenting moves bodies in memory but ids, shapes and joints keep working
+int DefragmentWorld(void)
+{
+	b2WorldId worldId = b2CreateWorld(&b2_defaultWorldDef);
+
+	b2BodyId groundId = b2CreateBody(worldId, &b2_defaultBodyDef);
+	b2Segment segment = {{-20.0f, 0.0f}, {20.0f, 0.0f}};
+	b2CreateSegmentShape(groundId, &b2_defaultShapeDef, &segment);
+
+	enum
+	{
+		e_count = 10
+	};
+
+	b2BodyId keepIds[e_count];
+	b2BodyId junkIds[e_count];
+
+	b2BodyDef bodyDef = b2_defaultBodyDef;
+	bodyDef.type = b2_dynamicBody;
+	b2Polygon box = b2MakeBox(0.5f, 0.5f);
+	for (int i = 0; i < e_count; ++i)
+	{
+		bodyDef.position = (b2Vec2){10.0f + 2.0f * i, 0.5f};
+		junkIds[i] = b2CreateBody(worldId, &bodyDef);
+		b2CreatePolygonShape(junkIds[i], &b2_defaultShapeDef, &box);
+
+		bodyDef.position = (b2Vec2){0.0f, 0.5f + 1.0f * i};
+		keepIds[i] = b2CreateBody(worldId, &bodyDef);
+		b2CreatePolygonShape(keepIds[i], &b2_defaultShapeDef, &box);
+	}
+
+	bodyDef.position = (b2Vec2){-5.0f, 0.5f};
+	bodyDef.isCompound = true;
+	b2BodyId compoundId = b2CreateBody(worldId, &bodyDef);
+	b2CreatePolygonShape(compoundId, &b2_defaultShapeDef, &box);
+	bodyDef.isCompound = false;
+
+	bodyDef.position = (b2Vec2){-10.0f, 5.0f};
+	b2BodyId pendulumId = b2CreateBody(worldId, &bodyDef);
+	b2CreatePolygonShape(pendulumId, &b2_defaultShapeDef, &box);
+
+	b2DistanceJointDef jointDef = b2_defaultDistanceJointDef;
+	jointDef.bodyIdA = groundId;
+	jointDef.bodyIdB = pendulumId;
+	jointDef.localAnchorA = (b2Vec2){-10.0f, 10.0f};
+	jointDef.length = 5.0f;
+	jointDef.minLength = 5.0f;
+	jointDef.maxLength = 5.0f;
+	b2JointId jointId = b2CreateDistanceJoint(worldId, &jointDef);
+
+	for (int i = 0; i < 30; ++i)
+	{
+		b2World_Step(worldId, 1.0f / 60.0f, 4, 2);
+	}
+
+	for (int i = 0; i < e_count; ++i)
+	{
+		b2DestroyBody(junkIds[i]);
+	}
+
+	b2Vec2 positions[e_count];
+	for (int i = 0; i < e_count; ++i)
+	{
+		positions[i] = b2Body_GetPosition(keepIds[i]);
+	}
+
+	b2World_Compact(worldId, true);
+
+	for (int i = 0; i < e_count; ++i)
+	{
+		ENSURE(b2Body_IsValid(keepIds[i]));
+		ENSURE(b2Body_IsValid(junkIds[i]) == false);
+
+		b2Vec2 p = b2Body_GetPosition(keepIds[i]);
+		ENSURE(p.x == positions[i].x && p.y == positions[i].y);
+
+		b2ShapeId shapeId = b2Body_GetFirstShape(keepIds[i]);
+		ENSURE(SameBodyId(b2Shape_GetBody(shapeId), keepIds[i]));
+	}
+
+	ENSURE(SameBodyId(b2Joint_GetBodyA(jointId), groundId));
+	ENSURE(SameBodyId(b2Joint_GetBodyB(jointId), pendulumId));
+
+	for (int i = 0; i < 60; ++i)
+	{
+		b2World_Step(worldId, 1.0f / 60.0f, 4, 2);
+	}
+
+	// The stack, the compound body and the pendulum kept simulating normally
+	b2Vec2 top = b2Body_GetPosition(keepIds[e_count - 1]);
+	ENSURE(fabsf(top.x) < 0.1f && fabsf(top.y - (0.5f + e_count - 1.0f)) < 0.1f);
+
+	b2Vec2 compoundPosition = b2Body_GetPosition(compoundId);
+	ENSURE(fabsf(compoundPosition.y - 0.5f) < 0.05f);
+
+	b2Vec2 pendulumPosition = b2Body_GetPosition(pendulumId);
+	float length = b2Length(b2Sub(pendulumPosition, jointDef.localAnchorA));
+	ENSURE(fabsf(length - jointDef.length) < 0.05f);
+
+	// New bodies get fresh ids
+	b2BodyId newId = b2CreateBody(worldId, &bodyDef);
+	ENSURE(b2Body_IsValid(newId));
+	for (int i = 0; i < e_count; ++i)
+	{
+		ENSURE(b2Body_IsValid(junkIds[i]) == false);
+	}
+
+	b2DestroyWorld(worldId);
+
+	return 0;
+}
+
+// Spatial sorting moves only the awake bodies. Sleeping bodies, joints and compound bodies keep working.
+int SpatialSortWorld(void)
+{
+	b2WorldDef worldDef = b2_defaultWorldDef;
+	worldDef.spatialSortInterval = 1;
+	b2WorldId worldId = b2CreateWorld(&worldDef);
+
+	b2BodyId groundId = b2CreateBody(worldId, &b2_defaultBodyDef);
+	b2Segment segment = {{-40.0f, 0.0f}, {40.0f, 0.0f}};
+	b2CreateSegmentShape(groundId, &b2_defaultShapeDef, &segment);
+
+	enum
+	{
+		e_count = 10
+	};
+
+	b2BodyId sleepIds[e_count];
+	b2BodyId awakeIds[e_count];
+
+	// Interleave sleeping and awake bodies in memory. The awake ones are created right to left.
+	b2BodyDef bodyDef = b2_defaultBodyDef;
+	bodyDef.type = b2_dynamicBody;
+	b2Polygon box = b2MakeBox(0.5f, 0.5f);
+	for (int i = 0; i < e_count; ++i)
+	{
+		bodyDef.isAwake = false;
+		bodyDef.position = (b2Vec2){-30.0f + 2.0f * i, 10.0f};
+		sleepIds[i] = b2CreateBody(worldId, &bodyDef);
+		b2CreatePolygonShape(sleepIds[i], &b2_defaultShapeDef, &box);
+
+		bodyDef.isAwake = true;
+		bodyDef.position = (b2Vec2){20.0f - 2.0f * i, 0.5f};
+		awakeIds[i] = b2CreateBody(worldId, &bodyDef);
+		b2CreatePolygonShape(awakeIds[i], &b2_defaultShapeDef, &box);
+	}
+
+	bodyDef.position = (b2Vec2){-5.0f, 0.5f};
+	bodyDef.isCompound = true;
+	b2BodyId compoundId = b2CreateBody(worldId, &bodyDef);
+	b2CreatePolygonShape(compoundId, &b2_defaultShapeDef, &box);
+	bodyDef.isCompound = false;
+
+	bodyDef.position = (b2Vec2){-10.0f, 5.0f};
+	b2BodyId pendulumId = b2CreateBody(worldId, &bodyDef);
+	b2CreatePolygonShape(pendulumId, &b2_defaultShapeDef, &box);
+
+	b2DistanceJointDef jointDef = b2_defaultDistanceJointDef;
+	jointDef.bodyIdA = groundId;
+	jointDef.bodyIdB = pendulumId;
+	jointDef.localAnchorA = (b2Vec2){-10.0f, 10.0f};
+	jointDef.length = 5.0f;
+	jointDef.minLength = 5.0f;
+	jointDef.maxLength = 5.0f;
+	b2JointId jointId = b2CreateDistanceJoint(worldId, &jointDef);
+
+	for (int i = 0; i < 60; ++i)
+	{
+		b2World_Step(worldId, 1.0f / 60.0f, 4, 2);
+	}
+
+	for (int i = 0; i < e_count; ++i)
+	{
+		ENSURE(b2Body_IsAwake(sleepIds[i]) == false);
+		b2Vec2 p = b2Body_GetPosition(sleepIds[i]);
+		ENSURE(p.x == -30.0f + 2.0f * i && p.y == 10.0f);
+
+		p = b2Body_GetPosition(awakeIds[i]);
+		ENSURE(fabsf(p.x - (20.0f - 2.0f * i)) < 0.01f && fabsf(p.y - 0.5f) < 0.01f);
+
+		b2ShapeId shapeId = b2Body_GetFirstShape(awakeIds[i]);
+		ENSURE(SameBodyId(b2Shape_GetBody(shapeId), awakeIds[i]));
+	}
+
+	ENSURE(SameBodyId(b2Joint_GetBodyA(jointId), groundId));
+	ENSURE(SameBodyId(b2Joint_GetBodyB(jointId), pendulumId));
+
+	b2Vec2 compoundPosition = b2Body_GetPosition(compoundId);
+	ENSURE(fabsf(compoundPosition.y - 0.5f) < 0.05f);
+
+	b2Vec2 pendulumPosition = b2Body_GetPosition(pendulumId);
+	float length = b2Length(b2Sub(pendulumPosition, jointDef.localAnchorA));
+	ENSURE(fabsf(length - jointDef.length) < 0.05f);
+
+	// Waking a sleeping body and dropping a body on the pile still works after many sorts
+	b2Body_Wake(sleepIds[0]);
+	bodyDef.position = (b2Vec2){20.0f, 3.0f};
+	b2BodyId dropId = b2CreateBody(worldId, &bodyDef);
+	b2CreatePolygonShape(dropId, &b2_defaultShapeDef, &box);
+
+	for (int i = 0; i < 60; ++i)
+	{
+		b2World_Step(worldId, 1.0f / 60.0f, 4, 2);
+	}
+
+	b2Vec2 dropPosition = b2Body_GetPosition(dropId);
+	ENSURE(fabsf(dropPosition.x - 20.0f) < 0.1f && fabsf(dropPosition.y - 1.5f) < 0.05f);
+
+	b2DestroyWorld(worldId);
+
+	return 0;
+}
+
 int WorldTest(void)
 {
 	RUN_SUBTEST(HelloWorld);
 	RUN_SUBTEST(EmptyWorld);
 	RUN_SUBTEST(DestroyAllBodiesWorld);
+	RUN_SUBTEST(CompoundBodyWorld);
+	RUN_SUBTEST(HeightfieldWorld);
+	RUN_SUBTEST(HeightfieldValley);
+	RUN_SUBTEST(SegmentTreeChainWorld);
+	RUN_SUBTEST(SegmentTreeChainValley);
+	RUN_SUBTEST(SensorWorld);
+	RUN_SUBTEST(AllocatorWorld);
+	RUN_SUBTEST(MemoryStatsWorld);
+	RUN_SUBTEST(StackAllocatorWorld);
+	RUN_SUBTEST(CompactWorld);
+	RUN_SUBTEST(CompactStaleIds);
+	RUN_SUBTEST(DefragmentWorld);
+	RUN_SUBTEST(SpatialSortWorld);
+	RUN_SUBTEST(AsyncStepWorld);
+	RUN_SUBTEST(IslandSplitWorld);
 
 	return 0;
 }